@@ -0,0 +1,223 @@
+/*
+ * Digest throughput benchmark.
+ *
+ * Runs the one shot function of every digest algorithm over message sizes
+ * from 8 bytes to 64 MiB, once on a 64 byte aligned buffer and once offset by
+ * a byte, and reports throughput, cycles per byte and latency per call. The
+ * results are also written as CSV, one row per algorithm, size and alignment,
+ * so runs from different commits can be compared with any diff or plot tool.
+ *
+ * Build it against the library sources, e.g.
+ *     cc -O2 -Iinclude -o bench_digest bench/digest.c src/[a-z]*.c -lpthread -ldl -lm
+ *
+ * Options:
+ *     --out=FILE      CSV output file, default bench_digest.csv.
+ *     --algo=NAME     Only run the named algorithm.
+ *     --max=BYTES     Largest message size, default 64 MiB.
+ *     --time=MS       Minimum measuring time per case, default 100 ms.
+ */
+#include <mx/digest.h>
+#include <mx/options.h>
+#include <mx/io/stream.h>
+#include <mx/cpu.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#if MX_CPU_X86
+    #if defined(_MSC_VER)
+        #include <intrin.h>
+    #else
+        #include <x86intrin.h>
+    #endif
+#endif
+
+/** Smallest and largest default message size. */
+#define BENCH_MIN_SIZE  8
+#define BENCH_MAX_SIZE  (64u << 20)
+/** Each measurement is repeated and the fastest run kept. */
+#define BENCH_REPEATS   5
+
+static const mx_digest_algorithm_t *const algorithms[] = {
+    &mx_digest_adler32,
+    &mx_digest_fvn0,
+    &mx_digest_fvn1,
+    &mx_digest_fvn1a,
+    &mx_digest_crc32,
+    &mx_digest_crc32c,
+    &mx_digest_sha256,
+    &mx_digest_wyhash64,
+};
+
+typedef struct bench_result_t {
+    double seconds;     /**< Seconds per call. */
+    double cycles;      /**< Reference cycles per call, 0 if unavailable. */
+} bench_result_t;
+
+static double bench_now(void)
+{
+#if _WIN32
+    LARGE_INTEGER freq, now;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&now);
+    return (double)now.QuadPart / (double)freq.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+#endif
+}
+
+static uint64_t bench_cycles(void)
+{
+#if MX_CPU_X86
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+/** Keep the compiler from discarding digests nobody reads. */
+static volatile unsigned char bench_sink;
+
+static bench_result_t bench_run(const mx_digest_algorithm_t *algo, const char *src, size_t length, double min_time)
+{
+    uint64_t digest[8];
+    bench_result_t best = { 0, 0 };
+    size_t calls = 1;
+
+    /* Warm up, and find a call count that runs for at least min_time. */
+    for (;;)
+    {
+        double start = bench_now();
+
+        for (size_t i = 0; i < calls; i++)
+            algo->digest(digest, src, length);
+
+        if (bench_now() - start >= min_time / BENCH_REPEATS || calls >= ((size_t)1 << 40))
+            break;
+
+        calls *= 2;
+    }
+
+    for (int r = 0; r < BENCH_REPEATS; r++)
+    {
+        double start = bench_now();
+        uint64_t c0 = bench_cycles();
+
+        for (size_t i = 0; i < calls; i++)
+            algo->digest(digest, src, length);
+
+        uint64_t c1 = bench_cycles();
+        double seconds = (bench_now() - start) / (double)calls;
+
+        if (r == 0 || seconds < best.seconds)
+        {
+            best.seconds = seconds;
+            best.cycles = (double)(c1 - c0) / (double)calls;
+        }
+    }
+
+    bench_sink ^= ((unsigned char*)digest)[0];
+    return best;
+}
+
+int main(int argc, char **argv)
+{
+    /* Copied, the parser reuses its key and value storage. */
+    char out[256] = "bench_digest.csv";
+    char only[64] = "";
+    size_t max_size = BENCH_MAX_SIZE;
+    double min_time = 0.1;
+    mx_optkind_t kind;
+
+    mx_options_begin(MX_OPT_UNIX, argc, argv);
+    mx_options_next(); /* Program name. */
+
+    while ((kind = mx_options_next()))
+    {
+        if (kind != MX_OPT_PAIR)
+        {
+            /* Only flags have a key. */
+            const char *arg = kind == MX_OPT_POSITIONAL ? mx_option_value
+                            : kind == MX_OPT_DASH ? "-"
+                            : kind == MX_OPT_DDASH ? "--"
+                            : mx_option_key;
+
+            fprintf(stderr, "unknown argument: %s\n", arg);
+            return 1;
+        }
+
+        if (strcmp(mx_option_key, "out") == 0)
+            snprintf(out, sizeof out, "%s", mx_option_value);
+        else if (strcmp(mx_option_key, "algo") == 0)
+            snprintf(only, sizeof only, "%s", mx_option_value);
+        else if (strcmp(mx_option_key, "max") == 0)
+            max_size = strtoull(mx_option_value, NULL, 0);
+        else if (strcmp(mx_option_key, "time") == 0)
+            min_time = strtod(mx_option_value, NULL) / 1000.0;
+        else
+        {
+            fprintf(stderr, "unknown option: %s\n", mx_option_key);
+            return 1;
+        }
+    }
+
+    /* One extra cache line for the unaligned run. */
+    char *buffer = malloc(max_size + 128);
+    if (!buffer)
+    {
+        fprintf(stderr, "could not allocate %zu bytes\n", max_size);
+        return 1;
+    }
+
+    char *aligned = (char*)(((uintptr_t)buffer + 63) & ~(uintptr_t)63);
+
+    for (size_t i = 0; i < max_size + 64; i++)
+        aligned[i] = (char)(i * 2654435761u >> 13);
+
+    fatptr_t(IStream) csv = mx_open(out, MX_OPEN_WRITE);
+    if (!csv.ptr)
+    {
+        fprintf(stderr, "could not open %s\n", out);
+        return 1;
+    }
+
+    IStream_printf(csv, "algorithm,size,offset,calls_per_sec,gb_per_sec,cycles_per_byte,ns_per_call\n");
+    printf("%-10s %10s %6s %10s %12s %12s\n", "algorithm", "size", "offset", "GB/s", "cycles/byte", "ns/call");
+
+    for (size_t a = 0; a < sizeof algorithms / sizeof *algorithms; a++)
+    {
+        const mx_digest_algorithm_t *algo = algorithms[a];
+
+        if (only[0] && strcmp(only, algo->name) != 0)
+            continue;
+
+        for (size_t size = BENCH_MIN_SIZE; size <= max_size; size = size < max_size && size * 4 > max_size ? max_size : size * 4)
+        {
+            for (int offset = 0; offset <= 1; offset++)
+            {
+                bench_result_t r = bench_run(algo, aligned + offset, size, min_time);
+                double gbps = (double)size / r.seconds * 1e-9;
+                double cpb = r.cycles / (double)size;
+                double ns = r.seconds * 1e9;
+
+                printf("%-10s %10zu %6d %10.3f %12.3f %12.1f\n", algo->name, size, offset, gbps, cpb, ns);
+                IStream_printf(csv, "%s,%zu,%d,%.1f,%.4f,%.4f,%.2f\n", algo->name, size, offset, 1.0 / r.seconds, gbps, cpb, ns);
+            }
+
+            if (size == max_size)
+                break;
+        }
+    }
+
+    IObject_destruct(IStream_AsIObject(csv));
+    free(buffer);
+    return 0;
+}
@@ -0,0 +1,249 @@
+#ifndef _MX_ARENA_H_
+#define _MX_ARENA_H_
+
+/**
+ * @file arena.h Allocators
+ *
+ * The IAllocator trait lets containers and streams allocate from something
+ * other than the C heap. Three allocators are provided:
+ *
+ * - The heap allocator, which forwards to malloc, realloc and free. This is
+ *   the default allocator until mx_set_allocator() is called.
+ * - The arena, which hands out memory by bumping a pointer through large
+ *   blocks. Freeing is a no-op except for the last allocation, and all
+ *   memory is released at once with mx_arena_reset().
+ * - The pool, which hands out objects of one fixed size from a free list.
+ *
+ * @code{c}
+ * mx_arena_t arena;
+ * mx_arena_init(&arena, 0);
+ *
+ * for (;;)
+ * {
+ *     int *list = NULL;
+ *     mx_list_init(list, mx_arena_allocator(&arena));
+ *     // ... request scoped work, no frees needed ...
+ *     mx_arena_reset(&arena);
+ * }
+ * @endcode
+ */
+
+#include "mx/base.h"
+#include "mx/trait.h"
+#include "mx/assert.h"
+
+/**
+ * Allocator traits.
+ */
+typedef struct IAllocator
+{
+    IObject Object;
+
+    /**
+     * Allocate memory.
+     * @param self Instance object.
+     * @param size Number of bytes.
+     * @param align Alignment, a power of two.
+     * @return The memory, or NULL.
+     */
+    void *(*alloc)(void *self, size_t size, size_t align);
+    /**
+     * Resize an allocation, moving it if needed.
+     * @param self Instance object.
+     * @param ptr The allocation, may be NULL.
+     * @param old_size The size it was allocated with.
+     * @param new_size The new size.
+     * @param align Alignment it was allocated with.
+     * @return The memory, or NULL. ptr is unchanged on failure.
+     */
+    void *(*realloc)(void *self, void *ptr, size_t old_size, size_t new_size, size_t align);
+    /**
+     * Release an allocation.
+     * @param self Instance object.
+     * @param ptr The allocation, may be NULL.
+     * @param size The size it was allocated with.
+     */
+    void  (*free)(void *self, void *ptr, size_t size);
+} IAllocator;
+fatptr_define(IAllocator);
+
+/** Alignment of the C heap, enough for any base type. */
+#define MX_ALLOC_ALIGN (_Alignof(max_align_t))
+
+MX_INLINE void *IAllocator_alloc(fatptr_t(IAllocator) alloc, size_t size, size_t align)
+{
+    return fatptr_vcall(alloc, alloc, size, align);
+}
+
+MX_INLINE void *IAllocator_realloc(fatptr_t(IAllocator) alloc, void *ptr, size_t old_size, size_t new_size, size_t align)
+{
+    return fatptr_vcall(alloc, realloc, ptr, old_size, new_size, align);
+}
+
+MX_INLINE void IAllocator_free(fatptr_t(IAllocator) alloc, void *ptr, size_t size)
+{
+    fatptr_vcall(alloc, free, ptr, size);
+}
+
+/**
+ * Get the allocator that forwards to malloc, realloc and free.
+ * @remarks Alignments above MX_ALLOC_ALIGN are not supported.
+ */
+MX_API fatptr_t(IAllocator) mx_heap_allocator(void);
+
+/**
+ * Get the default allocator, used when no allocator is given.
+ */
+MX_API fatptr_t(IAllocator) mx_get_allocator(void);
+
+/**
+ * Set the default allocator.
+ * @param[in] alloc The allocator. A NULL ptr restores the heap allocator.
+ * @remarks Objects must be freed with the allocator they were made with,
+ * change this before allocating anything.
+ */
+MX_API void mx_set_allocator(fatptr_t(IAllocator) alloc);
+
+/**
+ * Internal function that resolves a NULL allocator to the default.
+ */
+MX_INLINE fatptr_t(IAllocator) __mx_allocator(fatptr_t(IAllocator) alloc)
+{
+    return alloc.traits == NULL ? mx_get_allocator() : alloc;
+}
+
+typedef struct mx_arena_block_t mx_arena_block_t;
+
+/**
+ * Bump allocator.
+ */
+typedef struct mx_arena_t
+{
+    char *ptr;                  /**< Next free byte. */
+    char *end;                  /**< End of the current block. */
+    char *last;                 /**< Last allocation, can be resized in place. */
+    mx_arena_block_t *block;    /**< Current block, linked to the previous. */
+    mx_arena_block_t *spare;    /**< Blocks released by reset, for reuse. */
+    size_t block_size;          /**< Default size of a block. */
+} mx_arena_t;
+
+/**
+ * Initialize an arena.
+ * @param[out] arena The arena.
+ * @param[in] block_size Size of the blocks taken from the heap, 0 for 64 KiB.
+ * Larger allocations get a block of their own.
+ */
+MX_API void mx_arena_init(mx_arena_t *arena, size_t block_size);
+
+/**
+ * Release all memory of the arena to the heap.
+ * @param[in] arena The arena.
+ */
+MX_API void mx_arena_destroy(mx_arena_t *arena);
+
+/**
+ * Free every allocation at once. The blocks are kept for reuse.
+ * @param[in] arena The arena.
+ */
+MX_API void mx_arena_reset(mx_arena_t *arena);
+
+/**
+ * Internal function that allocates from a new block.
+ */
+MX_API void *__mx_arena_alloc_slow(mx_arena_t *arena, size_t size, size_t align);
+
+/**
+ * Allocate memory from an arena.
+ * @param[in] arena The arena.
+ * @param[in] size Number of bytes.
+ * @param[in] align Alignment, a power of two.
+ * @return The memory, or NULL if the heap is out of memory.
+ */
+MX_INLINE void *mx_arena_alloc(mx_arena_t *arena, size_t size, size_t align)
+{
+    char *ptr = (char*)(((uintptr_t)arena->ptr + (align - 1)) & ~(uintptr_t)(align - 1));
+
+    if (arena->ptr == NULL || ptr > arena->end || (size_t)(arena->end - ptr) < size)
+        return __mx_arena_alloc_slow(arena, size, align);
+
+    arena->ptr = ptr + size;
+    MX_ASSERT(arena->ptr <= arena->end, "Arena allocation must stay inside its block.");
+    arena->last = ptr;
+    return ptr;
+}
+
+/**
+ * Get an allocator for the arena.
+ * @param[in] arena The arena, must outlive the allocator.
+ */
+MX_API fatptr_t(IAllocator) mx_arena_allocator(mx_arena_t *arena);
+
+typedef struct mx_pool_block_t mx_pool_block_t;
+
+/**
+ * Fixed size object pool.
+ */
+typedef struct mx_pool_t
+{
+    void *free;                 /**< Free list, linked through the objects. */
+    mx_pool_block_t *block;     /**< Allocated blocks. */
+    size_t size;                /**< Object size. */
+    size_t count;               /**< Objects per block. */
+} mx_pool_t;
+
+/**
+ * Initialize a pool.
+ * @param[out] pool The pool.
+ * @param[in] size Size of the objects. Smaller allocations are allowed.
+ * @param[in] count Objects allocated at once, 0 for a block of about 64 KiB.
+ */
+MX_API void mx_pool_init(mx_pool_t *pool, size_t size, size_t count);
+
+/**
+ * Release all objects of the pool to the heap.
+ * @param[in] pool The pool.
+ */
+MX_API void mx_pool_destroy(mx_pool_t *pool);
+
+/**
+ * Internal function that refills the free list.
+ */
+MX_API bool __mx_pool_refill(mx_pool_t *pool);
+
+/**
+ * Allocate an object from a pool.
+ * @param[in] pool The pool.
+ * @return The object, or NULL if the heap is out of memory.
+ */
+MX_INLINE void *mx_pool_alloc(mx_pool_t *pool)
+{
+    if (pool->free == NULL && !__mx_pool_refill(pool))
+        return NULL;
+
+    void *ptr = pool->free;
+    pool->free = *(void**)ptr;
+    return ptr;
+}
+
+/**
+ * Return an object to a pool.
+ * @param[in] pool The pool.
+ * @param[in] ptr The object, may be NULL.
+ */
+MX_INLINE void mx_pool_free(mx_pool_t *pool, void *ptr)
+{
+    if (ptr == NULL)
+        return;
+
+    *(void**)ptr = pool->free;
+    pool->free = ptr;
+}
+
+/**
+ * Get an allocator for the pool.
+ * @param[in] pool The pool, must outlive the allocator.
+ * @remarks Allocations larger than the object size fail.
+ */
+MX_API fatptr_t(IAllocator) mx_pool_allocator(mx_pool_t *pool);
+
+#endif
@@ -9,6 +9,6 @@
 #define MX_IMPL
 #define MX_INLINE inline static
 
-typedef int32_t mx_len_t;
+typedef int64_t mx_len_t;
 
 #endif
\ No newline at end of file
@@ -0,0 +1,232 @@
+#ifndef _MX_BITSET_H_
+#define _MX_BITSET_H_
+
+/**
+ * @file bitset.h Bitsets
+ *
+ * A packed array of bits, 64 to a word, for flags that would otherwise take a
+ * byte each in a list of bools. Whole-set AND, OR, XOR and ANDNOT run 256 bits
+ * per step with AVX2 and counting uses the popcnt instruction when the CPU
+ * has them.
+ *
+ * A bitset either owns growable storage or wraps a fixed array supplied by
+ * the caller. Bits past the size are kept clear in the last word, so counting
+ * and searching never look at the size again.
+ *
+ * mx_bitset_rank_t is a read-only index built over a bitset that answers
+ * rank (set bits before a position) in constant time and select (position of
+ * the n-th set bit) in logarithmic time, for about 3% extra memory.
+ *
+ * @code{c}
+ * mx_bitset_t dirty;
+ * mx_bitset_init(&dirty, pages);
+ *
+ * mx_bitset_set(&dirty, 17);
+ *
+ * for (size_t i = mx_bitset_next(&dirty, 0); i < dirty.bits; i = mx_bitset_next(&dirty, i + 1))
+ *     flush(i);
+ *
+ * mx_bitset_destroy(&dirty);
+ * @endcode
+ */
+
+#include "mx/base.h"
+#include "mx/assert.h"
+#include "mx/arena.h"
+
+/** Number of 64 bit words that hold bits. */
+#define MX_BITSET_WORDS(bits) (((size_t)(bits) + 63) / 64)
+
+/**
+ * Bitset.
+ */
+typedef struct mx_bitset_t
+{
+    uint64_t *words;                /**< Bit i is bit i % 64 of word i / 64. */
+    size_t bits;                    /**< Number of bits. */
+    size_t capacity;                /**< Number of words allocated. */
+    bool fixed;                     /**< Words are owned by the caller. */
+    fatptr_t(IAllocator) allocator; /**< Allocator of the words. */
+} mx_bitset_t;
+
+/**
+ * Initialize a growable bitset with every bit clear.
+ * @param[out] set The bitset.
+ * @param[in] bits Number of bits.
+ */
+MX_API void mx_bitset_init(mx_bitset_t *set, size_t bits);
+
+/**
+ * Initialize a bitset over caller storage. The storage is cleared, and the
+ * set can be resized up to capacity * 64 bits but never grows past it.
+ * @param[out] set The bitset.
+ * @param[in] words The storage, must outlive the set.
+ * @param[in] capacity Number of words at words.
+ * @param[in] bits Number of bits.
+ */
+MX_API void mx_bitset_init_fixed(mx_bitset_t *set, uint64_t *words, size_t capacity, size_t bits);
+
+/**
+ * Release the storage of a bitset. The set is left empty and can be reused.
+ * @param[in] set The bitset.
+ */
+MX_API void mx_bitset_destroy(mx_bitset_t *set);
+
+/**
+ * Change the number of bits. New bits are clear.
+ * @param[in] set The bitset.
+ * @param[in] bits Number of bits.
+ */
+MX_API void mx_bitset_resize(mx_bitset_t *set, size_t bits);
+
+/**
+ * Get a bit.
+ */
+MX_INLINE bool mx_bitset_test(const mx_bitset_t *set, size_t i)
+{
+    MX_ASSERT(i < set->bits, "Bit index out of range.");
+    return (set->words[i / 64] >> (i % 64)) & 1;
+}
+
+/**
+ * Set a bit.
+ */
+MX_INLINE void mx_bitset_set(mx_bitset_t *set, size_t i)
+{
+    MX_ASSERT(i < set->bits, "Bit index out of range.");
+    set->words[i / 64] |= (uint64_t)1 << (i % 64);
+}
+
+/**
+ * Clear a bit.
+ */
+MX_INLINE void mx_bitset_clear(mx_bitset_t *set, size_t i)
+{
+    MX_ASSERT(i < set->bits, "Bit index out of range.");
+    set->words[i / 64] &= ~((uint64_t)1 << (i % 64));
+}
+
+/**
+ * Invert a bit.
+ */
+MX_INLINE void mx_bitset_flip(mx_bitset_t *set, size_t i)
+{
+    MX_ASSERT(i < set->bits, "Bit index out of range.");
+    set->words[i / 64] ^= (uint64_t)1 << (i % 64);
+}
+
+/**
+ * Set or clear a bit.
+ */
+MX_INLINE void mx_bitset_assign(mx_bitset_t *set, size_t i, bool value)
+{
+    MX_ASSERT(i < set->bits, "Bit index out of range.");
+    uint64_t mask = (uint64_t)1 << (i % 64);
+    set->words[i / 64] = (set->words[i / 64] & ~mask) | (value ? mask : 0);
+}
+
+/**
+ * Set or clear the bits in [begin, end).
+ */
+MX_API void mx_bitset_fill(mx_bitset_t *set, size_t begin, size_t end, bool value);
+
+/**
+ * dst = a & b. The operands must have the same size; dst is resized to it and
+ * may be either operand.
+ */
+MX_API void mx_bitset_and(mx_bitset_t *dst, const mx_bitset_t *a, const mx_bitset_t *b);
+
+/**
+ * dst = a | b, with the same rules as mx_bitset_and().
+ */
+MX_API void mx_bitset_or(mx_bitset_t *dst, const mx_bitset_t *a, const mx_bitset_t *b);
+
+/**
+ * dst = a ^ b, with the same rules as mx_bitset_and().
+ */
+MX_API void mx_bitset_xor(mx_bitset_t *dst, const mx_bitset_t *a, const mx_bitset_t *b);
+
+/**
+ * dst = a & ~b, with the same rules as mx_bitset_and().
+ */
+MX_API void mx_bitset_andnot(mx_bitset_t *dst, const mx_bitset_t *a, const mx_bitset_t *b);
+
+/**
+ * dst = ~a. dst is resized to a and may be a.
+ */
+MX_API void mx_bitset_not(mx_bitset_t *dst, const mx_bitset_t *a);
+
+/**
+ * Number of set bits.
+ */
+MX_API size_t mx_bitset_count(const mx_bitset_t *set);
+
+/**
+ * True if no bit is set.
+ */
+MX_API bool mx_bitset_none(const mx_bitset_t *set);
+
+/**
+ * Find the next set bit.
+ * @param[in] set The bitset.
+ * @param[in] from First bit to look at.
+ * @return The index of the first set bit not before from, or set->bits if
+ * there is none.
+ */
+MX_API size_t mx_bitset_next(const mx_bitset_t *set, size_t from);
+
+/**
+ * Find the next clear bit.
+ * @param[in] set The bitset.
+ * @param[in] from First bit to look at.
+ * @return The index of the first clear bit not before from, or set->bits if
+ * there is none.
+ */
+MX_API size_t mx_bitset_next_clear(const mx_bitset_t *set, size_t from);
+
+/**
+ * Rank and select index. It refers to the words of the bitset it was built
+ * from and is stale once that set changes.
+ */
+typedef struct mx_bitset_rank_t
+{
+    const uint64_t *words;          /**< Words of the indexed set. */
+    size_t bits;                    /**< Number of bits. */
+    size_t count;                   /**< Number of set bits. */
+    uint64_t *super;                /**< Set bits before each 65536 bit superblock. */
+    uint16_t *blocks;               /**< Set bits before each 512 bit block, from its superblock. */
+    size_t nsuper;                  /**< Number of superblocks. */
+    size_t nblocks;                 /**< Number of blocks. */
+    fatptr_t(IAllocator) allocator; /**< Allocator of the counts. */
+} mx_bitset_rank_t;
+
+/**
+ * Build the rank and select index of a bitset.
+ * @param[out] rank The index.
+ * @param[in] set The bitset.
+ */
+MX_API void mx_bitset_rank_init(mx_bitset_rank_t *rank, const mx_bitset_t *set);
+
+/**
+ * Release an index.
+ * @param[in] rank The index.
+ */
+MX_API void mx_bitset_rank_destroy(mx_bitset_rank_t *rank);
+
+/**
+ * Number of set bits before position i.
+ * @param[in] rank The index.
+ * @param[in] i Position, up to and including the size of the set.
+ */
+MX_API size_t mx_bitset_rank(const mx_bitset_rank_t *rank, size_t i);
+
+/**
+ * Position of a set bit by its number.
+ * @param[in] rank The index.
+ * @param[in] n Number of the set bit, from 0.
+ * @return Position of the set bit with n set bits before it, or the size of
+ * the set if there are not that many.
+ */
+MX_API size_t mx_bitset_select(const mx_bitset_rank_t *rank, size_t n);
+
+#endif
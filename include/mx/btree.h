@@ -0,0 +1,198 @@
+#ifndef _MX_BTREE_H_
+#define _MX_BTREE_H_
+
+/**
+ * @file btree.h B+Tree
+ *
+ * An ordered map from 64 bit integer keys to values of a fixed size. All
+ * entries live in the leaves, which are linked in key order, so a range scan
+ * walks contiguous arrays instead of chasing a pointer per entry.
+ *
+ * Every node holds up to MX_BTREE_KEYS keys, 512 bytes or eight cache lines,
+ * in one sorted array. Unused slots are padded with INT64_MAX so a node is
+ * always searched over the whole array: with AVX2 eight keys are compared
+ * per step, otherwise a branchless binary search is used. A tree of ten
+ * million keys is four levels deep.
+ *
+ * @code{c}
+ * mx_btree_t tree;
+ * mx_btree_init(&tree, sizeof(double));
+ *
+ * double price = 9.5;
+ * mx_btree_insert(&tree, 42, &price);
+ *
+ * for (mx_btree_iter_t it = mx_btree_lower_bound(&tree, 10);
+ *      mx_btree_valid(it) && mx_btree_key(it) < 100;
+ *      mx_btree_next(&it))
+ *     printf("%lld %f\n", (long long)mx_btree_key(it), *(double*)mx_btree_value(it));
+ *
+ * mx_btree_destroy(&tree);
+ * @endcode
+ */
+
+#include "mx/base.h"
+#include "mx/arena.h"
+
+/** Keys per node. */
+#define MX_BTREE_KEYS 64
+
+typedef struct mx_btree_leaf_t mx_btree_leaf_t;
+
+/**
+ * Internal leaf node.
+ */
+struct mx_btree_leaf_t {
+    int64_t keys[MX_BTREE_KEYS];    /**< Sorted keys, then INT64_MAX padding. */
+    mx_btree_leaf_t *prev;          /**< Leaf with the smaller keys. */
+    mx_btree_leaf_t *next;          /**< Leaf with the larger keys. */
+    int count;                      /**< Number of keys. */
+    max_align_t values[];           /**< MX_BTREE_KEYS values. */
+};
+
+/** Internal node search, the number of keys less than key. */
+typedef int (*mx_btree_search_function)(const int64_t *keys, int64_t key);
+
+/**
+ * Ordered map.
+ */
+typedef struct mx_btree_t
+{
+    void *root;                     /**< Root node, NULL when empty. */
+    int height;                     /**< Levels above the leaves. */
+    size_t count;                   /**< Number of entries. */
+    size_t value_size;              /**< Size of a value. */
+    mx_btree_leaf_t *first;         /**< Leaf with the smallest keys. */
+    mx_btree_leaf_t *last;          /**< Leaf with the largest keys. */
+    mx_btree_search_function search;
+    fatptr_t(IAllocator) allocator; /**< Allocator of the nodes. */
+} mx_btree_t;
+
+/**
+ * Position of an entry. Inserting or erasing invalidates every iterator.
+ */
+typedef struct mx_btree_iter_t
+{
+    mx_btree_leaf_t *leaf;          /**< NULL past the end. */
+    int index;
+    size_t value_size;
+} mx_btree_iter_t;
+
+/**
+ * Initialize a tree.
+ * @param[out] tree The tree.
+ * @param[in] value_size Size of a value, 0 for a set of keys.
+ */
+MX_API void mx_btree_init(mx_btree_t *tree, size_t value_size);
+
+/**
+ * Release every node of a tree. The tree is left empty and can be reused.
+ * @param[in] tree The tree.
+ */
+MX_API void mx_btree_destroy(mx_btree_t *tree);
+
+/**
+ * Find the value of a key.
+ * @param[in] tree The tree.
+ * @param[in] key The key.
+ * @return Pointer to the value, or NULL if the key is not in the tree.
+ */
+MX_API void *mx_btree_find(const mx_btree_t *tree, int64_t key);
+
+/**
+ * Insert a key, or replace the value of a key already in the tree.
+ * @param[in] tree The tree.
+ * @param[in] key The key.
+ * @param[in] value The value to copy in, may be NULL to leave it unset.
+ * @return True if the key is new.
+ */
+MX_API bool mx_btree_insert(mx_btree_t *tree, int64_t key, const void *value);
+
+/**
+ * Erase a key. Nodes left less than half full borrow from or merge with a
+ * neighbour.
+ * @param[in] tree The tree.
+ * @param[in] key The key.
+ * @param[out] value Where to copy the value of the erased key, may be NULL.
+ * @return True if the key was in the tree.
+ */
+MX_API bool mx_btree_erase(mx_btree_t *tree, int64_t key, void *value);
+
+/**
+ * Build the tree from sorted entries, filling the nodes bottom up. Much
+ * faster than inserting them one by one.
+ * @param[in] tree The tree, must be empty.
+ * @param[in] keys Strictly increasing keys, like a sorted mx_list.
+ * @param[in] values The values, in the same order, may be NULL.
+ * @param[in] count Number of entries.
+ */
+MX_API void mx_btree_bulk_load(mx_btree_t *tree, const int64_t *keys, const void *values, size_t count);
+
+/**
+ * Iterator to the smallest key.
+ */
+MX_API mx_btree_iter_t mx_btree_begin(const mx_btree_t *tree);
+
+/**
+ * Iterator to the largest key.
+ */
+MX_API mx_btree_iter_t mx_btree_last(const mx_btree_t *tree);
+
+/**
+ * Iterator to the first key not less than key.
+ */
+MX_API mx_btree_iter_t mx_btree_lower_bound(const mx_btree_t *tree, int64_t key);
+
+/**
+ * Iterator to the first key greater than key.
+ */
+MX_API mx_btree_iter_t mx_btree_upper_bound(const mx_btree_t *tree, int64_t key);
+
+/**
+ * True unless the iterator is past either end.
+ */
+MX_INLINE bool mx_btree_valid(mx_btree_iter_t it)
+{
+    return it.leaf != NULL;
+}
+
+/**
+ * Key of the entry at a valid iterator.
+ */
+MX_INLINE int64_t mx_btree_key(mx_btree_iter_t it)
+{
+    return it.leaf->keys[it.index];
+}
+
+/**
+ * Value of the entry at a valid iterator.
+ */
+MX_INLINE void *mx_btree_value(mx_btree_iter_t it)
+{
+    return (char*)it.leaf->values + (size_t)it.index * it.value_size;
+}
+
+/**
+ * Move to the next larger key.
+ */
+MX_INLINE void mx_btree_next(mx_btree_iter_t *it)
+{
+    if (++it->index >= it->leaf->count)
+    {
+        it->leaf = it->leaf->next;
+        it->index = 0;
+    }
+}
+
+/**
+ * Move to the next smaller key.
+ */
+MX_INLINE void mx_btree_prev(mx_btree_iter_t *it)
+{
+    if (it->index-- == 0)
+    {
+        it->leaf = it->leaf->prev;
+        it->index = it->leaf ? it->leaf->count - 1 : 0;
+    }
+}
+
+#endif
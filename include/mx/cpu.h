@@ -0,0 +1,61 @@
+#ifndef _MX_CPU_H_
+#define _MX_CPU_H_
+
+/**
+ * @file cpu.h CPU Feature Detection
+ *
+ * Runtime detection of the instruction set extensions the library can make
+ * use of. Accelerated code paths are compiled with MX_TARGET() so the rest of
+ * the library can still be built for the baseline architecture, and are only
+ * selected when mx_cpu_has() reports the required features.
+ */
+
+#include "mx/base.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+    #define MX_CPU_X86 1
+#else
+    #define MX_CPU_X86 0
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+    /** Compile a function for the given target extensions. */
+    #define MX_TARGET(x) __attribute__((target(x)))
+#else
+    #define MX_TARGET(x)
+#endif
+
+/**
+ * CPU feature flags.
+ */
+typedef enum mx_cpu_feature
+{
+    MX_CPU_SSE2   = 1 << 0,     /**< SSE2 */
+    MX_CPU_SSSE3  = 1 << 1,     /**< Supplemental SSE3 */
+    MX_CPU_AVX2   = 1 << 2,     /**< AVX2, with OS support for the YMM state. */
+    MX_CPU_SSE41  = 1 << 3,     /**< SSE4.1 */
+    MX_CPU_SSE42  = 1 << 4,     /**< SSE4.2, including the crc32 instruction. */
+    MX_CPU_PCLMUL = 1 << 5,     /**< Carry-less multiplication. */
+    MX_CPU_SHA    = 1 << 6,     /**< SHA extensions. */
+    MX_CPU_POPCNT = 1 << 7,     /**< Population count instruction. */
+    MX_CPU_BMI2   = 1 << 8,     /**< Bit manipulation, including pdep and pext. */
+} mx_cpu_feature;
+
+/**
+ * Get the features supported by the CPU the program is running on.
+ * @return Bitwise OR of mx_cpu_feature flags.
+ * @remarks The result is computed once and cached.
+ */
+MX_API mx_cpu_feature mx_cpu_features(void);
+
+/**
+ * Check if the CPU supports all of the given features.
+ * @param[in] features Bitwise OR of mx_cpu_feature flags.
+ * @return True if all features are supported.
+ */
+MX_INLINE bool mx_cpu_has(mx_cpu_feature features)
+{
+    return (mx_cpu_features() & features) == features;
+}
+
+#endif
@@ -15,26 +15,209 @@ typedef uint32_t adler32_t;     /**< The adler32 hash.*/
 typedef uint32_t fvn0_t;        /**< The FVN-0 hash. */
 typedef uint32_t fvn1_t;        /**< The FVN-1 hash. */
 typedef uint32_t fvn1a_t;       /**< The FVN-1a hash. */
+typedef uint32_t crc32_t;       /**< CRC32-IEEE checksum. */
+typedef uint32_t crc32c_t;      /**< CRC32C (Castagnoli) checksum. */
+typedef uint8_t  sha256_t[32];  /**< SHA256 checksum. */
+typedef uint64_t wyhash64_t;    /**< The 64 bit wyhash. */
 
 // typedef uint16_t crc16_t;       /**< CRC16-CCIT checksum. */
-// typedef uint32_t crc32_t;       /**< CRC32-IEEE checksum. */
 // typedef uint8_t  md5sum_t[8];   /**< MD5SUM checksum. */
 // typedef uint8_t  sha0_t  [8];   /**< SHA0 checksum. */
 // typedef uint8_t  sha128_t[8];   /**< SHA128 checksum. */
-// typedef uint8_t  sha256_t[8];   /**< SHA256 checksum. */
 
 MX_API void mx_adler32(adler32_t *digest, const char *src, size_t length);
 MX_API void mx_fvn0   (fvn0_t    *digest, const char *src, size_t length);
 MX_API void mx_fvn1   (fvn1_t    *digest, const char *src, size_t length);
 MX_API void mx_fvn1a  (fvn1a_t   *digest, const char *src, size_t length);
+MX_API void mx_crc32  (crc32_t   *digest, const char *src, size_t length);
+MX_API void mx_crc32c (crc32c_t  *digest, const char *src, size_t length);
+MX_API void mx_sha256 (sha256_t  *digest, const char *src, size_t length);
+MX_API void mx_wyhash64(wyhash64_t *digest, const char *src, size_t length);
+
+/**
+ * @brief The 64 bit wyhash with a seed.
+ * @param[out] digest The digest result.
+ * @param[in]  src    The source buffer.
+ * @param[in]  length The length of the buffer.
+ * @param[in]  seed   The seed. mx_wyhash64 is the same as a seed of 0.
+ * @remarks Fast non-cryptographic hash for hash tables, taking 48 bytes per
+ *          step. Prefer this over the FVN hashes for large tables.
+ */
+MX_API void mx_wyhash64_seeded(wyhash64_t *digest, const char *src, size_t length, uint64_t seed);
 
 // MX_API void mx_crc16  (crc16_t   *digest, const char *src, size_t length);
-// MX_API void mx_crc32  (crc32_t   *digest, const char *src, size_t length);
 // MX_API void mx_md5sum (md5sum_t  *digest, const char *src, size_t length);
 // MX_API void mx_sha0   (sha0_t    *digest, const char *src, size_t length);
 // MX_API void mx_sha128 (sha128_t  *digest, const char *src, size_t length);
-// MX_API void mx_sha256 (sha256_t  *digest, const char *src, size_t length);
 
 MX_API int mx_compare_digest(const void* a, const void *b, size_t size);
 
+/**
+ * @brief Streaming state of the adler32 hash.
+ */
+typedef struct mx_adler32_ctx_t { adler32_t state; } mx_adler32_ctx_t;
+/**
+ * @brief Streaming state of the FVN-0 hash.
+ */
+typedef struct mx_fvn0_ctx_t    { fvn0_t    state; } mx_fvn0_ctx_t;
+/**
+ * @brief Streaming state of the FVN-1 hash.
+ */
+typedef struct mx_fvn1_ctx_t    { fvn1_t    state; } mx_fvn1_ctx_t;
+/**
+ * @brief Streaming state of the FVN-1a hash.
+ */
+typedef struct mx_fvn1a_ctx_t   { fvn1a_t   state; } mx_fvn1a_ctx_t;
+/**
+ * @brief Streaming state of the CRC32 checksum.
+ */
+typedef struct mx_crc32_ctx_t   { crc32_t   state; } mx_crc32_ctx_t;
+/**
+ * @brief Streaming state of the CRC32C checksum.
+ */
+typedef struct mx_crc32c_ctx_t  { crc32c_t  state; } mx_crc32c_ctx_t;
+/**
+ * @brief Streaming state of the SHA256 checksum.
+ */
+typedef struct mx_sha256_ctx_t
+{
+    uint32_t state[8];
+    uint64_t length;
+    uint8_t  buffer[64];
+} mx_sha256_ctx_t;
+/**
+ * @brief Streaming state of the 64 bit wyhash.
+ */
+typedef struct mx_wyhash64_ctx_t
+{
+    uint64_t chain[3];
+    uint64_t length;
+    uint8_t  buffer[64];
+} mx_wyhash64_ctx_t;
+
+/**
+ * @brief Storage large enough for the streaming state of any digest.
+ */
+typedef union mx_digest_ctx_t
+{
+    mx_adler32_ctx_t adler32;
+    mx_fvn0_ctx_t    fvn0;
+    mx_fvn1_ctx_t    fvn1;
+    mx_fvn1a_ctx_t   fvn1a;
+    mx_crc32_ctx_t   crc32;
+    mx_crc32c_ctx_t  crc32c;
+    mx_sha256_ctx_t  sha256;
+    mx_wyhash64_ctx_t wyhash64;
+} mx_digest_ctx_t;
+
+/*
+ * Streaming digest functions. Call init once, update for every piece of the
+ * input in order, then final to get the digest. The result is the same as
+ * calling the one shot function over the concatenated input.
+ */
+
+MX_API void mx_adler32_init  (mx_adler32_ctx_t *ctx);
+MX_API void mx_adler32_update(mx_adler32_ctx_t *ctx, const char *src, size_t length);
+MX_API void mx_adler32_final (mx_adler32_ctx_t *ctx, adler32_t *digest);
+
+MX_API void mx_fvn0_init     (mx_fvn0_ctx_t    *ctx);
+MX_API void mx_fvn0_update   (mx_fvn0_ctx_t    *ctx, const char *src, size_t length);
+MX_API void mx_fvn0_final    (mx_fvn0_ctx_t    *ctx, fvn0_t    *digest);
+
+MX_API void mx_fvn1_init     (mx_fvn1_ctx_t    *ctx);
+MX_API void mx_fvn1_update   (mx_fvn1_ctx_t    *ctx, const char *src, size_t length);
+MX_API void mx_fvn1_final    (mx_fvn1_ctx_t    *ctx, fvn1_t    *digest);
+
+MX_API void mx_fvn1a_init    (mx_fvn1a_ctx_t   *ctx);
+MX_API void mx_fvn1a_update  (mx_fvn1a_ctx_t   *ctx, const char *src, size_t length);
+MX_API void mx_fvn1a_final   (mx_fvn1a_ctx_t   *ctx, fvn1a_t   *digest);
+
+MX_API void mx_crc32_init    (mx_crc32_ctx_t   *ctx);
+MX_API void mx_crc32_update  (mx_crc32_ctx_t   *ctx, const char *src, size_t length);
+MX_API void mx_crc32_final   (mx_crc32_ctx_t   *ctx, crc32_t   *digest);
+
+MX_API void mx_crc32c_init   (mx_crc32c_ctx_t  *ctx);
+MX_API void mx_crc32c_update (mx_crc32c_ctx_t  *ctx, const char *src, size_t length);
+MX_API void mx_crc32c_final  (mx_crc32c_ctx_t  *ctx, crc32c_t  *digest);
+
+MX_API void mx_sha256_init   (mx_sha256_ctx_t  *ctx);
+MX_API void mx_sha256_update (mx_sha256_ctx_t  *ctx, const char *src, size_t length);
+MX_API void mx_sha256_final  (mx_sha256_ctx_t  *ctx, sha256_t  *digest);
+
+MX_API void mx_wyhash64_init (mx_wyhash64_ctx_t *ctx);
+MX_API void mx_wyhash64_init_seeded(mx_wyhash64_ctx_t *ctx, uint64_t seed);
+MX_API void mx_wyhash64_update(mx_wyhash64_ctx_t *ctx, const char *src, size_t length);
+MX_API void mx_wyhash64_final(mx_wyhash64_ctx_t *ctx, wyhash64_t *digest);
+
+/**
+ * @brief Hash many independent messages with SHA256.
+ * @param[out] digests The digest of each message.
+ * @param[in]  src     The source buffer of each message.
+ * @param[in]  length  The length of each message.
+ * @param[in]  count   The number of messages.
+ * @remarks Without the SHA extensions, AVX2 capable CPUs hash eight messages
+ *          at once, one per SIMD lane.
+ */
+MX_API void mx_sha256_multi(sha256_t *digests, const char *const *src, const size_t *length, size_t count);
+
+/*
+ * Batched digest functions. Each hashes count independent messages, giving
+ * the same digests as calling the one shot function on every message. The
+ * messages are interleaved, so the byte at a time dependency chains of many
+ * messages run side by side instead of one after another.
+ */
+
+MX_API void mx_adler32_multi(adler32_t *digests, const char *const *src, const size_t *length, size_t count);
+MX_API void mx_fvn0_multi   (fvn0_t    *digests, const char *const *src, const size_t *length, size_t count);
+MX_API void mx_fvn1_multi   (fvn1_t    *digests, const char *const *src, const size_t *length, size_t count);
+MX_API void mx_fvn1a_multi  (fvn1a_t   *digests, const char *const *src, const size_t *length, size_t count);
+
+/*
+ * Digest combination. Given the digests of two consecutive pieces of input
+ * and the length of the second piece, compute the digest of both pieces as if
+ * they were hashed in one go. This lets pieces be hashed independently.
+ */
+
+MX_API adler32_t mx_adler32_combine(adler32_t first, adler32_t second, uint64_t second_length);
+MX_API crc32_t   mx_crc32_combine  (crc32_t   first, crc32_t   second, uint64_t second_length);
+MX_API crc32c_t  mx_crc32c_combine (crc32c_t  first, crc32c_t  second, uint64_t second_length);
+
+/**
+ * @brief Description of a digest algorithm, for code generic over digests.
+ */
+typedef struct mx_digest_algorithm_t
+{
+    const char *name;           /**< Name of the algorithm. */
+    size_t digest_size;         /**< Size of the digest in bytes. */
+    size_t context_size;        /**< Size of the streaming state in bytes. */
+    mx_digest_function digest;  /**< One shot function. */
+    void (*init)  (void *ctx);  /**< Streaming init function. */
+    void (*update)(void *ctx, const char *src, size_t length); /**< Streaming update function. */
+    void (*final) (void *ctx, void *digest);                   /**< Streaming final function. */
+    /** Batched function, may be NULL. */
+    void (*multi) (void *digests, const char *const *src, const size_t *length, size_t count);
+    /** Combine function, may be NULL. Replaces digest with the combination of digest and next. */
+    void (*combine)(void *digest, const void *next, uint64_t next_length);
+} mx_digest_algorithm_t;
+
+extern const mx_digest_algorithm_t mx_digest_adler32;   /**< The adler32 hash. */
+extern const mx_digest_algorithm_t mx_digest_fvn0;      /**< The FVN-0 hash. */
+extern const mx_digest_algorithm_t mx_digest_fvn1;      /**< The FVN-1 hash. */
+extern const mx_digest_algorithm_t mx_digest_fvn1a;     /**< The FVN-1a hash. */
+extern const mx_digest_algorithm_t mx_digest_crc32;     /**< The CRC32-IEEE checksum. */
+extern const mx_digest_algorithm_t mx_digest_crc32c;    /**< The CRC32C checksum. */
+extern const mx_digest_algorithm_t mx_digest_sha256;    /**< The SHA256 checksum. */
+extern const mx_digest_algorithm_t mx_digest_wyhash64;  /**< The 64 bit wyhash. */
+
+/**
+ * @brief Hash many independent messages with any digest algorithm.
+ * @param[in]  algorithm The digest algorithm.
+ * @param[out] digests   Array of count digests, algorithm->digest_size bytes each.
+ * @param[in]  src       The source buffer of each message.
+ * @param[in]  length    The length of each message.
+ * @param[in]  count     The number of messages.
+ * @remarks Uses the batched function of the algorithm if it has one.
+ */
+MX_API void mx_digest_multi(const mx_digest_algorithm_t *algorithm, void *digests, const char *const *src, const size_t *length, size_t count);
+
 #endif
\ No newline at end of file
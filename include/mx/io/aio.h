@@ -0,0 +1,204 @@
+#ifndef _MX_IO_AIO_H_
+#define _MX_IO_AIO_H_
+
+/**
+ * @file aio.h Asynchronous File I/O
+ *
+ * A queue of reads and writes on file descriptors that does not block the
+ * thread issuing them. Requests are queued with mx_aio_queue(), which does
+ * no system call, handed to the kernel in one batch by mx_aio_submit(), and
+ * their completions are reaped by mx_aio_poll(), which runs the callbacks
+ * of the requests and can also return the results to the caller.
+ *
+ * On Linux the queue is an io_uring driven with raw system calls: a batch
+ * costs one io_uring_enter, and one thread can keep as many requests in
+ * flight as the queue has entries. Files and buffers can be registered up
+ * front so the kernel does not look up the descriptor or map the pages on
+ * every request. Where io_uring is missing or disabled, requests run as
+ * blocking pread and pwrite calls on a thread pool of their own, with the
+ * same interface.
+ *
+ * A queue belongs to one thread: callbacks run on it, inside mx_aio_poll(),
+ * and may queue further requests. The descriptor of a stream from
+ * mx_fd_open() is available from mx_fd_stream_fd().
+ *
+ * @code{c}
+ * mx_aio_t *aio = mx_aio_create(NULL);
+ *
+ * for (int i = 0; i < 64; i++)
+ * {
+ *     mx_aio_request_t request = {
+ *         .op = MX_AIO_READ, .file = fd, .buffer = blocks[i],
+ *         .size = 4096, .offset = i * 4096, .callback = on_read, .arg = &jobs[i],
+ *     };
+ *     mx_aio_queue(aio, &request);
+ * }
+ *
+ * mx_aio_submit(aio);
+ * mx_aio_poll(aio, NULL, 64, 64);
+ * mx_aio_destroy(aio);
+ * @endcode
+ */
+
+#include "mx/io/stream.h"
+
+/** Entries used when the options are NULL or give 0. */
+#define MX_AIO_ENTRIES_DEFAULT 256
+/** Threads of the emulation when the options are NULL or give 0. */
+#define MX_AIO_THREADS_DEFAULT 8
+
+/**
+ * Operations.
+ */
+typedef enum mx_aio_op
+{
+    MX_AIO_READ,    /**< Read size bytes at offset into buffer. */
+    MX_AIO_WRITE,   /**< Write size bytes of buffer at offset. */
+    MX_AIO_FSYNC,   /**< Write the file's data and metadata to the device. */
+} mx_aio_op;
+
+/**
+ * Request flags.
+ */
+typedef enum mx_aio_flags
+{
+    MX_AIO_FIXED_FILE   = 1 << 0,   /**< file is an index into the registered files. */
+    MX_AIO_FIXED_BUFFER = 1 << 1,   /**< buffer lies in the registered buffer buffer_index. */
+} mx_aio_flags;
+
+/**
+ * Implementations of the queue.
+ */
+typedef enum mx_aio_backend
+{
+    MX_AIO_AUTO,    /**< io_uring where available, else threads. */
+    MX_AIO_URING,   /**< io_uring only. */
+    MX_AIO_THREADS, /**< Blocking calls on a thread pool. */
+} mx_aio_backend;
+
+/**
+ * Called when a request completes.
+ * @param arg The arg of the request.
+ * @param result Bytes transferred, 0 for a finished fsync, or a negative
+ * errno value.
+ */
+typedef void (*mx_aio_callback)(void *arg, mx_len_t result);
+
+/**
+ * A request. It is copied when queued, though buffer must stay valid until
+ * the request completes.
+ */
+typedef struct mx_aio_request_t
+{
+    mx_aio_op op;
+    mx_aio_flags flags;             /**< Bitwise OR of mx_aio_flags. */
+    int file;                       /**< Descriptor, or registered file index. */
+    void *buffer;
+    size_t size;                    /**< At most UINT32_MAX, the io_uring limit. */
+    mx_len_t offset;                /**< Offset in the file, from 0. */
+    unsigned buffer_index;          /**< Registered buffer, with MX_AIO_FIXED_BUFFER. */
+    mx_aio_callback callback;       /**< NULL to report only to mx_aio_poll(). */
+    void *arg;                      /**< Passed to the callback and returned by mx_aio_poll(). */
+} mx_aio_request_t;
+
+/**
+ * A completed request.
+ */
+typedef struct mx_aio_completion_t
+{
+    void *arg;                      /**< The arg of the request. */
+    mx_len_t result;                /**< As passed to the callback. */
+} mx_aio_completion_t;
+
+/**
+ * Options of a queue.
+ */
+typedef struct mx_aio_options_t
+{
+    unsigned entries;               /**< Most requests queued or in flight, 0 for the default. */
+    unsigned threads;               /**< Threads of the emulation, 0 for the default. */
+    mx_aio_backend backend;
+    fatptr_t(IAllocator) allocator; /**< Allocator of the queue, a NULL ptr for the default. */
+} mx_aio_options_t;
+
+/** Asynchronous I/O queue. */
+typedef struct mx_aio_t mx_aio_t;
+
+/**
+ * Create a queue.
+ * @param[in] options The options, NULL for the defaults.
+ * @return The queue, or NULL if out of memory, or if MX_AIO_URING was asked
+ * for and io_uring is not available.
+ */
+MX_API mx_aio_t *mx_aio_create(const mx_aio_options_t *options);
+
+/**
+ * Wait for the requests in flight, without running their callbacks, and
+ * release the queue. Requests queued but not submitted are dropped.
+ * @param[in] aio The queue.
+ */
+MX_API void mx_aio_destroy(mx_aio_t *aio);
+
+/**
+ * Get the implementation a queue runs on.
+ * @param[in] aio The queue.
+ * @return MX_AIO_URING or MX_AIO_THREADS.
+ */
+MX_API mx_aio_backend mx_aio_get_backend(mx_aio_t *aio);
+
+/**
+ * Register descriptors, for requests with MX_AIO_FIXED_FILE. Replaces the
+ * files registered before. Nothing may be in flight.
+ * @param[in] aio The queue.
+ * @param[in] files The descriptors, NULL to only drop the registered ones.
+ * @param[in] count Number of descriptors.
+ * @return False if the kernel refused them.
+ */
+MX_API bool mx_aio_register_files(mx_aio_t *aio, const int *files, unsigned count);
+
+/**
+ * Register buffers, for requests with MX_AIO_FIXED_BUFFER. The kernel pins
+ * their pages once instead of on every request, which counts against
+ * RLIMIT_MEMLOCK. Replaces the buffers registered before. Nothing may be in
+ * flight.
+ * @param[in] aio The queue.
+ * @param[in] buffers The buffers, NULL to only drop the registered ones.
+ * @param[in] count Number of buffers.
+ * @return False if the kernel refused them.
+ */
+MX_API bool mx_aio_register_buffers(mx_aio_t *aio, const mx_iovec_t *buffers, unsigned count);
+
+/**
+ * Queue a request, without a system call.
+ * @param[in] aio The queue.
+ * @param[in] request The request.
+ * @return False if the queue is full; poll for completions and try again.
+ */
+MX_API bool mx_aio_queue(mx_aio_t *aio, const mx_aio_request_t *request);
+
+/**
+ * Start every queued request.
+ * @param[in] aio The queue.
+ * @return Number of requests started. Any others stay queued.
+ */
+MX_API size_t mx_aio_submit(mx_aio_t *aio);
+
+/**
+ * Reap completed requests, running their callbacks. Queued requests are
+ * submitted first.
+ * @param[in] aio The queue.
+ * @param[out] completions Where to store the completions, NULL if only the
+ * callbacks are wanted.
+ * @param[in] max Most completions to reap.
+ * @param[in] wait Completions to wait for, up to the number in flight.
+ * @return Number of completions reaped.
+ */
+MX_API size_t mx_aio_poll(mx_aio_t *aio, mx_aio_completion_t *completions, size_t max, size_t wait);
+
+/**
+ * Get the number of requests queued or in flight.
+ * @param[in] aio The queue.
+ */
+MX_API size_t mx_aio_pending(mx_aio_t *aio);
+
+#endif
@@ -0,0 +1,80 @@
+#ifndef _MX_IO_DIGEST_STREAM_H_
+#define _MX_IO_DIGEST_STREAM_H_
+
+/**
+ * @file digest_stream.h Hashing Stream Decorator
+ *
+ * A stream that forwards every call to an underlying stream, and hashes all
+ * data that passes through read and write with a streaming digest. Reading a
+ * file through it while writing the data elsewhere hashes and copies the file
+ * in a single pass.
+ *
+ * @code{c}
+ * fatptr_t(IStream) src = mx_digest_stream_open(mx_open("in.bin", MX_OPEN_READ), &mx_digest_adler32, true);
+ * char buffer[4096];
+ * mx_len_t n;
+ *
+ * while ((n = IStream_read(src, buffer, sizeof buffer)) > 0)
+ *     IStream_write(dst, buffer, n);
+ *
+ * adler32_t digest;
+ * mx_digest_stream_result(src, &digest);
+ * IObject_destruct(IStream_AsIObject(src));
+ * @endcode
+ */
+
+#include "mx/io/stream.h"
+#include "mx/digest.h"
+
+/**
+ * Open a hashing stream over another stream.
+ * @param[in] base The stream to forward calls to.
+ * @param[in] algorithm The digest algorithm to use.
+ * @param[in] own If true, base is destructed along with this stream, or
+ * right away if this stream cannot be created.
+ * @return The hashing stream. Check ptr against NULL.
+ * @remarks Seeking is forwarded as is, and does not affect the digest.
+ */
+MX_API fatptr_t(IStream) mx_digest_stream_open(fatptr_t(IStream) base, const mx_digest_algorithm_t *algorithm, bool own);
+
+/**
+ * Get the digest of all data read or written so far.
+ * @param[in] str The hashing stream.
+ * @param[out] digest The digest result, algorithm->digest_size bytes.
+ * @remarks The stream can still be used after this call.
+ */
+MX_API void mx_digest_stream_result(fatptr_t(IStream) str, void *digest);
+
+/**
+ * Restart the digest, discarding all data hashed so far.
+ * @param[in] str The hashing stream.
+ */
+MX_API void mx_digest_stream_reset(fatptr_t(IStream) str);
+
+/**
+ * Hash the remainder of a stream on several threads.
+ * The stream is read in chunks, each chunk is hashed on its own and the
+ * results are merged with algorithm->combine, so the digest is identical to
+ * hashing the data sequentially. Algorithms without a combine function are
+ * hashed sequentially. Streams that lend their memory with IStream_borrow(),
+ * like mapped files, are hashed in place without copying.
+ * @param[in] str The stream to read until its end.
+ * @param[in] algorithm The digest algorithm to use.
+ * @param[out] digest The digest result, algorithm->digest_size bytes.
+ * @param[in] threads Number of hashing threads, 0 for one per processor.
+ * @param[in] chunk_size Bytes per chunk, 0 for the default of 4 MiB.
+ * @return False if memory could not be allocated or reading the stream
+ * failed, in which case digest is unspecified.
+ */
+MX_API bool mx_digest_istream(fatptr_t(IStream) str, const mx_digest_algorithm_t *algorithm, void *digest, unsigned threads, size_t chunk_size);
+
+/**
+ * Hash a file on several threads, see mx_digest_istream(). The file is
+ * mapped when possible.
+ * @param[in] path Path of the file.
+ * @return False if the file could not be opened or read, or memory not
+ * allocated.
+ */
+MX_API bool mx_digest_file(const char *path, const mx_digest_algorithm_t *algorithm, void *digest, unsigned threads, size_t chunk_size);
+
+#endif
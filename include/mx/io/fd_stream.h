@@ -0,0 +1,99 @@
+#ifndef _MX_IO_FD_STREAM_H_
+#define _MX_IO_FD_STREAM_H_
+
+/**
+ * @file fd_stream.h POSIX File Descriptor Stream
+ *
+ * A stream over a file descriptor that calls read and write directly, with
+ * its own buffer instead of the stdio one: no stdio locking, no second copy,
+ * and the buffer size is the caller's choice. Reads and writes at least as
+ * large as the buffer bypass it and go straight to the caller's memory, and
+ * a buffer size of 0 makes every call a system call. A read or write that
+ * fails before moving any bytes returns -1, so errors are not taken for
+ * the end of the file.
+ *
+ * MX_FD_DIRECT opens the file a second time with O_DIRECT so bulk transfers
+ * skip the page cache. The buffer is then aligned for the device and rounded
+ * up to a whole number of pages; transfers that are not aligned, like the
+ * tail of a file, silently go through the cached descriptor instead. Neither
+ * descriptor changes its flags afterwards. Files opened for appending are
+ * not opened with O_DIRECT. The other hints are passed on to posix_fadvise.
+ *
+ * IStream_pread() and IStream_pwrite() go to the file at once with pread and
+ * pwrite, bypassing the buffer, so flush buffered writes before reading them
+ * back by offset.
+ *
+ * IStream_readv() and IStream_writev() gather small records in the buffer
+ * and pass larger ones to readv and writev, together with any buffered
+ * bytes, so a record costs at most one system call and no copy.
+ *
+ * @code{c}
+ * mx_fd_options_t options = { .buffer_size = 1 << 20, .hints = MX_FD_SEQUENTIAL };
+ * fatptr_t(IStream) src = mx_fd_open("in.bin", MX_OPEN_READ, &options);
+ * @endcode
+ */
+
+#include "mx/io/stream.h"
+
+/** Buffer size used when the options are NULL. */
+#define MX_FD_BUFFER_DEFAULT (64 * 1024)
+
+/**
+ * Access hints.
+ */
+typedef enum mx_fd_hints
+{
+    MX_FD_DIRECT     = 1 << 0,  /**< Bypass the page cache with O_DIRECT. */
+    MX_FD_SEQUENTIAL = 1 << 1,  /**< The file is read front to back. */
+    MX_FD_RANDOM     = 1 << 2,  /**< The file is read in no particular order. */
+    MX_FD_WILLNEED   = 1 << 3,  /**< Start reading the whole file into the cache. */
+    MX_FD_NOREUSE    = 1 << 4,  /**< Data is accessed once. */
+    MX_FD_DONTNEED   = 1 << 5,  /**< Drop the cached pages of the file on close. */
+} mx_fd_hints;
+
+/**
+ * Options of a descriptor stream.
+ */
+typedef struct mx_fd_options_t
+{
+    size_t buffer_size;             /**< Bytes of buffer, 0 for none. */
+    mx_fd_hints hints;              /**< Bitwise OR of mx_fd_hints. */
+    fatptr_t(IAllocator) allocator; /**< Allocator of the stream and buffer, a NULL ptr for the default. */
+} mx_fd_options_t;
+
+/**
+ * Open a file as a descriptor stream.
+ * @param[in] file Path of the file.
+ * @param[in] flags Open flags.
+ * @param[in] options The options, NULL for a MX_FD_BUFFER_DEFAULT buffer
+ * and no hints.
+ * @return The stream. Check ptr against NULL.
+ */
+MX_API fatptr_t(IStream) mx_fd_open(const char *file, mx_open_flags flags, const mx_fd_options_t *options);
+
+/**
+ * Wrap an open descriptor in a stream.
+ * @param[in] fd The descriptor, positioned where the stream starts.
+ * @param[in] own If true, closing the stream closes fd.
+ * @param[in] options The options, NULL for the defaults. With MX_FD_DIRECT
+ * the file is opened again through /proc/self/fd, on Linux only, and
+ * O_DIRECT is cleared from fd.
+ * @return The stream. Check ptr against NULL.
+ */
+MX_API fatptr_t(IStream) mx_fd_stream(int fd, bool own, const mx_fd_options_t *options);
+
+/**
+ * Write out buffered data.
+ * @param[in] str A descriptor stream.
+ * @return False if a write failed.
+ */
+MX_API bool mx_fd_stream_flush(fatptr_t(IStream) str);
+
+/**
+ * Get the descriptor of a stream, after flushing it.
+ * @param[in] str A descriptor stream.
+ * @return The descriptor, or -1 once the stream is closed.
+ */
+MX_API int mx_fd_stream_fd(fatptr_t(IStream) str);
+
+#endif
@@ -0,0 +1,76 @@
+#ifndef _MX_IO_MEMORY_STREAM_H_
+#define _MX_IO_MEMORY_STREAM_H_
+
+/**
+ * @file memory_stream.h Memory Stream
+ *
+ * A stream over a buffer in memory, either grown from an allocator as it is
+ * written, or a fixed buffer of the caller's where writes past its capacity
+ * come up short. Reads and writes are plain copies, IStream_borrow() lends
+ * the bytes in place, and mx_memory_stream_data() exposes the whole buffer,
+ * so a serialized message can be passed on to a socket or a file without
+ * another copy.
+ *
+ * Writing past the end, also after seeking beyond it, extends the stream,
+ * with any gap filled with zeros. Closing the stream keeps the buffer until
+ * the stream is destroyed, and mx_memory_stream_reset() empties it for reuse
+ * without freeing the memory.
+ *
+ * @code{c}
+ * fatptr_t(IStream) msg = mx_memory_stream(4096, (fatptr_t(IAllocator)){ NULL, NULL });
+ * size_t size;
+ *
+ * serialize(msg, &record);
+ * send(socket, mx_memory_stream_data(msg, &size), size, 0);
+ * mx_memory_stream_reset(msg);
+ * @endcode
+ */
+
+#include "mx/io/stream.h"
+
+/**
+ * Create a stream over a growable buffer.
+ * @param[in] capacity Bytes to allocate up front, 0 to allocate on the first
+ * write.
+ * @param[in] allocator The allocator of the stream and the buffer, a NULL
+ * ptr for the default.
+ * @return The stream, or a NULL ptr if out of memory.
+ */
+MX_API fatptr_t(IStream) mx_memory_stream(size_t capacity, fatptr_t(IAllocator) allocator);
+
+/**
+ * Create a stream over a buffer of the caller's, which never grows.
+ * @param[in] buffer The buffer. It must outlive the stream.
+ * @param[in] capacity Size of the buffer.
+ * @param[in] size Bytes already in the buffer, readable from the start.
+ * @param[in] allocator The allocator of the stream object, a NULL ptr for
+ * the default.
+ * @return The stream, or a NULL ptr if out of memory.
+ */
+MX_API fatptr_t(IStream) mx_memory_stream_fixed(void *buffer, size_t capacity, size_t size, fatptr_t(IAllocator) allocator);
+
+/**
+ * Get the bytes of a memory stream, valid until the next write, reserve or
+ * destruction.
+ * @param[in] str A memory stream.
+ * @param[out] size Size of the stream.
+ * @return The first byte, NULL if nothing was ever allocated.
+ */
+MX_API char *mx_memory_stream_data(fatptr_t(IStream) str, size_t *size);
+
+/**
+ * Make room for at least capacity bytes, so later writes do not reallocate.
+ * @param[in] str A memory stream.
+ * @param[in] capacity Bytes wanted.
+ * @return False if out of memory, or if the buffer is fixed and smaller.
+ */
+MX_API bool mx_memory_stream_reserve(fatptr_t(IStream) str, size_t capacity);
+
+/**
+ * Empty the stream and move to the start, keeping the buffer. A closed stream
+ * is opened again.
+ * @param[in] str A memory stream.
+ */
+MX_API void mx_memory_stream_reset(fatptr_t(IStream) str);
+
+#endif
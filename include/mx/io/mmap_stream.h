@@ -0,0 +1,47 @@
+#ifndef _MX_IO_MMAP_STREAM_H_
+#define _MX_IO_MMAP_STREAM_H_
+
+/**
+ * @file mmap_stream.h Memory Mapped File Stream
+ *
+ * A read only stream over a file mapped into memory, opened by mx_open()
+ * with MX_OPEN_MMAP. Reads copy straight from the page cache, and
+ * IStream_borrow() hands out pointers into the mapping so parsers and
+ * digests run over the file without any copy at all.
+ *
+ * MX_OPEN_SEQUENTIAL, MX_OPEN_RANDOM, MX_OPEN_WILLNEED and MX_OPEN_HUGEPAGES
+ * are passed on to madvise. When the file cannot be mapped, like a pipe or a
+ * file opened for writing, mx_open() falls back to a regular stream that
+ * does not support borrowing.
+ *
+ * @code{c}
+ * fatptr_t(IStream) src = mx_open("log.txt", MX_OPEN_READ | MX_OPEN_MMAP | MX_OPEN_SEQUENTIAL);
+ * const char *data;
+ * mx_len_t n;
+ *
+ * while ((n = IStream_borrow(src, &data, 1 << 20)) > 0)
+ *     parse(data, n);
+ * @endcode
+ */
+
+#include "mx/io/stream.h"
+
+/**
+ * Map a file as a stream.
+ * @param[in] file Path of the file.
+ * @param[in] flags Open flags, MX_OPEN_READ and the madvise hints.
+ * @param[in] allocator The allocator of the stream object, a NULL ptr for
+ * the default.
+ * @return The stream, or a NULL ptr if the file cannot be mapped.
+ */
+MX_API fatptr_t(IStream) mx_mmap_open(const char *file, mx_open_flags flags, fatptr_t(IAllocator) allocator);
+
+/**
+ * Get the whole mapping of a mapped stream.
+ * @param[in] str A mapped stream.
+ * @param[out] size Size of the file.
+ * @return The first byte of the file, NULL for an empty file.
+ */
+MX_API const char *mx_mmap_stream_data(fatptr_t(IStream) str, size_t *size);
+
+#endif
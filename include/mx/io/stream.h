@@ -3,6 +3,7 @@
 
 #include "mx/base.h"
 #include "mx/trait.h"
+#include "mx/arena.h"
 
 #include <stdarg.h>
 
@@ -19,6 +20,15 @@ typedef enum mx_stream_flags
     MX_STREAM_EOF  = 1 << 1,
 } mx_stream_flags;
 
+/**
+ * One buffer of a vectored read or write.
+ */
+typedef struct mx_iovec_t
+{
+    void *data;
+    size_t size;
+} mx_iovec_t;
+
 typedef struct IStream
 {
     IObject Object;
@@ -28,6 +38,16 @@ typedef struct IStream
     mx_len_t (*seek)(void *self, mx_len_t offset, IStream_SeekOrigin origin);
     mx_len_t (*write)(void* self, const void *src, mx_len_t size);
     void (*close)(void *self);
+    /** Optional, NULL for streams that cannot lend their memory. */
+    mx_len_t (*borrow)(void *self, const char **data, mx_len_t max);
+    /** Optional, NULL for streams without positional reads. */
+    mx_len_t (*pread)(void *self, char *buffer, mx_len_t max, mx_len_t offset);
+    /** Optional, NULL for streams without positional writes. */
+    mx_len_t (*pwrite)(void *self, const void *src, mx_len_t size, mx_len_t offset);
+    /** Optional, NULL to read the buffers one by one. */
+    mx_len_t (*readv)(void *self, const mx_iovec_t *iov, int count);
+    /** Optional, NULL to write the buffers one by one. */
+    mx_len_t (*writev)(void *self, const mx_iovec_t *iov, int count);
 } IStream;
 fatptr_define(IStream);
 
@@ -61,21 +81,102 @@ MX_INLINE void IStream_close(fatptr_t(IStream) str)
     fatptr_vcall(str, close);
 }
 
+/**
+ * Read without copying: get a pointer to the next bytes of the stream and
+ * move past them, as a read of max bytes would.
+ * @param[in] str The stream.
+ * @param[out] data Set to the bytes, which stay valid until the stream is
+ * written to or closed.
+ * @param[in] max Most bytes to take. A max of 0 only tests whether the
+ * stream can lend its memory.
+ * @return Number of bytes at data, 0 at the end of the stream, or -1 if the
+ * stream cannot lend its memory and must be read instead.
+ */
+MX_INLINE mx_len_t IStream_borrow(fatptr_t(IStream) str, const char **data, mx_len_t max)
+{
+    return str.traits->borrow ? fatptr_vcall(str, borrow, data, max) : -1;
+}
+
+/**
+ * Read at an offset, without using or moving the position of the stream.
+ * Positional reads and writes may run on many threads at once, though not
+ * alongside the other calls of the stream.
+ * @param[in] str The stream.
+ * @param[out] buffer Where to read to.
+ * @param[in] max Most bytes to read.
+ * @param[in] offset Offset of the first byte from the start of the stream.
+ * @return Number of bytes read, fewer than max only at the end of the
+ * stream, or -1 on error or if the stream has no positional reads.
+ */
+MX_INLINE mx_len_t IStream_pread(fatptr_t(IStream) str, char *buffer, mx_len_t max, mx_len_t offset)
+{
+    return str.traits->pread ? fatptr_vcall(str, pread, buffer, max, offset) : -1;
+}
+
+/**
+ * Write at an offset, without using or moving the position of the stream.
+ * @param[in] str The stream.
+ * @param[in] buffer The bytes to write.
+ * @param[in] size Number of bytes.
+ * @param[in] offset Offset of the first byte from the start of the stream.
+ * @return Number of bytes written, or -1 on error or if the stream has no
+ * positional writes.
+ */
+MX_INLINE mx_len_t IStream_pwrite(fatptr_t(IStream) str, const void *buffer, mx_len_t size, mx_len_t offset)
+{
+    return str.traits->pwrite ? fatptr_vcall(str, pwrite, buffer, size, offset) : -1;
+}
+
+/**
+ * Read into several buffers in turn, in one call where the stream supports
+ * it.
+ * @param[in] str The stream.
+ * @param[in] iov The buffers, filled in order.
+ * @param[in] count Number of buffers.
+ * @return Number of bytes read, fewer than the total only at the end of the
+ * stream or on error.
+ */
+MX_API mx_len_t IStream_readv(fatptr_t(IStream) str, const mx_iovec_t *iov, int count);
+
+/**
+ * Write several buffers in turn, in one call where the stream supports it,
+ * so a header, payload and trailer need neither three calls nor a copy into
+ * one buffer.
+ * @param[in] str The stream.
+ * @param[in] iov The buffers, written in order.
+ * @param[in] count Number of buffers.
+ * @return Number of bytes written, fewer than the total on error.
+ */
+MX_API mx_len_t IStream_writev(fatptr_t(IStream) str, const mx_iovec_t *iov, int count);
+
 MX_API void IStream_printf(fatptr_t(IStream) str, const char *format, ...);
 MX_API void IStream_vprintf(fatptr_t(IStream) str, const char *format, va_list va);
 
 typedef enum mx_open_flags
 {
-    MX_OPEN_READ   = 1 << 0,
-    MX_OPEN_WRITE  = 1 << 1,
-    MX_OPEN_APPEND = 1 << 2,
-    MX_OPEN_NEW    = 1 << 3,
+    MX_OPEN_READ       = 1 << 0,
+    MX_OPEN_WRITE      = 1 << 1,
+    MX_OPEN_APPEND     = 1 << 2,
+    MX_OPEN_NEW        = 1 << 3,
+    MX_OPEN_MMAP       = 1 << 4,    /**< Map a file opened for reading only, see mmap_stream.h. */
+    MX_OPEN_SEQUENTIAL = 1 << 5,    /**< Mapped data is read front to back. */
+    MX_OPEN_RANDOM     = 1 << 6,    /**< Mapped data is read in no particular order. */
+    MX_OPEN_WILLNEED   = 1 << 7,    /**< Start paging in the whole mapping. */
+    MX_OPEN_HUGEPAGES  = 1 << 8,    /**< Back the mapping with huge pages where the system can. */
 } mx_open_flags;
 
 MX_API fatptr_t(IStream) mx_get_stdin(void);
 MX_API fatptr_t(IStream) mx_get_stdout(void);
 MX_API fatptr_t(IStream) mx_get_stderr(void);
 MX_API fatptr_t(IStream) mx_open(const char *file, mx_open_flags flags);
+/**
+ * Open a file, allocating the stream object from an allocator.
+ * @param[in] file Path of the file.
+ * @param[in] flags Open flags.
+ * @param[in] allocator The allocator, a NULL ptr for the default.
+ * @return The stream. Check ptr against NULL.
+ */
+MX_API fatptr_t(IStream) mx_open_allocator(const char *file, mx_open_flags flags, fatptr_t(IAllocator) allocator);
 
 #define mx_stdin  (mx_get_stdin())
 #define mx_stdout (mx_get_stdout())
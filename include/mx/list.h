@@ -3,19 +3,51 @@
  * This is an array list implementation inspired by the stb data structures
  * single header library. The list itself works like any C pointer, except
  * the real base pointer is before the pointer you will see.
+ *
+ * The header tracks a capacity next to the count, and the list grows
+ * geometrically, so appending N items costs O(N) copies and O(log N)
+ * allocations.
+ *
+ * Lists allocate from the default allocator of mx/arena.h, or from the
+ * allocator given to mx_list_init(). The allocator is kept in the header.
+ *
+ * Small lists can skip the allocation: mx_list_init_inline() places the
+ * header and the first items in storage the caller provides, on the stack or
+ * in a struct. The list only moves to the allocator once it outgrows that
+ * storage, and every other macro works on it unchanged.
+ *
+ * @code{c}
+ * mx_list_storage_t(int, 16) storage;
+ * int *list = NULL;
+ *
+ * mx_list_init_inline(list, storage, mx_get_allocator());
+ * mx_list_push(list, 42);
+ * mx_list_free(list);
+ * @endcode
  */
 #ifndef _MX_LIST_H_
 #define _MX_LIST_H_
 
 #include "mx/base.h"
 #include "mx/assert.h"
+#include "mx/arena.h"
 #include <stdlib.h>
 #include <string.h>
 
 struct mx_list_self_t {
-    int count;
+    fatptr_t(IAllocator) allocator; /**< Allocator of the list. */
+    int count;                      /**< Number of items in use. */
+    unsigned capacity : 31;         /**< Number of items allocated. */
+    unsigned fixed : 1;             /**< Items live in storage of the caller. */
 };
 
+/**
+ * @brief Storage for the header and the first n items of a list.
+ * @param T The item type.
+ * @param n The number of items kept inline.
+ */
+#define mx_list_storage_t(T, n) struct { struct mx_list_self_t self; T items[n]; }
+
 /**
  * @brief Internal function for retreiving the list header.
  * @param list The list.
@@ -30,12 +62,231 @@ struct mx_list_self_t {
 */
 #define mx_list_count(list) (((list) == NULL) ? 0 : mx_list_self(list)->count)
 
-#define mx_list_resize(list, count) do { \
-    struct mx_list_self_t *self = (list == NULL) ? NULL : mx_list_self(list); \
-    self = realloc(self, sizeof(*self) + sizeof(*(list)) * (count)); \
-    if (self != NULL) { \
-        self->count = (count); \
-        (list) = (void*)(self+1); \
+/**
+ * @brief The number of items the list can hold without reallocating.
+ * @param list The list.
+ * @returns The capacity of the list.
+*/
+#define mx_list_capacity(list) (((list) == NULL) ? 0 : mx_list_self(list)->capacity)
+
+/**
+ * @brief Internal function that allocates an empty list.
+ * @param allocator The allocator, a NULL ptr for the default.
+ * @returns The new list pointer.
+ */
+MX_INLINE void *__mx_list_new(fatptr_t(IAllocator) allocator)
+{
+    allocator = __mx_allocator(allocator);
+
+    struct mx_list_self_t *self = IAllocator_alloc(allocator, sizeof(*self), MX_ALLOC_ALIGN);
+    MX_ASSERT_OOM(self);
+
+    self->allocator = allocator;
+    self->count = 0;
+    self->capacity = 0;
+    self->fixed = 0;
+    return self + 1;
+}
+
+/**
+ * @brief Internal function that sets up the header of inline storage.
+ * @param self The header of the storage.
+ * @param capacity The number of items the storage holds.
+ * @param allocator The allocator to move to when full, a NULL ptr for the default.
+ */
+MX_INLINE void __mx_list_new_inline(struct mx_list_self_t *self, int capacity, fatptr_t(IAllocator) allocator)
+{
+    self->allocator = __mx_allocator(allocator);
+    self->count = 0;
+    self->capacity = capacity;
+    self->fixed = 1;
+}
+
+/**
+ * @brief Internal function that reallocates a list to hold at least capacity items.
+ * @param list The list, may be NULL.
+ * @param size The size of an item.
+ * @param capacity The minimum capacity.
+ * @param exact If false, the capacity grows geometrically so appends are amortized O(1).
+ * @returns The new list pointer.
+ */
+MX_INLINE void *__mx_list_grow(void *list, size_t size, int capacity, bool exact)
+{
+    struct mx_list_self_t *self = (list == NULL) ? NULL : mx_list_self(list);
+    int current = (self == NULL) ? 0 : self->capacity;
+
+    if (capacity <= current)
+        return list;
+
+    if (!exact)
+    {
+        int grown = current < 8 ? 8 : current * 2;
+        capacity = grown > capacity ? grown : capacity;
+    }
+
+    if (self == NULL)
+        self = mx_list_self(__mx_list_new((fatptr_t(IAllocator)){ NULL, NULL }));
+
+    if (self->fixed)
+    {
+        /* Outgrew the inline storage, which stays with the caller. */
+        struct mx_list_self_t *heap = IAllocator_alloc(self->allocator, sizeof(*self) + size * (size_t)capacity, MX_ALLOC_ALIGN);
+        MX_ASSERT_OOM(heap);
+
+        memcpy(heap, self, sizeof(*self) + size * (size_t)self->count);
+        heap->capacity = capacity;
+        heap->fixed = 0;
+        return heap + 1;
+    }
+
+    self = IAllocator_realloc(self->allocator, self,
+                              sizeof(*self) + size * (size_t)current,
+                              sizeof(*self) + size * (size_t)capacity, MX_ALLOC_ALIGN);
+    MX_ASSERT_OOM(self);
+
+    self->capacity = capacity;
+    return self + 1;
+}
+
+/**
+ * @brief Internal function that releases the unused capacity of a list.
+ * @param list The list, may be NULL.
+ * @param size The size of an item.
+ * @returns The new list pointer, NULL if the list was empty. Lists in inline
+ * storage are returned as they are.
+ */
+MX_INLINE void *__mx_list_shrink(void *list, size_t size)
+{
+    if (list == NULL)
+        return NULL;
+
+    struct mx_list_self_t *self = mx_list_self(list);
+    size_t old_size = sizeof(*self) + size * (size_t)self->capacity;
+
+    if (self->fixed)
+        return list;
+
+    if (self->count == 0)
+    {
+        IAllocator_free(self->allocator, self, old_size);
+        return NULL;
+    }
+
+    if (self->count < self->capacity)
+    {
+        self = IAllocator_realloc(self->allocator, self, old_size, sizeof(*self) + size * (size_t)self->count, MX_ALLOC_ALIGN);
+        MX_ASSERT_OOM(self);
+        self->capacity = self->count;
+    }
+
+    return self + 1;
+}
+
+/**
+ * @brief Internal function that frees a list.
+ * @param list The list, may be NULL.
+ * @param size The size of an item.
+ */
+MX_INLINE void __mx_list_free(void *list, size_t size)
+{
+    if (list != NULL && !mx_list_self(list)->fixed)
+    {
+        struct mx_list_self_t *self = mx_list_self(list);
+        IAllocator_free(self->allocator, self, sizeof(*self) + size * (size_t)self->capacity);
+    }
+}
+
+/**
+ * @brief Create an empty list that allocates from an allocator.
+ * @param list The list, must be NULL.
+ * @param allocator The allocator, fatptr_t(IAllocator).
+ */
+#define mx_list_init(list, allocator) do { \
+    MX_ASSERT((list) == NULL, "mx_list_init() expected an empty list."); \
+    (list) = __mx_list_new(allocator); \
+} while (0)
+
+/**
+ * @brief Create an empty list in inline storage, that moves to an allocator
+ * once it holds more items than the storage.
+ * @param list The list, must be NULL.
+ * @param storage The storage, an mx_list_storage_t() of the item type. It
+ * must stay in place while the list uses it.
+ * @param allocator The allocator, fatptr_t(IAllocator).
+ * @remarks mx_list_free() leaves the storage alone, and it can be reused.
+ */
+#define mx_list_init_inline(list, storage, allocator) do { \
+    MX_ASSERT((list) == NULL, "mx_list_init_inline() expected an empty list."); \
+    _Static_assert(offsetof(__typeof__(storage), items) == sizeof(struct mx_list_self_t), \
+                   "mx_list_storage_t() items must follow the header."); \
+    __mx_list_new_inline(&(storage).self, sizeof((storage).items) / sizeof((storage).items[0]), (allocator)); \
+    (list) = (storage).items; \
+} while (0)
+
+/**
+ * @brief Make sure the list can hold at least capacity items.
+ * @param list The list.
+ * @param capacity The number of items to allocate for.
+ * @remarks Allocates exactly capacity items if the list has to grow.
+ */
+#define mx_list_reserve(list, capacity) do { \
+    (list) = __mx_list_grow((list), sizeof(*(list)), (capacity), true); \
+} while (0)
+
+/**
+ * @brief Set the number of items in the list, growing the capacity as needed.
+ * @param list The list.
+ * @param nitems The new number of items. New items are not initialized.
+ */
+#define mx_list_resize(list, nitems) do { \
+    int __count = (nitems); \
+    (list) = __mx_list_grow((list), sizeof(*(list)), __count, false); \
+    if ((list) != NULL) \
+        mx_list_self(list)->count = __count; \
+} while (0)
+
+/**
+ * @brief Release the capacity not in use. An empty list is freed.
+ * @param list The list.
+ */
+#define mx_list_shrink_to_fit(list) do { \
+    (list) = __mx_list_shrink((list), sizeof(*(list))); \
+} while (0)
+
+/**
+ * @brief Append an item to the end of the list (with assignment)
+ * @param list The list.
+ * @param item The item to append.
+ */
+#define mx_list_push(list, item) do { \
+    int __count = mx_list_count(list); \
+    (list) = __mx_list_grow((list), sizeof(*(list)), __count + 1, false); \
+    (list)[__count] = (item); \
+    mx_list_self(list)->count = __count + 1; \
+} while (0)
+
+/**
+ * @brief Remove the last item of the list.
+ * @param list The list, must not be empty.
+ * @returns The removed item.
+ * @remarks The capacity is kept, use mx_list_shrink_to_fit() to release it.
+ */
+#define mx_list_pop(list) \
+    (MX_ASSERT(mx_list_count(list) > 0, "mx_list_pop() on an empty list."), \
+     (list)[--mx_list_self(list)->count])
+
+/**
+ * @brief Append items to the end of the list (with copy)
+ * @param list The list.
+ * @param items Pointer to the items to append.
+ * @param nelem The number of items to append.
+ */
+#define mx_list_append(list, items, nelem) do { \
+    int __count = mx_list_count(list), __nelem = (nelem); \
+    if (__nelem > 0) { \
+        (list) = __mx_list_grow((list), sizeof(*(list)), __count + __nelem, false); \
+        memcpy(&(list)[__count], (items), __nelem * sizeof(*(list))); \
+        mx_list_self(list)->count = __count + __nelem; \
     } \
 } while (0)
 
@@ -48,40 +299,28 @@ struct mx_list_self_t {
  */
 #define mx_list_insert(list, index, item) do { \
     int idx = (index); \
-    if (list == NULL) { \
-        MX_ASSERT(idx == 0, "mx_list_insert() can only insert at 0 for an empty list."); \
-        mx_list_resize(list, 1); \
-        list[0] = item; \
-    } else { \
-        int count = mx_list_count(list) \
-        MX_ASSERT(idx > 0 && idx <= count, "mx_list_insert() expected a range between 0 and mx_list_count()."); \
-        mx_list_resize(list, count + 1); \
-        memmove(&list[idx]+1, &list[idx], (count - idx) * sizeof(*list)); \
-        list[idx] = item; \
-    } \
+    int count = mx_list_count(list); \
+    MX_ASSERT(idx >= 0 && idx <= count, "mx_list_insert() expected a range between 0 and mx_list_count()."); \
+    mx_list_resize(list, count + 1); \
+    memmove(&list[idx]+1, &list[idx], (count - idx) * sizeof(*list)); \
+    list[idx] = item; \
 } while(0)
 
 /**
- * @brief Insert an item into the list (with copy)
+ * @brief Insert items into the list (with copy)
  * @param list The list.
- * @param index The index to insert the item into.
- * @param item The item to insert.
+ * @param index The index to insert the items into.
+ * @param item Pointer to (or array of) the items to insert.
  * @param nelem The number of elements to insert.
- * @remarks This overload is for things that can be copied, like structs. Item must be an addressable lvalue.
+ * @remarks This overload is for things that can be copied, like structs.
  */
 #define mx_list_insert_array(list, index, item, nelem) do { \
     int idx = (index); \
-    if (list == NULL) { \
-        MX_ASSERT(idx == 0, "mx_list_insert() can only insert at 0 for an empty list."); \
-        mx_list_resize(list, (nelem)); \
-        memcpy(&list[0], &item, (nelem)*sizeof(*item)); \
-    } else { \
-        int count = mx_list_count(list) \
-        MX_ASSERT(idx > 0 && idx <= count, "mx_list_insert() expected a range between 0 and mx_list_count()."); \
-        mx_list_resize(list, count + (nelem)); \
-        memmove(&list[idx]+(nelem), &list[idx], (count - idx) * sizeof(*list)); \
-        memcpy(&list[idx], &item, (nelem)*sizeof(*item)); \
-    } \
+    int count = mx_list_count(list); \
+    MX_ASSERT(idx >= 0 && idx <= count, "mx_list_insert() expected a range between 0 and mx_list_count()."); \
+    mx_list_resize(list, count + (nelem)); \
+    memmove(&list[idx]+(nelem), &list[idx], (count - idx) * sizeof(*list)); \
+    memcpy(&list[idx], (item), (nelem)*sizeof(*list)); \
 } while(0)
 
 /**
@@ -90,7 +329,7 @@ struct mx_list_self_t {
  */
 #define mx_list_free(list) do { \
     if (list != NULL) { \
-        free(mx_list_self(list)); \
+        __mx_list_free((list), sizeof(*(list))); \
         list = NULL; \
     } \
 } while(0)
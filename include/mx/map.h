@@ -0,0 +1,205 @@
+/**
+ * @file map.h Hash Map
+ * An open addressing hash map in the style of SwissTable. Like the array
+ * list, the map works like a plain C pointer to its entries, with the real
+ * base pointer before the pointer you will see.
+ *
+ * The entry type is any struct with a member called key, and usually one
+ * called value. Keys are hashed and compared by their bytes, so they should
+ * be integers, pointers, or structs without padding.
+ *
+ * Next to the entries lives an array of control bytes, one per slot, holding
+ * 7 bits of the hash of the key in the slot or an empty or deleted marker.
+ * Lookups compare 16 control bytes at a time with SSE2, and only touch an
+ * entry when its control byte matches, so most lookups cost one cache miss
+ * for the control bytes and one for the entry. The map grows at a load
+ * factor of 7/8.
+ *
+ * @code{c}
+ * struct { int key; double value; } *map = NULL;
+ *
+ * mx_map_put(map, 42, 1.5);
+ * int i = mx_map_find(map, 42);           // Index into map, or -1.
+ *
+ * for (int i = mx_map_begin(map); i < mx_map_end(map); i = mx_map_next(map, i))
+ *     printf("%d %f\n", map[i].key, map[i].value);
+ *
+ * mx_map_free(map);
+ * @endcode
+ */
+#ifndef _MX_MAP_H_
+#define _MX_MAP_H_
+
+#include "mx/base.h"
+#include "mx/assert.h"
+#include "mx/digest.h"
+
+struct mx_map_self_t {
+    int count;                  /**< Number of entries. */
+    int capacity;               /**< Number of slots, a power of two. */
+    int growth_left;            /**< Entries that fit before the next rehash. */
+    int index;                  /**< Index returned by the last insert. */
+    size_t key_offset;          /**< Offset of the key in an entry. */
+    size_t key_size;            /**< Size of the key. */
+    mx_digest_function hash;    /**< Key hash, NULL for mx_wyhash64. */
+    int8_t *ctrl;               /**< Control bytes, capacity + 16. */
+};
+
+/*
+ * Internal functions. The size of an entry is passed to the functions that
+ * index entries, and the functions that look up a key take its address.
+ */
+
+MX_API void *__mx_map_create(size_t size, size_t key_offset, size_t key_size, mx_digest_function hash, int capacity);
+MX_API void *__mx_map_reserve(void *map, size_t size, int count);
+MX_API int   __mx_map_find(const void *map, size_t size, const void *key);
+MX_API void *__mx_map_insert(void *map, size_t size, const void *key);
+MX_API bool  __mx_map_erase(void *map, size_t size, const void *key);
+MX_API int   __mx_map_next(const void *map, int index);
+MX_API void  __mx_map_clear(void *map);
+MX_API void  __mx_map_free(void *map);
+
+/**
+ * @brief Internal function for retreiving the map header.
+ * @param map The map.
+ * @returns The map header.
+ */
+#define mx_map_self(map) (((struct mx_map_self_t*)(map)) - 1)
+
+/** Internal macro for the address of a copy of a key. */
+#define __mx_map_key(map, k) (&((struct { __typeof__((map)->key) key; }){ (k) }).key)
+
+/** Internal macro for the entry layout arguments. */
+#define __mx_map_layout(map) sizeof(*(map)), offsetof(__typeof__(*(map)), key), sizeof((map)->key)
+
+/** Internal macro that makes sure the map exists. */
+#define __mx_map_prepare(map) \
+    ((map) == NULL ? __mx_map_create(__mx_map_layout(map), NULL, 0) : (void*)(map))
+
+/**
+ * @brief The number of entries in the map.
+ * @param map The map.
+ * @returns The number of entries in the map.
+ */
+#define mx_map_count(map) (((map) == NULL) ? 0 : mx_map_self(map)->count)
+
+/**
+ * @brief The number of slots in the map.
+ * @param map The map.
+ * @returns The capacity of the map. Not every slot can be filled.
+ */
+#define mx_map_capacity(map) (((map) == NULL) ? 0 : mx_map_self(map)->capacity)
+
+/**
+ * @brief Create an empty map with a custom key hash.
+ * @param map The map, must be NULL.
+ * @param hash The digest function used to hash keys. Only the first 8 bytes
+ * of the digest are used, and the digest must not be larger than 64 bytes.
+ * @remarks A map created by the first insert uses mx_wyhash64.
+ */
+#define mx_map_init(map, hash) do { \
+    MX_ASSERT((map) == NULL, "mx_map_init() expected an empty map."); \
+    (map) = __mx_map_create(__mx_map_layout(map), (hash), 0); \
+} while (0)
+
+/**
+ * @brief Make sure the map can hold count entries without rehashing.
+ * @param map The map.
+ * @param count The number of entries.
+ */
+#define mx_map_reserve(map, count) do { \
+    (map) = __mx_map_prepare(map); \
+    (map) = __mx_map_reserve((map), sizeof(*(map)), (count)); \
+} while (0)
+
+/**
+ * @brief Find an entry.
+ * @param map The map.
+ * @param k The key.
+ * @returns The index of the entry, or -1 if there is none.
+ */
+#define mx_map_find(map, k) \
+    (((map) == NULL) ? -1 : __mx_map_find((map), sizeof(*(map)), __mx_map_key(map, k)))
+
+/**
+ * @brief Check if the map has an entry for a key.
+ * @param map The map.
+ * @param k The key.
+ * @returns True if there is an entry.
+ */
+#define mx_map_contains(map, k) (mx_map_find(map, k) >= 0)
+
+/**
+ * @brief Find or insert an entry.
+ * @param map The map.
+ * @param k The key.
+ * @returns The index of the entry. A new entry is zeroed except for its key.
+ * @remarks Inserting may move all entries, invalidating indices and pointers.
+ */
+#define mx_map_insert(map, k) \
+    ((map) = __mx_map_prepare(map), \
+     (map) = __mx_map_insert((map), sizeof(*(map)), __mx_map_key(map, k)), mx_map_self(map)->index)
+
+/**
+ * @brief Insert or replace the value for a key.
+ * @param map The map.
+ * @param k The key.
+ * @param v The value, assigned to the value member of the entry.
+ */
+#define mx_map_put(map, k, v) do { \
+    int __index = mx_map_insert(map, k); \
+    (map)[__index].value = (v); \
+} while (0)
+
+/**
+ * @brief Remove an entry.
+ * @param map The map.
+ * @param k The key.
+ * @returns True if the entry existed.
+ */
+#define mx_map_erase(map, k) \
+    (((map) == NULL) ? false : __mx_map_erase((map), sizeof(*(map)), __mx_map_key(map, k)))
+
+/**
+ * @brief Index of the first entry, for iteration.
+ * @param map The map.
+ * @returns The index of the first entry, or mx_map_end() if the map is empty.
+ * @remarks Entries are visited in slot order, which is not insertion order.
+ */
+#define mx_map_begin(map) (((map) == NULL) ? 0 : __mx_map_next((map), 0))
+
+/**
+ * @brief End index for iteration.
+ * @param map The map.
+ */
+#define mx_map_end(map) mx_map_capacity(map)
+
+/**
+ * @brief Index of the entry after index, for iteration.
+ * @param map The map.
+ * @param index The current index.
+ * @remarks Erasing the current entry while iterating is allowed.
+ */
+#define mx_map_next(map, index) __mx_map_next((map), (index) + 1)
+
+/**
+ * @brief Remove all entries, keeping the capacity.
+ * @param map The map.
+ */
+#define mx_map_clear(map) do { \
+    if ((map) != NULL) \
+        __mx_map_clear(map); \
+} while (0)
+
+/**
+ * @brief Free the map, completely destroying any associated memory.
+ * @param map The map to free.
+ */
+#define mx_map_free(map) do { \
+    if ((map) != NULL) { \
+        __mx_map_free(map); \
+        (map) = NULL; \
+    } \
+} while (0)
+
+#endif
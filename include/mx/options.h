@@ -12,6 +12,10 @@
  * static functions. Pointer mode allows you to pass the structure itself.
  * Pointer mode functions are postfixed with `_r`.
  *
+ * Keys and values point into argv, they are not copied. The exception is a
+ * key followed by '=' or ':' in the same argument, which is copied to a
+ * buffer so it can end in a NUL; key_str and value_str always slice argv.
+ *
  * @example mx_options_static Static Mode Usage.
  * @code{c}
  * #include <stdio.h>
@@ -65,6 +69,8 @@
  */
 
 #include <mx/base.h>
+#include <mx/arena.h>
+#include <mx/str.h>
 
 /**
  * Option kind.
@@ -103,6 +109,12 @@ typedef struct mx_options_t
     mx_optkind_t kind;  /**< Last option kind. */
     const char  *key;   /**< Last key. */
     const char  *value; /**< Last value. */
+    mx_str_t     key_str;   /**< Last key, as a slice of argv. */
+    mx_str_t     value_str; /**< Last value, as a slice of argv. */
+    /** Allocator for key copies. Set to the default by mx_options_begin_r(), replace it after. */
+    fatptr_t(IAllocator) allocator;
+    char        *buffer;        /**< Copy of a key that ends at '=' or ':'. */
+    size_t       buffer_size;   /**< Size of the buffer. */
 } mx_options_t;
 
 /**
@@ -0,0 +1,191 @@
+#ifndef _MX_RING_H_
+#define _MX_RING_H_
+
+/**
+ * @file ring.h Lock-free Queues
+ *
+ * Two bounded queues of fixed size items, for passing work between threads
+ * without locks.
+ *
+ * - mx_spsc_t is a ring for exactly one producer thread and one consumer
+ *   thread. Each side caches the index of the other, so it only touches the
+ *   other's cache line when the ring looks full or empty.
+ * - mx_mpmc_t is a queue for any number of producers and consumers, after
+ *   Dmitry Vyukov's bounded MPMC queue. Every cell has a sequence number
+ *   that tells producers and consumers whose turn it is, so a push or pop
+ *   costs one compare and swap.
+ *
+ * The indices written by the producers and by the consumers live on their
+ * own cache lines, so the two sides do not invalidate each other's caches
+ * on every operation. Items are copied in and out by value; to pass buffers,
+ * queue pointers to them.
+ *
+ * @code{c}
+ * mx_spsc_t ring;
+ * mx_spsc_init(&ring, 1024, sizeof(char*));
+ *
+ * // Producer thread.
+ * while (!mx_spsc_push(&ring, &buffer))
+ *     ;
+ *
+ * // Consumer thread.
+ * char *buffers[32];
+ * size_t n = mx_spsc_pop_n(&ring, buffers, 32);
+ * @endcode
+ */
+
+#include "mx/base.h"
+#include "mx/arena.h"
+#include <stdatomic.h>
+
+/** Size of a cache line, the unit of false sharing. */
+#define MX_CACHE_LINE 64
+
+/**
+ * Single producer, single consumer ring.
+ */
+typedef struct mx_spsc_t
+{
+    /* Written by the consumer. */
+    _Alignas(MX_CACHE_LINE) atomic_size_t head; /**< Next item to pop. */
+    size_t tail_cache;                          /**< Last tail seen by the consumer. */
+
+    /* Written by the producer. */
+    _Alignas(MX_CACHE_LINE) atomic_size_t tail; /**< Next slot to push. */
+    size_t head_cache;                          /**< Last head seen by the producer. */
+
+    /* Read only. */
+    _Alignas(MX_CACHE_LINE) char *items;        /**< Item storage. */
+    size_t mask;                                /**< Capacity - 1. */
+    size_t size;                                /**< Size of an item. */
+    fatptr_t(IAllocator) allocator;             /**< Allocator of the items. */
+} mx_spsc_t;
+
+/**
+ * Multiple producer, multiple consumer queue.
+ */
+typedef struct mx_mpmc_t
+{
+    _Alignas(MX_CACHE_LINE) atomic_size_t tail; /**< Next position to push. */
+    _Alignas(MX_CACHE_LINE) atomic_size_t head; /**< Next position to pop. */
+
+    /* Read only. */
+    _Alignas(MX_CACHE_LINE) char *cells;        /**< Sequence number and item per cell. */
+    size_t mask;                                /**< Capacity - 1. */
+    size_t size;                                /**< Size of an item. */
+    size_t stride;                              /**< Size of a cell. */
+    fatptr_t(IAllocator) allocator;             /**< Allocator of the cells. */
+} mx_mpmc_t;
+
+/**
+ * Initialize a ring.
+ * @param[out] ring The ring.
+ * @param[in] capacity Number of items, rounded up to a power of two.
+ * @param[in] size Size of an item in bytes.
+ * @return False if memory could not be allocated.
+ */
+MX_API bool mx_spsc_init(mx_spsc_t *ring, size_t capacity, size_t size);
+
+/**
+ * Release the memory of a ring. Items still queued are dropped.
+ * @param[in] ring The ring.
+ */
+MX_API void mx_spsc_destroy(mx_spsc_t *ring);
+
+/**
+ * Push an item. Only call from the producer thread.
+ * @param[in] ring The ring.
+ * @param[in] item The item to copy in.
+ * @return False if the ring is full.
+ */
+MX_API bool mx_spsc_push(mx_spsc_t *ring, const void *item);
+
+/**
+ * Pop an item. Only call from the consumer thread.
+ * @param[in] ring The ring.
+ * @param[out] item Where to copy the item to.
+ * @return False if the ring is empty.
+ */
+MX_API bool mx_spsc_pop(mx_spsc_t *ring, void *item);
+
+/**
+ * Push up to count items, publishing them at once.
+ * @param[in] ring The ring.
+ * @param[in] items Array of items.
+ * @param[in] count Number of items.
+ * @return The number of items pushed, fewer if the ring filled up.
+ */
+MX_API size_t mx_spsc_push_n(mx_spsc_t *ring, const void *items, size_t count);
+
+/**
+ * Pop up to count items at once.
+ * @param[in] ring The ring.
+ * @param[out] items Array for the items.
+ * @param[in] count Maximum number of items.
+ * @return The number of items popped.
+ */
+MX_API size_t mx_spsc_pop_n(mx_spsc_t *ring, void *items, size_t count);
+
+/**
+ * Number of items in the ring. Only exact when neither side is running.
+ * @param[in] ring The ring.
+ */
+MX_API size_t mx_spsc_count(mx_spsc_t *ring);
+
+/**
+ * Initialize a queue.
+ * @param[out] queue The queue.
+ * @param[in] capacity Number of items, rounded up to a power of two, at least 2.
+ * @param[in] size Size of an item in bytes.
+ * @return False if memory could not be allocated.
+ */
+MX_API bool mx_mpmc_init(mx_mpmc_t *queue, size_t capacity, size_t size);
+
+/**
+ * Release the memory of a queue. Items still queued are dropped.
+ * @param[in] queue The queue.
+ */
+MX_API void mx_mpmc_destroy(mx_mpmc_t *queue);
+
+/**
+ * Push an item.
+ * @param[in] queue The queue.
+ * @param[in] item The item to copy in.
+ * @return False if the queue is full.
+ */
+MX_API bool mx_mpmc_push(mx_mpmc_t *queue, const void *item);
+
+/**
+ * Pop an item.
+ * @param[in] queue The queue.
+ * @param[out] item Where to copy the item to.
+ * @return False if the queue is empty.
+ */
+MX_API bool mx_mpmc_pop(mx_mpmc_t *queue, void *item);
+
+/**
+ * Push up to count items, claiming their cells with a single compare and swap.
+ * @param[in] queue The queue.
+ * @param[in] items Array of items.
+ * @param[in] count Number of items.
+ * @return The number of items pushed, fewer if the queue filled up.
+ * @remarks The items are queued in order and next to each other.
+ */
+MX_API size_t mx_mpmc_push_n(mx_mpmc_t *queue, const void *items, size_t count);
+
+/**
+ * Pop up to count items, claiming their cells with a single compare and swap.
+ * @param[in] queue The queue.
+ * @param[out] items Array for the items.
+ * @param[in] count Maximum number of items.
+ * @return The number of items popped.
+ */
+MX_API size_t mx_mpmc_pop_n(mx_mpmc_t *queue, void *items, size_t count);
+
+/**
+ * Number of items in the queue. Only exact when no thread is using it.
+ * @param[in] queue The queue.
+ */
+MX_API size_t mx_mpmc_count(mx_mpmc_t *queue);
+
+#endif
@@ -0,0 +1,285 @@
+#ifndef _MX_SKETCH_H_
+#define _MX_SKETCH_H_
+
+/**
+ * @file sketch.h Bloom Filter and Count-Min Sketch
+ *
+ * Probabilistic summaries of a set of keys, for screening keys before an
+ * expensive lookup. Each key is hashed once with mx_wyhash64_seeded() and the
+ * probe positions are derived from that hash by double hashing, so callers
+ * that already hold a hash, like mx_str_hash(), can pass it directly.
+ *
+ * The Bloom filter is blocked: all probes of a key fall in one 512 bit block,
+ * a single cache line, so a query costs one cache miss at the price of a
+ * slightly higher false positive rate than a classic filter of the same size.
+ *
+ * The count-min sketch estimates how often each key was added. An estimate
+ * is never below the true count and exceeds it by at most epsilon times the
+ * total count, with probability 1 - delta.
+ *
+ * Adding with the _concurrent functions and querying may run on any number of
+ * threads at once without locks. The batch functions hash a group of keys and
+ * prefetch their cache lines before probing any of them, which hides most of
+ * the memory latency on large structures.
+ *
+ * Both structures can be saved to and loaded from an IStream, in a little
+ * endian format that does not depend on the host.
+ *
+ * @code{c}
+ * mx_bloom_t seen;
+ * mx_bloom_init(&seen, 1000000, 0.01);
+ *
+ * mx_bloom_add(&seen, "alice", 5);
+ *
+ * if (mx_bloom_contains(&seen, key, length))
+ *     expensive_lookup(key, length);
+ *
+ * mx_bloom_destroy(&seen);
+ * @endcode
+ */
+
+#include "mx/base.h"
+#include "mx/arena.h"
+#include "mx/io/stream.h"
+#include <stdatomic.h>
+
+/** Bits per Bloom filter block. */
+#define MX_BLOOM_BLOCK_BITS 512
+/** Most probes per key. */
+#define MX_BLOOM_MAX_PROBES 16
+/** Most count-min sketch rows. */
+#define MX_CMS_MAX_DEPTH    16
+
+/**
+ * Blocked Bloom filter.
+ */
+typedef struct mx_bloom_t
+{
+    _Atomic uint64_t *words;        /**< Blocks of eight words, cache line aligned. */
+    size_t blocks;                  /**< Number of blocks. */
+    unsigned probes;                /**< Bits set per key. */
+    uint64_t seed;                  /**< Hash seed. */
+    void *memory;                   /**< Allocation holding the words. */
+    size_t memory_size;             /**< Size of the allocation. */
+    fatptr_t(IAllocator) allocator; /**< Allocator of the words. */
+} mx_bloom_t;
+
+/**
+ * Initialize an empty filter sized for a number of keys.
+ * @param[out] bloom The filter.
+ * @param[in] expected Number of keys the filter will hold.
+ * @param[in] fp_rate Wanted false positive rate at that many keys, in (0, 1).
+ */
+MX_API void mx_bloom_init(mx_bloom_t *bloom, size_t expected, double fp_rate);
+
+/**
+ * Initialize an empty filter of a given shape.
+ * @param[out] bloom The filter.
+ * @param[in] blocks Number of 512 bit blocks, at least one.
+ * @param[in] probes Bits set per key, 1 to MX_BLOOM_MAX_PROBES.
+ * @param[in] seed Hash seed. Filters only agree on keys with the same seed.
+ */
+MX_API void mx_bloom_init_shape(mx_bloom_t *bloom, size_t blocks, unsigned probes, uint64_t seed);
+
+/**
+ * Release the storage of a filter.
+ * @param[in] bloom The filter.
+ */
+MX_API void mx_bloom_destroy(mx_bloom_t *bloom);
+
+/**
+ * Remove every key.
+ * @param[in] bloom The filter.
+ */
+MX_API void mx_bloom_clear(mx_bloom_t *bloom);
+
+/**
+ * Hash a key the way the filter does.
+ */
+MX_API uint64_t mx_bloom_hash(const mx_bloom_t *bloom, const void *key, size_t length);
+
+/**
+ * Add a key by its hash. Not safe while other threads add keys.
+ */
+MX_API void mx_bloom_add_hash(mx_bloom_t *bloom, uint64_t hash);
+
+/**
+ * Add a key by its hash with atomic operations, safe on any thread.
+ */
+MX_API void mx_bloom_add_hash_concurrent(mx_bloom_t *bloom, uint64_t hash);
+
+/**
+ * Test a key by its hash.
+ * @return False if the key was never added, true if it probably was.
+ */
+MX_API bool mx_bloom_contains_hash(const mx_bloom_t *bloom, uint64_t hash);
+
+/**
+ * Add a key. Not safe while other threads add keys.
+ */
+MX_API void mx_bloom_add(mx_bloom_t *bloom, const void *key, size_t length);
+
+/**
+ * Add a key with atomic operations, safe on any thread.
+ */
+MX_API void mx_bloom_add_concurrent(mx_bloom_t *bloom, const void *key, size_t length);
+
+/**
+ * Test a key.
+ * @return False if the key was never added, true if it probably was.
+ */
+MX_API bool mx_bloom_contains(const mx_bloom_t *bloom, const void *key, size_t length);
+
+/**
+ * Add several keys. Not safe while other threads add keys.
+ * @param[in] bloom The filter.
+ * @param[in] keys The keys.
+ * @param[in] lengths Length of each key.
+ * @param[in] count Number of keys.
+ */
+MX_API void mx_bloom_add_batch(mx_bloom_t *bloom, const void *const *keys, const size_t *lengths, size_t count);
+
+/**
+ * Add several keys with atomic operations, safe on any thread.
+ */
+MX_API void mx_bloom_add_batch_concurrent(mx_bloom_t *bloom, const void *const *keys, const size_t *lengths, size_t count);
+
+/**
+ * Test several keys.
+ * @param[in] bloom The filter.
+ * @param[in] keys The keys.
+ * @param[in] lengths Length of each key.
+ * @param[in] count Number of keys.
+ * @param[out] results Whether each key was probably added.
+ * @return Number of keys that were probably added.
+ */
+MX_API size_t mx_bloom_contains_batch(const mx_bloom_t *bloom, const void *const *keys, const size_t *lengths, size_t count, bool *results);
+
+/**
+ * Write a filter to a stream.
+ * @return False if the stream failed.
+ */
+MX_API bool mx_bloom_save(const mx_bloom_t *bloom, fatptr_t(IStream) stream);
+
+/**
+ * Initialize a filter from a stream written by mx_bloom_save().
+ * @param[out] bloom The filter, left uninitialized on failure.
+ * @param[in] stream The stream.
+ * @return False if the stream failed or does not hold a filter.
+ */
+MX_API bool mx_bloom_load(mx_bloom_t *bloom, fatptr_t(IStream) stream);
+
+/**
+ * Count-min sketch.
+ */
+typedef struct mx_cms_t
+{
+    _Atomic uint32_t *counters;     /**< depth rows of width counters. */
+    size_t width;                   /**< Counters per row. */
+    unsigned depth;                 /**< Number of rows. */
+    uint64_t seed;                  /**< Hash seed. */
+    fatptr_t(IAllocator) allocator; /**< Allocator of the counters. */
+} mx_cms_t;
+
+/**
+ * Initialize an empty sketch for an error bound.
+ * @param[out] cms The sketch.
+ * @param[in] epsilon Overestimate as a fraction of the total count, in (0, 1).
+ * @param[in] delta Probability of exceeding that, in (0, 1).
+ */
+MX_API void mx_cms_init(mx_cms_t *cms, double epsilon, double delta);
+
+/**
+ * Initialize an empty sketch of a given shape.
+ * @param[out] cms The sketch.
+ * @param[in] width Counters per row, at least one.
+ * @param[in] depth Number of rows, 1 to MX_CMS_MAX_DEPTH.
+ * @param[in] seed Hash seed.
+ */
+MX_API void mx_cms_init_shape(mx_cms_t *cms, size_t width, unsigned depth, uint64_t seed);
+
+/**
+ * Release the storage of a sketch.
+ * @param[in] cms The sketch.
+ */
+MX_API void mx_cms_destroy(mx_cms_t *cms);
+
+/**
+ * Reset every count to zero.
+ * @param[in] cms The sketch.
+ */
+MX_API void mx_cms_clear(mx_cms_t *cms);
+
+/**
+ * Hash a key the way the sketch does.
+ */
+MX_API uint64_t mx_cms_hash(const mx_cms_t *cms, const void *key, size_t length);
+
+/**
+ * Add to the count of a key by its hash. Not safe while other threads add.
+ * Counts saturate at UINT32_MAX.
+ */
+MX_API void mx_cms_add_hash(mx_cms_t *cms, uint64_t hash, uint32_t count);
+
+/**
+ * Add to the count of a key by its hash with atomic operations, safe on any
+ * thread. Counts saturate at UINT32_MAX.
+ */
+MX_API void mx_cms_add_hash_concurrent(mx_cms_t *cms, uint64_t hash, uint32_t count);
+
+/**
+ * Estimate the count of a key by its hash.
+ */
+MX_API uint32_t mx_cms_estimate_hash(const mx_cms_t *cms, uint64_t hash);
+
+/**
+ * Add to the count of a key. Not safe while other threads add.
+ */
+MX_API void mx_cms_add(mx_cms_t *cms, const void *key, size_t length, uint32_t count);
+
+/**
+ * Add to the count of a key with atomic operations, safe on any thread.
+ */
+MX_API void mx_cms_add_concurrent(mx_cms_t *cms, const void *key, size_t length, uint32_t count);
+
+/**
+ * Estimate the count of a key, never less than the true count.
+ */
+MX_API uint32_t mx_cms_estimate(const mx_cms_t *cms, const void *key, size_t length);
+
+/**
+ * Add one to the count of several keys. Not safe while other threads add.
+ * @param[in] cms The sketch.
+ * @param[in] keys The keys.
+ * @param[in] lengths Length of each key.
+ * @param[in] count Number of keys.
+ */
+MX_API void mx_cms_add_batch(mx_cms_t *cms, const void *const *keys, const size_t *lengths, size_t count);
+
+/**
+ * Add one to the count of several keys with atomic operations, safe on any
+ * thread.
+ */
+MX_API void mx_cms_add_batch_concurrent(mx_cms_t *cms, const void *const *keys, const size_t *lengths, size_t count);
+
+/**
+ * Estimate the count of several keys.
+ * @param[out] estimates The estimate of each key.
+ */
+MX_API void mx_cms_estimate_batch(const mx_cms_t *cms, const void *const *keys, const size_t *lengths, size_t count, uint32_t *estimates);
+
+/**
+ * Write a sketch to a stream.
+ * @return False if the stream failed.
+ */
+MX_API bool mx_cms_save(const mx_cms_t *cms, fatptr_t(IStream) stream);
+
+/**
+ * Initialize a sketch from a stream written by mx_cms_save().
+ * @param[out] cms The sketch, left uninitialized on failure.
+ * @param[in] stream The stream.
+ * @return False if the stream failed or does not hold a sketch.
+ */
+MX_API bool mx_cms_load(mx_cms_t *cms, fatptr_t(IStream) stream);
+
+#endif
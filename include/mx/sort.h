@@ -0,0 +1,365 @@
+#ifndef _MX_SORT_H_
+#define _MX_SORT_H_
+
+/**
+ * @file sort.h Sorting and Searching
+ *
+ * Type generic sorting for arrays and lists. MX_SORT_DEFINE() generates
+ * functions for one element type with the comparison inlined, instead of an
+ * indirect call per comparison as with qsort.
+ *
+ * @code{c}
+ * #define point_less(a, b) ((a).x < (b).x)
+ * MX_SORT_DEFINE(point, point_t, point_less)
+ *
+ * point_sort(list, mx_list_count(list));          // Introsort.
+ * point_stable_sort(list, mx_list_count(list));   // Merge sort.
+ * point_parallel_sort(list, mx_list_count(list), 0);
+ * size_t i = point_lower_bound(list, mx_list_count(list), key);
+ * @endcode
+ *
+ * For integer and floating point keys, LSD radix sort is faster still. The
+ * mx_sort_u32() family sorts plain arrays of numbers, and
+ * MX_SORT_DEFINE_RADIX() generates a stable radix sort over any unsigned key
+ * extracted from an element.
+ */
+
+#include "mx/base.h"
+#include "mx/assert.h"
+#include "mx/arena.h"
+#include "mx/thread.h"
+#include <string.h>
+
+/** Ranges this short are insertion sorted. */
+#define MX_SORT_INSERTION   16
+/** Smallest number of elements per thread of a parallel sort. */
+#define MX_SORT_PARALLEL    (1u << 16)
+/** Largest number of threads of a parallel sort. */
+#define MX_SORT_THREADS     64
+
+/**
+ * @brief Define sorting and searching functions for a type.
+ * @param name Prefix of the generated functions.
+ * @param T Element type.
+ * @param less Function or macro taking two T values, true if the first sorts
+ * before the second. It must be a strict weak ordering.
+ *
+ * Generates:
+ * - void name_sort(T *a, size_t n): Introsort, not stable.
+ * - void name_stable_sort(T *a, size_t n): Merge sort, stable.
+ * - void name_parallel_sort(T *a, size_t n, unsigned threads): Stable merge
+ *   sort on up to threads threads, 0 for one per processor. Each thread
+ *   allocates from the default allocator, which must be thread safe.
+ * - size_t name_lower_bound(const T *a, size_t n, T key): Index of the first
+ *   element not less than key.
+ * - size_t name_upper_bound(const T *a, size_t n, T key): Index of the first
+ *   element greater than key.
+ */
+#define MX_SORT_DEFINE(name, T, less) \
+\
+MX_INLINE void name##_insertion_sort(T *a, size_t n) \
+{ \
+    for (size_t i = 1; i < n; i++) \
+    { \
+        T x = a[i]; \
+        size_t j = i; \
+        for (; j > 0 && less(x, a[j - 1]); j--) \
+            a[j] = a[j - 1]; \
+        a[j] = x; \
+    } \
+} \
+\
+MX_INLINE void name##_heap_sort(T *a, size_t n) \
+{ \
+    for (size_t start = n / 2, end = n; end > 1; ) \
+    { \
+        size_t root; \
+        if (start > 0) \
+        { \
+            root = --start; \
+        } \
+        else \
+        { \
+            T t = a[0]; a[0] = a[--end]; a[end] = t; \
+            root = 0; \
+        } \
+        for (size_t child; (child = 2 * root + 1) < end; root = child) \
+        { \
+            if (child + 1 < end && less(a[child], a[child + 1])) \
+                child++; \
+            if (!less(a[root], a[child])) \
+                break; \
+            T t = a[root]; a[root] = a[child]; a[child] = t; \
+        } \
+    } \
+} \
+\
+MX_INLINE void name##_introsort(T *a, size_t n, int depth) \
+{ \
+    while (n > MX_SORT_INSERTION) \
+    { \
+        if (depth-- == 0) \
+        { \
+            name##_heap_sort(a, n); \
+            return; \
+        } \
+        /* Median of three, which also bounds both partition scans. */ \
+        size_t m = n / 2; \
+        T t; \
+        if (less(a[m], a[0]))     { t = a[m]; a[m] = a[0]; a[0] = t; } \
+        if (less(a[n - 1], a[m])) { t = a[m]; a[m] = a[n - 1]; a[n - 1] = t; \
+            if (less(a[m], a[0])) { t = a[m]; a[m] = a[0]; a[0] = t; } } \
+        T pivot = a[m]; \
+        size_t i = 0, j = n - 1; \
+        for (;;) \
+        { \
+            while (less(a[i], pivot)) i++; \
+            while (less(pivot, a[j])) j--; \
+            if (i >= j) break; \
+            t = a[i]; a[i] = a[j]; a[j] = t; \
+            i++; j--; \
+        } \
+        /* Recurse into the smaller side, loop on the larger. */ \
+        size_t left = j + 1; \
+        if (left < n - left) \
+        { \
+            name##_introsort(a, left, depth); \
+            a += left; \
+            n -= left; \
+        } \
+        else \
+        { \
+            name##_introsort(a + left, n - left, depth); \
+            n = left; \
+        } \
+    } \
+    name##_insertion_sort(a, n); \
+} \
+\
+MX_INLINE void name##_sort(T *a, size_t n) \
+{ \
+    int depth = 0; \
+    for (size_t k = n; k > 1; k >>= 1) \
+        depth += 2; \
+    name##_introsort(a, n, depth); \
+} \
+\
+/* Merge two sorted runs into dst. dst may overlap b if it ends where b ends. */ \
+MX_INLINE void name##_merge(T *dst, const T *a, size_t na, const T *b, size_t nb) \
+{ \
+    size_t i = 0, j = 0, k = 0; \
+    while (i < na && j < nb) \
+        dst[k++] = less(b[j], a[i]) ? b[j++] : a[i++]; \
+    while (i < na) \
+        dst[k++] = a[i++]; \
+    while (j < nb) \
+        dst[k++] = b[j++]; \
+} \
+\
+MX_INLINE void name##_merge_sort(T *a, size_t n, T *tmp) \
+{ \
+    if (n <= MX_SORT_INSERTION) \
+    { \
+        name##_insertion_sort(a, n); \
+        return; \
+    } \
+    size_t m = n / 2; \
+    name##_merge_sort(a, m, tmp); \
+    name##_merge_sort(a + m, n - m, tmp); \
+    if (!less(a[m], a[m - 1])) \
+        return; \
+    memcpy(tmp, a, m * sizeof(T)); \
+    name##_merge(a, tmp, m, a + m, n - m); \
+} \
+\
+MX_INLINE void name##_stable_sort(T *a, size_t n) \
+{ \
+    if (n <= MX_SORT_INSERTION) \
+    { \
+        name##_insertion_sort(a, n); \
+        return; \
+    } \
+    fatptr_t(IAllocator) alloc = mx_get_allocator(); \
+    T *tmp = IAllocator_alloc(alloc, (n / 2) * sizeof(T), MX_ALLOC_ALIGN); \
+    MX_ASSERT_OOM(tmp); \
+    name##_merge_sort(a, n, tmp); \
+    IAllocator_free(alloc, tmp, (n / 2) * sizeof(T)); \
+} \
+\
+typedef struct name##_sort_task_t { \
+    T *dst; \
+    const T *a, *b; \
+    size_t na, nb; \
+} name##_sort_task_t; \
+\
+MX_INLINE void name##_sort_task(void *arg) \
+{ \
+    name##_sort_task_t *task = arg; \
+    if (task->b == NULL) \
+        name##_stable_sort(task->dst, task->na); \
+    else \
+        name##_merge(task->dst, task->a, task->na, task->b, task->nb); \
+} \
+\
+/* Run tasks on threads, the first on the calling thread. */ \
+MX_INLINE void name##_sort_run(name##_sort_task_t *tasks, size_t count) \
+{ \
+    mx_thread_t threads[MX_SORT_THREADS]; \
+    bool started[MX_SORT_THREADS]; \
+    for (size_t i = 1; i < count; i++) \
+        started[i] = mx_thread_create(&threads[i], name##_sort_task, &tasks[i]); \
+    name##_sort_task(&tasks[0]); \
+    for (size_t i = 1; i < count; i++) \
+    { \
+        if (started[i]) \
+            mx_thread_join(threads[i]); \
+        else \
+            name##_sort_task(&tasks[i]); \
+    } \
+} \
+\
+MX_INLINE void name##_parallel_sort(T *a, size_t n, unsigned threads) \
+{ \
+    size_t parts = 1; \
+    if (threads == 0) \
+        threads = mx_thread_concurrency(); \
+    while (parts * 2 <= threads && parts * 2 <= MX_SORT_THREADS && n / (parts * 2) >= MX_SORT_PARALLEL) \
+        parts *= 2; \
+    if (parts == 1) \
+    { \
+        name##_stable_sort(a, n); \
+        return; \
+    } \
+    size_t bound[MX_SORT_THREADS + 1]; \
+    name##_sort_task_t tasks[MX_SORT_THREADS]; \
+    for (size_t i = 0; i <= parts; i++) \
+        bound[i] = n * i / parts; \
+    for (size_t i = 0; i < parts; i++) \
+        tasks[i] = (name##_sort_task_t){ a + bound[i], NULL, NULL, bound[i + 1] - bound[i], 0 }; \
+    name##_sort_run(tasks, parts); \
+    fatptr_t(IAllocator) alloc = mx_get_allocator(); \
+    T *buffer = IAllocator_alloc(alloc, n * sizeof(T), MX_ALLOC_ALIGN); \
+    MX_ASSERT_OOM(buffer); \
+    T *src = a, *dst = buffer; \
+    /* Merge pairs of runs until one is left, each merge on its own thread. */ \
+    for (size_t width = 1; width < parts; width *= 2) \
+    { \
+        size_t count = 0; \
+        for (size_t i = 0; i < parts; i += 2 * width) \
+        { \
+            size_t lo = bound[i], mid = bound[i + width], hi = bound[i + 2 * width]; \
+            tasks[count++] = (name##_sort_task_t){ dst + lo, src + lo, src + mid, mid - lo, hi - mid }; \
+        } \
+        name##_sort_run(tasks, count); \
+        T *t = src; src = dst; dst = t; \
+    } \
+    if (src != a) \
+        memcpy(a, src, n * sizeof(T)); \
+    IAllocator_free(alloc, buffer, n * sizeof(T)); \
+} \
+\
+MX_INLINE size_t name##_lower_bound(const T *a, size_t n, T key) \
+{ \
+    if (n == 0) \
+        return 0; \
+    const T *base = a; \
+    while (n > 1) \
+    { \
+        size_t half = n / 2; \
+        base = less(base[half], key) ? base + half : base; \
+        n -= half; \
+    } \
+    return (size_t)(base - a) + (less(*base, key) ? 1 : 0); \
+} \
+\
+MX_INLINE size_t name##_upper_bound(const T *a, size_t n, T key) \
+{ \
+    if (n == 0) \
+        return 0; \
+    const T *base = a; \
+    while (n > 1) \
+    { \
+        size_t half = n / 2; \
+        base = less(key, base[half]) ? base : base + half; \
+        n -= half; \
+    } \
+    return (size_t)(base - a) + (less(key, *base) ? 0 : 1); \
+}
+
+/**
+ * @brief Define a stable LSD radix sort for a type.
+ * @param name Prefix of the generated function.
+ * @param T Element type.
+ * @param K Unsigned key type, uint32_t or uint64_t.
+ * @param key Function or macro taking a T value and returning its K key.
+ * Elements are sorted by increasing key.
+ *
+ * Generates void name_radix_sort(T *a, size_t n). Keys are sorted a byte at
+ * a time, and bytes that are the same in every key are skipped.
+ */
+#define MX_SORT_DEFINE_RADIX(name, T, K, key) \
+\
+MX_INLINE void name##_radix_sort(T *a, size_t n) \
+{ \
+    if (n < 2) \
+        return; \
+    if (n <= MX_SORT_INSERTION * 4) \
+    { \
+        for (size_t i = 1; i < n; i++) \
+        { \
+            T x = a[i]; \
+            K kx = key(x); \
+            size_t j = i; \
+            for (; j > 0 && kx < key(a[j - 1]); j--) \
+                a[j] = a[j - 1]; \
+            a[j] = x; \
+        } \
+        return; \
+    } \
+    size_t hist[sizeof(K)][256]; \
+    memset(hist, 0, sizeof hist); \
+    for (size_t i = 0; i < n; i++) \
+    { \
+        K k = key(a[i]); \
+        for (size_t d = 0; d < sizeof(K); d++) \
+            hist[d][(k >> (8 * d)) & 0xFF]++; \
+    } \
+    fatptr_t(IAllocator) alloc = mx_get_allocator(); \
+    T *buffer = IAllocator_alloc(alloc, n * sizeof(T), MX_ALLOC_ALIGN); \
+    MX_ASSERT_OOM(buffer); \
+    T *src = a, *dst = buffer; \
+    K first = key(a[0]); \
+    for (size_t d = 0; d < sizeof(K); d++) \
+    { \
+        size_t *h = hist[d]; \
+        if (h[(first >> (8 * d)) & 0xFF] == n) \
+            continue; \
+        size_t sum = 0; \
+        for (size_t b = 0; b < 256; b++) \
+        { \
+            size_t c = h[b]; \
+            h[b] = sum; \
+            sum += c; \
+        } \
+        for (size_t i = 0; i < n; i++) \
+            dst[h[(key(src[i]) >> (8 * d)) & 0xFF]++] = src[i]; \
+        T *t = src; src = dst; dst = t; \
+    } \
+    if (src != a) \
+        memcpy(a, src, n * sizeof(T)); \
+    IAllocator_free(alloc, buffer, n * sizeof(T)); \
+}
+
+/*
+ * Radix sorts for arrays of numbers. Floating point values are sorted by the
+ * IEEE total order: -NaN < -Inf < ... < -0.0 < +0.0 < ... < +Inf < +NaN.
+ */
+
+MX_API void mx_sort_u32(uint32_t *a, size_t n);
+MX_API void mx_sort_i32(int32_t *a, size_t n);
+MX_API void mx_sort_u64(uint64_t *a, size_t n);
+MX_API void mx_sort_i64(int64_t *a, size_t n);
+MX_API void mx_sort_f32(float *a, size_t n);
+MX_API void mx_sort_f64(double *a, size_t n);
+
+#endif
@@ -0,0 +1,181 @@
+#ifndef _MX_STR_H_
+#define _MX_STR_H_
+
+/**
+ * @file str.h Strings
+ *
+ * mx_str_t is a slice: a pointer and a length into memory someone else owns,
+ * like an argv entry or a stream buffer. Slicing, comparing and hashing never
+ * copy, and the bytes need not end in a NUL.
+ *
+ * The intern table keeps one copy of every distinct string, in an arena, and
+ * hands out a pointer to that copy. Two interned strings are equal exactly
+ * when their pointers are equal, so maps can key on the pointer and compare
+ * eight bytes instead of the text.
+ *
+ * @code{c}
+ * mx_intern_t names;
+ * mx_intern_init(&names);
+ *
+ * const char *a = mx_intern(&names, mx_str("content-length"));
+ * const char *b = mx_intern(&names, MX_STR("content-length"));
+ * // a == b
+ *
+ * mx_intern_destroy(&names);
+ * @endcode
+ */
+
+#include "mx/base.h"
+#include "mx/arena.h"
+#include <string.h>
+
+/**
+ * String slice.
+ */
+typedef struct mx_str_t
+{
+    const char *ptr;            /**< First byte. */
+    size_t len;                 /**< Number of bytes. */
+} mx_str_t;
+
+/** Slice of a string literal. */
+#define MX_STR(literal) ((mx_str_t){ (literal), sizeof(literal) - 1 })
+
+/**
+ * Slice of a NUL terminated string.
+ * @param[in] cstr The string, may be NULL.
+ */
+MX_INLINE mx_str_t mx_str(const char *cstr)
+{
+    return (mx_str_t){ cstr, cstr ? strlen(cstr) : 0 };
+}
+
+/**
+ * Slice of len bytes at ptr.
+ */
+MX_INLINE mx_str_t mx_str_n(const char *ptr, size_t len)
+{
+    return (mx_str_t){ ptr, len };
+}
+
+/**
+ * Part of a slice.
+ * @param[in] str The slice.
+ * @param[in] begin First byte, clamped to the length.
+ * @param[in] end One past the last byte, clamped to the length.
+ */
+MX_INLINE mx_str_t mx_str_slice(mx_str_t str, size_t begin, size_t end)
+{
+    end = end < str.len ? end : str.len;
+    begin = begin < end ? begin : end;
+    return (mx_str_t){ str.ptr + begin, end - begin };
+}
+
+/**
+ * True if both slices hold the same bytes.
+ */
+MX_INLINE bool mx_str_equal(mx_str_t a, mx_str_t b)
+{
+    return a.len == b.len && (a.len == 0 || a.ptr == b.ptr || memcmp(a.ptr, b.ptr, a.len) == 0);
+}
+
+/**
+ * Compare slices byte by byte, a shorter prefix first.
+ * @return Less than, equal to, or greater than zero, like strcmp.
+ */
+MX_INLINE int mx_str_compare(mx_str_t a, mx_str_t b)
+{
+    size_t len = a.len < b.len ? a.len : b.len;
+    int diff = len ? memcmp(a.ptr, b.ptr, len) : 0;
+
+    if (diff != 0)
+        return diff;
+
+    return a.len < b.len ? -1 : a.len > b.len;
+}
+
+/**
+ * True if str begins with prefix.
+ */
+MX_INLINE bool mx_str_starts_with(mx_str_t str, mx_str_t prefix)
+{
+    return str.len >= prefix.len && (prefix.len == 0 || memcmp(str.ptr, prefix.ptr, prefix.len) == 0);
+}
+
+/**
+ * Find a byte.
+ * @return The index of the first c in str, or str.len if there is none.
+ */
+MX_INLINE size_t mx_str_find(mx_str_t str, char c)
+{
+    const char *at = str.len ? memchr(str.ptr, c, str.len) : NULL;
+    return at ? (size_t)(at - str.ptr) : str.len;
+}
+
+/**
+ * Hash the bytes of a slice with mx_wyhash64.
+ */
+MX_API uint64_t mx_str_hash(mx_str_t str);
+
+typedef struct mx_intern_entry_t mx_intern_entry_t;
+
+/**
+ * String intern table. Not thread safe.
+ */
+typedef struct mx_intern_t
+{
+    mx_arena_t arena;               /**< Holds the strings. */
+    mx_intern_entry_t *entries;     /**< Open addressing slots. */
+    size_t count;                   /**< Number of strings. */
+    size_t mask;                    /**< Number of slots - 1. */
+    fatptr_t(IAllocator) allocator; /**< Allocator of the slots. */
+} mx_intern_t;
+
+/**
+ * Initialize an intern table.
+ * @param[out] table The table.
+ */
+MX_API void mx_intern_init(mx_intern_t *table);
+
+/**
+ * Release a table and every string interned in it.
+ * @param[in] table The table.
+ */
+MX_API void mx_intern_destroy(mx_intern_t *table);
+
+/**
+ * Intern a string.
+ * @param[in] table The table.
+ * @param[in] str The string.
+ * @return The interned copy, NUL terminated, which lives as long as the
+ * table. Interning the same bytes again returns the same pointer.
+ */
+MX_API const char *mx_intern(mx_intern_t *table, mx_str_t str);
+
+/**
+ * Look up a string without interning it.
+ * @param[in] table The table.
+ * @param[in] str The string.
+ * @return The interned copy, or NULL if the string was never interned.
+ */
+MX_API const char *mx_intern_find(mx_intern_t *table, mx_str_t str);
+
+/**
+ * Length of an interned string, without scanning it.
+ * @param[in] interned A string returned by mx_intern().
+ */
+MX_INLINE size_t mx_intern_length(const char *interned)
+{
+    return ((const size_t*)interned)[-1];
+}
+
+/**
+ * Slice of an interned string.
+ * @param[in] interned A string returned by mx_intern().
+ */
+MX_INLINE mx_str_t mx_intern_str(const char *interned)
+{
+    return (mx_str_t){ interned, mx_intern_length(interned) };
+}
+
+#endif
@@ -0,0 +1,73 @@
+#ifndef _MX_THREAD_H_
+#define _MX_THREAD_H_
+/**
+ * @file thread.h LibMX Threads
+ *
+ * Minimal wrapper over the native threading primitives of the operating
+ * system. Internally pthreads (*NIX) or the Win32 thread API is used.
+ */
+
+#include "mx/base.h"
+
+#if _WIN32
+/** Handle to a thread. */
+typedef void *mx_thread_t;
+/** Mutual exclusion lock. (SRWLOCK) */
+typedef struct mx_mutex_t { void *ptr; } mx_mutex_t;
+/** Condition variable. (CONDITION_VARIABLE) */
+typedef struct mx_cond_t { void *ptr; } mx_cond_t;
+#else
+#include <pthread.h>
+/** Handle to a thread. */
+typedef pthread_t mx_thread_t;
+/** Mutual exclusion lock. */
+typedef pthread_mutex_t mx_mutex_t;
+/** Condition variable. */
+typedef pthread_cond_t mx_cond_t;
+#endif
+
+/** Thread entry point. */
+typedef void (*mx_thread_function)(void *arg);
+
+/**
+ * Start a new thread.
+ * @param[out] thread The handle of the new thread.
+ * @param[in] function The function the thread runs.
+ * @param[in] arg The argument passed to the function.
+ * @return True if the thread was started.
+ */
+MX_API bool mx_thread_create(mx_thread_t *thread, mx_thread_function function, void *arg);
+
+/**
+ * Wait for a thread to exit, and release its handle.
+ * @param[in] thread The thread to wait for.
+ */
+MX_API void mx_thread_join(mx_thread_t thread);
+
+/**
+ * Get the number of threads the machine can run at the same time.
+ * @return The number of logical processors, at least 1.
+ */
+MX_API unsigned mx_thread_concurrency(void);
+
+/**
+ * Give up the rest of the time slice of the calling thread.
+ */
+MX_API void mx_thread_yield(void);
+
+MX_API void mx_mutex_init(mx_mutex_t *mutex);
+MX_API void mx_mutex_destroy(mx_mutex_t *mutex);
+MX_API void mx_mutex_lock(mx_mutex_t *mutex);
+MX_API void mx_mutex_unlock(mx_mutex_t *mutex);
+
+MX_API void mx_cond_init(mx_cond_t *cond);
+MX_API void mx_cond_destroy(mx_cond_t *cond);
+/**
+ * Atomically unlock the mutex and wait for the condition to be signaled.
+ * The mutex is locked again before returning. Wake ups may be spurious.
+ */
+MX_API void mx_cond_wait(mx_cond_t *cond, mx_mutex_t *mutex);
+MX_API void mx_cond_signal(mx_cond_t *cond);
+MX_API void mx_cond_broadcast(mx_cond_t *cond);
+
+#endif
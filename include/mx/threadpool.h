@@ -0,0 +1,157 @@
+#ifndef _MX_THREADPOOL_H_
+#define _MX_THREADPOOL_H_
+
+/**
+ * @file threadpool.h Work Stealing Thread Pool
+ *
+ * A pool of worker threads that share work by stealing. Every worker owns a
+ * Chase-Lev deque: it pushes and takes tasks at the bottom without locks,
+ * while idle workers steal from the top of the others. Tasks submitted from
+ * threads outside the pool go through a shared injector queue.
+ *
+ * Tasks are objects with the ITask trait. Their completion is tracked by a
+ * task group, and a thread waiting on a group runs queued tasks instead of
+ * blocking.
+ *
+ * mx_parallel_for() and mx_parallel_reduce() split an index range in halves
+ * until the pieces are no larger than the grain size. The halves are forked
+ * and joined on the stack, so they do not allocate.
+ *
+ * @code{c}
+ * static void scale(void *arg, size_t begin, size_t end)
+ * {
+ *     float *values = arg;
+ *
+ *     for (size_t i = begin; i < end; i++)
+ *         values[i] *= 2.0f;
+ * }
+ *
+ * mx_parallel_for(NULL, 0, count, 4096, scale, values);
+ * @endcode
+ */
+
+#include "mx/base.h"
+#include "mx/trait.h"
+#include <stdatomic.h>
+
+/**
+ * Task traits.
+ */
+typedef struct ITask
+{
+    IObject Object;
+
+    /**
+     * Run the task. It may submit more tasks to the pool it runs in.
+     * @param self Instance object.
+     */
+    void (*run)(void *self);
+} ITask;
+fatptr_define(ITask);
+
+MX_INLINE void ITask_run(fatptr_t(ITask) task)
+{
+    fatptr_vcall(task, run);
+}
+
+/** Thread pool. */
+typedef struct mx_threadpool_t mx_threadpool_t;
+
+/**
+ * Set of submitted tasks that can be waited on.
+ */
+typedef struct mx_task_group_t
+{
+    atomic_size_t pending;      /**< Tasks not yet finished. */
+} mx_task_group_t;
+
+/** Initializer for a task group. */
+#define MX_TASK_GROUP_INIT { 0 }
+
+/** Body of a parallel for over [begin, end). */
+typedef void (*mx_parallel_for_function)(void *arg, size_t begin, size_t end);
+
+/** Reduce [begin, end) into result, which holds a partial result. */
+typedef void (*mx_reduce_function)(void *arg, size_t begin, size_t end, void *result);
+
+/** Merge the partial result other, which follows result, into result. */
+typedef void (*mx_combine_function)(void *arg, void *result, const void *other);
+
+/**
+ * Create a thread pool.
+ * @param[in] threads Number of worker threads, 0 for one per processor.
+ * @return The pool, or NULL if out of memory or a thread could not be started.
+ */
+MX_API mx_threadpool_t *mx_threadpool_create(unsigned threads);
+
+/**
+ * Stop the workers and release the pool.
+ * @param[in] pool The pool. Every task group must have been waited on.
+ */
+MX_API void mx_threadpool_destroy(mx_threadpool_t *pool);
+
+/**
+ * Get the shared pool, created with one worker per processor on first use.
+ * @return The pool, or NULL if it could not be created.
+ */
+MX_API mx_threadpool_t *mx_threadpool_default(void);
+
+/**
+ * Get the number of worker threads of a pool.
+ * @param[in] pool The pool, NULL for the shared pool.
+ */
+MX_API unsigned mx_threadpool_threads(mx_threadpool_t *pool);
+
+/**
+ * Queue a task. From a worker of the pool it goes to the worker's own deque,
+ * otherwise to the injector queue.
+ * @param[in] pool The pool, NULL for the shared pool.
+ * @param[in] group The group to add the task to.
+ * @param[in] task The task. It must stay valid until the group is waited on.
+ * @return False if out of memory, the task then ran on the calling thread.
+ */
+MX_API bool mx_threadpool_submit(mx_threadpool_t *pool, mx_task_group_t *group, fatptr_t(ITask) task);
+
+/**
+ * Wait for every task of a group to finish, running queued tasks meanwhile.
+ * @param[in] pool The pool, NULL for the shared pool.
+ * @param[in] group The group.
+ */
+MX_API void mx_threadpool_wait(mx_threadpool_t *pool, mx_task_group_t *group);
+
+/**
+ * Call a function on pieces of [begin, end) in parallel, and wait for all.
+ * @param[in] pool The pool, NULL for the shared pool.
+ * @param[in] begin First index.
+ * @param[in] end One past the last index.
+ * @param[in] grain Largest piece a single call gets, 0 to choose one from
+ * the number of workers.
+ * @param[in] function The function.
+ * @param[in] arg The first argument of the function.
+ */
+MX_API void mx_parallel_for(mx_threadpool_t *pool, size_t begin, size_t end, size_t grain,
+                            mx_parallel_for_function function, void *arg);
+
+/**
+ * Reduce [begin, end) in parallel. Every piece is reduced into a copy of the
+ * identity, then neighbouring results are combined left to right. The pieces
+ * only depend on the range and the grain, not on which thread runs them, so
+ * with a fixed grain a floating point sum gives the same result on every run.
+ * @param[in] pool The pool, NULL for the shared pool.
+ * @param[in] begin First index.
+ * @param[in] end One past the last index.
+ * @param[in] grain Largest piece a single call gets, 0 to choose one from
+ * the number of workers.
+ * @param[out] result The result.
+ * @param[in] size Size of the result in bytes.
+ * @param[in] identity The initial value of every partial result, must not
+ * overlap result.
+ * @param[in] reduce Reduces a piece.
+ * @param[in] combine Merges two partial results.
+ * @param[in] arg The first argument of reduce and combine.
+ */
+MX_API void mx_parallel_reduce(mx_threadpool_t *pool, size_t begin, size_t end, size_t grain,
+                               void *result, size_t size, const void *identity,
+                               mx_reduce_function reduce, mx_combine_function combine, void *arg);
+
+#endif
@@ -0,0 +1,692 @@
+#if __unix__
+#define _GNU_SOURCE
+#define _FILE_OFFSET_BITS 64
+#include "mx/io/aio.h"
+#include "mx/threadpool.h"
+#include "mx/thread.h"
+#include "mx/assert.h"
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#if defined(__linux__) && defined(__has_include)
+    #if __has_include(<linux/io_uring.h>)
+        #include <linux/io_uring.h>
+        #include <sys/mman.h>
+        #include <sys/syscall.h>
+
+        #ifdef __NR_io_uring_setup
+            #define MX_AIO_HAVE_URING 1
+        #endif
+    #endif
+#endif
+
+/*
+ * Every request lives in a slot from the moment it is queued until it is
+ * reaped. The number of slots bounds the requests queued and in flight, so
+ * neither the submission ring nor the completion ring, which the kernel
+ * makes twice as large, can overflow.
+ */
+
+typedef struct mx_aio_slot_t mx_aio_slot_t;
+
+struct mx_aio_slot_t {
+    mx_aio_request_t request;
+    struct iovec iov;               /**< Buffer of a vectored io_uring request. */
+    mx_len_t result;
+    mx_aio_t *aio;
+    mx_aio_slot_t *next;            /**< In the free, queued or completed list. */
+};
+
+#if MX_AIO_HAVE_URING
+typedef struct mx_uring_t {
+    int fd;
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+    struct io_uring_sqe *sqes;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_cqe *cqes;
+    unsigned tail;                  /**< Submission tail, published on submit. */
+    void *sq_ring, *cq_ring;        /**< The same mapping with IORING_FEAT_SINGLE_MMAP. */
+    size_t sq_ring_size, cq_ring_size, sqes_size;
+} mx_uring_t;
+#endif
+
+struct mx_aio_t {
+    mx_aio_backend backend;
+    mx_aio_slot_t *slots;
+    unsigned capacity;
+    mx_aio_slot_t *free;
+    size_t queued;                  /**< Queued, not yet submitted. */
+    size_t inflight;                /**< Submitted, not yet reaped. */
+    unsigned nfiles;                /**< Registered files. */
+    unsigned nbuffers;              /**< Registered buffers. */
+    fatptr_t(IAllocator) allocator;
+#if MX_AIO_HAVE_URING
+    mx_uring_t ring;
+#endif
+
+    /* Emulation. */
+    mx_threadpool_t *pool;
+    mx_task_group_t group;
+    int *files;                     /**< Registered descriptors. */
+    mx_aio_slot_t *first, *last;    /**< Queued requests. */
+    mx_mutex_t mutex;
+    mx_cond_t done;                 /**< Signaled when a request completes. */
+    mx_aio_slot_t *completed, *completed_last;
+};
+
+/*
+ * io_uring, through the raw system calls.
+ */
+
+#if MX_AIO_HAVE_URING
+static int mx_uring_enter(int fd, unsigned submit, unsigned complete, unsigned flags)
+{
+    return (int)syscall(__NR_io_uring_enter, fd, submit, complete, flags, NULL, 0);
+}
+
+static int mx_uring_register(int fd, unsigned opcode, const void *arg, unsigned count)
+{
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, count);
+}
+
+static void mx_uring_destroy(mx_uring_t *ring)
+{
+    if (ring->sqes)
+        munmap(ring->sqes, ring->sqes_size);
+
+    if (ring->cq_ring && ring->cq_ring != ring->sq_ring)
+        munmap(ring->cq_ring, ring->cq_ring_size);
+
+    if (ring->sq_ring)
+        munmap(ring->sq_ring, ring->sq_ring_size);
+
+    close(ring->fd);
+}
+
+static bool mx_uring_init(mx_uring_t *ring, unsigned entries)
+{
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    memset(ring, 0, sizeof(*ring));
+
+    ring->fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+
+    if (ring->fd < 0)
+        return false;
+
+    ring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        if (ring->cq_ring_size > ring->sq_ring_size)
+            ring->sq_ring_size = ring->cq_ring_size;
+
+        ring->cq_ring_size = ring->sq_ring_size;
+    }
+
+    void *sq = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+    ring->sq_ring = sq == MAP_FAILED ? NULL : sq;
+
+    if (ring->sq_ring && (params.features & IORING_FEAT_SINGLE_MMAP))
+    {
+        ring->cq_ring = ring->sq_ring;
+    }
+    else if (ring->sq_ring)
+    {
+        void *cq = mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+        ring->cq_ring = cq == MAP_FAILED ? NULL : cq;
+    }
+
+    if (ring->cq_ring)
+    {
+        void *sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+        ring->sqes = sqes == MAP_FAILED ? NULL : sqes;
+    }
+
+    if (!ring->sqes)
+    {
+        mx_uring_destroy(ring);
+        return false;
+    }
+
+    char *sq_ring = ring->sq_ring, *cq_ring = ring->cq_ring;
+
+    ring->sq_head  = (unsigned*)(sq_ring + params.sq_off.head);
+    ring->sq_tail  = (unsigned*)(sq_ring + params.sq_off.tail);
+    ring->sq_mask  = (unsigned*)(sq_ring + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned*)(sq_ring + params.sq_off.array);
+    ring->cq_head  = (unsigned*)(cq_ring + params.cq_off.head);
+    ring->cq_tail  = (unsigned*)(cq_ring + params.cq_off.tail);
+    ring->cq_mask  = (unsigned*)(cq_ring + params.cq_off.ring_mask);
+    ring->cqes     = (struct io_uring_cqe*)(cq_ring + params.cq_off.cqes);
+    ring->tail     = *ring->sq_tail;
+    return true;
+}
+
+static void mx_uring_queue(mx_uring_t *ring, mx_aio_slot_t *slot)
+{
+    const mx_aio_request_t *request = &slot->request;
+    unsigned index = ring->tail & *ring->sq_mask;
+    struct io_uring_sqe *sqe = &ring->sqes[index];
+    bool fixed = request->flags & MX_AIO_FIXED_BUFFER;
+
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->fd = request->file;
+    sqe->off = (uint64_t)request->offset;
+    sqe->user_data = (uint64_t)(uintptr_t)slot;
+
+    if (request->flags & MX_AIO_FIXED_FILE)
+        sqe->flags |= IOSQE_FIXED_FILE;
+
+    switch (request->op)
+    {
+    case MX_AIO_READ:
+    case MX_AIO_WRITE:
+        if (fixed)
+        {
+            sqe->opcode = request->op == MX_AIO_READ ? IORING_OP_READ_FIXED : IORING_OP_WRITE_FIXED;
+            sqe->addr = (uint64_t)(uintptr_t)request->buffer;
+            sqe->len = (unsigned)request->size;
+            sqe->buf_index = (uint16_t)request->buffer_index;
+        }
+        else
+        {
+            /* The vectored forms go back to the first kernels with io_uring. */
+            slot->iov.iov_base = request->buffer;
+            slot->iov.iov_len = request->size;
+            sqe->opcode = request->op == MX_AIO_READ ? IORING_OP_READV : IORING_OP_WRITEV;
+            sqe->addr = (uint64_t)(uintptr_t)&slot->iov;
+            sqe->len = 1;
+        }
+        break;
+
+    case MX_AIO_FSYNC:
+        sqe->opcode = IORING_OP_FSYNC;
+        break;
+    }
+
+    ring->sq_array[index] = index;
+    ring->tail++;
+}
+
+static size_t mx_uring_submit(mx_uring_t *ring, size_t queued)
+{
+    /* Pairs with the kernel's acquire of the tail. */
+    __atomic_store_n(ring->sq_tail, ring->tail, __ATOMIC_RELEASE);
+
+    int n;
+
+    do
+        n = mx_uring_enter(ring->fd, (unsigned)queued, 0, 0);
+    while (n < 0 && errno == EINTR);
+
+    return n < 0 ? 0 : (size_t)n;
+}
+
+static mx_aio_slot_t *mx_uring_reap(mx_uring_t *ring)
+{
+    unsigned head = *ring->cq_head;
+
+    if (head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE))
+        return NULL;
+
+    struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cq_mask];
+    mx_aio_slot_t *slot = (mx_aio_slot_t*)(uintptr_t)cqe->user_data;
+
+    slot->result = cqe->res;
+    __atomic_store_n(ring->cq_head, head + 1, __ATOMIC_RELEASE);
+    return slot;
+}
+
+static void mx_uring_wait(mx_uring_t *ring, size_t count)
+{
+    while (mx_uring_enter(ring->fd, 0, (unsigned)count, IORING_ENTER_GETEVENTS) < 0 && errno == EINTR)
+        ;
+}
+#endif
+
+/*
+ * Emulation. A slot is its own task on the pool and moves itself to the
+ * completed list when done.
+ */
+
+static size_t mx_aio_slot_IObject_get_size(mx_aio_slot_t *self);
+static size_t mx_aio_slot_IObject_to_string(mx_aio_slot_t *self, char *buffer, size_t max);
+static void   mx_aio_slot_IObject_destruct(mx_aio_slot_t *self);
+static void   mx_aio_slot_ITask_run(mx_aio_slot_t *self);
+
+const ITask fat_vtable(mx_aio_slot_t, ITask) = {
+    .Object = {
+        .get_size  = (void*)mx_aio_slot_IObject_get_size,
+        .get_type  = NULL,
+        .to_string = (void*)mx_aio_slot_IObject_to_string,
+        .destruct  = (void*)mx_aio_slot_IObject_destruct
+    },
+    .run = (void*)mx_aio_slot_ITask_run,
+};
+
+static size_t mx_aio_slot_IObject_get_size(mx_aio_slot_t *self)
+{
+    return sizeof(*self);
+}
+
+static size_t mx_aio_slot_IObject_to_string(mx_aio_slot_t *self, char *buffer, size_t max)
+{
+    int n = snprintf(buffer, max, "aio %d@%lld", self->request.file, (long long)self->request.offset);
+    return n < 0 ? 0 : (size_t)n < max ? (size_t)n : max;
+}
+
+static void mx_aio_slot_IObject_destruct(mx_aio_slot_t *self)
+{
+    /* Slots belong to their queue. */
+    (void)self;
+}
+
+static void mx_aio_slot_ITask_run(mx_aio_slot_t *self)
+{
+    const mx_aio_request_t *request = &self->request;
+    mx_aio_t *aio = self->aio;
+    int fd = request->flags & MX_AIO_FIXED_FILE ? aio->files[request->file] : request->file;
+    ssize_t n;
+
+    do
+    {
+        switch (request->op)
+        {
+        case MX_AIO_READ:  n = pread(fd, request->buffer, request->size, (off_t)request->offset); break;
+        case MX_AIO_WRITE: n = pwrite(fd, request->buffer, request->size, (off_t)request->offset); break;
+        default:           n = fsync(fd); break;
+        }
+    }
+    while (n < 0 && errno == EINTR);
+
+    self->result = n < 0 ? -errno : (mx_len_t)n;
+    self->next = NULL;
+
+    mx_mutex_lock(&aio->mutex);
+
+    if (aio->completed_last)
+        aio->completed_last->next = self;
+    else
+        aio->completed = self;
+
+    aio->completed_last = self;
+    mx_cond_signal(&aio->done);
+    mx_mutex_unlock(&aio->mutex);
+}
+
+static mx_aio_slot_t *mx_aio_emulated_reap(mx_aio_t *aio, bool wait)
+{
+    mx_mutex_lock(&aio->mutex);
+
+    while (wait && !aio->completed)
+        mx_cond_wait(&aio->done, &aio->mutex);
+
+    mx_aio_slot_t *slot = aio->completed;
+
+    if (slot && !(aio->completed = slot->next))
+        aio->completed_last = NULL;
+
+    mx_mutex_unlock(&aio->mutex);
+    return slot;
+}
+
+/*
+ * Queue.
+ */
+
+static mx_aio_slot_t *mx_aio_reap(mx_aio_t *aio)
+{
+#if MX_AIO_HAVE_URING
+    if (aio->backend == MX_AIO_URING)
+        return mx_uring_reap(&aio->ring);
+#endif
+
+    return mx_aio_emulated_reap(aio, false);
+}
+
+/** Block until at least one of count more completions is there. */
+static void mx_aio_wait(mx_aio_t *aio, size_t count, mx_aio_slot_t **slot)
+{
+#if MX_AIO_HAVE_URING
+    if (aio->backend == MX_AIO_URING)
+    {
+        mx_uring_wait(&aio->ring, count);
+        *slot = mx_uring_reap(&aio->ring);
+        return;
+    }
+#endif
+
+    (void)count;
+    *slot = mx_aio_emulated_reap(aio, true);
+}
+
+static void mx_aio_release(mx_aio_t *aio, mx_aio_slot_t *slot)
+{
+    slot->next = aio->free;
+    aio->free = slot;
+    aio->inflight--;
+}
+
+MX_IMPL mx_aio_t *mx_aio_create(const mx_aio_options_t *options)
+{
+    mx_aio_options_t defaults = { 0, 0, MX_AIO_AUTO, { NULL, NULL } };
+    options = options ? options : &defaults;
+
+    unsigned capacity = options->entries ? options->entries : MX_AIO_ENTRIES_DEFAULT;
+    fatptr_t(IAllocator) allocator = __mx_allocator(options->allocator);
+
+    /* io_uring sizes its rings in powers of two. */
+    while (capacity & (capacity - 1))
+        capacity += capacity & -capacity;
+
+    mx_aio_t *aio = IAllocator_alloc(allocator, sizeof(mx_aio_t), MX_ALLOC_ALIGN);
+
+    if (!aio)
+        return NULL;
+
+    memset(aio, 0, sizeof(*aio));
+    aio->allocator = allocator;
+    aio->capacity = capacity;
+    aio->slots = IAllocator_alloc(allocator, capacity * sizeof(mx_aio_slot_t), MX_ALLOC_ALIGN);
+
+    if (!aio->slots)
+    {
+        IAllocator_free(allocator, aio, sizeof(*aio));
+        return NULL;
+    }
+
+    for (unsigned i = 0; i < capacity; i++)
+    {
+        aio->slots[i].aio = aio;
+        aio->slots[i].next = i + 1 < capacity ? &aio->slots[i + 1] : NULL;
+    }
+
+    aio->free = aio->slots;
+
+#if MX_AIO_HAVE_URING
+    if (options->backend != MX_AIO_THREADS && mx_uring_init(&aio->ring, capacity))
+    {
+        aio->backend = MX_AIO_URING;
+        return aio;
+    }
+#endif
+
+    if (options->backend != MX_AIO_URING)
+        aio->pool = mx_threadpool_create(options->threads ? options->threads : MX_AIO_THREADS_DEFAULT);
+
+    if (!aio->pool)
+    {
+        IAllocator_free(allocator, aio->slots, capacity * sizeof(mx_aio_slot_t));
+        IAllocator_free(allocator, aio, sizeof(*aio));
+        return NULL;
+    }
+
+    aio->backend = MX_AIO_THREADS;
+    mx_mutex_init(&aio->mutex);
+    mx_cond_init(&aio->done);
+    return aio;
+}
+
+MX_IMPL void mx_aio_destroy(mx_aio_t *aio)
+{
+    if (!aio)
+        return;
+
+    /* The kernel or the pool may still write to the buffers and slots. */
+    while (aio->inflight)
+    {
+        mx_aio_slot_t *slot = mx_aio_reap(aio);
+
+        if (!slot)
+            mx_aio_wait(aio, aio->inflight, &slot);
+
+        if (slot)
+            mx_aio_release(aio, slot);
+    }
+
+#if MX_AIO_HAVE_URING
+    if (aio->backend == MX_AIO_URING)
+        mx_uring_destroy(&aio->ring);
+#endif
+
+    if (aio->backend == MX_AIO_THREADS)
+    {
+        mx_threadpool_wait(aio->pool, &aio->group);
+        mx_threadpool_destroy(aio->pool);
+        mx_cond_destroy(&aio->done);
+        mx_mutex_destroy(&aio->mutex);
+    }
+
+    if (aio->files)
+        IAllocator_free(aio->allocator, aio->files, aio->nfiles * sizeof(int));
+
+    IAllocator_free(aio->allocator, aio->slots, aio->capacity * sizeof(mx_aio_slot_t));
+    IAllocator_free(aio->allocator, aio, sizeof(*aio));
+}
+
+MX_IMPL mx_aio_backend mx_aio_get_backend(mx_aio_t *aio)
+{
+    MX_ASSERT_PTR(aio, "Queue must be valid.");
+    return aio->backend;
+}
+
+MX_IMPL bool mx_aio_register_files(mx_aio_t *aio, const int *files, unsigned count)
+{
+    MX_ASSERT_PTR(aio, "Queue must be valid.");
+    MX_ASSERT(aio->inflight == 0 && aio->queued == 0, "Requests are pending.");
+
+    if (!files)
+        count = 0;
+
+#if MX_AIO_HAVE_URING
+    if (aio->backend == MX_AIO_URING)
+    {
+        if (aio->nfiles)
+            mx_uring_register(aio->ring.fd, IORING_UNREGISTER_FILES, NULL, 0);
+
+        aio->nfiles = 0;
+
+        if (count && mx_uring_register(aio->ring.fd, IORING_REGISTER_FILES, files, count) < 0)
+            return false;
+
+        aio->nfiles = count;
+        return true;
+    }
+#endif
+
+    if (aio->files)
+        IAllocator_free(aio->allocator, aio->files, aio->nfiles * sizeof(int));
+
+    aio->files = NULL;
+    aio->nfiles = 0;
+
+    if (!count)
+        return true;
+
+    if (!(aio->files = IAllocator_alloc(aio->allocator, count * sizeof(int), MX_ALLOC_ALIGN)))
+        return false;
+
+    memcpy(aio->files, files, count * sizeof(int));
+    aio->nfiles = count;
+    return true;
+}
+
+MX_IMPL bool mx_aio_register_buffers(mx_aio_t *aio, const mx_iovec_t *buffers, unsigned count)
+{
+    MX_ASSERT_PTR(aio, "Queue must be valid.");
+    MX_ASSERT(aio->inflight == 0 && aio->queued == 0, "Requests are pending.");
+
+    if (!buffers)
+        count = 0;
+
+#if MX_AIO_HAVE_URING
+    if (aio->backend == MX_AIO_URING)
+    {
+        if (aio->nbuffers)
+            mx_uring_register(aio->ring.fd, IORING_UNREGISTER_BUFFERS, NULL, 0);
+
+        aio->nbuffers = 0;
+
+        if (!count)
+            return true;
+
+        struct iovec *iov = IAllocator_alloc(aio->allocator, count * sizeof(struct iovec), MX_ALLOC_ALIGN);
+
+        if (!iov)
+            return false;
+
+        for (unsigned i = 0; i < count; i++)
+        {
+            iov[i].iov_base = buffers[i].data;
+            iov[i].iov_len = buffers[i].size;
+        }
+
+        int n = mx_uring_register(aio->ring.fd, IORING_REGISTER_BUFFERS, iov, count);
+        IAllocator_free(aio->allocator, iov, count * sizeof(struct iovec));
+
+        if (n < 0)
+            return false;
+
+        aio->nbuffers = count;
+        return true;
+    }
+#endif
+
+    /* Plain pread and pwrite take any buffer. */
+    aio->nbuffers = count;
+    return true;
+}
+
+MX_IMPL bool mx_aio_queue(mx_aio_t *aio, const mx_aio_request_t *request)
+{
+    MX_ASSERT_PTR(aio, "Queue must be valid.");
+    MX_ASSERT_PTR(request, "Request must be valid.");
+    MX_ASSERT(request->op == MX_AIO_FSYNC || request->buffer || !request->size, "Buffer must be non-null.");
+    MX_ASSERT(request->offset >= 0, "Offset must not be negative.");
+    MX_ASSERT((uint64_t)request->size <= UINT32_MAX, "Size must fit 32 bits, split larger requests.");
+    MX_ASSERT(!(request->flags & MX_AIO_FIXED_FILE) || (unsigned)request->file < aio->nfiles, "File is not registered.");
+    MX_ASSERT(!(request->flags & MX_AIO_FIXED_BUFFER) || request->buffer_index < aio->nbuffers, "Buffer is not registered.");
+
+    mx_aio_slot_t *slot = aio->free;
+
+    if (!slot)
+        return false;
+
+    aio->free = slot->next;
+    slot->request = *request;
+    slot->next = NULL;
+
+#if MX_AIO_HAVE_URING
+    if (aio->backend == MX_AIO_URING)
+        mx_uring_queue(&aio->ring, slot);
+#endif
+
+    if (aio->backend == MX_AIO_THREADS)
+    {
+        if (aio->last)
+            aio->last->next = slot;
+        else
+            aio->first = slot;
+
+        aio->last = slot;
+    }
+
+    aio->queued++;
+    return true;
+}
+
+MX_IMPL size_t mx_aio_submit(mx_aio_t *aio)
+{
+    MX_ASSERT_PTR(aio, "Queue must be valid.");
+
+    if (!aio->queued)
+        return 0;
+
+    size_t n = aio->queued;
+
+#if MX_AIO_HAVE_URING
+    if (aio->backend == MX_AIO_URING)
+        n = mx_uring_submit(&aio->ring, aio->queued);
+#endif
+
+    if (aio->backend == MX_AIO_THREADS)
+    {
+        mx_aio_slot_t *slot = aio->first;
+        aio->first = aio->last = NULL;
+
+        /* Count the requests in flight first, a task may finish at once. */
+        aio->inflight += n;
+        aio->queued = 0;
+
+        while (slot)
+        {
+            mx_aio_slot_t *next = slot->next;
+            mx_threadpool_submit(aio->pool, &aio->group, fat_new(slot, fat_vtable(mx_aio_slot_t, ITask), ITask));
+            slot = next;
+        }
+
+        return n;
+    }
+
+    aio->queued -= n;
+    aio->inflight += n;
+    return n;
+}
+
+MX_IMPL size_t mx_aio_poll(mx_aio_t *aio, mx_aio_completion_t *completions, size_t max, size_t wait)
+{
+    MX_ASSERT_PTR(aio, "Queue must be valid.");
+
+    mx_aio_submit(aio);
+
+    wait = wait < max ? wait : max;
+    wait = wait < aio->inflight ? wait : aio->inflight;
+
+    size_t n = 0;
+
+    while (n < max)
+    {
+        mx_aio_slot_t *slot = mx_aio_reap(aio);
+
+        if (!slot)
+        {
+            if (n >= wait)
+                break;
+
+            mx_aio_wait(aio, wait - n, &slot);
+
+            if (!slot)
+                continue;
+        }
+
+        /* Free the slot first, so the callback can queue into it. */
+        mx_aio_callback callback = slot->request.callback;
+        void *arg = slot->request.arg;
+        mx_len_t result = slot->result;
+
+        mx_aio_release(aio, slot);
+
+        if (completions)
+            completions[n] = (mx_aio_completion_t){ arg, result };
+
+        n++;
+
+        if (callback)
+            callback(arg, result);
+    }
+
+    return n;
+}
+
+MX_IMPL size_t mx_aio_pending(mx_aio_t *aio)
+{
+    MX_ASSERT_PTR(aio, "Queue must be valid.");
+    return aio->queued + aio->inflight;
+}
+#endif
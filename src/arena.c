@@ -0,0 +1,363 @@
+#include "mx/arena.h"
+#include "mx/assert.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** Default arena block and pool block size. */
+#define MX_ARENA_BLOCK (64u << 10)
+
+struct mx_arena_block_t {
+    mx_arena_block_t *next;
+    size_t size;                /**< Usable bytes after the header. */
+};
+
+struct mx_pool_block_t {
+    mx_pool_block_t *next;
+};
+
+/*
+ * Heap allocator.
+ */
+
+typedef struct mx_heap_t {
+    char unused;
+} mx_heap_t;
+
+static size_t mx_heap_IObject_get_size(mx_heap_t *self)
+{
+    return sizeof(*self);
+}
+
+static size_t mx_heap_IObject_to_string(mx_heap_t *self, char *buffer, size_t max)
+{
+    (void)self;
+    int n = snprintf(buffer, max, "heap");
+    return n < 0 ? 0 : (size_t)n;
+}
+
+static void mx_heap_IObject_destruct(mx_heap_t *self)
+{
+    (void)self;
+}
+
+static void *mx_heap_IAllocator_alloc(mx_heap_t *self, size_t size, size_t align)
+{
+    (void)self;
+    MX_ASSERT(align <= MX_ALLOC_ALIGN, "The heap allocator does not support this alignment.");
+    return malloc(size);
+}
+
+static void *mx_heap_IAllocator_realloc(mx_heap_t *self, void *ptr, size_t old_size, size_t new_size, size_t align)
+{
+    (void)self;
+    (void)old_size;
+    MX_ASSERT(align <= MX_ALLOC_ALIGN, "The heap allocator does not support this alignment.");
+    return realloc(ptr, new_size);
+}
+
+static void mx_heap_IAllocator_free(mx_heap_t *self, void *ptr, size_t size)
+{
+    (void)self;
+    (void)size;
+    free(ptr);
+}
+
+const IAllocator fat_vtable(mx_heap_t, IAllocator) = {
+    .Object = {
+        .get_size  = (void*)mx_heap_IObject_get_size,
+        .get_type  = NULL,
+        .to_string = (void*)mx_heap_IObject_to_string,
+        .destruct  = (void*)mx_heap_IObject_destruct
+    },
+    .alloc   = (void*)mx_heap_IAllocator_alloc,
+    .realloc = (void*)mx_heap_IAllocator_realloc,
+    .free    = (void*)mx_heap_IAllocator_free,
+};
+
+static mx_heap_t mx_heap;
+static fatptr_t(IAllocator) mx_default_allocator = { &mx_heap, &fat_vtable(mx_heap_t, IAllocator) };
+
+MX_IMPL fatptr_t(IAllocator) mx_heap_allocator(void)
+{
+    return fat_cast(mx_heap, mx_heap_t, IAllocator);
+}
+
+MX_IMPL fatptr_t(IAllocator) mx_get_allocator(void)
+{
+    return mx_default_allocator;
+}
+
+MX_IMPL void mx_set_allocator(fatptr_t(IAllocator) alloc)
+{
+    mx_default_allocator = alloc.ptr == NULL ? mx_heap_allocator() : alloc;
+}
+
+/*
+ * Arena.
+ */
+
+MX_IMPL void mx_arena_init(mx_arena_t *arena, size_t block_size)
+{
+    MX_ASSERT_SELFPTR(arena);
+
+    arena->ptr = arena->end = arena->last = NULL;
+    arena->block = arena->spare = NULL;
+    arena->block_size = block_size ? block_size : MX_ARENA_BLOCK;
+}
+
+static void mx_arena_free_blocks(mx_arena_block_t *block)
+{
+    while (block)
+    {
+        mx_arena_block_t *next = block->next;
+        free(block);
+        block = next;
+    }
+}
+
+MX_IMPL void mx_arena_destroy(mx_arena_t *arena)
+{
+    MX_ASSERT_SELFPTR(arena);
+
+    mx_arena_free_blocks(arena->block);
+    mx_arena_free_blocks(arena->spare);
+    mx_arena_init(arena, arena->block_size);
+}
+
+MX_IMPL void mx_arena_reset(mx_arena_t *arena)
+{
+    MX_ASSERT_SELFPTR(arena);
+
+    /* Oversized blocks go back to the heap, the rest are kept. */
+    while (arena->block)
+    {
+        mx_arena_block_t *block = arena->block;
+        arena->block = block->next;
+
+        if (block->size > arena->block_size)
+        {
+            free(block);
+        }
+        else
+        {
+            block->next = arena->spare;
+            arena->spare = block;
+        }
+    }
+
+    arena->ptr = arena->end = arena->last = NULL;
+}
+
+MX_IMPL void *__mx_arena_alloc_slow(mx_arena_t *arena, size_t size, size_t align)
+{
+    MX_ASSERT((align & (align - 1)) == 0, "Alignment must be a power of two.");
+
+    mx_arena_block_t *block = NULL;
+    size_t need = size + align;
+
+    if (need <= arena->block_size && arena->spare)
+    {
+        block = arena->spare;
+        arena->spare = block->next;
+    }
+    else
+    {
+        size_t bytes = need > arena->block_size ? need : arena->block_size;
+
+        if (!(block = malloc(sizeof(mx_arena_block_t) + bytes)))
+            return NULL;
+
+        block->size = bytes;
+    }
+
+    block->next = arena->block;
+    arena->block = block;
+    arena->ptr = (char*)(block + 1);
+    arena->end = arena->ptr + block->size;
+
+    return mx_arena_alloc(arena, size, align);
+}
+
+static size_t mx_arena_IObject_get_size(mx_arena_t *self)
+{
+    return sizeof(*self);
+}
+
+static size_t mx_arena_IObject_to_string(mx_arena_t *self, char *buffer, size_t max)
+{
+    int n = snprintf(buffer, max, "arena %p", (void*)self);
+    return n < 0 ? 0 : (size_t)n;
+}
+
+static void mx_arena_IObject_destruct(mx_arena_t *self)
+{
+    mx_arena_destroy(self);
+}
+
+static void *mx_arena_IAllocator_alloc(mx_arena_t *self, size_t size, size_t align)
+{
+    return mx_arena_alloc(self, size, align);
+}
+
+static void *mx_arena_IAllocator_realloc(mx_arena_t *self, void *ptr, size_t old_size, size_t new_size, size_t align)
+{
+    /* The last allocation can grow or shrink in place. */
+    if (ptr != NULL && ptr == self->last && (size_t)(self->end - (char*)ptr) >= new_size)
+    {
+        self->ptr = (char*)ptr + new_size;
+        return ptr;
+    }
+
+    if (new_size <= old_size && ptr != NULL)
+        return ptr;
+
+    void *mem = mx_arena_alloc(self, new_size, align);
+
+    if (mem && ptr)
+        memcpy(mem, ptr, old_size < new_size ? old_size : new_size);
+
+    return mem;
+}
+
+static void mx_arena_IAllocator_free(mx_arena_t *self, void *ptr, size_t size)
+{
+    (void)size;
+
+    if (ptr != NULL && ptr == self->last)
+    {
+        self->ptr = ptr;
+        self->last = NULL;
+    }
+}
+
+const IAllocator fat_vtable(mx_arena_t, IAllocator) = {
+    .Object = {
+        .get_size  = (void*)mx_arena_IObject_get_size,
+        .get_type  = NULL,
+        .to_string = (void*)mx_arena_IObject_to_string,
+        .destruct  = (void*)mx_arena_IObject_destruct
+    },
+    .alloc   = (void*)mx_arena_IAllocator_alloc,
+    .realloc = (void*)mx_arena_IAllocator_realloc,
+    .free    = (void*)mx_arena_IAllocator_free,
+};
+
+MX_IMPL fatptr_t(IAllocator) mx_arena_allocator(mx_arena_t *arena)
+{
+    return fat_new(arena, fat_vtable(mx_arena_t, IAllocator), IAllocator);
+}
+
+/*
+ * Pool.
+ */
+
+MX_IMPL void mx_pool_init(mx_pool_t *pool, size_t size, size_t count)
+{
+    MX_ASSERT_SELFPTR(pool);
+
+    /* Free objects hold the free list link, and every object stays aligned. */
+    if (size < sizeof(void*))
+        size = sizeof(void*);
+
+    size = (size + MX_ALLOC_ALIGN - 1) & ~(MX_ALLOC_ALIGN - 1);
+
+    if (count == 0)
+        count = size < MX_ARENA_BLOCK ? MX_ARENA_BLOCK / size : 1;
+
+    pool->free = NULL;
+    pool->block = NULL;
+    pool->size = size;
+    pool->count = count;
+}
+
+MX_IMPL void mx_pool_destroy(mx_pool_t *pool)
+{
+    MX_ASSERT_SELFPTR(pool);
+
+    while (pool->block)
+    {
+        mx_pool_block_t *next = pool->block->next;
+        free(pool->block);
+        pool->block = next;
+    }
+
+    pool->free = NULL;
+}
+
+MX_IMPL bool __mx_pool_refill(mx_pool_t *pool)
+{
+    /* The block header is padded so the objects stay aligned. */
+    size_t header = (sizeof(mx_pool_block_t) + MX_ALLOC_ALIGN - 1) & ~(MX_ALLOC_ALIGN - 1);
+    mx_pool_block_t *block = malloc(header + pool->size * pool->count);
+
+    if (!block)
+        return false;
+
+    block->next = pool->block;
+    pool->block = block;
+
+    char *objects = (char*)block + header;
+
+    for (size_t i = pool->count; i-- > 0; )
+        mx_pool_free(pool, objects + i * pool->size);
+
+    return true;
+}
+
+static size_t mx_pool_IObject_get_size(mx_pool_t *self)
+{
+    return sizeof(*self);
+}
+
+static size_t mx_pool_IObject_to_string(mx_pool_t *self, char *buffer, size_t max)
+{
+    int n = snprintf(buffer, max, "pool %p (%zu bytes)", (void*)self, self->size);
+    return n < 0 ? 0 : (size_t)n;
+}
+
+static void mx_pool_IObject_destruct(mx_pool_t *self)
+{
+    mx_pool_destroy(self);
+}
+
+static void *mx_pool_IAllocator_alloc(mx_pool_t *self, size_t size, size_t align)
+{
+    if (size > self->size || align > MX_ALLOC_ALIGN)
+        return NULL;
+
+    return mx_pool_alloc(self);
+}
+
+static void *mx_pool_IAllocator_realloc(mx_pool_t *self, void *ptr, size_t old_size, size_t new_size, size_t align)
+{
+    (void)old_size;
+
+    if (new_size > self->size || align > MX_ALLOC_ALIGN)
+        return NULL;
+
+    return ptr ? ptr : mx_pool_alloc(self);
+}
+
+static void mx_pool_IAllocator_free(mx_pool_t *self, void *ptr, size_t size)
+{
+    (void)size;
+    mx_pool_free(self, ptr);
+}
+
+const IAllocator fat_vtable(mx_pool_t, IAllocator) = {
+    .Object = {
+        .get_size  = (void*)mx_pool_IObject_get_size,
+        .get_type  = NULL,
+        .to_string = (void*)mx_pool_IObject_to_string,
+        .destruct  = (void*)mx_pool_IObject_destruct
+    },
+    .alloc   = (void*)mx_pool_IAllocator_alloc,
+    .realloc = (void*)mx_pool_IAllocator_realloc,
+    .free    = (void*)mx_pool_IAllocator_free,
+};
+
+MX_IMPL fatptr_t(IAllocator) mx_pool_allocator(mx_pool_t *pool)
+{
+    return fat_new(pool, fat_vtable(mx_pool_t, IAllocator), IAllocator);
+}
@@ -0,0 +1,623 @@
+#include "mx/bitset.h"
+#include "mx/cpu.h"
+#include <string.h>
+
+#if MX_CPU_X86
+#include <immintrin.h>
+#endif
+
+/** Bits per rank block, one cache line of words. */
+#define MX_RANK_BLOCK   512
+/** Bits per rank superblock; block counts within it fit in 16 bits. */
+#define MX_RANK_SUPER   65536
+
+typedef enum mx_bitset_op
+{
+    MX_BITSET_AND,
+    MX_BITSET_OR,
+    MX_BITSET_XOR,
+    MX_BITSET_ANDNOT,
+} mx_bitset_op;
+
+/** Mask of the bits of the last word below the size, all ones if it is full. */
+static uint64_t mx_bitset_tail(size_t bits)
+{
+    return bits % 64 ? ((uint64_t)1 << (bits % 64)) - 1 : ~(uint64_t)0;
+}
+
+/*
+ * Word kernels. The operation is a constant in each wrapper so the switch
+ * folds away, and the AVX2 versions finish the last few words with the
+ * scalar one.
+ */
+
+MX_INLINE void mx_bitset_apply_scalar(uint64_t *dst, const uint64_t *a, const uint64_t *b, size_t n, mx_bitset_op op)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        switch (op)
+        {
+        case MX_BITSET_AND:    dst[i] = a[i] & b[i]; break;
+        case MX_BITSET_OR:     dst[i] = a[i] | b[i]; break;
+        case MX_BITSET_XOR:    dst[i] = a[i] ^ b[i]; break;
+        case MX_BITSET_ANDNOT: dst[i] = a[i] & ~b[i]; break;
+        }
+    }
+}
+
+static void mx_bitset_and_scalar(uint64_t *dst, const uint64_t *a, const uint64_t *b, size_t n)
+{
+    mx_bitset_apply_scalar(dst, a, b, n, MX_BITSET_AND);
+}
+
+static void mx_bitset_or_scalar(uint64_t *dst, const uint64_t *a, const uint64_t *b, size_t n)
+{
+    mx_bitset_apply_scalar(dst, a, b, n, MX_BITSET_OR);
+}
+
+static void mx_bitset_xor_scalar(uint64_t *dst, const uint64_t *a, const uint64_t *b, size_t n)
+{
+    mx_bitset_apply_scalar(dst, a, b, n, MX_BITSET_XOR);
+}
+
+static void mx_bitset_andnot_scalar(uint64_t *dst, const uint64_t *a, const uint64_t *b, size_t n)
+{
+    mx_bitset_apply_scalar(dst, a, b, n, MX_BITSET_ANDNOT);
+}
+
+static size_t mx_bitset_popcount_scalar(const uint64_t *words, size_t n)
+{
+    size_t count = 0;
+
+    for (size_t i = 0; i < n; i++)
+    {
+        uint64_t w = words[i];
+        w = w - ((w >> 1) & 0x5555555555555555);
+        w = (w & 0x3333333333333333) + ((w >> 2) & 0x3333333333333333);
+        w = (w + (w >> 4)) & 0x0F0F0F0F0F0F0F0F;
+        count += (size_t)((w * 0x0101010101010101) >> 56);
+    }
+
+    return count;
+}
+
+/** Index of the first word at or after i that is not skip, or n. */
+static size_t mx_bitset_skip_scalar(const uint64_t *words, size_t i, size_t n, uint64_t skip)
+{
+    while (i < n && words[i] == skip)
+        i++;
+
+    return i;
+}
+
+/** Position of the set bit of w with n set bits below it. */
+static unsigned mx_bitset_select64_scalar(uint64_t w, unsigned n)
+{
+    unsigned shift = 0;
+
+    for (;;)
+    {
+        uint64_t byte = w & 0xFF;
+        unsigned c = (unsigned)mx_bitset_popcount_scalar(&byte, 1);
+
+        if (n < c)
+            break;
+
+        n -= c;
+        w >>= 8;
+        shift += 8;
+    }
+
+    while (n--)
+        w &= w - 1;
+
+    return shift + (unsigned)__builtin_ctzll(w);
+}
+
+#if MX_CPU_X86
+MX_TARGET("avx2")
+MX_INLINE void mx_bitset_apply_avx2(uint64_t *dst, const uint64_t *a, const uint64_t *b, size_t n, mx_bitset_op op)
+{
+    size_t i = 0;
+
+    for (; i + 8 <= n; i += 8)
+    {
+        __m256i x0 = _mm256_loadu_si256((const __m256i*)&a[i]);
+        __m256i x1 = _mm256_loadu_si256((const __m256i*)&a[i + 4]);
+        __m256i y0 = _mm256_loadu_si256((const __m256i*)&b[i]);
+        __m256i y1 = _mm256_loadu_si256((const __m256i*)&b[i + 4]);
+
+        switch (op)
+        {
+        case MX_BITSET_AND:    x0 = _mm256_and_si256(x0, y0);    x1 = _mm256_and_si256(x1, y1);    break;
+        case MX_BITSET_OR:     x0 = _mm256_or_si256(x0, y0);     x1 = _mm256_or_si256(x1, y1);     break;
+        case MX_BITSET_XOR:    x0 = _mm256_xor_si256(x0, y0);    x1 = _mm256_xor_si256(x1, y1);    break;
+        case MX_BITSET_ANDNOT: x0 = _mm256_andnot_si256(y0, x0); x1 = _mm256_andnot_si256(y1, x1); break;
+        }
+
+        _mm256_storeu_si256((__m256i*)&dst[i], x0);
+        _mm256_storeu_si256((__m256i*)&dst[i + 4], x1);
+    }
+
+    mx_bitset_apply_scalar(dst + i, a + i, b + i, n - i, op);
+}
+
+MX_TARGET("avx2")
+static void mx_bitset_and_avx2(uint64_t *dst, const uint64_t *a, const uint64_t *b, size_t n)
+{
+    mx_bitset_apply_avx2(dst, a, b, n, MX_BITSET_AND);
+}
+
+MX_TARGET("avx2")
+static void mx_bitset_or_avx2(uint64_t *dst, const uint64_t *a, const uint64_t *b, size_t n)
+{
+    mx_bitset_apply_avx2(dst, a, b, n, MX_BITSET_OR);
+}
+
+MX_TARGET("avx2")
+static void mx_bitset_xor_avx2(uint64_t *dst, const uint64_t *a, const uint64_t *b, size_t n)
+{
+    mx_bitset_apply_avx2(dst, a, b, n, MX_BITSET_XOR);
+}
+
+MX_TARGET("avx2")
+static void mx_bitset_andnot_avx2(uint64_t *dst, const uint64_t *a, const uint64_t *b, size_t n)
+{
+    mx_bitset_apply_avx2(dst, a, b, n, MX_BITSET_ANDNOT);
+}
+
+MX_TARGET("avx2")
+static size_t mx_bitset_skip_avx2(const uint64_t *words, size_t i, size_t n, uint64_t skip)
+{
+    __m256i s = _mm256_set1_epi64x((long long)skip);
+
+    for (; i + 4 <= n; i += 4)
+    {
+        __m256i eq = _mm256_cmpeq_epi64(_mm256_loadu_si256((const __m256i*)&words[i]), s);
+
+        if (_mm256_movemask_pd(_mm256_castsi256_pd(eq)) != 0xF)
+            break;
+    }
+
+    return mx_bitset_skip_scalar(words, i, n, skip);
+}
+
+MX_TARGET("popcnt")
+static size_t mx_bitset_popcount_hw(const uint64_t *words, size_t n)
+{
+    /* Independent sums, so the popcnt latency overlaps. */
+    uint64_t c0 = 0, c1 = 0, c2 = 0, c3 = 0;
+    size_t i = 0;
+
+    for (; i + 4 <= n; i += 4)
+    {
+        c0 += (uint64_t)__builtin_popcountll(words[i]);
+        c1 += (uint64_t)__builtin_popcountll(words[i + 1]);
+        c2 += (uint64_t)__builtin_popcountll(words[i + 2]);
+        c3 += (uint64_t)__builtin_popcountll(words[i + 3]);
+    }
+
+    for (; i < n; i++)
+        c0 += (uint64_t)__builtin_popcountll(words[i]);
+
+    return (size_t)(c0 + c1 + c2 + c3);
+}
+
+#if defined(__x86_64__) || defined(_M_X64)
+MX_TARGET("bmi2")
+static unsigned mx_bitset_select64_bmi2(uint64_t w, unsigned n)
+{
+    return (unsigned)__builtin_ctzll(_pdep_u64((uint64_t)1 << n, w));
+}
+#endif
+#endif
+
+typedef void (*mx_bitset_apply_function)(uint64_t *dst, const uint64_t *a, const uint64_t *b, size_t n);
+
+static size_t mx_bitset_popcount(const uint64_t *words, size_t n)
+{
+#if MX_CPU_X86
+    if (mx_cpu_has(MX_CPU_POPCNT))
+        return mx_bitset_popcount_hw(words, n);
+#endif
+
+    return mx_bitset_popcount_scalar(words, n);
+}
+
+static size_t mx_bitset_popcount64(uint64_t w)
+{
+    return mx_bitset_popcount(&w, 1);
+}
+
+static size_t mx_bitset_skip(const uint64_t *words, size_t i, size_t n, uint64_t skip)
+{
+#if MX_CPU_X86
+    if (mx_cpu_has(MX_CPU_AVX2))
+        return mx_bitset_skip_avx2(words, i, n, skip);
+#endif
+
+    return mx_bitset_skip_scalar(words, i, n, skip);
+}
+
+static unsigned mx_bitset_select64(uint64_t w, unsigned n)
+{
+#if defined(__x86_64__) || defined(_M_X64)
+    if (mx_cpu_has(MX_CPU_BMI2))
+        return mx_bitset_select64_bmi2(w, n);
+#endif
+
+    return mx_bitset_select64_scalar(w, n);
+}
+
+MX_IMPL void mx_bitset_init(mx_bitset_t *set, size_t bits)
+{
+    MX_ASSERT_SELFPTR(set);
+
+    set->words = NULL;
+    set->bits = 0;
+    set->capacity = 0;
+    set->fixed = false;
+    set->allocator = mx_get_allocator();
+    mx_bitset_resize(set, bits);
+}
+
+MX_IMPL void mx_bitset_init_fixed(mx_bitset_t *set, uint64_t *words, size_t capacity, size_t bits)
+{
+    MX_ASSERT_SELFPTR(set);
+    MX_ASSERT(words || capacity == 0, "Storage must be non-null.");
+    MX_ASSERT(MX_BITSET_WORDS(bits) <= capacity, "Storage too small for the bits.");
+
+    if (capacity)
+        memset(words, 0, capacity * sizeof(uint64_t));
+
+    set->words = words;
+    set->bits = bits;
+    set->capacity = capacity;
+    set->fixed = true;
+    set->allocator = mx_get_allocator();
+}
+
+MX_IMPL void mx_bitset_destroy(mx_bitset_t *set)
+{
+    MX_ASSERT_SELFPTR(set);
+
+    if (set->words && !set->fixed)
+        IAllocator_free(set->allocator, set->words, set->capacity * sizeof(uint64_t));
+
+    set->words = NULL;
+    set->bits = 0;
+    set->capacity = 0;
+    set->fixed = false;
+}
+
+MX_IMPL void mx_bitset_resize(mx_bitset_t *set, size_t bits)
+{
+    MX_ASSERT_SELFPTR(set);
+
+    size_t used = MX_BITSET_WORDS(set->bits);
+    size_t words = MX_BITSET_WORDS(bits);
+
+    if (words > set->capacity)
+    {
+        MX_ASSERT(!set->fixed, "A fixed bitset cannot grow past its storage.");
+
+        size_t capacity = set->capacity * 2 > words ? set->capacity * 2 : words;
+        uint64_t *grown = IAllocator_realloc(set->allocator, set->words,
+            set->capacity * sizeof(uint64_t), capacity * sizeof(uint64_t), MX_ALLOC_ALIGN);
+        MX_ASSERT_OOM(grown);
+
+        set->words = grown;
+        set->capacity = capacity;
+    }
+
+    if (words > used)
+    {
+        memset(set->words + used, 0, (words - used) * sizeof(uint64_t));
+    }
+    else
+    {
+        /* Clear what was cut off so growing again yields clear bits. */
+        if (used > words)
+            memset(set->words + words, 0, (used - words) * sizeof(uint64_t));
+
+        if (words)
+            set->words[words - 1] &= mx_bitset_tail(bits);
+    }
+
+    set->bits = bits;
+}
+
+MX_IMPL void mx_bitset_fill(mx_bitset_t *set, size_t begin, size_t end, bool value)
+{
+    MX_ASSERT_SELFPTR(set);
+    MX_ASSERT(begin <= end && end <= set->bits, "Bit range out of range.");
+
+    if (begin == end)
+        return;
+
+    size_t first = begin / 64, last = (end - 1) / 64;
+    uint64_t head = ~(uint64_t)0 << (begin % 64);
+    uint64_t tail = mx_bitset_tail(end);
+    uint64_t fill = value ? ~(uint64_t)0 : 0;
+
+    if (first == last)
+    {
+        uint64_t mask = head & tail;
+        set->words[first] = (set->words[first] & ~mask) | (fill & mask);
+        return;
+    }
+
+    set->words[first] = (set->words[first] & ~head) | (fill & head);
+
+    if (last > first + 1)
+        memset(set->words + first + 1, value ? 0xFF : 0, (last - first - 1) * sizeof(uint64_t));
+
+    set->words[last] = (set->words[last] & ~tail) | (fill & tail);
+}
+
+static void mx_bitset_binary(mx_bitset_t *dst, const mx_bitset_t *a, const mx_bitset_t *b, mx_bitset_op op)
+{
+    MX_ASSERT_SELFPTR(dst);
+    MX_ASSERT_PTR(a, "Operand must be non-null.");
+    MX_ASSERT_PTR(b, "Operand must be non-null.");
+    MX_ASSERT(a->bits == b->bits, "Operands must have the same size.");
+
+    static const mx_bitset_apply_function scalar[] = {
+        mx_bitset_and_scalar, mx_bitset_or_scalar, mx_bitset_xor_scalar, mx_bitset_andnot_scalar
+    };
+    mx_bitset_apply_function apply = scalar[op];
+
+#if MX_CPU_X86
+    static const mx_bitset_apply_function avx2[] = {
+        mx_bitset_and_avx2, mx_bitset_or_avx2, mx_bitset_xor_avx2, mx_bitset_andnot_avx2
+    };
+
+    if (mx_cpu_has(MX_CPU_AVX2))
+        apply = avx2[op];
+#endif
+
+    /* Operands have the size dst takes, so an aliased one is never moved. */
+    mx_bitset_resize(dst, a->bits);
+    apply(dst->words, a->words, b->words, MX_BITSET_WORDS(a->bits));
+}
+
+MX_IMPL void mx_bitset_and(mx_bitset_t *dst, const mx_bitset_t *a, const mx_bitset_t *b)
+{
+    mx_bitset_binary(dst, a, b, MX_BITSET_AND);
+}
+
+MX_IMPL void mx_bitset_or(mx_bitset_t *dst, const mx_bitset_t *a, const mx_bitset_t *b)
+{
+    mx_bitset_binary(dst, a, b, MX_BITSET_OR);
+}
+
+MX_IMPL void mx_bitset_xor(mx_bitset_t *dst, const mx_bitset_t *a, const mx_bitset_t *b)
+{
+    mx_bitset_binary(dst, a, b, MX_BITSET_XOR);
+}
+
+MX_IMPL void mx_bitset_andnot(mx_bitset_t *dst, const mx_bitset_t *a, const mx_bitset_t *b)
+{
+    mx_bitset_binary(dst, a, b, MX_BITSET_ANDNOT);
+}
+
+MX_IMPL void mx_bitset_not(mx_bitset_t *dst, const mx_bitset_t *a)
+{
+    MX_ASSERT_SELFPTR(dst);
+    MX_ASSERT_PTR(a, "Operand must be non-null.");
+
+    /* ~a is a ^ ~0, and the tail is cleared again after. */
+    size_t words = MX_BITSET_WORDS(a->bits);
+
+    mx_bitset_resize(dst, a->bits);
+
+    for (size_t i = 0; i < words; i++)
+        dst->words[i] = ~a->words[i];
+
+    if (words)
+        dst->words[words - 1] &= mx_bitset_tail(a->bits);
+}
+
+MX_IMPL size_t mx_bitset_count(const mx_bitset_t *set)
+{
+    MX_ASSERT_SELFPTR(set);
+    return mx_bitset_popcount(set->words, MX_BITSET_WORDS(set->bits));
+}
+
+MX_IMPL bool mx_bitset_none(const mx_bitset_t *set)
+{
+    MX_ASSERT_SELFPTR(set);
+
+    size_t words = MX_BITSET_WORDS(set->bits);
+    return mx_bitset_skip(set->words, 0, words, 0) == words;
+}
+
+MX_IMPL size_t mx_bitset_next(const mx_bitset_t *set, size_t from)
+{
+    MX_ASSERT_SELFPTR(set);
+
+    if (from >= set->bits)
+        return set->bits;
+
+    size_t words = MX_BITSET_WORDS(set->bits);
+    size_t i = from / 64;
+    uint64_t w = set->words[i] & (~(uint64_t)0 << (from % 64));
+
+    if (w == 0)
+    {
+        i = mx_bitset_skip(set->words, i + 1, words, 0);
+
+        if (i == words)
+            return set->bits;
+
+        w = set->words[i];
+    }
+
+    return i * 64 + (size_t)__builtin_ctzll(w);
+}
+
+MX_IMPL size_t mx_bitset_next_clear(const mx_bitset_t *set, size_t from)
+{
+    MX_ASSERT_SELFPTR(set);
+
+    if (from >= set->bits)
+        return set->bits;
+
+    size_t words = MX_BITSET_WORDS(set->bits);
+    size_t i = from / 64;
+    uint64_t w = ~set->words[i] & (~(uint64_t)0 << (from % 64));
+
+    if (w == 0)
+    {
+        i = mx_bitset_skip(set->words, i + 1, words, ~(uint64_t)0);
+
+        if (i == words)
+            return set->bits;
+
+        w = ~set->words[i];
+    }
+
+    /* The clear tail of the last word reads as free bits past the size. */
+    size_t bit = i * 64 + (size_t)__builtin_ctzll(w);
+    return bit < set->bits ? bit : set->bits;
+}
+
+/*
+ * Rank directory. super[s] counts the set bits before superblock s and
+ * blocks[b] those between the start of its superblock and block b, so a rank
+ * is two lookups plus a popcount of at most eight words. Select searches the
+ * superblocks, then the blocks of one superblock, then the words of one block.
+ */
+
+MX_IMPL void mx_bitset_rank_init(mx_bitset_rank_t *rank, const mx_bitset_t *set)
+{
+    MX_ASSERT_SELFPTR(rank);
+    MX_ASSERT_PTR(set, "Bitset must be non-null.");
+
+    size_t words = MX_BITSET_WORDS(set->bits);
+
+    rank->words = set->words;
+    rank->bits = set->bits;
+    rank->count = 0;
+    rank->nsuper = (set->bits + MX_RANK_SUPER - 1) / MX_RANK_SUPER;
+    rank->nblocks = (set->bits + MX_RANK_BLOCK - 1) / MX_RANK_BLOCK;
+    rank->allocator = mx_get_allocator();
+    rank->super = NULL;
+    rank->blocks = NULL;
+
+    if (rank->nblocks == 0)
+        return;
+
+    rank->super = IAllocator_alloc(rank->allocator, rank->nsuper * sizeof(uint64_t), MX_ALLOC_ALIGN);
+    rank->blocks = IAllocator_alloc(rank->allocator, rank->nblocks * sizeof(uint16_t), MX_ALLOC_ALIGN);
+    MX_ASSERT_OOM(rank->super);
+    MX_ASSERT_OOM(rank->blocks);
+
+    size_t total = 0, within = 0;
+
+    for (size_t b = 0; b < rank->nblocks; b++)
+    {
+        if (b % (MX_RANK_SUPER / MX_RANK_BLOCK) == 0)
+        {
+            rank->super[b / (MX_RANK_SUPER / MX_RANK_BLOCK)] = total;
+            within = 0;
+        }
+
+        size_t first = b * (MX_RANK_BLOCK / 64);
+        size_t n = words - first < MX_RANK_BLOCK / 64 ? words - first : MX_RANK_BLOCK / 64;
+        size_t c = mx_bitset_popcount(set->words + first, n);
+
+        rank->blocks[b] = (uint16_t)within;
+        within += c;
+        total += c;
+    }
+
+    rank->count = total;
+}
+
+MX_IMPL void mx_bitset_rank_destroy(mx_bitset_rank_t *rank)
+{
+    MX_ASSERT_SELFPTR(rank);
+
+    if (rank->super)
+        IAllocator_free(rank->allocator, rank->super, rank->nsuper * sizeof(uint64_t));
+
+    if (rank->blocks)
+        IAllocator_free(rank->allocator, rank->blocks, rank->nblocks * sizeof(uint16_t));
+
+    rank->super = NULL;
+    rank->blocks = NULL;
+    rank->nsuper = rank->nblocks = 0;
+    rank->bits = rank->count = 0;
+}
+
+MX_IMPL size_t mx_bitset_rank(const mx_bitset_rank_t *rank, size_t i)
+{
+    MX_ASSERT_SELFPTR(rank);
+    MX_ASSERT(i <= rank->bits, "Bit index out of range.");
+
+    if (i >= rank->bits)
+        return rank->count;
+
+    size_t b = i / MX_RANK_BLOCK;
+    size_t word = i / 64;
+    size_t first = b * (MX_RANK_BLOCK / 64);
+    size_t count = (size_t)rank->super[i / MX_RANK_SUPER] + rank->blocks[b];
+
+    count += mx_bitset_popcount(rank->words + first, word - first);
+
+    if (i % 64)
+        count += mx_bitset_popcount64(rank->words[word] & (((uint64_t)1 << (i % 64)) - 1));
+
+    return count;
+}
+
+MX_IMPL size_t mx_bitset_select(const mx_bitset_rank_t *rank, size_t n)
+{
+    MX_ASSERT_SELFPTR(rank);
+
+    if (n >= rank->count)
+        return rank->bits;
+
+    /* Last superblock starting at or before the n-th bit. */
+    size_t lo = 0, hi = rank->nsuper;
+
+    while (hi - lo > 1)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+
+        if (rank->super[mid] <= n)
+            lo = mid;
+        else
+            hi = mid;
+    }
+
+    size_t s = lo;
+    n -= (size_t)rank->super[s];
+
+    /* Last block of that superblock starting at or before it. */
+    lo = s * (MX_RANK_SUPER / MX_RANK_BLOCK);
+    hi = lo + MX_RANK_SUPER / MX_RANK_BLOCK < rank->nblocks ? lo + MX_RANK_SUPER / MX_RANK_BLOCK : rank->nblocks;
+
+    while (hi - lo > 1)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+
+        if (rank->blocks[mid] <= n)
+            lo = mid;
+        else
+            hi = mid;
+    }
+
+    n -= rank->blocks[lo];
+
+    for (size_t i = lo * (MX_RANK_BLOCK / 64); ; i++)
+    {
+        size_t c = mx_bitset_popcount64(rank->words[i]);
+
+        if (n < c)
+            return i * 64 + mx_bitset_select64(rank->words[i], (unsigned)n);
+
+        n -= c;
+    }
+}
@@ -0,0 +1,643 @@
+#include "mx/btree.h"
+#include "mx/cpu.h"
+#include "mx/assert.h"
+#include <stdlib.h>
+#include <string.h>
+
+#if MX_CPU_X86
+#include <immintrin.h>
+#endif
+
+/** Fewest keys a node other than the root keeps after an erase. */
+#define MX_BTREE_MIN    (MX_BTREE_KEYS / 2)
+/** Keys per node written by a bulk load, leaving room for inserts. */
+#define MX_BTREE_FILL   (MX_BTREE_KEYS - MX_BTREE_KEYS / 8)
+
+typedef struct mx_btree_inner_t {
+    int64_t keys[MX_BTREE_KEYS];            /**< Separators, then INT64_MAX padding. */
+    void *children[MX_BTREE_KEYS + 1];      /**< Child i holds keys below keys[i]. */
+    int count;                              /**< Number of separators. */
+} mx_btree_inner_t;
+
+/*
+ * Node search. Keys are sorted and padded with INT64_MAX, which is never
+ * less than a key, so both versions may run over the full array.
+ */
+
+static int mx_btree_search_scalar(const int64_t *keys, int64_t key)
+{
+    const int64_t *base = keys;
+    size_t n = MX_BTREE_KEYS;
+
+    while (n > 1)
+    {
+        size_t half = n / 2;
+        base = base[half - 1] < key ? base + half : base;
+        n -= half;
+    }
+
+    return (int)(base - keys) + (*base < key);
+}
+
+#if MX_CPU_X86
+MX_TARGET("avx2")
+static int mx_btree_search_avx2(const int64_t *keys, int64_t key)
+{
+    __m256i k = _mm256_set1_epi64x(key);
+
+    for (int i = 0; i < MX_BTREE_KEYS; i += 8)
+    {
+        __m256i a = _mm256_cmpgt_epi64(k, _mm256_loadu_si256((const __m256i*)&keys[i]));
+        __m256i b = _mm256_cmpgt_epi64(k, _mm256_loadu_si256((const __m256i*)&keys[i + 4]));
+        unsigned less = (unsigned)_mm256_movemask_pd(_mm256_castsi256_pd(a))
+                      | (unsigned)_mm256_movemask_pd(_mm256_castsi256_pd(b)) << 4;
+
+        /* The keys less than key are a prefix, so stop at the first other. */
+        if (less != 0xFF)
+            return i + __builtin_ctz(~less);
+    }
+
+    return MX_BTREE_KEYS;
+}
+#endif
+
+/** Index of the child of an inner node that may hold key. */
+static int mx_btree_route(const mx_btree_t *tree, const mx_btree_inner_t *node, int64_t key)
+{
+    /* Separators not greater than key, the padding included at INT64_MAX. */
+    return key == INT64_MAX ? node->count : tree->search(node->keys, key + 1);
+}
+
+static char *mx_btree_values(const mx_btree_t *tree, mx_btree_leaf_t *leaf, int index)
+{
+    return (char*)leaf->values + (size_t)index * tree->value_size;
+}
+
+static mx_btree_leaf_t *mx_btree_leaf_new(mx_btree_t *tree)
+{
+    mx_btree_leaf_t *leaf = IAllocator_alloc(tree->allocator, sizeof(mx_btree_leaf_t) + MX_BTREE_KEYS * tree->value_size, MX_ALLOC_ALIGN);
+    MX_ASSERT_OOM(leaf);
+
+    for (int i = 0; i < MX_BTREE_KEYS; i++)
+        leaf->keys[i] = INT64_MAX;
+
+    leaf->prev = leaf->next = NULL;
+    leaf->count = 0;
+    return leaf;
+}
+
+static mx_btree_inner_t *mx_btree_inner_new(mx_btree_t *tree)
+{
+    mx_btree_inner_t *node = IAllocator_alloc(tree->allocator, sizeof(mx_btree_inner_t), MX_ALLOC_ALIGN);
+    MX_ASSERT_OOM(node);
+
+    for (int i = 0; i < MX_BTREE_KEYS; i++)
+        node->keys[i] = INT64_MAX;
+
+    node->count = 0;
+    return node;
+}
+
+static void mx_btree_free_node(mx_btree_t *tree, void *node, int height)
+{
+    if (height == 0)
+    {
+        IAllocator_free(tree->allocator, node, sizeof(mx_btree_leaf_t) + MX_BTREE_KEYS * tree->value_size);
+        return;
+    }
+
+    mx_btree_inner_t *inner = node;
+
+    for (int i = 0; i <= inner->count; i++)
+        mx_btree_free_node(tree, inner->children[i], height - 1);
+
+    IAllocator_free(tree->allocator, node, sizeof(mx_btree_inner_t));
+}
+
+MX_IMPL void mx_btree_init(mx_btree_t *tree, size_t value_size)
+{
+    MX_ASSERT_SELFPTR(tree);
+
+    tree->root = NULL;
+    tree->height = 0;
+    tree->count = 0;
+    tree->value_size = value_size;
+    tree->first = tree->last = NULL;
+    tree->search = mx_btree_search_scalar;
+    tree->allocator = mx_get_allocator();
+
+#if MX_CPU_X86
+    if (mx_cpu_has(MX_CPU_AVX2))
+        tree->search = mx_btree_search_avx2;
+#endif
+}
+
+MX_IMPL void mx_btree_destroy(mx_btree_t *tree)
+{
+    MX_ASSERT_SELFPTR(tree);
+
+    if (tree->root)
+        mx_btree_free_node(tree, tree->root, tree->height);
+
+    tree->root = NULL;
+    tree->height = 0;
+    tree->count = 0;
+    tree->first = tree->last = NULL;
+}
+
+/** Leaf that may hold key. */
+static mx_btree_leaf_t *mx_btree_descend(const mx_btree_t *tree, int64_t key)
+{
+    void *node = tree->root;
+
+    for (int h = tree->height; h > 0; h--)
+        node = ((mx_btree_inner_t*)node)->children[mx_btree_route(tree, node, key)];
+
+    return node;
+}
+
+MX_IMPL void *mx_btree_find(const mx_btree_t *tree, int64_t key)
+{
+    MX_ASSERT_SELFPTR(tree);
+
+    if (tree->root == NULL)
+        return NULL;
+
+    mx_btree_leaf_t *leaf = mx_btree_descend(tree, key);
+    int pos = tree->search(leaf->keys, key);
+
+    if (pos < leaf->count && leaf->keys[pos] == key)
+        return mx_btree_values(tree, leaf, pos);
+
+    return NULL;
+}
+
+/*
+ * Insertion. A full node splits in two and hands the first key of the right
+ * half to its parent; a full root grows the tree by a level.
+ */
+
+typedef struct mx_btree_split_t {
+    int64_t key;                /**< Smallest key of the new node. */
+    void *node;                 /**< The new right node, NULL if no split. */
+} mx_btree_split_t;
+
+static void mx_btree_leaf_put(mx_btree_t *tree, mx_btree_leaf_t *leaf, int pos, int64_t key, const void *value)
+{
+    memmove(&leaf->keys[pos + 1], &leaf->keys[pos], (size_t)(leaf->count - pos) * sizeof(int64_t));
+    memmove(mx_btree_values(tree, leaf, pos + 1), mx_btree_values(tree, leaf, pos), (size_t)(leaf->count - pos) * tree->value_size);
+
+    leaf->keys[pos] = key;
+    leaf->count++;
+
+    if (value && tree->value_size)
+        memcpy(mx_btree_values(tree, leaf, pos), value, tree->value_size);
+}
+
+static mx_btree_split_t mx_btree_leaf_insert(mx_btree_t *tree, mx_btree_leaf_t *leaf, int64_t key, const void *value, bool *inserted)
+{
+    mx_btree_split_t split = { 0, NULL };
+    int pos = tree->search(leaf->keys, key);
+
+    if (pos < leaf->count && leaf->keys[pos] == key)
+    {
+        if (value && tree->value_size)
+            memcpy(mx_btree_values(tree, leaf, pos), value, tree->value_size);
+
+        *inserted = false;
+        return split;
+    }
+
+    *inserted = true;
+
+    if (leaf->count < MX_BTREE_KEYS)
+    {
+        mx_btree_leaf_put(tree, leaf, pos, key, value);
+        return split;
+    }
+
+    mx_btree_leaf_t *right = mx_btree_leaf_new(tree);
+    int half = MX_BTREE_KEYS / 2;
+
+    memcpy(right->keys, &leaf->keys[half], (size_t)(MX_BTREE_KEYS - half) * sizeof(int64_t));
+    memcpy(mx_btree_values(tree, right, 0), mx_btree_values(tree, leaf, half), (size_t)(MX_BTREE_KEYS - half) * tree->value_size);
+    right->count = MX_BTREE_KEYS - half;
+
+    for (int i = half; i < MX_BTREE_KEYS; i++)
+        leaf->keys[i] = INT64_MAX;
+
+    leaf->count = half;
+
+    right->prev = leaf;
+    right->next = leaf->next;
+
+    if (leaf->next)
+        leaf->next->prev = right;
+    else
+        tree->last = right;
+
+    leaf->next = right;
+
+    if (pos <= half)
+        mx_btree_leaf_put(tree, leaf, pos, key, value);
+    else
+        mx_btree_leaf_put(tree, right, pos - half, key, value);
+
+    split.key = right->keys[0];
+    split.node = right;
+    return split;
+}
+
+static mx_btree_split_t mx_btree_inner_insert(mx_btree_t *tree, mx_btree_inner_t *node, int height, int64_t key, const void *value, bool *inserted)
+{
+    int c = mx_btree_route(tree, node, key);
+    mx_btree_split_t child = height == 1
+        ? mx_btree_leaf_insert(tree, node->children[c], key, value, inserted)
+        : mx_btree_inner_insert(tree, node->children[c], height - 1, key, value, inserted);
+    mx_btree_split_t split = { 0, NULL };
+
+    if (child.node == NULL)
+        return split;
+
+    if (node->count < MX_BTREE_KEYS)
+    {
+        memmove(&node->keys[c + 1], &node->keys[c], (size_t)(node->count - c) * sizeof(int64_t));
+        memmove(&node->children[c + 2], &node->children[c + 1], (size_t)(node->count - c) * sizeof(void*));
+        node->keys[c] = child.key;
+        node->children[c + 1] = child.node;
+        node->count++;
+        return split;
+    }
+
+    /* Lay out all separators and children, then cut around the middle one,
+     * which moves up to the parent. */
+    int64_t keys[MX_BTREE_KEYS + 1];
+    void *children[MX_BTREE_KEYS + 2];
+
+    memcpy(keys, node->keys, (size_t)c * sizeof(int64_t));
+    keys[c] = child.key;
+    memcpy(&keys[c + 1], &node->keys[c], (size_t)(MX_BTREE_KEYS - c) * sizeof(int64_t));
+
+    memcpy(children, node->children, (size_t)(c + 1) * sizeof(void*));
+    children[c + 1] = child.node;
+    memcpy(&children[c + 2], &node->children[c + 1], (size_t)(MX_BTREE_KEYS - c) * sizeof(void*));
+
+    mx_btree_inner_t *right = mx_btree_inner_new(tree);
+    int half = (MX_BTREE_KEYS + 1) / 2;
+
+    for (int i = 0; i < MX_BTREE_KEYS; i++)
+        node->keys[i] = i < half ? keys[i] : INT64_MAX;
+
+    memcpy(node->children, children, (size_t)(half + 1) * sizeof(void*));
+    node->count = half;
+
+    right->count = MX_BTREE_KEYS - half;
+    memcpy(right->keys, &keys[half + 1], (size_t)right->count * sizeof(int64_t));
+    memcpy(right->children, &children[half + 1], (size_t)(right->count + 1) * sizeof(void*));
+
+    split.key = keys[half];
+    split.node = right;
+    return split;
+}
+
+MX_IMPL bool mx_btree_insert(mx_btree_t *tree, int64_t key, const void *value)
+{
+    MX_ASSERT_SELFPTR(tree);
+
+    bool inserted = false;
+
+    if (tree->root == NULL)
+    {
+        mx_btree_leaf_t *leaf = mx_btree_leaf_new(tree);
+        tree->root = tree->first = tree->last = leaf;
+        tree->height = 0;
+    }
+
+    mx_btree_split_t split = tree->height == 0
+        ? mx_btree_leaf_insert(tree, tree->root, key, value, &inserted)
+        : mx_btree_inner_insert(tree, tree->root, tree->height, key, value, &inserted);
+
+    if (split.node)
+    {
+        mx_btree_inner_t *root = mx_btree_inner_new(tree);
+        root->keys[0] = split.key;
+        root->children[0] = tree->root;
+        root->children[1] = split.node;
+        root->count = 1;
+
+        tree->root = root;
+        tree->height++;
+    }
+
+    tree->count += inserted;
+    return inserted;
+}
+
+/*
+ * Erase. A child left with fewer than MX_BTREE_MIN keys takes one from a
+ * neighbour when the two hold more than a node, and merges with it otherwise.
+ */
+
+/** Remove separator i and child i + 1 of an inner node. */
+static void mx_btree_inner_remove(mx_btree_inner_t *node, int i)
+{
+    memmove(&node->keys[i], &node->keys[i + 1], (size_t)(node->count - i - 1) * sizeof(int64_t));
+    memmove(&node->children[i + 1], &node->children[i + 2], (size_t)(node->count - i - 1) * sizeof(void*));
+    node->count--;
+    node->keys[node->count] = INT64_MAX;
+}
+
+static void mx_btree_fix_leaves(mx_btree_t *tree, mx_btree_inner_t *parent, int i)
+{
+    mx_btree_leaf_t *left = parent->children[i];
+    mx_btree_leaf_t *right = parent->children[i + 1];
+    size_t size = tree->value_size;
+
+    if (left->count + right->count <= MX_BTREE_KEYS)
+    {
+        memcpy(&left->keys[left->count], right->keys, (size_t)right->count * sizeof(int64_t));
+        memcpy(mx_btree_values(tree, left, left->count), mx_btree_values(tree, right, 0), (size_t)right->count * size);
+        left->count += right->count;
+
+        left->next = right->next;
+
+        if (right->next)
+            right->next->prev = left;
+        else
+            tree->last = left;
+
+        mx_btree_free_node(tree, right, 0);
+        mx_btree_inner_remove(parent, i);
+        return;
+    }
+
+    if (left->count < right->count)
+    {
+        /* Move the smallest key of the right leaf to the end of the left. */
+        left->keys[left->count] = right->keys[0];
+        memcpy(mx_btree_values(tree, left, left->count), mx_btree_values(tree, right, 0), size);
+        left->count++;
+
+        right->count--;
+        memmove(right->keys, &right->keys[1], (size_t)right->count * sizeof(int64_t));
+        memmove(mx_btree_values(tree, right, 0), mx_btree_values(tree, right, 1), (size_t)right->count * size);
+        right->keys[right->count] = INT64_MAX;
+    }
+    else
+    {
+        /* Move the largest key of the left leaf to the front of the right. */
+        left->count--;
+        mx_btree_leaf_put(tree, right, 0, left->keys[left->count], mx_btree_values(tree, left, left->count));
+        left->keys[left->count] = INT64_MAX;
+    }
+
+    parent->keys[i] = right->keys[0];
+}
+
+static void mx_btree_fix_inner(mx_btree_t *tree, mx_btree_inner_t *parent, int i)
+{
+    mx_btree_inner_t *left = parent->children[i];
+    mx_btree_inner_t *right = parent->children[i + 1];
+
+    if (left->count + right->count + 1 <= MX_BTREE_KEYS)
+    {
+        left->keys[left->count] = parent->keys[i];
+        memcpy(&left->keys[left->count + 1], right->keys, (size_t)right->count * sizeof(int64_t));
+        memcpy(&left->children[left->count + 1], right->children, (size_t)(right->count + 1) * sizeof(void*));
+        left->count += right->count + 1;
+
+        IAllocator_free(tree->allocator, right, sizeof(mx_btree_inner_t));
+        mx_btree_inner_remove(parent, i);
+        return;
+    }
+
+    if (left->count < right->count)
+    {
+        /* Rotate left through the parent separator. */
+        left->keys[left->count] = parent->keys[i];
+        left->children[left->count + 1] = right->children[0];
+        left->count++;
+
+        parent->keys[i] = right->keys[0];
+        memmove(right->keys, &right->keys[1], (size_t)(right->count - 1) * sizeof(int64_t));
+        memmove(right->children, &right->children[1], (size_t)right->count * sizeof(void*));
+        right->count--;
+        right->keys[right->count] = INT64_MAX;
+    }
+    else
+    {
+        /* Rotate right through the parent separator. */
+        memmove(&right->keys[1], right->keys, (size_t)right->count * sizeof(int64_t));
+        memmove(&right->children[1], right->children, (size_t)(right->count + 1) * sizeof(void*));
+        right->keys[0] = parent->keys[i];
+        right->children[0] = left->children[left->count];
+        right->count++;
+
+        left->count--;
+        parent->keys[i] = left->keys[left->count];
+        left->keys[left->count] = INT64_MAX;
+    }
+}
+
+static bool mx_btree_erase_node(mx_btree_t *tree, void *node, int height, int64_t key, void *value)
+{
+    if (height == 0)
+    {
+        mx_btree_leaf_t *leaf = node;
+        int pos = tree->search(leaf->keys, key);
+
+        if (pos >= leaf->count || leaf->keys[pos] != key)
+            return false;
+
+        if (value && tree->value_size)
+            memcpy(value, mx_btree_values(tree, leaf, pos), tree->value_size);
+
+        leaf->count--;
+        memmove(&leaf->keys[pos], &leaf->keys[pos + 1], (size_t)(leaf->count - pos) * sizeof(int64_t));
+        memmove(mx_btree_values(tree, leaf, pos), mx_btree_values(tree, leaf, pos + 1), (size_t)(leaf->count - pos) * tree->value_size);
+        leaf->keys[leaf->count] = INT64_MAX;
+        return true;
+    }
+
+    mx_btree_inner_t *inner = node;
+    int c = mx_btree_route(tree, inner, key);
+
+    if (!mx_btree_erase_node(tree, inner->children[c], height - 1, key, value))
+        return false;
+
+    int count = height == 1
+        ? ((mx_btree_leaf_t*)inner->children[c])->count
+        : ((mx_btree_inner_t*)inner->children[c])->count;
+
+    if (count < MX_BTREE_MIN)
+    {
+        int i = c > 0 ? c - 1 : c;
+
+        if (height == 1)
+            mx_btree_fix_leaves(tree, inner, i);
+        else
+            mx_btree_fix_inner(tree, inner, i);
+    }
+
+    return true;
+}
+
+MX_IMPL bool mx_btree_erase(mx_btree_t *tree, int64_t key, void *value)
+{
+    MX_ASSERT_SELFPTR(tree);
+
+    if (tree->root == NULL || !mx_btree_erase_node(tree, tree->root, tree->height, key, value))
+        return false;
+
+    tree->count--;
+
+    if (tree->height > 0 && ((mx_btree_inner_t*)tree->root)->count == 0)
+    {
+        /* The root has a single child left, which becomes the root. */
+        mx_btree_inner_t *root = tree->root;
+        tree->root = root->children[0];
+        tree->height--;
+        IAllocator_free(tree->allocator, root, sizeof(mx_btree_inner_t));
+    }
+    else if (tree->height == 0 && tree->count == 0)
+    {
+        mx_btree_free_node(tree, tree->root, 0);
+        tree->root = NULL;
+        tree->first = tree->last = NULL;
+    }
+
+    return true;
+}
+
+/*
+ * Bulk load. Entries are spread evenly over as few leaves as hold them at
+ * MX_BTREE_FILL keys each; the levels above are built the same way from the
+ * first key of every node below.
+ */
+
+MX_IMPL void mx_btree_bulk_load(mx_btree_t *tree, const int64_t *keys, const void *values, size_t count)
+{
+    MX_ASSERT_SELFPTR(tree);
+    MX_ASSERT(tree->root == NULL, "mx_btree_bulk_load() expected an empty tree.");
+
+    if (count == 0)
+        return;
+
+    size_t nodes = (count + MX_BTREE_FILL - 1) / MX_BTREE_FILL;
+    void **level = malloc(nodes * sizeof(void*));
+    int64_t *mins = malloc(nodes * sizeof(int64_t));
+    MX_ASSERT_OOM(level);
+    MX_ASSERT_OOM(mins);
+
+    mx_btree_leaf_t *prev = NULL;
+    size_t at = 0;
+
+    for (size_t n = 0; n < nodes; n++)
+    {
+        mx_btree_leaf_t *leaf = mx_btree_leaf_new(tree);
+        int take = (int)(count / nodes + (n < count % nodes));
+
+        memcpy(leaf->keys, &keys[at], (size_t)take * sizeof(int64_t));
+
+        if (values && tree->value_size)
+            memcpy(mx_btree_values(tree, leaf, 0), (const char*)values + at * tree->value_size, (size_t)take * tree->value_size);
+
+        for (int i = 1; i < take; i++)
+            MX_ASSERT(leaf->keys[i - 1] < leaf->keys[i], "mx_btree_bulk_load() expected strictly increasing keys.");
+
+        MX_ASSERT(prev == NULL || prev->keys[prev->count - 1] < leaf->keys[0], "mx_btree_bulk_load() expected strictly increasing keys.");
+
+        leaf->count = take;
+        leaf->prev = prev;
+
+        if (prev)
+            prev->next = leaf;
+        else
+            tree->first = leaf;
+
+        prev = leaf;
+        level[n] = leaf;
+        mins[n] = leaf->keys[0];
+        at += (size_t)take;
+    }
+
+    tree->last = prev;
+    tree->height = 0;
+
+    /* Build parents until a single node is left, in place over the arrays. */
+    while (nodes > 1)
+    {
+        size_t parents = (nodes + MX_BTREE_FILL) / (MX_BTREE_FILL + 1);
+        size_t child = 0;
+
+        for (size_t n = 0; n < parents; n++)
+        {
+            mx_btree_inner_t *node = mx_btree_inner_new(tree);
+            int take = (int)(nodes / parents + (n < nodes % parents));
+            int64_t min = mins[child];
+
+            node->children[0] = level[child];
+
+            for (int i = 1; i < take; i++)
+            {
+                node->keys[i - 1] = mins[child + (size_t)i];
+                node->children[i] = level[child + (size_t)i];
+            }
+
+            node->count = take - 1;
+            child += (size_t)take;
+            level[n] = node;
+            mins[n] = min;
+        }
+
+        nodes = parents;
+        tree->height++;
+    }
+
+    tree->root = level[0];
+    tree->count = count;
+
+    free(level);
+    free(mins);
+}
+
+/*
+ * Iteration.
+ */
+
+MX_IMPL mx_btree_iter_t mx_btree_begin(const mx_btree_t *tree)
+{
+    return (mx_btree_iter_t){ tree->first, 0, tree->value_size };
+}
+
+MX_IMPL mx_btree_iter_t mx_btree_last(const mx_btree_t *tree)
+{
+    return (mx_btree_iter_t){ tree->last, tree->last ? tree->last->count - 1 : 0, tree->value_size };
+}
+
+MX_IMPL mx_btree_iter_t mx_btree_lower_bound(const mx_btree_t *tree, int64_t key)
+{
+    mx_btree_iter_t it = { NULL, 0, tree->value_size };
+
+    if (tree->root == NULL)
+        return it;
+
+    it.leaf = mx_btree_descend(tree, key);
+    it.index = tree->search(it.leaf->keys, key);
+
+    if (it.index >= it.leaf->count)
+    {
+        it.leaf = it.leaf->next;
+        it.index = 0;
+    }
+
+    return it;
+}
+
+MX_IMPL mx_btree_iter_t mx_btree_upper_bound(const mx_btree_t *tree, int64_t key)
+{
+    if (key == INT64_MAX)
+        return (mx_btree_iter_t){ NULL, 0, tree->value_size };
+
+    return mx_btree_lower_bound(tree, key + 1);
+}
@@ -0,0 +1,89 @@
+#include "mx/cpu.h"
+#include <stdatomic.h>
+
+#if MX_CPU_X86
+    #if defined(_MSC_VER)
+        #include <intrin.h>
+    #else
+        #include <cpuid.h>
+    #endif
+#endif
+
+#if MX_CPU_X86
+static void mx_cpuid(uint32_t leaf, uint32_t subleaf, uint32_t regs[4])
+{
+#if defined(_MSC_VER)
+    __cpuidex((int*)regs, (int)leaf, (int)subleaf);
+#else
+    __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+static uint64_t mx_xgetbv(uint32_t index)
+{
+#if defined(_MSC_VER)
+    return _xgetbv(index);
+#else
+    uint32_t eax, edx;
+    __asm__ volatile ("xgetbv" : "=a"(eax), "=d"(edx) : "c"(index));
+    return ((uint64_t)edx << 32) | eax;
+#endif
+}
+
+static mx_cpu_feature mx_cpu_detect(void)
+{
+    uint32_t regs[4];
+    mx_cpu_feature features = 0;
+
+    mx_cpuid(0, 0, regs);
+    uint32_t max_leaf = regs[0];
+
+    if (max_leaf < 1)
+        return features;
+
+    mx_cpuid(1, 0, regs);
+    uint32_t ecx1 = regs[2], edx1 = regs[3];
+
+    if (edx1 & (1u << 26)) features |= MX_CPU_SSE2;
+    if (ecx1 & (1u <<  9)) features |= MX_CPU_SSSE3;
+    if (ecx1 & (1u << 19)) features |= MX_CPU_SSE41;
+    if (ecx1 & (1u << 20)) features |= MX_CPU_SSE42;
+    if (ecx1 & (1u <<  1)) features |= MX_CPU_PCLMUL;
+    if (ecx1 & (1u << 23)) features |= MX_CPU_POPCNT;
+
+    /* AVX state must be enabled by the OS as well, check OSXSAVE and XCR0. */
+    bool ymm = (ecx1 & (1u << 27)) && (mx_xgetbv(0) & 0x6) == 0x6;
+
+    if (max_leaf >= 7)
+    {
+        mx_cpuid(7, 0, regs);
+        uint32_t ebx7 = regs[1];
+
+        if (ymm && (ebx7 & (1u << 5))) features |= MX_CPU_AVX2;
+        if (ebx7 & (1u << 29)) features |= MX_CPU_SHA;
+        if (ebx7 & (1u <<  8)) features |= MX_CPU_BMI2;
+    }
+
+    return features;
+}
+#else
+static mx_cpu_feature mx_cpu_detect(void)
+{
+    return 0;
+}
+#endif
+
+MX_IMPL mx_cpu_feature mx_cpu_features(void)
+{
+    static atomic_bool init;
+    static _Atomic(mx_cpu_feature) features;
+
+    /* Detection has no side effects, so racing threads may both run it. */
+    if (!atomic_load_explicit(&init, memory_order_acquire))
+    {
+        atomic_store_explicit(&features, mx_cpu_detect(), memory_order_relaxed);
+        atomic_store_explicit(&init, true, memory_order_release);
+    }
+
+    return atomic_load_explicit(&features, memory_order_relaxed);
+}
@@ -0,0 +1,433 @@
+#include <mx/digest.h>
+#include <mx/cpu.h>
+#include <mx/assert.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if MX_CPU_X86
+#include <immintrin.h>
+#endif
+
+/** Reflected CRC32-IEEE polynomial. */
+#define CRC32_POLY  0xEDB88320u
+/** Reflected CRC32C (Castagnoli) polynomial. */
+#define CRC32C_POLY 0x82F63B78u
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    #define CRC32_LITTLE_ENDIAN 0
+#else
+    #define CRC32_LITTLE_ENDIAN 1
+#endif
+
+/**
+ * Lookup tables, built on first use. table[k][n] is the CRC of byte n
+ * followed by k zeroes, for slicing-by-8, and power[k] is x^(2^k) modulo the
+ * polynomial, for combining.
+ */
+typedef struct mx_crc32_tables_t {
+    uint32_t crc32_table [8][256];
+    uint32_t crc32c_table[8][256];
+    uint32_t crc32_power [32];
+    uint32_t crc32c_power[32];
+} mx_crc32_tables_t;
+
+static _Atomic(const mx_crc32_tables_t*) mx_crc32_tables;
+
+static void mx_crc32_make_powers(uint32_t power[32], uint32_t poly);
+
+static void mx_crc32_make_table(uint32_t table[8][256], uint32_t poly)
+{
+    for (uint32_t n = 0; n < 256; n++)
+    {
+        uint32_t c = n;
+
+        for (int k = 0; k < 8; k++)
+            c = (c & 1) ? (c >> 1) ^ poly : (c >> 1);
+
+        table[0][n] = c;
+    }
+
+    for (uint32_t n = 0; n < 256; n++)
+    {
+        uint32_t c = table[0][n];
+
+        for (int k = 1; k < 8; k++)
+        {
+            c = table[0][c & 0xFF] ^ (c >> 8);
+            table[k][n] = c;
+        }
+    }
+}
+
+/**
+ * Slicing-by-8 CRC over a table. The crc argument and result are the internal
+ * (pre and post inverted) register value.
+ */
+static uint32_t mx_crc32_slice8(const uint32_t table[8][256], uint32_t crc, const unsigned char *src, size_t length)
+{
+    while (length > 0 && ((uintptr_t)src & 7))
+    {
+        crc = table[0][(crc ^ *(src++)) & 0xFF] ^ (crc >> 8);
+        length--;
+    }
+
+#if CRC32_LITTLE_ENDIAN
+    for (; length >= 8; length -= 8, src += 8)
+    {
+        uint32_t lo, hi;
+        memcpy(&lo, src, 4);
+        memcpy(&hi, src + 4, 4);
+        lo ^= crc;
+
+        crc = table[7][(lo      ) & 0xFF] ^ table[6][(lo >>  8) & 0xFF]
+            ^ table[5][(lo >> 16) & 0xFF] ^ table[4][(lo >> 24)       ]
+            ^ table[3][(hi      ) & 0xFF] ^ table[2][(hi >>  8) & 0xFF]
+            ^ table[1][(hi >> 16) & 0xFF] ^ table[0][(hi >> 24)       ];
+    }
+#endif
+
+    while (length--)
+        crc = table[0][(crc ^ *(src++)) & 0xFF] ^ (crc >> 8);
+
+    return crc;
+}
+
+/** The tables, built by the first caller. Racing callers keep the first published. */
+static const mx_crc32_tables_t *mx_crc32_get_tables(void)
+{
+    const mx_crc32_tables_t *tables = atomic_load_explicit(&mx_crc32_tables, memory_order_acquire);
+
+    if (tables)
+        return tables;
+
+    mx_crc32_tables_t *built = malloc(sizeof(mx_crc32_tables_t));
+    MX_ASSERT_OOM(built);
+
+    mx_crc32_make_table(built->crc32_table,  CRC32_POLY);
+    mx_crc32_make_table(built->crc32c_table, CRC32C_POLY);
+    mx_crc32_make_powers(built->crc32_power,  CRC32_POLY);
+    mx_crc32_make_powers(built->crc32c_power, CRC32C_POLY);
+
+    if (atomic_compare_exchange_strong_explicit(&mx_crc32_tables, &tables, built, memory_order_acq_rel, memory_order_acquire))
+        return built;
+
+    /* Another thread won the race. */
+    free(built);
+    return tables;
+}
+
+static uint32_t mx_crc32_table_block(uint32_t crc, const unsigned char *src, size_t length)
+{
+    return mx_crc32_slice8(mx_crc32_get_tables()->crc32_table, crc, src, length);
+}
+
+static uint32_t mx_crc32c_table_block(uint32_t crc, const unsigned char *src, size_t length)
+{
+    return mx_crc32_slice8(mx_crc32_get_tables()->crc32c_table, crc, src, length);
+}
+
+#if MX_CPU_X86
+MX_TARGET("sse4.2")
+static uint32_t mx_crc32c_sse42(uint32_t crc, const unsigned char *src, size_t length)
+{
+    while (length > 0 && ((uintptr_t)src & 7))
+    {
+        crc = _mm_crc32_u8(crc, *(src++));
+        length--;
+    }
+
+#if defined(__x86_64__) || defined(_M_X64)
+    uint64_t crc64 = crc;
+
+    for (; length >= 32; length -= 32, src += 32)
+    {
+        uint64_t w[4];
+        memcpy(w, src, sizeof w);
+        crc64 = _mm_crc32_u64(crc64, w[0]);
+        crc64 = _mm_crc32_u64(crc64, w[1]);
+        crc64 = _mm_crc32_u64(crc64, w[2]);
+        crc64 = _mm_crc32_u64(crc64, w[3]);
+    }
+
+    for (; length >= 8; length -= 8, src += 8)
+    {
+        uint64_t w;
+        memcpy(&w, src, sizeof w);
+        crc64 = _mm_crc32_u64(crc64, w);
+    }
+
+    crc = (uint32_t)crc64;
+#endif
+
+    for (; length >= 4; length -= 4, src += 4)
+    {
+        uint32_t w;
+        memcpy(&w, src, sizeof w);
+        crc = _mm_crc32_u32(crc, w);
+    }
+
+    while (length--)
+        crc = _mm_crc32_u8(crc, *(src++));
+
+    return crc;
+}
+
+/*
+ * CRC32-IEEE by folding with carry-less multiplication, after "Fast CRC
+ * Computation for Generic Polynomials Using PCLMULQDQ Instruction" (Gopal et
+ * al., Intel 2009). Four 128 bit accumulators are folded 64 bytes at a time,
+ * reduced to one, then to 32 bits with a Barrett reduction. The constants are
+ * the bit reflected x^n mod P values given at the end of the paper.
+ */
+MX_TARGET("pclmul,sse4.1")
+static uint32_t mx_crc32_pclmul(uint32_t crc, const unsigned char *src, size_t length)
+{
+    static const uint64_t k1k2[2] = { 0x0154442bd4, 0x01c6e41596 };
+    static const uint64_t k3k4[2] = { 0x01751997d0, 0x00ccaa009e };
+    static const uint64_t k5k0[2] = { 0x0163cd6124, 0x0000000000 };
+    static const uint64_t poly[2] = { 0x01db710641, 0x01f7011641 };
+
+    if (length < 64)
+        return mx_crc32_table_block(crc, src, length);
+
+    size_t tail = length & 15;
+    length -= tail;
+
+    __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8;
+
+    x1 = _mm_loadu_si128((const __m128i*)(src + 0x00));
+    x2 = _mm_loadu_si128((const __m128i*)(src + 0x10));
+    x3 = _mm_loadu_si128((const __m128i*)(src + 0x20));
+    x4 = _mm_loadu_si128((const __m128i*)(src + 0x30));
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int)crc));
+    x0 = _mm_loadu_si128((const __m128i*)k1k2);
+
+    src += 64;
+    length -= 64;
+
+    while (length >= 64)
+    {
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+        x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+        x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+        x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+        x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128((const __m128i*)(src + 0x00)));
+        x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128((const __m128i*)(src + 0x10)));
+        x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128((const __m128i*)(src + 0x20)));
+        x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128((const __m128i*)(src + 0x30)));
+
+        src += 64;
+        length -= 64;
+    }
+
+    /* Fold the four accumulators into one. */
+    x0 = _mm_loadu_si128((const __m128i*)k3k4);
+
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+    /* Fold the remaining 16 byte blocks. */
+    while (length >= 16)
+    {
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, _mm_loadu_si128((const __m128i*)src)), x5);
+
+        src += 16;
+        length -= 16;
+    }
+
+    /* Fold 128 bits to 64 bits. */
+    x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+    x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+    x1 = _mm_srli_si128(x1, 8);
+    x1 = _mm_xor_si128(x1, x2);
+
+    x0 = _mm_loadl_epi64((const __m128i*)k5k0);
+
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, x3);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    /* Barrett reduce to 32 bits. */
+    x0 = _mm_loadu_si128((const __m128i*)poly);
+
+    x2 = _mm_and_si128(x1, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+    x2 = _mm_and_si128(x2, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    crc = (uint32_t)_mm_extract_epi32(x1, 1);
+
+    return mx_crc32_table_block(crc, src, tail);
+}
+#endif
+
+static uint32_t mx_crc32_resolve(uint32_t crc, const unsigned char *src, size_t length);
+static uint32_t mx_crc32c_resolve(uint32_t crc, const unsigned char *src, size_t length);
+
+typedef uint32_t (*mx_crc32_block_function)(uint32_t crc, const unsigned char *src, size_t length);
+
+/**
+ * CRC32 and CRC32C block functions, selected on first use. The table
+ * functions fetch their own tables, so threads racing to select one only
+ * need the store to be atomic.
+ */
+static _Atomic(mx_crc32_block_function) mx_crc32_block  = mx_crc32_resolve;
+static _Atomic(mx_crc32_block_function) mx_crc32c_block = mx_crc32c_resolve;
+
+static uint32_t mx_crc32_call(_Atomic(mx_crc32_block_function) *block, uint32_t crc, const unsigned char *src, size_t length)
+{
+    return atomic_load_explicit(block, memory_order_relaxed)(crc, src, length);
+}
+
+static uint32_t mx_crc32_resolve(uint32_t crc, const unsigned char *src, size_t length)
+{
+    mx_crc32_block_function block = mx_crc32_table_block;
+#if MX_CPU_X86
+    if (mx_cpu_has(MX_CPU_PCLMUL | MX_CPU_SSE41))
+        block = mx_crc32_pclmul;
+#endif
+    atomic_store_explicit(&mx_crc32_block, block, memory_order_relaxed);
+    return block(crc, src, length);
+}
+
+static uint32_t mx_crc32c_resolve(uint32_t crc, const unsigned char *src, size_t length)
+{
+    mx_crc32_block_function block = mx_crc32c_table_block;
+#if MX_CPU_X86
+    if (mx_cpu_has(MX_CPU_SSE42))
+        block = mx_crc32c_sse42;
+#endif
+    atomic_store_explicit(&mx_crc32c_block, block, memory_order_relaxed);
+    return block(crc, src, length);
+}
+
+MX_IMPL void mx_crc32(crc32_t *digest, const char *src, size_t length)
+{
+    *digest = ~mx_crc32_call(&mx_crc32_block, ~0u, (const unsigned char*)src, length);
+}
+
+MX_IMPL void mx_crc32_init(mx_crc32_ctx_t *ctx)
+{
+    ctx->state = ~0u;
+}
+
+MX_IMPL void mx_crc32_update(mx_crc32_ctx_t *ctx, const char *src, size_t length)
+{
+    ctx->state = mx_crc32_call(&mx_crc32_block, ctx->state, (const unsigned char*)src, length);
+}
+
+MX_IMPL void mx_crc32_final(mx_crc32_ctx_t *ctx, crc32_t *digest)
+{
+    *digest = ~ctx->state;
+}
+
+MX_IMPL void mx_crc32c(crc32c_t *digest, const char *src, size_t length)
+{
+    *digest = ~mx_crc32_call(&mx_crc32c_block, ~0u, (const unsigned char*)src, length);
+}
+
+MX_IMPL void mx_crc32c_init(mx_crc32c_ctx_t *ctx)
+{
+    ctx->state = ~0u;
+}
+
+MX_IMPL void mx_crc32c_update(mx_crc32c_ctx_t *ctx, const char *src, size_t length)
+{
+    ctx->state = mx_crc32_call(&mx_crc32c_block, ctx->state, (const unsigned char*)src, length);
+}
+
+MX_IMPL void mx_crc32c_final(mx_crc32c_ctx_t *ctx, crc32c_t *digest)
+{
+    *digest = ~ctx->state;
+}
+
+/*
+ * CRC combination, after zlib. Appending n zero bytes to a message multiplies
+ * its CRC register by x^(8n) modulo the polynomial, so the CRC of A followed
+ * by B is crc(A) * x^(8|B|) + crc(B). Powers x^(2^k) are tabulated, so this
+ * takes O(log n) multiplications.
+ */
+
+/** Multiply a and b modulo the reflected polynomial. */
+static uint32_t mx_crc32_multmodp(uint32_t a, uint32_t b, uint32_t poly)
+{
+    uint32_t m = 1u << 31, p = 0;
+
+    for (;;)
+    {
+        if (a & m)
+        {
+            p ^= b;
+
+            if ((a & (m - 1)) == 0)
+                break;
+        }
+
+        m >>= 1;
+        b = (b & 1) ? (b >> 1) ^ poly : b >> 1;
+    }
+
+    return p;
+}
+
+/** x^(n * 2^k) modulo the polynomial, with power[k] = x^(2^k). */
+static uint32_t mx_crc32_x2nmodp(const uint32_t power[32], uint64_t n, unsigned k, uint32_t poly)
+{
+    uint32_t p = 1u << 31;
+
+    for (; n > 0; n >>= 1, k++)
+    {
+        if (n & 1)
+            p = mx_crc32_multmodp(power[k & 31], p, poly);
+    }
+
+    return p;
+}
+
+static void mx_crc32_make_powers(uint32_t power[32], uint32_t poly)
+{
+    uint32_t p = 1u << 30;
+
+    for (int k = 0; k < 32; k++)
+    {
+        power[k] = p;
+        p = mx_crc32_multmodp(p, p, poly);
+    }
+}
+
+static uint32_t mx_crc32_combine_poly(uint32_t first, uint32_t second, uint64_t second_length, uint32_t poly)
+{
+    const mx_crc32_tables_t *tables = mx_crc32_get_tables();
+    const uint32_t *power = poly == CRC32_POLY ? tables->crc32_power : tables->crc32c_power;
+    return mx_crc32_multmodp(mx_crc32_x2nmodp(power, second_length, 3, poly), first, poly) ^ second;
+}
+
+MX_IMPL crc32_t mx_crc32_combine(crc32_t first, crc32_t second, uint64_t second_length)
+{
+    return mx_crc32_combine_poly(first, second, second_length, CRC32_POLY);
+}
+
+MX_IMPL crc32c_t mx_crc32c_combine(crc32c_t first, crc32c_t second, uint64_t second_length)
+{
+    return mx_crc32_combine_poly(first, second, second_length, CRC32C_POLY);
+}
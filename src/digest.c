@@ -1,57 +1,797 @@
 #include <mx/digest.h>
+#include <mx/cpu.h>
+#include <stdatomic.h>
 #include <string.h>
 
+#if MX_CPU_X86
+#include <immintrin.h>
+#endif
+
 const uint32_t FVN_BASIS = 0x811c9dc5;
 const uint32_t FVN_PRIME = 0x01000193;
 
+/** Largest prime smaller than 65536. */
+#define ADLER32_BASE 65521u
+/**
+ * Largest n such that 255n(n+1)/2 + (n+1)(BASE-1) <= 2^32-1, i.e. the number
+ * of bytes the sums can take before they must be reduced.
+ */
+#define ADLER32_NMAX 5552u
+
 MX_IMPL int mx_compare_digest(const void* a, const void *b, size_t size)
 {
     return memcmp(a, b, size);
 }
 
-MX_IMPL void mx_adler32(adler32_t *digest, const char *src, size_t length)
+static uint32_t mx_adler32_scalar(uint32_t adler, const unsigned char *src, size_t length)
 {
-    const uint32_t modulo = 65521;
-    uint32_t a = 1, b = 0;
+    uint32_t a = adler & 0xFFFF, b = adler >> 16;
 
-    while (length--)
+    while (length > 0)
     {
-        a = (a + *(src++)) % modulo;
-        b = (a + b)        % modulo;
+        size_t n = length < ADLER32_NMAX ? length : ADLER32_NMAX;
+        length -= n;
+
+        for (; n >= 8; n -= 8, src += 8)
+        {
+            a += src[0]; b += a;
+            a += src[1]; b += a;
+            a += src[2]; b += a;
+            a += src[3]; b += a;
+            a += src[4]; b += a;
+            a += src[5]; b += a;
+            a += src[6]; b += a;
+            a += src[7]; b += a;
+        }
+
+        for (; n > 0; n--)
+        {
+            a += *(src++);
+            b += a;
+        }
+
+        a %= ADLER32_BASE;
+        b %= ADLER32_BASE;
     }
 
-    return (b << 16) | (a << 0);
+    return (b << 16) | a;
+}
+
+#if MX_CPU_X86
+/*
+ * The vector paths split each NMAX block into 32 byte chunks. For a chunk
+ * x[0..31] the sums advance as:
+ *   a' = a + sum(x[i])
+ *   b' = b + 32a + sum((32 - i) * x[i])
+ * The weighted sum is computed with maddubs, the plain sum with sad, and the
+ * 32a terms are accumulated in `prev` and applied once at the block end.
+ */
+
+MX_TARGET("ssse3")
+static uint32_t mx_adler32_ssse3(uint32_t adler, const unsigned char *src, size_t length)
+{
+    uint32_t a = adler & 0xFFFF, b = adler >> 16;
+    size_t chunks = length / 32;
+
+    const __m128i tap1 = _mm_setr_epi8(32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17);
+    const __m128i tap2 = _mm_setr_epi8(16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i ones = _mm_set1_epi16(1);
+
+    length -= chunks * 32;
+
+    while (chunks > 0)
+    {
+        size_t n = chunks < ADLER32_NMAX / 32 ? chunks : ADLER32_NMAX / 32;
+        chunks -= n;
+
+        __m128i prev = _mm_cvtsi32_si128((int)(a * n));
+        __m128i va   = zero;
+        __m128i vb   = _mm_cvtsi32_si128((int)b);
+
+        do
+        {
+            __m128i x1 = _mm_loadu_si128((const __m128i*)(src +  0));
+            __m128i x2 = _mm_loadu_si128((const __m128i*)(src + 16));
+
+            prev = _mm_add_epi32(prev, va);
+
+            va = _mm_add_epi32(va, _mm_sad_epu8(x1, zero));
+            vb = _mm_add_epi32(vb, _mm_madd_epi16(_mm_maddubs_epi16(x1, tap1), ones));
+            va = _mm_add_epi32(va, _mm_sad_epu8(x2, zero));
+            vb = _mm_add_epi32(vb, _mm_madd_epi16(_mm_maddubs_epi16(x2, tap2), ones));
+
+            src += 32;
+        } while (--n);
+
+        vb = _mm_add_epi32(vb, _mm_slli_epi32(prev, 5));
+
+        va = _mm_add_epi32(va, _mm_shuffle_epi32(va, _MM_SHUFFLE(1, 0, 3, 2)));
+        va = _mm_add_epi32(va, _mm_shuffle_epi32(va, _MM_SHUFFLE(2, 3, 0, 1)));
+        vb = _mm_add_epi32(vb, _mm_shuffle_epi32(vb, _MM_SHUFFLE(1, 0, 3, 2)));
+        vb = _mm_add_epi32(vb, _mm_shuffle_epi32(vb, _MM_SHUFFLE(2, 3, 0, 1)));
+
+        a = (a + (uint32_t)_mm_cvtsi128_si32(va)) % ADLER32_BASE;
+        b = (uint32_t)_mm_cvtsi128_si32(vb) % ADLER32_BASE;
+    }
+
+    return mx_adler32_scalar((b << 16) | a, src, length);
+}
+
+MX_TARGET("avx2")
+static uint32_t mx_adler32_avx2(uint32_t adler, const unsigned char *src, size_t length)
+{
+    uint32_t a = adler & 0xFFFF, b = adler >> 16;
+    size_t chunks = length / 32;
+
+    const __m256i tap = _mm256_setr_epi8(
+        32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17,
+        16, 15, 14, 13, 12, 11, 10,  9,  8,  7,  6,  5,  4,  3,  2,  1);
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i ones = _mm256_set1_epi16(1);
+
+    length -= chunks * 32;
+
+    while (chunks > 0)
+    {
+        size_t n = chunks < ADLER32_NMAX / 32 ? chunks : ADLER32_NMAX / 32;
+        chunks -= n;
+
+        __m256i prev = _mm256_zextsi128_si256(_mm_cvtsi32_si128((int)(a * n)));
+        __m256i va   = zero;
+        __m256i vb   = _mm256_zextsi128_si256(_mm_cvtsi32_si128((int)b));
+
+        do
+        {
+            __m256i x = _mm256_loadu_si256((const __m256i*)src);
+
+            prev = _mm256_add_epi32(prev, va);
+            va = _mm256_add_epi32(va, _mm256_sad_epu8(x, zero));
+            vb = _mm256_add_epi32(vb, _mm256_madd_epi16(_mm256_maddubs_epi16(x, tap), ones));
+
+            src += 32;
+        } while (--n);
+
+        vb = _mm256_add_epi32(vb, _mm256_slli_epi32(prev, 5));
+
+        __m128i sa = _mm_add_epi32(_mm256_castsi256_si128(va), _mm256_extracti128_si256(va, 1));
+        __m128i sb = _mm_add_epi32(_mm256_castsi256_si128(vb), _mm256_extracti128_si256(vb, 1));
+
+        sa = _mm_add_epi32(sa, _mm_shuffle_epi32(sa, _MM_SHUFFLE(1, 0, 3, 2)));
+        sa = _mm_add_epi32(sa, _mm_shuffle_epi32(sa, _MM_SHUFFLE(2, 3, 0, 1)));
+        sb = _mm_add_epi32(sb, _mm_shuffle_epi32(sb, _MM_SHUFFLE(1, 0, 3, 2)));
+        sb = _mm_add_epi32(sb, _mm_shuffle_epi32(sb, _MM_SHUFFLE(2, 3, 0, 1)));
+
+        a = (a + (uint32_t)_mm_cvtsi128_si32(sa)) % ADLER32_BASE;
+        b = (uint32_t)_mm_cvtsi128_si32(sb) % ADLER32_BASE;
+    }
+
+    return mx_adler32_scalar((b << 16) | a, src, length);
+}
+#endif
+
+static uint32_t mx_adler32_resolve(uint32_t adler, const unsigned char *src, size_t length);
+
+typedef uint32_t (*mx_adler32_block_function)(uint32_t adler, const unsigned char *src, size_t length);
+
+/**
+ * Adler-32 block function, selected on first use. The block functions need
+ * no setup, so threads racing to select one only need the store to be atomic.
+ */
+static _Atomic(mx_adler32_block_function) mx_adler32_block = mx_adler32_resolve;
+
+static uint32_t mx_adler32_update_block(uint32_t adler, const unsigned char *src, size_t length)
+{
+    return atomic_load_explicit(&mx_adler32_block, memory_order_relaxed)(adler, src, length);
+}
+
+static uint32_t mx_adler32_resolve(uint32_t adler, const unsigned char *src, size_t length)
+{
+    mx_adler32_block_function block = mx_adler32_scalar;
+#if MX_CPU_X86
+    if (mx_cpu_has(MX_CPU_AVX2))
+        block = mx_adler32_avx2;
+    else if (mx_cpu_has(MX_CPU_SSSE3))
+        block = mx_adler32_ssse3;
+#endif
+    atomic_store_explicit(&mx_adler32_block, block, memory_order_relaxed);
+    return block(adler, src, length);
+}
+
+MX_IMPL void mx_adler32(adler32_t *digest, const char *src, size_t length)
+{
+    *digest = mx_adler32_update_block(1, (const unsigned char*)src, length);
+}
+
+MX_IMPL void mx_adler32_init(mx_adler32_ctx_t *ctx)
+{
+    ctx->state = 1;
+}
+
+MX_IMPL void mx_adler32_update(mx_adler32_ctx_t *ctx, const char *src, size_t length)
+{
+    ctx->state = mx_adler32_update_block(ctx->state, (const unsigned char*)src, length);
+}
+
+MX_IMPL void mx_adler32_final(mx_adler32_ctx_t *ctx, adler32_t *digest)
+{
+    *digest = ctx->state;
 }
 
 MX_IMPL void mx_fvn0(fvn0_t *digest, const char *src, size_t length)
 {
-    *digest = 0;
+    mx_fvn0_ctx_t ctx;
+    mx_fvn0_init(&ctx);
+    mx_fvn0_update(&ctx, src, length);
+    mx_fvn0_final(&ctx, digest);
+}
+
+MX_IMPL void mx_fvn0_init(mx_fvn0_ctx_t *ctx)
+{
+    ctx->state = 0;
+}
+
+MX_IMPL void mx_fvn0_update(mx_fvn0_ctx_t *ctx, const char *src, size_t length)
+{
+    fvn0_t hash = ctx->state;
 
     for (size_t i = 0; i < length; i++)
     {
-        *digest *= FVN_PRIME;
-        *digest ^= (fvn0_t)src[i];
+        hash *= FVN_PRIME;
+        hash ^= (fvn0_t)src[i];
     }
+
+    ctx->state = hash;
+}
+
+MX_IMPL void mx_fvn0_final(mx_fvn0_ctx_t *ctx, fvn0_t *digest)
+{
+    *digest = ctx->state;
 }
 
 MX_IMPL void mx_fvn1(fvn1_t    *digest, const char *src, size_t length)
 {
-    *digest = FVN_BASIS;
+    mx_fvn1_ctx_t ctx;
+    mx_fvn1_init(&ctx);
+    mx_fvn1_update(&ctx, src, length);
+    mx_fvn1_final(&ctx, digest);
+}
+
+MX_IMPL void mx_fvn1_init(mx_fvn1_ctx_t *ctx)
+{
+    ctx->state = FVN_BASIS;
+}
+
+MX_IMPL void mx_fvn1_update(mx_fvn1_ctx_t *ctx, const char *src, size_t length)
+{
+    fvn1_t hash = ctx->state;
 
     for (size_t i = 0; i < length; i++)
     {
-        *digest *= FVN_PRIME;
-        *digest ^= src[i];
+        hash *= FVN_PRIME;
+        hash ^= src[i];
     }
+
+    ctx->state = hash;
+}
+
+MX_IMPL void mx_fvn1_final(mx_fvn1_ctx_t *ctx, fvn1_t *digest)
+{
+    *digest = ctx->state;
 }
 
 MX_IMPL void mx_fvn1a(fvn1a_t   *digest, const char *src, size_t length)
 {
-    *digest = FVN_BASIS;
+    mx_fvn1a_ctx_t ctx;
+    mx_fvn1a_init(&ctx);
+    mx_fvn1a_update(&ctx, src, length);
+    mx_fvn1a_final(&ctx, digest);
+}
+
+MX_IMPL void mx_fvn1a_init(mx_fvn1a_ctx_t *ctx)
+{
+    ctx->state = FVN_BASIS;
+}
+
+MX_IMPL void mx_fvn1a_update(mx_fvn1a_ctx_t *ctx, const char *src, size_t length)
+{
+    fvn1a_t hash = ctx->state;
 
     for (size_t i = 0; i < length; i++)
     {
-        *digest ^= src[i];
-        *digest *= FVN_PRIME;
+        hash ^= src[i];
+        hash *= FVN_PRIME;
+    }
+
+    ctx->state = hash;
+}
+
+MX_IMPL void mx_fvn1a_final(mx_fvn1a_ctx_t *ctx, fvn1a_t *digest)
+{
+    *digest = ctx->state;
+}
+
+/*
+ * Batched digests. Messages are interleaved across lanes, each lane hashing
+ * one message, so the per byte dependency chains of several messages overlap.
+ * Lanes advance in lockstep, so each batch is first ordered by length to put
+ * messages of equal length side by side. Lanes that run out early are masked.
+ */
+
+/** Number of messages ordered by length at a time. */
+#define MX_MULTI_CHUNK 512
+
+/** Lengths at or above this are not told apart when ordering by length. */
+#define MX_MULTI_BUCKETS 256
+
+/** Number of messages hashed side by side by the scalar batched digests. */
+#define MX_MULTI_LANES 4
+
+/** Messages longer than this are hashed alone over the Adler-32 vector path. */
+#define ADLER32_MULTI_MAX 256
+
+/** The lane kernels must be specialized for each digest to be fast. */
+#if defined(__GNUC__) || defined(__clang__)
+    #define MX_MULTI_INLINE MX_INLINE __attribute__((always_inline))
+#else
+    #define MX_MULTI_INLINE MX_INLINE
+#endif
+
+/** The digests with batched implementations. */
+typedef enum mx_multi_kind
+{
+    MX_MULTI_FVN0,
+    MX_MULTI_FVN1,
+    MX_MULTI_FVN1A,
+    MX_MULTI_ADLER32,
+} mx_multi_kind;
+
+/** The lane state of a digest, h is the FVN hash or the Adler-32 a sum. */
+typedef struct mx_multi_lane_t
+{
+    uint32_t h, b;
+} mx_multi_lane_t;
+
+MX_MULTI_INLINE mx_multi_lane_t mx_multi_begin(mx_multi_kind kind)
+{
+    return (mx_multi_lane_t){ kind == MX_MULTI_FVN0 ? 0 : kind == MX_MULTI_ADLER32 ? 1 : FVN_BASIS, 0 };
+}
+
+MX_MULTI_INLINE void mx_multi_step(mx_multi_lane_t *lane, char c, mx_multi_kind kind)
+{
+    switch (kind)
+    {
+    case MX_MULTI_FVN0:
+    case MX_MULTI_FVN1:   lane->h = (lane->h * FVN_PRIME) ^ c; break;
+    case MX_MULTI_FVN1A:  lane->h = (lane->h ^ c) * FVN_PRIME; break;
+    case MX_MULTI_ADLER32:
+        lane->h += (unsigned char)c;
+        lane->b += lane->h;
+        break;
+    }
+}
+
+MX_MULTI_INLINE uint32_t mx_multi_end(mx_multi_lane_t lane, mx_multi_kind kind)
+{
+    if (kind == MX_MULTI_ADLER32)
+        return ((lane.b % ADLER32_BASE) << 16) | (lane.h % ADLER32_BASE);
+
+    return lane.h;
+}
+
+MX_MULTI_INLINE void mx_multi_scalar(uint32_t *digests, const char *const *src, const size_t *length, size_t count, mx_multi_kind kind)
+{
+    size_t i = 0;
+
+    for (; i + MX_MULTI_LANES <= count; i += MX_MULTI_LANES)
+    {
+        const char *const *p = &src[i];
+        mx_multi_lane_t s[MX_MULTI_LANES];
+        size_t common = length[i];
+
+        for (int l = 0; l < MX_MULTI_LANES; l++)
+        {
+            s[l] = mx_multi_begin(kind);
+
+            if (length[i + l] < common)
+                common = length[i + l];
+        }
+
+        for (size_t k = 0; k < common; k++)
+        {
+            mx_multi_step(&s[0], p[0][k], kind);
+            mx_multi_step(&s[1], p[1][k], kind);
+            mx_multi_step(&s[2], p[2][k], kind);
+            mx_multi_step(&s[3], p[3][k], kind);
+        }
+
+        for (int l = 0; l < MX_MULTI_LANES; l++)
+        {
+            for (size_t k = common; k < length[i + l]; k++)
+                mx_multi_step(&s[l], p[l][k], kind);
+
+            digests[i + l] = mx_multi_end(s[l], kind);
+        }
+    }
+
+    for (; i < count; i++)
+    {
+        mx_multi_lane_t s = mx_multi_begin(kind);
+
+        for (size_t k = 0; k < length[i]; k++)
+            mx_multi_step(&s, src[i][k], kind);
+
+        digests[i] = mx_multi_end(s, kind);
+    }
+}
+
+/* The AVX2 lanes load and gather through 64-bit message pointers. */
+#if defined(__x86_64__) || defined(_M_X64)
+    #define MX_MULTI_AVX2 1
+#else
+    #define MX_MULTI_AVX2 0
+#endif
+
+#if MX_MULTI_AVX2
+/** Messages per AVX2 group. Two vectors keep the multiplier busy. */
+#define MX_MULTI_AVX2_LANES 16
+
+MX_TARGET("avx2")
+MX_MULTI_INLINE void mx_multi_step_avx2(__m256i *h, __m256i *b, __m256i x, int j, mx_multi_kind kind)
+{
+    const __m256i prime = _mm256_set1_epi32((int)FVN_PRIME);
+    __m256i c;
+
+    switch (kind)
+    {
+    case MX_MULTI_FVN0:
+    case MX_MULTI_FVN1:
+        /* Sign extend the byte, as the scalar versions do with char. */
+        c  = _mm256_srai_epi32(_mm256_slli_epi32(x, 24 - 8 * j), 24);
+        *h = _mm256_xor_si256(_mm256_mullo_epi32(*h, prime), c);
+        break;
+    case MX_MULTI_FVN1A:
+        c  = _mm256_srai_epi32(_mm256_slli_epi32(x, 24 - 8 * j), 24);
+        *h = _mm256_mullo_epi32(_mm256_xor_si256(*h, c), prime);
+        break;
+    case MX_MULTI_ADLER32:
+        c  = _mm256_and_si256(_mm256_srli_epi32(x, 8 * j), _mm256_set1_epi32(0xFF));
+        *h = _mm256_add_epi32(*h, c);
+        *b = _mm256_add_epi32(*b, *h);
+        break;
+    }
+}
+
+/**
+ * Hash 16 messages at a time in two vectors of eight 32 bit lanes. Four
+ * bytes of every message are gathered per step. Past the shortest message,
+ * lanes that have run out are masked so they keep their state.
+ */
+MX_TARGET("avx2")
+MX_MULTI_INLINE void mx_multi_avx2(uint32_t *digests, const char *const *src, const size_t *length, size_t count, mx_multi_kind kind)
+{
+    for (; count >= MX_MULTI_AVX2_LANES; count -= MX_MULTI_AVX2_LANES)
+    {
+        size_t common = SIZE_MAX, longest = 0;
+        int32_t lens[MX_MULTI_AVX2_LANES];
+
+        for (int l = 0; l < MX_MULTI_AVX2_LANES; l++)
+        {
+            if (length[l] < common) common = length[l];
+            if (length[l] > longest) longest = length[l];
+            lens[l] = (int32_t)length[l];
+        }
+
+        if (longest > INT32_MAX)
+            break;
+
+        mx_multi_lane_t init = mx_multi_begin(kind);
+        __m256i h[2], b[2], len[2];
+
+        for (int v = 0; v < 2; v++)
+        {
+            h[v] = _mm256_set1_epi32((int)init.h);
+            b[v] = _mm256_setzero_si256();
+            len[v] = _mm256_loadu_si256((const __m256i*)&lens[8 * v]);
+        }
+
+        __m256i ptr[4];
+
+        for (int q = 0; q < 4; q++)
+            ptr[q] = _mm256_loadu_si256((const __m256i*)&src[4 * q]);
+
+        for (size_t k = 0; k < longest; k += 4)
+        {
+            __m256i words[2];
+
+            if (k + 4 <= common)
+            {
+                /* Gather four bytes from each message, addressing by pointer. */
+                __m256i offset = _mm256_set1_epi64x((long long)k);
+
+                for (int v = 0; v < 2; v++)
+                {
+                    __m128i lo = _mm256_i64gather_epi32(NULL, _mm256_add_epi64(ptr[2 * v], offset), 1);
+                    __m128i hi = _mm256_i64gather_epi32(NULL, _mm256_add_epi64(ptr[2 * v + 1], offset), 1);
+                    words[v] = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+                }
+            }
+            else
+            {
+                uint32_t w[MX_MULTI_AVX2_LANES];
+
+                for (int l = 0; l < MX_MULTI_AVX2_LANES; l++)
+                {
+                    size_t n = length[l] > k ? length[l] - k : 0;
+                    w[l] = 0;
+                    memcpy(&w[l], src[l] + k, n < 4 ? n : 4);
+                }
+
+                words[0] = _mm256_loadu_si256((const __m256i*)&w[0]);
+                words[1] = _mm256_loadu_si256((const __m256i*)&w[8]);
+            }
+
+            for (int v = 0; v < 2; v++)
+            {
+                __m256i x = words[v];
+
+                for (int j = 0; j < 4; j++)
+                {
+                    if (k + j < common)
+                    {
+                        mx_multi_step_avx2(&h[v], &b[v], x, j, kind);
+                    }
+                    else
+                    {
+                        __m256i nh = h[v], nb = b[v];
+                        __m256i live = _mm256_cmpgt_epi32(len[v], _mm256_set1_epi32((int)(k + j)));
+                        mx_multi_step_avx2(&nh, &nb, x, j, kind);
+                        h[v] = _mm256_blendv_epi8(h[v], nh, live);
+                        b[v] = _mm256_blendv_epi8(b[v], nb, live);
+                    }
+                }
+            }
+        }
+
+        for (int v = 0; v < 2; v++)
+        {
+            if (kind == MX_MULTI_ADLER32)
+            {
+                mx_multi_lane_t s[8];
+                uint32_t hs[8], bs[8];
+                _mm256_storeu_si256((__m256i*)hs, h[v]);
+                _mm256_storeu_si256((__m256i*)bs, b[v]);
+
+                for (int l = 0; l < 8; l++)
+                {
+                    s[l] = (mx_multi_lane_t){ hs[l], bs[l] };
+                    digests[8 * v + l] = mx_multi_end(s[l], kind);
+                }
+            }
+            else
+            {
+                _mm256_storeu_si256((__m256i*)&digests[8 * v], h[v]);
+            }
+        }
+
+        digests += MX_MULTI_AVX2_LANES;
+        src += MX_MULTI_AVX2_LANES;
+        length += MX_MULTI_AVX2_LANES;
+    }
+
+    mx_multi_scalar(digests, src, length, count, kind);
+}
+
+MX_TARGET("avx2")
+static void mx_multi_avx2_fvn0(uint32_t *digests, const char *const *src, const size_t *length, size_t count)
+{
+    mx_multi_avx2(digests, src, length, count, MX_MULTI_FVN0);
+}
+
+MX_TARGET("avx2")
+static void mx_multi_avx2_fvn1(uint32_t *digests, const char *const *src, const size_t *length, size_t count)
+{
+    mx_multi_avx2(digests, src, length, count, MX_MULTI_FVN1);
+}
+
+MX_TARGET("avx2")
+static void mx_multi_avx2_fvn1a(uint32_t *digests, const char *const *src, const size_t *length, size_t count)
+{
+    mx_multi_avx2(digests, src, length, count, MX_MULTI_FVN1A);
+}
+
+MX_TARGET("avx2")
+static void mx_multi_avx2_adler32(uint32_t *digests, const char *const *src, const size_t *length, size_t count)
+{
+    mx_multi_avx2(digests, src, length, count, MX_MULTI_ADLER32);
+}
+#endif
+
+static void mx_multi_scalar_fvn0(uint32_t *digests, const char *const *src, const size_t *length, size_t count)
+{
+    mx_multi_scalar(digests, src, length, count, MX_MULTI_FVN0);
+}
+
+static void mx_multi_scalar_fvn1(uint32_t *digests, const char *const *src, const size_t *length, size_t count)
+{
+    mx_multi_scalar(digests, src, length, count, MX_MULTI_FVN1);
+}
+
+static void mx_multi_scalar_fvn1a(uint32_t *digests, const char *const *src, const size_t *length, size_t count)
+{
+    mx_multi_scalar(digests, src, length, count, MX_MULTI_FVN1A);
+}
+
+static void mx_multi_scalar_adler32(uint32_t *digests, const char *const *src, const size_t *length, size_t count)
+{
+    mx_multi_scalar(digests, src, length, count, MX_MULTI_ADLER32);
+}
+
+typedef void (*mx_multi_lanes_function)(uint32_t *digests, const char *const *src, const size_t *length, size_t count);
+
+/**
+ * Order the messages by length in chunks, hash each chunk over the lanes and
+ * put the digests back in the original order.
+ */
+static void mx_multi(uint32_t *digests, const char *const *src, const size_t *length, size_t count, mx_multi_kind kind)
+{
+    static const mx_multi_lanes_function scalar[] = {
+        mx_multi_scalar_fvn0, mx_multi_scalar_fvn1, mx_multi_scalar_fvn1a, mx_multi_scalar_adler32
+    };
+    mx_multi_lanes_function lanes = scalar[kind];
+
+#if MX_MULTI_AVX2
+    static const mx_multi_lanes_function avx2[] = {
+        mx_multi_avx2_fvn0, mx_multi_avx2_fvn1, mx_multi_avx2_fvn1a, mx_multi_avx2_adler32
+    };
+
+    if (mx_cpu_has(MX_CPU_AVX2))
+        lanes = avx2[kind];
+#endif
+
+    const char *sorted_src[MX_MULTI_CHUNK];
+    size_t sorted_length[MX_MULTI_CHUNK];
+    uint32_t sorted_digests[MX_MULTI_CHUNK];
+    uint16_t order[MX_MULTI_CHUNK];
+    uint16_t start[MX_MULTI_BUCKETS + 1];
+
+    for (size_t base = 0; base < count; base += MX_MULTI_CHUNK)
+    {
+        size_t n = count - base < MX_MULTI_CHUNK ? count - base : MX_MULTI_CHUNK;
+        size_t m = 0;
+        bool uniform = true;
+
+        for (size_t i = 1; i < n && uniform; i++)
+            uniform = length[base + i] == length[base];
+
+        /* Skip the ordering when there is nothing to order. */
+        if (uniform && (kind != MX_MULTI_ADLER32 || length[base] <= ADLER32_MULTI_MAX))
+        {
+            lanes(&digests[base], &src[base], &length[base], n);
+            continue;
+        }
+
+        memset(start, 0, sizeof start);
+
+        for (size_t i = 0; i < n; i++)
+        {
+            size_t len = length[base + i];
+
+            if (kind == MX_MULTI_ADLER32 && len > ADLER32_MULTI_MAX)
+            {
+                mx_adler32(&digests[base + i], src[base + i], len);
+                continue;
+            }
+
+            start[(len < MX_MULTI_BUCKETS ? len : MX_MULTI_BUCKETS - 1) + 1]++;
+        }
+
+        for (int k = 0; k < MX_MULTI_BUCKETS; k++)
+            start[k + 1] += start[k];
+
+        for (size_t i = 0; i < n; i++)
+        {
+            size_t len = length[base + i];
+
+            if (kind == MX_MULTI_ADLER32 && len > ADLER32_MULTI_MAX)
+                continue;
+
+            uint16_t at = start[len < MX_MULTI_BUCKETS ? len : MX_MULTI_BUCKETS - 1]++;
+            order[at] = (uint16_t)i;
+            sorted_src[at] = src[base + i];
+            sorted_length[at] = len;
+            m++;
+        }
+
+        lanes(sorted_digests, sorted_src, sorted_length, m);
+
+        for (size_t i = 0; i < m; i++)
+            digests[base + order[i]] = sorted_digests[i];
     }
-}
\ No newline at end of file
+}
+
+MX_IMPL void mx_adler32_multi(adler32_t *digests, const char *const *src, const size_t *length, size_t count)
+{
+    mx_multi(digests, src, length, count, MX_MULTI_ADLER32);
+}
+
+MX_IMPL void mx_fvn0_multi(fvn0_t *digests, const char *const *src, const size_t *length, size_t count)
+{
+    mx_multi(digests, src, length, count, MX_MULTI_FVN0);
+}
+
+MX_IMPL void mx_fvn1_multi(fvn1_t *digests, const char *const *src, const size_t *length, size_t count)
+{
+    mx_multi(digests, src, length, count, MX_MULTI_FVN1);
+}
+
+MX_IMPL void mx_fvn1a_multi(fvn1a_t *digests, const char *const *src, const size_t *length, size_t count)
+{
+    mx_multi(digests, src, length, count, MX_MULTI_FVN1A);
+}
+
+MX_IMPL adler32_t mx_adler32_combine(adler32_t first, adler32_t second, uint64_t second_length)
+{
+    uint32_t rem = (uint32_t)(second_length % ADLER32_BASE);
+    uint32_t a = first & 0xFFFF;
+    uint32_t b = (uint32_t)(((uint64_t)rem * a) % ADLER32_BASE);
+
+    /* a = a1 + a2 - 1, b = b1 + b2 + rem * a1 - rem, all mod BASE. */
+    a += (second & 0xFFFF) + ADLER32_BASE - 1;
+    b += (first >> 16) + (second >> 16) + ADLER32_BASE - rem;
+
+    if (a >= ADLER32_BASE) a -= ADLER32_BASE;
+    if (a >= ADLER32_BASE) a -= ADLER32_BASE;
+    if (b >= ADLER32_BASE * 2) b -= ADLER32_BASE * 2;
+    if (b >= ADLER32_BASE) b -= ADLER32_BASE;
+
+    return (b << 16) | a;
+}
+
+static void mx_adler32_combine_digest(adler32_t *digest, const adler32_t *next, uint64_t next_length)
+{
+    *digest = mx_adler32_combine(*digest, *next, next_length);
+}
+
+static void mx_crc32_combine_digest(crc32_t *digest, const crc32_t *next, uint64_t next_length)
+{
+    *digest = mx_crc32_combine(*digest, *next, next_length);
+}
+
+static void mx_crc32c_combine_digest(crc32c_t *digest, const crc32c_t *next, uint64_t next_length)
+{
+    *digest = mx_crc32c_combine(*digest, *next, next_length);
+}
+
+#define MX_DIGEST_ALGORITHM(algo, batch, join) { \
+    .name         = #algo, \
+    .digest_size  = sizeof(algo##_t), \
+    .context_size = sizeof(mx_##algo##_ctx_t), \
+    .digest       = (mx_digest_function)mx_##algo, \
+    .init         = (void*)mx_##algo##_init, \
+    .update       = (void*)mx_##algo##_update, \
+    .final        = (void*)mx_##algo##_final, \
+    .multi        = (void*)batch, \
+    .combine      = (void*)join, \
+}
+
+const mx_digest_algorithm_t mx_digest_adler32 = MX_DIGEST_ALGORITHM(adler32, mx_adler32_multi, mx_adler32_combine_digest);
+const mx_digest_algorithm_t mx_digest_fvn0    = MX_DIGEST_ALGORITHM(fvn0,    mx_fvn0_multi,    NULL);
+const mx_digest_algorithm_t mx_digest_fvn1    = MX_DIGEST_ALGORITHM(fvn1,    mx_fvn1_multi,    NULL);
+const mx_digest_algorithm_t mx_digest_fvn1a   = MX_DIGEST_ALGORITHM(fvn1a,   mx_fvn1a_multi,   NULL);
+const mx_digest_algorithm_t mx_digest_crc32   = MX_DIGEST_ALGORITHM(crc32,   NULL,             mx_crc32_combine_digest);
+const mx_digest_algorithm_t mx_digest_crc32c  = MX_DIGEST_ALGORITHM(crc32c,  NULL,             mx_crc32c_combine_digest);
+const mx_digest_algorithm_t mx_digest_sha256  = MX_DIGEST_ALGORITHM(sha256,  mx_sha256_multi,  NULL);
+const mx_digest_algorithm_t mx_digest_wyhash64 = MX_DIGEST_ALGORITHM(wyhash64, NULL,            NULL);
+
+MX_IMPL void mx_digest_multi(const mx_digest_algorithm_t *algorithm, void *digests, const char *const *src, const size_t *length, size_t count)
+{
+    if (algorithm->multi)
+    {
+        algorithm->multi(digests, src, length, count);
+        return;
+    }
+
+    for (size_t i = 0; i < count; i++)
+        algorithm->digest((char*)digests + i * algorithm->digest_size, src[i], length[i]);
+}
@@ -0,0 +1,305 @@
+#include "mx/io/digest_stream.h"
+#include "mx/thread.h"
+#include "mx/assert.h"
+#include <stdlib.h>
+#include <string.h>
+
+/** Chunk size used when none is given. */
+#define MX_DIGEST_CHUNK_DEFAULT (4u << 20)
+/** Largest chunk, bounding the memory of the slots. */
+#define MX_DIGEST_CHUNK_MAX     (1u << 30)
+/** Slots per worker, so reading can run ahead of hashing. */
+#define MX_DIGEST_SLOTS         2
+
+typedef enum mx_digest_slot_state
+{
+    MX_DIGEST_SLOT_EMPTY,   /**< Free for the reader. */
+    MX_DIGEST_SLOT_FILLED,  /**< Holds a chunk waiting to be hashed. */
+    MX_DIGEST_SLOT_HASHING, /**< Owned by a worker. */
+    MX_DIGEST_SLOT_DONE,    /**< Holds the digest of its chunk. */
+} mx_digest_slot_state;
+
+typedef struct mx_digest_slot_t {
+    char *buffer;           /**< NULL when chunks are borrowed from the stream. */
+    const char *data;       /**< The chunk, in buffer or borrowed. */
+    size_t length;
+    uint64_t index;
+    mx_digest_slot_state state;
+    uint64_t digest[8];
+} mx_digest_slot_t;
+
+typedef struct mx_digest_job_t {
+    const mx_digest_algorithm_t *algorithm;
+    mx_digest_slot_t *slots;
+    size_t nslots;
+    bool stop;
+    mx_mutex_t mutex;
+    mx_cond_t work;         /**< Signaled when a slot is filled, or on stop. */
+    mx_cond_t done;         /**< Signaled when a slot is hashed. */
+} mx_digest_job_t;
+
+static void mx_digest_worker(mx_digest_job_t *job)
+{
+    mx_mutex_lock(&job->mutex);
+
+    for (;;)
+    {
+        mx_digest_slot_t *slot = NULL;
+
+        /* Take the oldest filled chunk, so results complete roughly in order. */
+        for (size_t i = 0; i < job->nslots; i++)
+        {
+            mx_digest_slot_t *s = &job->slots[i];
+
+            if (s->state == MX_DIGEST_SLOT_FILLED && (!slot || s->index < slot->index))
+                slot = s;
+        }
+
+        if (!slot)
+        {
+            if (job->stop)
+                break;
+
+            mx_cond_wait(&job->work, &job->mutex);
+            continue;
+        }
+
+        slot->state = MX_DIGEST_SLOT_HASHING;
+        mx_mutex_unlock(&job->mutex);
+
+        job->algorithm->digest(slot->digest, slot->data, slot->length);
+
+        mx_mutex_lock(&job->mutex);
+        slot->state = MX_DIGEST_SLOT_DONE;
+        mx_cond_signal(&job->done);
+    }
+
+    mx_mutex_unlock(&job->mutex);
+}
+
+/** Read until max bytes are read or the stream ends. Negative on a read error. */
+static mx_len_t mx_digest_read_chunk(fatptr_t(IStream) str, char *buffer, size_t max)
+{
+    size_t total = 0;
+
+    while (total < max)
+    {
+        mx_len_t n = IStream_read(str, buffer + total, (mx_len_t)(max - total));
+
+        if (n < 0)
+            return n;
+        if (n == 0)
+            break;
+
+        total += (size_t)n;
+    }
+
+    return (mx_len_t)total;
+}
+
+/** True if the stream lends its memory, so chunks need no buffers. */
+static bool mx_digest_can_borrow(fatptr_t(IStream) str)
+{
+    const char *data;
+    return IStream_borrow(str, &data, 0) >= 0;
+}
+
+/** Get the next chunk, borrowed or read into buffer. Negative on a read error. */
+static mx_len_t mx_digest_next_chunk(fatptr_t(IStream) str, char *buffer, size_t max, const char **data)
+{
+    if (!buffer)
+        return IStream_borrow(str, data, (mx_len_t)max);
+
+    *data = buffer;
+    return mx_digest_read_chunk(str, buffer, max);
+}
+
+static bool mx_digest_istream_sequential(fatptr_t(IStream) str, const mx_digest_algorithm_t *algorithm, void *digest, size_t chunk_size)
+{
+    char *buffer = NULL;
+
+    if (!mx_digest_can_borrow(str) && !(buffer = malloc(chunk_size)))
+        return false;
+
+    mx_digest_ctx_t ctx;
+    const char *data;
+    mx_len_t n;
+
+    algorithm->init(&ctx);
+
+    while ((n = mx_digest_next_chunk(str, buffer, chunk_size, &data)) > 0)
+        algorithm->update(&ctx, data, (size_t)n);
+
+    algorithm->final(&ctx, digest);
+    free(buffer);
+    return n == 0;
+}
+
+/**
+ * Combine finished chunks into the result, in input order. Called with the
+ * mutex held.
+ */
+static void mx_digest_collect(mx_digest_job_t *job, void *digest, uint64_t *next)
+{
+    for (;;)
+    {
+        mx_digest_slot_t *slot = &job->slots[*next % job->nslots];
+
+        if (slot->state != MX_DIGEST_SLOT_DONE || slot->index != *next)
+            return;
+
+        if (*next == 0)
+            memcpy(digest, slot->digest, job->algorithm->digest_size);
+        else
+            job->algorithm->combine(digest, slot->digest, slot->length);
+
+        slot->state = MX_DIGEST_SLOT_EMPTY;
+        (*next)++;
+    }
+}
+
+MX_IMPL bool mx_digest_istream(fatptr_t(IStream) str, const mx_digest_algorithm_t *algorithm, void *digest, unsigned threads, size_t chunk_size)
+{
+    MX_ASSERT_PTR(str.ptr, "Stream must be valid.");
+    MX_ASSERT_PTR(algorithm, "Algorithm must be valid.");
+    MX_ASSERT_PTR(digest, "Digest must be valid.");
+
+    if (chunk_size == 0)
+        chunk_size = MX_DIGEST_CHUNK_DEFAULT;
+    if (chunk_size > MX_DIGEST_CHUNK_MAX)
+        chunk_size = MX_DIGEST_CHUNK_MAX;
+    if (threads == 0)
+        threads = mx_thread_concurrency();
+
+    if (threads <= 1 || !algorithm->combine)
+        return mx_digest_istream_sequential(str, algorithm, digest, chunk_size);
+
+    mx_digest_job_t job = {
+        .algorithm = algorithm,
+        .nslots = (size_t)threads * MX_DIGEST_SLOTS,
+    };
+
+    MX_ASSERT(algorithm->digest_size <= sizeof(job.slots->digest), "Digest does not fit a chunk slot.");
+
+    job.slots = calloc(job.nslots, sizeof(mx_digest_slot_t));
+    if (!job.slots)
+        return false;
+
+    bool borrow = mx_digest_can_borrow(str);
+
+    for (size_t i = 0; i < job.nslots && !borrow; i++)
+    {
+        if (!(job.slots[i].buffer = malloc(chunk_size)))
+        {
+            while (i-- > 0)
+                free(job.slots[i].buffer);
+
+            free(job.slots);
+            return false;
+        }
+    }
+
+    mx_mutex_init(&job.mutex);
+    mx_cond_init(&job.work);
+    mx_cond_init(&job.done);
+
+    mx_thread_t *workers = malloc(threads * sizeof(mx_thread_t));
+    unsigned started = 0;
+
+    if (workers)
+    {
+        while (started < threads && mx_thread_create(&workers[started], (mx_thread_function)mx_digest_worker, &job))
+            started++;
+    }
+
+    bool ok = started > 0;
+    uint64_t filled = 0, combined = 0;
+
+    while (ok)
+    {
+        mx_digest_slot_t *slot = &job.slots[filled % job.nslots];
+
+        /* Wait for the slot to be free, combining results meanwhile. */
+        mx_mutex_lock(&job.mutex);
+        mx_digest_collect(&job, digest, &combined);
+
+        while (slot->state != MX_DIGEST_SLOT_EMPTY)
+        {
+            mx_cond_wait(&job.done, &job.mutex);
+            mx_digest_collect(&job, digest, &combined);
+        }
+
+        mx_mutex_unlock(&job.mutex);
+
+        /* The slot is not visible to workers while empty, read without the lock. */
+        mx_len_t n = mx_digest_next_chunk(str, slot->buffer, chunk_size, &slot->data);
+
+        if (n <= 0)
+        {
+            ok = n == 0;
+            break;
+        }
+
+        mx_mutex_lock(&job.mutex);
+        slot->length = (size_t)n;
+        slot->index = filled++;
+        slot->state = MX_DIGEST_SLOT_FILLED;
+        mx_cond_signal(&job.work);
+        mx_mutex_unlock(&job.mutex);
+
+        /* A short read is the end, a short borrow need not be. */
+        if ((size_t)n < chunk_size && !borrow)
+            break;
+    }
+
+    /* Drain the remaining chunks, then stop the workers. */
+    mx_mutex_lock(&job.mutex);
+
+    while (ok && combined < filled)
+    {
+        mx_digest_collect(&job, digest, &combined);
+
+        if (combined < filled)
+            mx_cond_wait(&job.done, &job.mutex);
+    }
+
+    job.stop = true;
+    mx_cond_broadcast(&job.work);
+    mx_mutex_unlock(&job.mutex);
+
+    for (unsigned i = 0; i < started; i++)
+        mx_thread_join(workers[i]);
+
+    if (ok && filled == 0)
+        algorithm->digest(digest, "", 0);
+
+    for (size_t i = 0; i < job.nslots; i++)
+        free(job.slots[i].buffer);
+
+    free(job.slots);
+    free(workers);
+    mx_cond_destroy(&job.done);
+    mx_cond_destroy(&job.work);
+    mx_mutex_destroy(&job.mutex);
+
+    /* Nothing was read if no worker could be started. */
+    if (!started)
+        return mx_digest_istream_sequential(str, algorithm, digest, chunk_size);
+
+    return ok;
+}
+
+MX_IMPL bool mx_digest_file(const char *path, const mx_digest_algorithm_t *algorithm, void *digest, unsigned threads, size_t chunk_size)
+{
+    MX_ASSERT_PTR(path, "Path must be valid.");
+
+    /* Hash straight from the page cache where the file can be mapped. */
+    fatptr_t(IStream) str = mx_open(path, MX_OPEN_READ | MX_OPEN_MMAP | MX_OPEN_SEQUENTIAL);
+
+    if (!str.ptr)
+        return false;
+
+    bool ok = mx_digest_istream(str, algorithm, digest, threads, chunk_size);
+    IObject_destruct(IStream_AsIObject(str));
+    return ok;
+}
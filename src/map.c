@@ -0,0 +1,384 @@
+#include "mx/map.h"
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define MX_MAP_SSE2 1
+    #include <emmintrin.h>
+#else
+    #define MX_MAP_SSE2 0
+#endif
+
+/** Number of control bytes probed at once. */
+#define MX_MAP_GROUP    16
+/** Smallest capacity of a map. */
+#define MX_MAP_MIN      16
+
+/** Control byte of a slot that was never used. */
+#define MX_MAP_EMPTY    ((int8_t)-128)
+/** Control byte of a slot whose entry was erased. */
+#define MX_MAP_DELETED  ((int8_t)-2)
+
+/*
+ * Slots are probed a group of 16 control bytes at a time, starting at any
+ * slot. The first 16 control bytes are repeated after the last, so a group
+ * never has to wrap around.
+ */
+
+#if MX_MAP_SSE2
+typedef __m128i mx_map_group_t;
+
+static mx_map_group_t mx_map_group_load(const int8_t *ctrl)
+{
+    return _mm_loadu_si128((const __m128i*)ctrl);
+}
+
+/** Bit mask of the bytes in the group equal to h2. */
+static uint32_t mx_map_group_match(mx_map_group_t group, int8_t h2)
+{
+    return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(h2)));
+}
+
+static uint32_t mx_map_group_empty(mx_map_group_t group)
+{
+    return mx_map_group_match(group, MX_MAP_EMPTY);
+}
+
+/** Empty and deleted slots are the only control bytes with the top bit set. */
+static uint32_t mx_map_group_free(mx_map_group_t group)
+{
+    return (uint32_t)_mm_movemask_epi8(group);
+}
+#else
+typedef struct { int8_t ctrl[MX_MAP_GROUP]; } mx_map_group_t;
+
+static mx_map_group_t mx_map_group_load(const int8_t *ctrl)
+{
+    mx_map_group_t group;
+    memcpy(group.ctrl, ctrl, MX_MAP_GROUP);
+    return group;
+}
+
+static uint32_t mx_map_group_match(mx_map_group_t group, int8_t h2)
+{
+    uint32_t mask = 0;
+
+    for (int i = 0; i < MX_MAP_GROUP; i++)
+        mask |= (uint32_t)(group.ctrl[i] == h2) << i;
+
+    return mask;
+}
+
+static uint32_t mx_map_group_empty(mx_map_group_t group)
+{
+    return mx_map_group_match(group, MX_MAP_EMPTY);
+}
+
+static uint32_t mx_map_group_free(mx_map_group_t group)
+{
+    uint32_t mask = 0;
+
+    for (int i = 0; i < MX_MAP_GROUP; i++)
+        mask |= (uint32_t)(group.ctrl[i] < 0) << i;
+
+    return mask;
+}
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+
+static unsigned mx_map_ctz(uint32_t mask)
+{
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return index;
+}
+
+static unsigned mx_map_clz(uint32_t mask)
+{
+    unsigned long index;
+    _BitScanReverse(&index, mask);
+    return 31 - index;
+}
+#else
+static unsigned mx_map_ctz(uint32_t mask)
+{
+    return (unsigned)__builtin_ctz(mask);
+}
+
+static unsigned mx_map_clz(uint32_t mask)
+{
+    return (unsigned)__builtin_clz(mask);
+}
+#endif
+
+static struct mx_map_self_t *mx_map_header(const void *map)
+{
+    return (struct mx_map_self_t*)map - 1;
+}
+
+static char *mx_map_entry(const void *map, size_t size, size_t index)
+{
+    return (char*)map + size * index;
+}
+
+static uint64_t mx_map_hash(const struct mx_map_self_t *self, const void *key)
+{
+    uint64_t h;
+
+    if (self->hash == NULL)
+    {
+        mx_wyhash64(&h, key, self->key_size);
+        return h;
+    }
+
+    uint64_t digest[8] = { 0 };
+    self->hash(digest, key, self->key_size);
+
+    /* Spread digests that are short or weak in the low bits. */
+    h = digest[0] * 0x9E3779B97F4A7C15ull;
+    return h ^ (h >> 32);
+}
+
+static void mx_map_set_ctrl(struct mx_map_self_t *self, int index, int8_t h2)
+{
+    self->ctrl[index] = h2;
+
+    if (index < MX_MAP_GROUP)
+        self->ctrl[self->capacity + index] = h2;
+}
+
+/** Entries that fit in a capacity at the maximum load factor. */
+static int mx_map_max_load(int capacity)
+{
+    return capacity - capacity / 8;
+}
+
+/** First empty or deleted slot in the probe sequence of a hash. */
+static int mx_map_find_free(const struct mx_map_self_t *self, uint64_t h)
+{
+    size_t mask = (size_t)self->capacity - 1;
+    size_t pos = (size_t)(h >> 7) & mask;
+
+    for (size_t step = MX_MAP_GROUP; ; step += MX_MAP_GROUP)
+    {
+        uint32_t free = mx_map_group_free(mx_map_group_load(&self->ctrl[pos]));
+
+        if (free)
+            return (int)((pos + mx_map_ctz(free)) & mask);
+
+        pos = (pos + step) & mask;
+    }
+}
+
+static struct mx_map_self_t *mx_map_alloc(size_t size, int capacity)
+{
+    size_t bytes = sizeof(struct mx_map_self_t) + size * (size_t)capacity + (size_t)capacity + MX_MAP_GROUP;
+    struct mx_map_self_t *self = malloc(bytes);
+    MX_ASSERT_OOM(self);
+
+    self->count = 0;
+    self->capacity = capacity;
+    self->growth_left = mx_map_max_load(capacity);
+    self->index = -1;
+    self->ctrl = (int8_t*)((char*)(self + 1) + size * (size_t)capacity);
+    memset(self->ctrl, MX_MAP_EMPTY, (size_t)capacity + MX_MAP_GROUP);
+
+    return self;
+}
+
+/** Move all entries into a table with a new capacity. */
+static void *mx_map_rehash(void *map, size_t size, int capacity)
+{
+    struct mx_map_self_t *old = mx_map_header(map);
+    struct mx_map_self_t *self = mx_map_alloc(size, capacity);
+    char *entries = (char*)(self + 1);
+
+    self->key_offset = old->key_offset;
+    self->key_size = old->key_size;
+    self->hash = old->hash;
+
+    for (int i = 0; i < old->capacity; i++)
+    {
+        if (old->ctrl[i] < 0)
+            continue;
+
+        const char *entry = mx_map_entry(map, size, (size_t)i);
+        uint64_t h = mx_map_hash(self, entry + self->key_offset);
+        int slot = mx_map_find_free(self, h);
+
+        mx_map_set_ctrl(self, slot, (int8_t)(h & 0x7F));
+        memcpy(mx_map_entry(entries, size, (size_t)slot), entry, size);
+    }
+
+    self->count = old->count;
+    self->growth_left -= old->count;
+
+    free(old);
+    return entries;
+}
+
+static int mx_map_capacity_for(int count)
+{
+    int capacity = MX_MAP_MIN;
+
+    while (mx_map_max_load(capacity) < count)
+        capacity *= 2;
+
+    return capacity;
+}
+
+MX_IMPL void *__mx_map_create(size_t size, size_t key_offset, size_t key_size, mx_digest_function hash, int capacity)
+{
+    struct mx_map_self_t *self = mx_map_alloc(size, mx_map_capacity_for(capacity));
+
+    self->key_offset = key_offset;
+    self->key_size = key_size;
+    self->hash = hash;
+
+    return self + 1;
+}
+
+MX_IMPL void *__mx_map_reserve(void *map, size_t size, int count)
+{
+    struct mx_map_self_t *self = mx_map_header(map);
+
+    if (count - self->count <= self->growth_left)
+        return map;
+
+    return mx_map_rehash(map, size, mx_map_capacity_for(count));
+}
+
+/** Find the slot of a key, given its hash. */
+static int mx_map_lookup(const void *map, size_t size, const void *key, uint64_t h)
+{
+    const struct mx_map_self_t *self = mx_map_header(map);
+    size_t mask = (size_t)self->capacity - 1;
+    size_t pos = (size_t)(h >> 7) & mask;
+    int8_t h2 = (int8_t)(h & 0x7F);
+
+    for (size_t step = MX_MAP_GROUP; ; step += MX_MAP_GROUP)
+    {
+        mx_map_group_t group = mx_map_group_load(&self->ctrl[pos]);
+
+        for (uint32_t match = mx_map_group_match(group, h2); match; match &= match - 1)
+        {
+            size_t index = (pos + mx_map_ctz(match)) & mask;
+
+            if (memcmp(mx_map_entry(map, size, index) + self->key_offset, key, self->key_size) == 0)
+                return (int)index;
+        }
+
+        /* An empty slot ends every probe sequence that passes it. */
+        if (mx_map_group_empty(group))
+            return -1;
+
+        pos = (pos + step) & mask;
+    }
+}
+
+MX_IMPL int __mx_map_find(const void *map, size_t size, const void *key)
+{
+    return mx_map_lookup(map, size, key, mx_map_hash(mx_map_header(map), key));
+}
+
+MX_IMPL void *__mx_map_insert(void *map, size_t size, const void *key)
+{
+    struct mx_map_self_t *self = mx_map_header(map);
+    uint64_t h = mx_map_hash(self, key);
+    int index = mx_map_lookup(map, size, key, h);
+
+    if (index >= 0)
+    {
+        self->index = index;
+        return map;
+    }
+
+    index = mx_map_find_free(self, h);
+
+    /* Reusing a deleted slot does not use up an empty one. */
+    if (self->growth_left == 0 && self->ctrl[index] == MX_MAP_EMPTY)
+    {
+        /* Many deleted slots are cleaned up by rehashing to the same size. */
+        int capacity = self->count < mx_map_max_load(self->capacity) / 2 ? self->capacity : self->capacity * 2;
+
+        map = mx_map_rehash(map, size, capacity);
+        self = mx_map_header(map);
+        index = mx_map_find_free(self, h);
+    }
+
+    if (self->ctrl[index] == MX_MAP_EMPTY)
+        self->growth_left--;
+
+    char *entry = mx_map_entry(map, size, (size_t)index);
+    memset(entry, 0, size);
+    memcpy(entry + self->key_offset, key, self->key_size);
+
+    mx_map_set_ctrl(self, index, (int8_t)(h & 0x7F));
+    self->count++;
+    self->index = index;
+    return map;
+}
+
+MX_IMPL bool __mx_map_erase(void *map, size_t size, const void *key)
+{
+    struct mx_map_self_t *self = mx_map_header(map);
+    int index = __mx_map_find(map, size, key);
+
+    if (index < 0)
+        return false;
+
+    size_t mask = (size_t)self->capacity - 1;
+    uint32_t before = mx_map_group_empty(mx_map_group_load(&self->ctrl[((size_t)index - MX_MAP_GROUP) & mask]));
+    uint32_t after = mx_map_group_empty(mx_map_group_load(&self->ctrl[index]));
+
+    /*
+     * If no group containing this slot was ever full, no probe sequence went
+     * past it, and it can be marked empty again instead of deleted.
+     */
+    if (before && after && (mx_map_clz(before) - (32 - MX_MAP_GROUP)) + mx_map_ctz(after) < MX_MAP_GROUP)
+    {
+        mx_map_set_ctrl(self, index, MX_MAP_EMPTY);
+        self->growth_left++;
+    }
+    else
+    {
+        mx_map_set_ctrl(self, index, MX_MAP_DELETED);
+    }
+
+    self->count--;
+    return true;
+}
+
+MX_IMPL int __mx_map_next(const void *map, int index)
+{
+    const struct mx_map_self_t *self = mx_map_header(map);
+
+    for (; index < self->capacity; index += MX_MAP_GROUP)
+    {
+        uint32_t full = ~mx_map_group_free(mx_map_group_load(&self->ctrl[index])) & 0xFFFF;
+
+        if (full)
+        {
+            index += (int)mx_map_ctz(full);
+            return index < self->capacity ? index : self->capacity;
+        }
+    }
+
+    return self->capacity;
+}
+
+MX_IMPL void __mx_map_clear(void *map)
+{
+    struct mx_map_self_t *self = mx_map_header(map);
+
+    memset(self->ctrl, MX_MAP_EMPTY, (size_t)self->capacity + MX_MAP_GROUP);
+    self->count = 0;
+    self->growth_left = mx_map_max_load(self->capacity);
+}
+
+MX_IMPL void __mx_map_free(void *map)
+{
+    free(mx_map_header(map));
+}
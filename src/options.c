@@ -3,18 +3,34 @@
 #include <stdlib.h>
 #include <string.h>
 
-MX_INLINE char* mx_strdup(const char **pptr, char *nstr, size_t len)
+/**
+ * Set the key and value of the current option. Both slice argv, and only a
+ * key that does not end in a NUL there is copied to the buffer.
+ */
+static mx_optkind_t mx_options_emit(mx_options_t *self, mx_optkind_t kind, mx_str_t key, const char *value)
 {
-    if (len == 0)
-        len = strlen(nstr);
+    self->key_str   = key;
+    self->value_str = mx_str(value);
+    self->value     = value;
+    self->key       = key.ptr;
 
-    char *ptr = realloc(*pptr, len + 1);
-    MX_ASSERT_OOM(ptr);
+    if (key.ptr && key.ptr[key.len] != '\0')
+    {
+        if (self->buffer_size < key.len + 1)
+        {
+            char *buffer = IAllocator_realloc(self->allocator, self->buffer, self->buffer_size, key.len + 1, 1);
+            MX_ASSERT_OOM(buffer);
 
-    memcpy(ptr, nstr, len);
-    ptr[len] = '\0';
+            self->buffer = buffer;
+            self->buffer_size = key.len + 1;
+        }
+
+        memcpy(self->buffer, key.ptr, key.len);
+        self->buffer[key.len] = '\0';
+        self->key = self->buffer;
+    }
 
-    return (*pptr = ptr);
+    return (self->kind = kind);
 }
 
 MX_IMPL void mx_options_begin_r(mx_options_t *self, mx_optflag_t flags, int argc, const char **argv)
@@ -30,6 +46,11 @@ MX_IMPL void mx_options_begin_r(mx_options_t *self, mx_optflag_t flags, int argc
     self->kind  = MX_OPT_END;
     self->key   = NULL;
     self->value = NULL;
+    self->key_str   = mx_str_n(NULL, 0);
+    self->value_str = mx_str_n(NULL, 0);
+    self->allocator = mx_get_allocator();
+    self->buffer = NULL;
+    self->buffer_size = 0;
 }
 
 MX_IMPL mx_optkind_t mx_options_next_r(mx_options_t *self)
@@ -41,9 +62,9 @@ MX_IMPL mx_optkind_t mx_options_next_r(mx_options_t *self)
         return (self->kind = MX_OPT_END);
     }
 
-    char  *current = self->argv[self->i];
-    char  *next    = (self->i + 1 < self->argc) ? self->argv[self->i + 1] : NULL;
-    size_t clen    = strlen(current);
+    const char *current = self->argv[self->i];
+    const char *next    = (self->i + 1 < self->argc) ? self->argv[self->i + 1] : NULL;
+    size_t      clen    = strlen(current);
 
     if ((self->flags & MX_OPT_UNIX) && current[0] == '-')
     {
@@ -55,63 +76,51 @@ MX_IMPL mx_optkind_t mx_options_next_r(mx_options_t *self)
             {
                 /* -- */
                 self->i++;
-                return (self->kind = MX_OPT_DDASH);
+                return mx_options_emit(self, MX_OPT_DDASH, mx_str_n(NULL, 0), NULL);
             }
             else
             {
                 /* --long-flag or --key=pair*/
 
-                char *equals = strchr(current, '=');
+                const char *equals = strchr(current, '=');
 
                 if (equals)
                 {
                     /* The equals is in this token. */
-                    size_t len = (size_t)(equals - &current[2]);
-                    mx_strdup(&self->key, &current[2], len);
+                    mx_str_t key = mx_str_n(&current[2], (size_t)(equals - &current[2]));
 
                     if (equals[1] == '\0')
                     {
                         /* The value is in the next token. */
-                        next = next ? next : "";
-                        mx_strdup(&self->value, next, 0);
-
-                        self->i++;
-                    }
-                    else
-                    {
-                        /* The value is also in this token.*/
-                        mx_strdup(&self->value, &equals[1], 0);
+                        self->i += next ? 2 : 1;
+                        return mx_options_emit(self, MX_OPT_PAIR, key, next ? next : "");
                     }
 
+                    /* The value is also in this token.*/
                     self->i++;
-                    return (self->kind = MX_OPT_PAIR);
+                    return mx_options_emit(self, MX_OPT_PAIR, key, &equals[1]);
                 }
                 else if (next && next[0] == '=')
                 {
                     /* The equals is in the next token. */
-                    mx_strdup(&self->key,   &current[2], clen-2);
-                    mx_strdup(&self->value, &next[1], 0);
-
                     self->i += 2;
-                    return (self->kind = MX_OPT_PAIR);
+                    return mx_options_emit(self, MX_OPT_PAIR, mx_str_n(&current[2], clen - 2), &next[1]);
                 }
 
                 /* Don't treat this as a key pair. It's a long flag.*/
-                mx_strdup(&self->key, current, clen-2);
                 self->i++;
-                return (self->kind = MX_OPT_LONG);
+                return mx_options_emit(self, MX_OPT_LONG, mx_str_n(&current[2], clen - 2), NULL);
             }
         }
         else if (current[1] == '\0')
         {
             self->i++;
-            return (self->kind = MX_OPT_DASH);
+            return mx_options_emit(self, MX_OPT_DASH, mx_str_n(NULL, 0), NULL);
         }
         else
         {
-            mx_strdup(&self->key,&current[1], clen - 1);
             self->i++;
-            return (self->kind = MX_OPT_SHORT);
+            return mx_options_emit(self, MX_OPT_SHORT, mx_str_n(&current[1], clen - 1), NULL);
         }
     }
 
@@ -119,60 +128,53 @@ MX_IMPL mx_optkind_t mx_options_next_r(mx_options_t *self)
     {
         /* / indicated a DOS flag sequence. */
 
-        char *colon = strchr(current, ':');
+        const char *colon = strchr(current, ':');
 
         if (colon)
         {
             /* The colon is in this token. */
+            mx_str_t key = mx_str_n(&current[1], (size_t)(colon - &current[1]));
+
             if (colon[1] == '\0')
             {
                 /* The value is in the next token. */
-                next = next ? next : "";
-                mx_strdup(&self->value, next, 0);
-                self->i++;
-            }
-            else
-            {
-                /* The value is in this token. */
-                mx_strdup(&self->value, &colon[1], 0);
+                self->i += next ? 2 : 1;
+                return mx_options_emit(self, MX_OPT_PAIR, key, next ? next : "");
             }
 
+            /* The value is in this token. */
             self->i++;
-            mx_strdup(&self->key, &current[1], (size_t)(colon-&current[1]));
-            return (self->kind = MX_OPT_PAIR);
+            return mx_options_emit(self, MX_OPT_PAIR, key, &colon[1]);
         }
         else if (next && next[0]==':')
         {
             /* The colon is in the next token. */
-            mx_strdup(&self->key, &current[1], clen-1);
-            mx_strdup(&self->value, &next[1], 0);
-            self->i+=2;
-            return (self->kind = MX_OPT_PAIR);
+            self->i += 2;
+            return mx_options_emit(self, MX_OPT_PAIR, mx_str_n(&current[1], clen - 1), &next[1]);
         }
         else
         {
             self->i++;
-            mx_strdup(&self->key, &current[1], clen - 1);
-            return (self->kind = MX_OPT_LONG);
+            return mx_options_emit(self, MX_OPT_LONG, mx_str_n(&current[1], clen - 1), NULL);
         }
     }
 
     /* Otherwise treate as a positional argument. */
     {
-        char *ptr = realloc(self->value, clen);
-        MX_ASSERT_OOM(ptr);
-
         self->i++;
-        self->value = memcpy(ptr, current, clen);
-        return (self->kind = MX_OPT_POSITIONAL);
+        return mx_options_emit(self, MX_OPT_POSITIONAL, mx_str_n(NULL, 0), current);
     }
 }
 
 MX_IMPL void mx_options_end_r(mx_options_t *self)
 {
+    if (self && self->allocator.ptr && self->buffer)
+        IAllocator_free(self->allocator, self->buffer, self->buffer_size);
+
     if (self)
     {
-        free(self->key);
-        free(self->value);
+        self->key = self->value = NULL;
+        self->buffer = NULL;
+        self->buffer_size = 0;
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,361 @@
+#include "mx/ring.h"
+#include "mx/assert.h"
+#include <string.h>
+
+#define MX_LOAD(p, order)       atomic_load_explicit((p), memory_order_##order)
+#define MX_STORE(p, v, order)   atomic_store_explicit((p), (v), memory_order_##order)
+
+static size_t mx_ring_capacity(size_t capacity, size_t min)
+{
+    size_t n = min;
+
+    while (n < capacity)
+        n *= 2;
+
+    return n;
+}
+
+/*
+ * Single producer, single consumer ring. head and tail count items ever
+ * popped and pushed, and wrap around with the size_t. Only the consumer
+ * stores head and only the producer stores tail; each side reloads the
+ * other's index only when its cached copy says the ring is empty or full.
+ */
+
+MX_IMPL bool mx_spsc_init(mx_spsc_t *ring, size_t capacity, size_t size)
+{
+    MX_ASSERT_SELFPTR(ring);
+    MX_ASSERT(size > 0, "Item size must be greater than zero.");
+
+    capacity = mx_ring_capacity(capacity, 1);
+    ring->allocator = mx_get_allocator();
+    ring->items = IAllocator_alloc(ring->allocator, capacity * size, MX_ALLOC_ALIGN);
+
+    if (!ring->items)
+        return false;
+
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    ring->head_cache = ring->tail_cache = 0;
+    ring->mask = capacity - 1;
+    ring->size = size;
+    return true;
+}
+
+MX_IMPL void mx_spsc_destroy(mx_spsc_t *ring)
+{
+    MX_ASSERT_SELFPTR(ring);
+
+    IAllocator_free(ring->allocator, ring->items, (ring->mask + 1) * ring->size);
+    ring->items = NULL;
+}
+
+/** Copy count items between a linear array and the ring, which may wrap. */
+static void mx_ring_copy(char *ring, size_t mask, size_t size, size_t pos, char *items, size_t count, bool into)
+{
+    size_t first = mask + 1 - (pos & mask);
+
+    if (first > count)
+        first = count;
+
+    char *slot = ring + (pos & mask) * size;
+
+    if (into)
+    {
+        memcpy(slot, items, first * size);
+        memcpy(ring, items + first * size, (count - first) * size);
+    }
+    else
+    {
+        memcpy(items, slot, first * size);
+        memcpy(items + first * size, ring, (count - first) * size);
+    }
+}
+
+MX_IMPL size_t mx_spsc_push_n(mx_spsc_t *ring, const void *items, size_t count)
+{
+    size_t tail = MX_LOAD(&ring->tail, relaxed);
+    size_t capacity = ring->mask + 1;
+
+    if (capacity - (tail - ring->head_cache) < count)
+        ring->head_cache = MX_LOAD(&ring->head, acquire);
+
+    size_t space = capacity - (tail - ring->head_cache);
+
+    if (count > space)
+        count = space;
+
+    if (count == 0)
+        return 0;
+
+    mx_ring_copy(ring->items, ring->mask, ring->size, tail, (char*)items, count, true);
+    MX_STORE(&ring->tail, tail + count, release);
+    return count;
+}
+
+MX_IMPL size_t mx_spsc_pop_n(mx_spsc_t *ring, void *items, size_t count)
+{
+    size_t head = MX_LOAD(&ring->head, relaxed);
+
+    if (ring->tail_cache - head < count)
+        ring->tail_cache = MX_LOAD(&ring->tail, acquire);
+
+    size_t avail = ring->tail_cache - head;
+
+    if (count > avail)
+        count = avail;
+
+    if (count == 0)
+        return 0;
+
+    mx_ring_copy(ring->items, ring->mask, ring->size, head, items, count, false);
+    MX_STORE(&ring->head, head + count, release);
+    return count;
+}
+
+MX_IMPL bool mx_spsc_push(mx_spsc_t *ring, const void *item)
+{
+    size_t tail = MX_LOAD(&ring->tail, relaxed);
+
+    if (tail - ring->head_cache > ring->mask)
+    {
+        ring->head_cache = MX_LOAD(&ring->head, acquire);
+
+        if (tail - ring->head_cache > ring->mask)
+            return false;
+    }
+
+    memcpy(ring->items + (tail & ring->mask) * ring->size, item, ring->size);
+    MX_STORE(&ring->tail, tail + 1, release);
+    return true;
+}
+
+MX_IMPL bool mx_spsc_pop(mx_spsc_t *ring, void *item)
+{
+    size_t head = MX_LOAD(&ring->head, relaxed);
+
+    if (head == ring->tail_cache)
+    {
+        ring->tail_cache = MX_LOAD(&ring->tail, acquire);
+
+        if (head == ring->tail_cache)
+            return false;
+    }
+
+    memcpy(item, ring->items + (head & ring->mask) * ring->size, ring->size);
+    MX_STORE(&ring->head, head + 1, release);
+    return true;
+}
+
+MX_IMPL size_t mx_spsc_count(mx_spsc_t *ring)
+{
+    return MX_LOAD(&ring->tail, acquire) - MX_LOAD(&ring->head, acquire);
+}
+
+/*
+ * Multiple producer, multiple consumer queue. The cell for position pos has
+ * sequence pos when it is free for the producer of pos, and pos + 1 when it
+ * holds the item for the consumer of pos. The consumer then frees it for the
+ * producer one lap later by setting pos + capacity.
+ */
+
+typedef struct mx_mpmc_cell_t {
+    atomic_size_t sequence;
+} mx_mpmc_cell_t;
+
+static mx_mpmc_cell_t *mx_mpmc_cell(mx_mpmc_t *queue, size_t pos)
+{
+    return (mx_mpmc_cell_t*)(queue->cells + (pos & queue->mask) * queue->stride);
+}
+
+static char *mx_mpmc_data(mx_mpmc_cell_t *cell)
+{
+    return (char*)(cell + 1);
+}
+
+MX_IMPL bool mx_mpmc_init(mx_mpmc_t *queue, size_t capacity, size_t size)
+{
+    MX_ASSERT_SELFPTR(queue);
+    MX_ASSERT(size > 0, "Item size must be greater than zero.");
+
+    capacity = mx_ring_capacity(capacity, 2);
+    queue->stride = (sizeof(mx_mpmc_cell_t) + size + sizeof(size_t) - 1) & ~(sizeof(size_t) - 1);
+    queue->allocator = mx_get_allocator();
+    queue->cells = IAllocator_alloc(queue->allocator, capacity * queue->stride, MX_ALLOC_ALIGN);
+
+    if (!queue->cells)
+        return false;
+
+    queue->mask = capacity - 1;
+    queue->size = size;
+
+    for (size_t i = 0; i < capacity; i++)
+        atomic_init(&mx_mpmc_cell(queue, i)->sequence, i);
+
+    atomic_init(&queue->head, 0);
+    atomic_init(&queue->tail, 0);
+    return true;
+}
+
+MX_IMPL void mx_mpmc_destroy(mx_mpmc_t *queue)
+{
+    MX_ASSERT_SELFPTR(queue);
+
+    IAllocator_free(queue->allocator, queue->cells, (queue->mask + 1) * queue->stride);
+    queue->cells = NULL;
+}
+
+MX_IMPL bool mx_mpmc_push(mx_mpmc_t *queue, const void *item)
+{
+    size_t pos = MX_LOAD(&queue->tail, relaxed);
+    mx_mpmc_cell_t *cell;
+
+    for (;;)
+    {
+        cell = mx_mpmc_cell(queue, pos);
+        size_t seq = MX_LOAD(&cell->sequence, acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+
+        if (diff == 0)
+        {
+            if (atomic_compare_exchange_weak_explicit(&queue->tail, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed))
+                break;
+        }
+        else if (diff < 0)
+        {
+            /* The consumer of the previous lap has not freed the cell. */
+            return false;
+        }
+        else
+        {
+            pos = MX_LOAD(&queue->tail, relaxed);
+        }
+    }
+
+    memcpy(mx_mpmc_data(cell), item, queue->size);
+    MX_STORE(&cell->sequence, pos + 1, release);
+    return true;
+}
+
+MX_IMPL bool mx_mpmc_pop(mx_mpmc_t *queue, void *item)
+{
+    size_t pos = MX_LOAD(&queue->head, relaxed);
+    mx_mpmc_cell_t *cell;
+
+    for (;;)
+    {
+        cell = mx_mpmc_cell(queue, pos);
+        size_t seq = MX_LOAD(&cell->sequence, acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+
+        if (diff == 0)
+        {
+            if (atomic_compare_exchange_weak_explicit(&queue->head, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed))
+                break;
+        }
+        else if (diff < 0)
+        {
+            /* The producer of this position has not finished. */
+            return false;
+        }
+        else
+        {
+            pos = MX_LOAD(&queue->head, relaxed);
+        }
+    }
+
+    memcpy(item, mx_mpmc_data(cell), queue->size);
+    MX_STORE(&cell->sequence, pos + queue->mask + 1, release);
+    return true;
+}
+
+/*
+ * Batches scan forward from the current position for cells in the expected
+ * state, then claim all of them by moving the position past them. Cells seen
+ * in that state cannot change before the claim, since only the owner of the
+ * position may use them.
+ */
+
+MX_IMPL size_t mx_mpmc_push_n(mx_mpmc_t *queue, const void *items, size_t count)
+{
+    size_t pos = MX_LOAD(&queue->tail, relaxed);
+    size_t n;
+
+    for (;;)
+    {
+        for (n = 0; n < count; n++)
+        {
+            if (MX_LOAD(&mx_mpmc_cell(queue, pos + n)->sequence, acquire) != pos + n)
+                break;
+        }
+
+        if (n == 0)
+        {
+            size_t now = MX_LOAD(&queue->tail, relaxed);
+
+            if (now == pos)
+                return 0;
+
+            pos = now;
+            continue;
+        }
+
+        if (atomic_compare_exchange_weak_explicit(&queue->tail, &pos, pos + n, memory_order_relaxed, memory_order_relaxed))
+            break;
+    }
+
+    for (size_t i = 0; i < n; i++)
+    {
+        mx_mpmc_cell_t *cell = mx_mpmc_cell(queue, pos + i);
+        memcpy(mx_mpmc_data(cell), (const char*)items + i * queue->size, queue->size);
+        MX_STORE(&cell->sequence, pos + i + 1, release);
+    }
+
+    return n;
+}
+
+MX_IMPL size_t mx_mpmc_pop_n(mx_mpmc_t *queue, void *items, size_t count)
+{
+    size_t pos = MX_LOAD(&queue->head, relaxed);
+    size_t n;
+
+    for (;;)
+    {
+        for (n = 0; n < count; n++)
+        {
+            if (MX_LOAD(&mx_mpmc_cell(queue, pos + n)->sequence, acquire) != pos + n + 1)
+                break;
+        }
+
+        if (n == 0)
+        {
+            size_t now = MX_LOAD(&queue->head, relaxed);
+
+            if (now == pos)
+                return 0;
+
+            pos = now;
+            continue;
+        }
+
+        if (atomic_compare_exchange_weak_explicit(&queue->head, &pos, pos + n, memory_order_relaxed, memory_order_relaxed))
+            break;
+    }
+
+    for (size_t i = 0; i < n; i++)
+    {
+        mx_mpmc_cell_t *cell = mx_mpmc_cell(queue, pos + i);
+        memcpy((char*)items + i * queue->size, mx_mpmc_data(cell), queue->size);
+        MX_STORE(&cell->sequence, pos + i + queue->mask + 1, release);
+    }
+
+    return n;
+}
+
+MX_IMPL size_t mx_mpmc_count(mx_mpmc_t *queue)
+{
+    size_t tail = MX_LOAD(&queue->tail, acquire);
+    size_t head = MX_LOAD(&queue->head, acquire);
+
+    return tail - head > queue->mask + 1 ? 0 : tail - head;
+}
@@ -0,0 +1,415 @@
+#include <mx/digest.h>
+#include <mx/cpu.h>
+#include <stdatomic.h>
+#include <string.h>
+
+#if MX_CPU_X86
+#include <immintrin.h>
+#endif
+
+static const uint32_t K256[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+static const uint32_t SHA256_IV[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+};
+
+static uint32_t mx_load_be32(const unsigned char *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static void mx_store_be32(unsigned char *p, uint32_t v)
+{
+    p[0] = v >> 24; p[1] = v >> 16; p[2] = v >> 8; p[3] = v;
+}
+
+static void mx_store_be64(unsigned char *p, uint64_t v)
+{
+    mx_store_be32(p, (uint32_t)(v >> 32));
+    mx_store_be32(p + 4, (uint32_t)v);
+}
+
+#define ROTR32(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+static void mx_sha256_scalar(uint32_t state[8], const unsigned char *src, size_t blocks)
+{
+    uint32_t w[64];
+
+    for (; blocks > 0; blocks--, src += 64)
+    {
+        for (int t = 0; t < 16; t++)
+            w[t] = mx_load_be32(src + 4 * t);
+
+        for (int t = 16; t < 64; t++)
+        {
+            uint32_t s0 = ROTR32(w[t - 15], 7) ^ ROTR32(w[t - 15], 18) ^ (w[t - 15] >> 3);
+            uint32_t s1 = ROTR32(w[t - 2], 17) ^ ROTR32(w[t - 2], 19) ^ (w[t - 2] >> 10);
+            w[t] = w[t - 16] + s0 + w[t - 7] + s1;
+        }
+
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+        uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+
+        for (int t = 0; t < 64; t++)
+        {
+            uint32_t t1 = h + (ROTR32(e, 6) ^ ROTR32(e, 11) ^ ROTR32(e, 25)) + ((e & f) ^ (~e & g)) + K256[t] + w[t];
+            uint32_t t2 = (ROTR32(a, 2) ^ ROTR32(a, 13) ^ ROTR32(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+            h = g; g = f; f = e; e = d + t1;
+            d = c; c = b; b = a; a = t1 + t2;
+        }
+
+        state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+        state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+    }
+}
+
+#if MX_CPU_X86
+/*
+ * Four rounds with the SHA extensions. cur holds the message words for these
+ * rounds, prv those of the previous four, and nxt is the schedule vector
+ * completed by sha256msg2 for the four rounds after.
+ */
+#define SHA256_NI_ROUNDS(k, cur, prv, nxt, msg2, msg1) do { \
+    msg = _mm_add_epi32(cur, _mm_loadu_si128((const __m128i*)&K256[k])); \
+    state1 = _mm_sha256rnds2_epu32(state1, state0, msg); \
+    if (msg2) \
+    { \
+        nxt = _mm_add_epi32(nxt, _mm_alignr_epi8(cur, prv, 4)); \
+        nxt = _mm_sha256msg2_epu32(nxt, cur); \
+    } \
+    msg = _mm_shuffle_epi32(msg, 0x0E); \
+    state0 = _mm_sha256rnds2_epu32(state0, state1, msg); \
+    if (msg1) \
+        prv = _mm_sha256msg1_epu32(prv, cur); \
+} while (0)
+
+MX_TARGET("sha,sse4.1")
+static void mx_sha256_shani(uint32_t state[8], const unsigned char *src, size_t blocks)
+{
+    const __m128i bswap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+    __m128i state0, state1, msg, tmp, m0, m1, m2, m3, abef, cdgh;
+
+    /* The instructions want the state as ABEF and CDGH. */
+    tmp    = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)&state[0]), 0xB1);
+    state1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)&state[4]), 0x1B);
+    state0 = _mm_alignr_epi8(tmp, state1, 8);
+    state1 = _mm_blend_epi16(state1, tmp, 0xF0);
+
+    for (; blocks > 0; blocks--, src += 64)
+    {
+        abef = state0;
+        cdgh = state1;
+
+        m0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(src +  0)), bswap);
+        m1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(src + 16)), bswap);
+        m2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(src + 32)), bswap);
+        m3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(src + 48)), bswap);
+
+        SHA256_NI_ROUNDS( 0, m0, m3, m1, 0, 0);
+        SHA256_NI_ROUNDS( 4, m1, m0, m2, 0, 1);
+        SHA256_NI_ROUNDS( 8, m2, m1, m3, 0, 1);
+        SHA256_NI_ROUNDS(12, m3, m2, m0, 1, 1);
+        SHA256_NI_ROUNDS(16, m0, m3, m1, 1, 1);
+        SHA256_NI_ROUNDS(20, m1, m0, m2, 1, 1);
+        SHA256_NI_ROUNDS(24, m2, m1, m3, 1, 1);
+        SHA256_NI_ROUNDS(28, m3, m2, m0, 1, 1);
+        SHA256_NI_ROUNDS(32, m0, m3, m1, 1, 1);
+        SHA256_NI_ROUNDS(36, m1, m0, m2, 1, 1);
+        SHA256_NI_ROUNDS(40, m2, m1, m3, 1, 1);
+        SHA256_NI_ROUNDS(44, m3, m2, m0, 1, 1);
+        SHA256_NI_ROUNDS(48, m0, m3, m1, 1, 1);
+        SHA256_NI_ROUNDS(52, m1, m0, m2, 1, 0);
+        SHA256_NI_ROUNDS(56, m2, m1, m3, 1, 0);
+        SHA256_NI_ROUNDS(60, m3, m2, m0, 0, 0);
+
+        state0 = _mm_add_epi32(state0, abef);
+        state1 = _mm_add_epi32(state1, cdgh);
+    }
+
+    tmp    = _mm_shuffle_epi32(state0, 0x1B);
+    state1 = _mm_shuffle_epi32(state1, 0xB1);
+    state0 = _mm_blend_epi16(tmp, state1, 0xF0);
+    state1 = _mm_alignr_epi8(state1, tmp, 8);
+
+    _mm_storeu_si128((__m128i*)&state[0], state0);
+    _mm_storeu_si128((__m128i*)&state[4], state1);
+}
+
+#undef SHA256_NI_ROUNDS
+
+#define ROTR256(x, n) _mm256_or_si256(_mm256_srli_epi32(x, n), _mm256_slli_epi32(x, 32 - (n)))
+
+/**
+ * Transpose eight rows of eight 32 bit words, so that out[i] holds word i of
+ * every row.
+ */
+MX_TARGET("avx2")
+static void mx_transpose8x8(__m256i out[8], const __m256i r[8])
+{
+    __m256i t0 = _mm256_unpacklo_epi32(r[0], r[1]);
+    __m256i t1 = _mm256_unpackhi_epi32(r[0], r[1]);
+    __m256i t2 = _mm256_unpacklo_epi32(r[2], r[3]);
+    __m256i t3 = _mm256_unpackhi_epi32(r[2], r[3]);
+    __m256i t4 = _mm256_unpacklo_epi32(r[4], r[5]);
+    __m256i t5 = _mm256_unpackhi_epi32(r[4], r[5]);
+    __m256i t6 = _mm256_unpacklo_epi32(r[6], r[7]);
+    __m256i t7 = _mm256_unpackhi_epi32(r[6], r[7]);
+
+    __m256i u0 = _mm256_unpacklo_epi64(t0, t2);
+    __m256i u1 = _mm256_unpackhi_epi64(t0, t2);
+    __m256i u2 = _mm256_unpacklo_epi64(t1, t3);
+    __m256i u3 = _mm256_unpackhi_epi64(t1, t3);
+    __m256i u4 = _mm256_unpacklo_epi64(t4, t6);
+    __m256i u5 = _mm256_unpackhi_epi64(t4, t6);
+    __m256i u6 = _mm256_unpacklo_epi64(t5, t7);
+    __m256i u7 = _mm256_unpackhi_epi64(t5, t7);
+
+    out[0] = _mm256_permute2x128_si256(u0, u4, 0x20);
+    out[1] = _mm256_permute2x128_si256(u1, u5, 0x20);
+    out[2] = _mm256_permute2x128_si256(u2, u6, 0x20);
+    out[3] = _mm256_permute2x128_si256(u3, u7, 0x20);
+    out[4] = _mm256_permute2x128_si256(u0, u4, 0x31);
+    out[5] = _mm256_permute2x128_si256(u1, u5, 0x31);
+    out[6] = _mm256_permute2x128_si256(u2, u6, 0x31);
+    out[7] = _mm256_permute2x128_si256(u3, u7, 0x31);
+}
+
+/**
+ * Compress one block for each of eight independent messages, one per lane.
+ * Lanes not set in active keep their state.
+ */
+MX_TARGET("avx2")
+static void mx_sha256_avx2_x8(__m256i s[8], const unsigned char *const block[8], __m256i active)
+{
+    const __m256i bswap = _mm256_setr_epi8(
+        3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+        3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+    __m256i w[16], rows[8];
+
+    for (int half = 0; half < 2; half++)
+    {
+        for (int l = 0; l < 8; l++)
+            rows[l] = _mm256_loadu_si256((const __m256i*)(block[l] + 32 * half));
+
+        mx_transpose8x8(&w[8 * half], rows);
+    }
+
+    for (int t = 0; t < 16; t++)
+        w[t] = _mm256_shuffle_epi8(w[t], bswap);
+
+    __m256i a = s[0], b = s[1], c = s[2], d = s[3];
+    __m256i e = s[4], f = s[5], g = s[6], h = s[7];
+
+    for (int t = 0; t < 64; t++)
+    {
+        __m256i wt;
+
+        if (t < 16)
+        {
+            wt = w[t];
+        }
+        else
+        {
+            __m256i w15 = w[(t - 15) & 15], w2 = w[(t - 2) & 15];
+            __m256i s0 = _mm256_xor_si256(_mm256_xor_si256(ROTR256(w15, 7), ROTR256(w15, 18)), _mm256_srli_epi32(w15, 3));
+            __m256i s1 = _mm256_xor_si256(_mm256_xor_si256(ROTR256(w2, 17), ROTR256(w2, 19)), _mm256_srli_epi32(w2, 10));
+            wt = _mm256_add_epi32(_mm256_add_epi32(w[t & 15], s0), _mm256_add_epi32(w[(t - 7) & 15], s1));
+            w[t & 15] = wt;
+        }
+
+        __m256i S1  = _mm256_xor_si256(_mm256_xor_si256(ROTR256(e, 6), ROTR256(e, 11)), ROTR256(e, 25));
+        __m256i ch  = _mm256_xor_si256(_mm256_and_si256(e, f), _mm256_andnot_si256(e, g));
+        __m256i t1  = _mm256_add_epi32(_mm256_add_epi32(h, S1), _mm256_add_epi32(ch, _mm256_add_epi32(wt, _mm256_set1_epi32((int)K256[t]))));
+        __m256i S0  = _mm256_xor_si256(_mm256_xor_si256(ROTR256(a, 2), ROTR256(a, 13)), ROTR256(a, 22));
+        __m256i maj = _mm256_or_si256(_mm256_and_si256(a, b), _mm256_and_si256(c, _mm256_or_si256(a, b)));
+
+        h = g; g = f; f = e; e = _mm256_add_epi32(d, t1);
+        d = c; c = b; b = a; a = _mm256_add_epi32(t1, _mm256_add_epi32(S0, maj));
+    }
+
+    __m256i r[8] = { a, b, c, d, e, f, g, h };
+
+    for (int i = 0; i < 8; i++)
+        s[i] = _mm256_blendv_epi8(s[i], _mm256_add_epi32(s[i], r[i]), active);
+}
+
+#undef ROTR256
+
+/**
+ * Hash up to eight messages at once, each in its own AVX2 lane. Blocks are
+ * taken from the message while it lasts, then from a padded tail buffer.
+ */
+MX_TARGET("avx2")
+static void mx_sha256_multi_avx2(sha256_t *digests, const char *const *src, const size_t *length, size_t count)
+{
+    static const unsigned char zero[64] = { 0 };
+    unsigned char tail[8][128];
+    size_t full[8], total[8], blocks = 0;
+    __m256i s[8];
+
+    for (size_t l = 0; l < 8; l++)
+    {
+        full[l] = total[l] = 0;
+
+        if (l >= count)
+            continue;
+
+        size_t rem = length[l] % 64;
+        full[l]  = length[l] / 64;
+        total[l] = full[l] + (rem + 9 <= 64 ? 1 : 2);
+
+        memset(tail[l], 0, sizeof tail[l]);
+        memcpy(tail[l], src[l] + 64 * full[l], rem);
+        tail[l][rem] = 0x80;
+        mx_store_be64(&tail[l][64 * (total[l] - full[l]) - 8], (uint64_t)length[l] * 8);
+
+        if (total[l] > blocks)
+            blocks = total[l];
+    }
+
+    for (int i = 0; i < 8; i++)
+        s[i] = _mm256_set1_epi32((int)SHA256_IV[i]);
+
+    for (size_t b = 0; b < blocks; b++)
+    {
+        const unsigned char *block[8];
+        int32_t mask[8];
+
+        for (size_t l = 0; l < 8; l++)
+        {
+            if (b < full[l])
+                block[l] = (const unsigned char*)src[l] + 64 * b;
+            else if (b < total[l])
+                block[l] = tail[l] + 64 * (b - full[l]);
+            else
+                block[l] = zero;
+
+            mask[l] = b < total[l] ? -1 : 0;
+        }
+
+        mx_sha256_avx2_x8(s, block, _mm256_loadu_si256((const __m256i*)mask));
+    }
+
+    uint32_t state[8][8];
+
+    for (int i = 0; i < 8; i++)
+        _mm256_storeu_si256((__m256i*)state[i], s[i]);
+
+    for (size_t l = 0; l < count; l++)
+        for (int i = 0; i < 8; i++)
+            mx_store_be32(&digests[l][4 * i], state[i][l]);
+}
+#endif
+
+static void mx_sha256_resolve(uint32_t state[8], const unsigned char *src, size_t blocks);
+
+typedef void (*mx_sha256_blocks_function)(uint32_t state[8], const unsigned char *src, size_t blocks);
+
+/** SHA-256 block function, selected on first use. */
+static _Atomic(mx_sha256_blocks_function) mx_sha256_block_function = mx_sha256_resolve;
+
+static void mx_sha256_blocks(uint32_t state[8], const unsigned char *src, size_t blocks)
+{
+    atomic_load_explicit(&mx_sha256_block_function, memory_order_relaxed)(state, src, blocks);
+}
+
+static void mx_sha256_resolve(uint32_t state[8], const unsigned char *src, size_t blocks)
+{
+    mx_sha256_blocks_function block = mx_sha256_scalar;
+#if MX_CPU_X86
+    if (mx_cpu_has(MX_CPU_SHA | MX_CPU_SSE41))
+        block = mx_sha256_shani;
+#endif
+    atomic_store_explicit(&mx_sha256_block_function, block, memory_order_relaxed);
+    block(state, src, blocks);
+}
+
+MX_IMPL void mx_sha256(sha256_t *digest, const char *src, size_t length)
+{
+    mx_sha256_ctx_t ctx;
+    mx_sha256_init(&ctx);
+    mx_sha256_update(&ctx, src, length);
+    mx_sha256_final(&ctx, digest);
+}
+
+MX_IMPL void mx_sha256_init(mx_sha256_ctx_t *ctx)
+{
+    memcpy(ctx->state, SHA256_IV, sizeof ctx->state);
+    ctx->length = 0;
+}
+
+MX_IMPL void mx_sha256_update(mx_sha256_ctx_t *ctx, const char *src, size_t length)
+{
+    size_t used = ctx->length % 64;
+    ctx->length += length;
+
+    if (used > 0)
+    {
+        size_t n = 64 - used < length ? 64 - used : length;
+        memcpy(ctx->buffer + used, src, n);
+        src += n;
+        length -= n;
+
+        if (used + n < 64)
+            return;
+
+        mx_sha256_blocks(ctx->state, ctx->buffer, 1);
+    }
+
+    if (length >= 64)
+    {
+        mx_sha256_blocks(ctx->state, (const unsigned char*)src, length / 64);
+        src += length & ~(size_t)63;
+        length &= 63;
+    }
+
+    memcpy(ctx->buffer, src, length);
+}
+
+MX_IMPL void mx_sha256_final(mx_sha256_ctx_t *ctx, sha256_t *digest)
+{
+    size_t used = ctx->length % 64;
+    size_t blocks = used + 9 <= 64 ? 1 : 2;
+    unsigned char pad[128] = { 0 };
+
+    memcpy(pad, ctx->buffer, used);
+    pad[used] = 0x80;
+    mx_store_be64(&pad[64 * blocks - 8], ctx->length * 8);
+    mx_sha256_blocks(ctx->state, pad, blocks);
+
+    for (int i = 0; i < 8; i++)
+        mx_store_be32(&(*digest)[4 * i], ctx->state[i]);
+}
+
+MX_IMPL void mx_sha256_multi(sha256_t *digests, const char *const *src, const size_t *length, size_t count)
+{
+#if MX_CPU_X86
+    /* With the SHA extensions a single stream is already faster than the lanes. */
+    if (!mx_cpu_has(MX_CPU_SHA | MX_CPU_SSE41) && mx_cpu_has(MX_CPU_AVX2))
+    {
+        for (; count > 0; )
+        {
+            size_t n = count < 8 ? count : 8;
+            mx_sha256_multi_avx2(digests, src, length, n);
+            digests += n;
+            src += n;
+            length += n;
+            count -= n;
+        }
+
+        return;
+    }
+#endif
+
+    for (size_t i = 0; i < count; i++)
+        mx_sha256(&digests[i], src[i], length[i]);
+}
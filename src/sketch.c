@@ -0,0 +1,670 @@
+#include "mx/sketch.h"
+#include "mx/digest.h"
+#include "mx/assert.h"
+#include <math.h>
+#include <string.h>
+
+/** Keys hashed and prefetched ahead of probing in the batch functions. */
+#define MX_SKETCH_BATCH     16
+/** Bytes per Bloom filter block. */
+#define MX_BLOOM_BLOCK      (MX_BLOOM_BLOCK_BITS / 8)
+/** Bytes moved per stream call when saving or loading. */
+#define MX_SKETCH_CHUNK     4096
+
+#define MX_LN2              0.69314718055994530942
+#define MX_E                2.71828182845904523536
+
+#define MX_LOAD(p)          atomic_load_explicit((p), memory_order_relaxed)
+#define MX_STORE(p, v)      atomic_store_explicit((p), (v), memory_order_relaxed)
+
+static const char mx_bloom_magic[8] = { 'M', 'X', 'B', 'L', 'O', 'O', 'M', '1' };
+static const char mx_cms_magic[8]   = { 'M', 'X', 'C', 'M', 'S', 'K', 'T', '1' };
+
+/*
+ * Double hashing. The low half of the hash is the start and a remix of the
+ * whole hash is the odd step, so probe i is start + i * step. The Bloom
+ * filter picks its block from the high half, and both map a 32 bit value to
+ * a range by its top bits with a multiply instead of a division.
+ */
+
+static uint32_t mx_sketch_start(uint64_t hash)
+{
+    return (uint32_t)hash;
+}
+
+static uint32_t mx_sketch_step(uint64_t hash)
+{
+    return (uint32_t)((hash * 0x9E3779B97F4A7C15) >> 32) | 1;
+}
+
+static size_t mx_sketch_range(uint32_t x, size_t n)
+{
+    return (size_t)(((uint64_t)x * n) >> 32);
+}
+
+static uint64_t mx_sketch_hash(const void *key, size_t length, uint64_t seed)
+{
+    wyhash64_t hash;
+    mx_wyhash64_seeded(&hash, key, length, seed);
+    return hash;
+}
+
+static void mx_sketch_put64(unsigned char *p, uint64_t v)
+{
+    for (int i = 0; i < 8; i++)
+        p[i] = (unsigned char)(v >> (8 * i));
+}
+
+static uint64_t mx_sketch_get64(const unsigned char *p)
+{
+    uint64_t v = 0;
+
+    for (int i = 0; i < 8; i++)
+        v |= (uint64_t)p[i] << (8 * i);
+
+    return v;
+}
+
+static bool mx_sketch_write(fatptr_t(IStream) stream, const void *src, size_t size)
+{
+    return IStream_write(stream, src, (mx_len_t)size) == (mx_len_t)size;
+}
+
+static bool mx_sketch_read(fatptr_t(IStream) stream, void *dst, size_t size)
+{
+    char *at = dst;
+
+    while (size)
+    {
+        mx_len_t n = IStream_read(stream, at, (mx_len_t)size);
+
+        if (n <= 0)
+            return false;
+
+        at += n;
+        size -= (size_t)n;
+    }
+
+    return true;
+}
+
+/** Write the magic and three little endian fields. */
+static bool mx_sketch_write_header(fatptr_t(IStream) stream, const char magic[8], uint64_t a, uint64_t b, uint64_t c)
+{
+    unsigned char header[32];
+
+    memcpy(header, magic, 8);
+    mx_sketch_put64(header + 8, a);
+    mx_sketch_put64(header + 16, b);
+    mx_sketch_put64(header + 24, c);
+    return mx_sketch_write(stream, header, sizeof header);
+}
+
+static bool mx_sketch_read_header(fatptr_t(IStream) stream, const char magic[8], uint64_t *a, uint64_t *b, uint64_t *c)
+{
+    unsigned char header[32];
+
+    if (!mx_sketch_read(stream, header, sizeof header) || memcmp(header, magic, 8) != 0)
+        return false;
+
+    *a = mx_sketch_get64(header + 8);
+    *b = mx_sketch_get64(header + 16);
+    *c = mx_sketch_get64(header + 24);
+    return true;
+}
+
+/*
+ * Bloom filter. A key sets probes bits of one block; the masks for the eight
+ * words of the block are built first so each word is touched once.
+ */
+
+static _Atomic uint64_t *mx_bloom_block(const mx_bloom_t *bloom, uint64_t hash)
+{
+    return bloom->words + mx_sketch_range((uint32_t)(hash >> 32), bloom->blocks) * (MX_BLOOM_BLOCK / 8);
+}
+
+static void mx_bloom_masks(const mx_bloom_t *bloom, uint64_t hash, uint64_t masks[8])
+{
+    uint32_t at = mx_sketch_start(hash), step = mx_sketch_step(hash);
+
+    memset(masks, 0, 8 * sizeof(uint64_t));
+
+    for (unsigned i = 0; i < bloom->probes; i++, at += step)
+    {
+        /* The top nine bits are the bit within the block. */
+        unsigned bit = at >> 23;
+        masks[bit / 64] |= (uint64_t)1 << (bit % 64);
+    }
+}
+
+MX_IMPL void mx_bloom_init(mx_bloom_t *bloom, size_t expected, double fp_rate)
+{
+    MX_ASSERT(fp_rate > 0 && fp_rate < 1, "False positive rate must be in (0, 1).");
+
+    double n = expected ? (double)expected : 1;
+    double bits = -n * log(fp_rate) / (MX_LN2 * MX_LN2);
+    double probes = round(bits / n * MX_LN2);
+
+    probes = probes < 1 ? 1 : probes > MX_BLOOM_MAX_PROBES ? MX_BLOOM_MAX_PROBES : probes;
+    mx_bloom_init_shape(bloom, (size_t)ceil(bits / MX_BLOOM_BLOCK_BITS), (unsigned)probes, 0);
+}
+
+/** Allocate the blocks of a filter without clearing them. False if out of memory. */
+static bool mx_bloom_alloc(mx_bloom_t *bloom, size_t blocks, unsigned probes, uint64_t seed)
+{
+    bloom->blocks = blocks;
+    bloom->probes = probes;
+    bloom->seed = seed;
+    bloom->allocator = mx_get_allocator();
+
+    /* Over-allocate so the blocks start on a cache line. */
+    bloom->memory_size = blocks * MX_BLOOM_BLOCK + MX_BLOOM_BLOCK;
+    bloom->memory = IAllocator_alloc(bloom->allocator, bloom->memory_size, MX_ALLOC_ALIGN);
+
+    if (!bloom->memory)
+        return false;
+
+    bloom->words = (void*)(((uintptr_t)bloom->memory + MX_BLOOM_BLOCK - 1) & ~(uintptr_t)(MX_BLOOM_BLOCK - 1));
+    return true;
+}
+
+MX_IMPL void mx_bloom_init_shape(mx_bloom_t *bloom, size_t blocks, unsigned probes, uint64_t seed)
+{
+    MX_ASSERT_SELFPTR(bloom);
+    MX_ASSERT(probes >= 1 && probes <= MX_BLOOM_MAX_PROBES, "Probes must be in 1 to MX_BLOOM_MAX_PROBES.");
+
+    blocks = blocks ? blocks : 1;
+    MX_ASSERT((uint64_t)blocks <= UINT32_MAX && blocks <= (SIZE_MAX - MX_BLOOM_BLOCK) / MX_BLOOM_BLOCK, "Too many blocks.");
+
+    mx_bloom_alloc(bloom, blocks, probes, seed);
+    MX_ASSERT_OOM(bloom->memory);
+
+    mx_bloom_clear(bloom);
+}
+
+MX_IMPL void mx_bloom_destroy(mx_bloom_t *bloom)
+{
+    MX_ASSERT_SELFPTR(bloom);
+
+    if (bloom->memory)
+        IAllocator_free(bloom->allocator, bloom->memory, bloom->memory_size);
+
+    bloom->memory = NULL;
+    bloom->words = NULL;
+    bloom->blocks = 0;
+}
+
+MX_IMPL void mx_bloom_clear(mx_bloom_t *bloom)
+{
+    MX_ASSERT_SELFPTR(bloom);
+    memset((void*)bloom->words, 0, bloom->blocks * MX_BLOOM_BLOCK);
+}
+
+MX_IMPL uint64_t mx_bloom_hash(const mx_bloom_t *bloom, const void *key, size_t length)
+{
+    MX_ASSERT_SELFPTR(bloom);
+    return mx_sketch_hash(key, length, bloom->seed);
+}
+
+MX_IMPL void mx_bloom_add_hash(mx_bloom_t *bloom, uint64_t hash)
+{
+    MX_ASSERT_SELFPTR(bloom);
+
+    _Atomic uint64_t *block = mx_bloom_block(bloom, hash);
+    uint64_t masks[8];
+    mx_bloom_masks(bloom, hash, masks);
+
+    for (int i = 0; i < 8; i++)
+        MX_STORE(&block[i], MX_LOAD(&block[i]) | masks[i]);
+}
+
+MX_IMPL void mx_bloom_add_hash_concurrent(mx_bloom_t *bloom, uint64_t hash)
+{
+    MX_ASSERT_SELFPTR(bloom);
+
+    _Atomic uint64_t *block = mx_bloom_block(bloom, hash);
+    uint64_t masks[8];
+    mx_bloom_masks(bloom, hash, masks);
+
+    /* Skip the locked instruction for words without a probe or already set. */
+    for (int i = 0; i < 8; i++)
+        if ((MX_LOAD(&block[i]) & masks[i]) != masks[i])
+            atomic_fetch_or_explicit(&block[i], masks[i], memory_order_relaxed);
+}
+
+MX_IMPL bool mx_bloom_contains_hash(const mx_bloom_t *bloom, uint64_t hash)
+{
+    MX_ASSERT_SELFPTR(bloom);
+
+    _Atomic uint64_t *block = mx_bloom_block(bloom, hash);
+    uint64_t masks[8], missing = 0;
+    mx_bloom_masks(bloom, hash, masks);
+
+    for (int i = 0; i < 8; i++)
+        missing |= masks[i] & ~MX_LOAD(&block[i]);
+
+    return missing == 0;
+}
+
+MX_IMPL void mx_bloom_add(mx_bloom_t *bloom, const void *key, size_t length)
+{
+    mx_bloom_add_hash(bloom, mx_bloom_hash(bloom, key, length));
+}
+
+MX_IMPL void mx_bloom_add_concurrent(mx_bloom_t *bloom, const void *key, size_t length)
+{
+    mx_bloom_add_hash_concurrent(bloom, mx_bloom_hash(bloom, key, length));
+}
+
+MX_IMPL bool mx_bloom_contains(const mx_bloom_t *bloom, const void *key, size_t length)
+{
+    return mx_bloom_contains_hash(bloom, mx_bloom_hash(bloom, key, length));
+}
+
+/** Hash a group of keys and prefetch their blocks. */
+static size_t mx_bloom_prepare(const mx_bloom_t *bloom, const void *const *keys, const size_t *lengths, size_t count, uint64_t *hashes)
+{
+    size_t n = count < MX_SKETCH_BATCH ? count : MX_SKETCH_BATCH;
+
+    for (size_t i = 0; i < n; i++)
+    {
+        hashes[i] = mx_bloom_hash(bloom, keys[i], lengths[i]);
+        __builtin_prefetch((const void*)mx_bloom_block(bloom, hashes[i]));
+    }
+
+    return n;
+}
+
+MX_IMPL void mx_bloom_add_batch(mx_bloom_t *bloom, const void *const *keys, const size_t *lengths, size_t count)
+{
+    MX_ASSERT_SELFPTR(bloom);
+
+    uint64_t hashes[MX_SKETCH_BATCH];
+
+    for (size_t base = 0; base < count; )
+    {
+        size_t n = mx_bloom_prepare(bloom, keys + base, lengths + base, count - base, hashes);
+
+        for (size_t i = 0; i < n; i++)
+            mx_bloom_add_hash(bloom, hashes[i]);
+
+        base += n;
+    }
+}
+
+MX_IMPL void mx_bloom_add_batch_concurrent(mx_bloom_t *bloom, const void *const *keys, const size_t *lengths, size_t count)
+{
+    MX_ASSERT_SELFPTR(bloom);
+
+    uint64_t hashes[MX_SKETCH_BATCH];
+
+    for (size_t base = 0; base < count; )
+    {
+        size_t n = mx_bloom_prepare(bloom, keys + base, lengths + base, count - base, hashes);
+
+        for (size_t i = 0; i < n; i++)
+            mx_bloom_add_hash_concurrent(bloom, hashes[i]);
+
+        base += n;
+    }
+}
+
+MX_IMPL size_t mx_bloom_contains_batch(const mx_bloom_t *bloom, const void *const *keys, const size_t *lengths, size_t count, bool *results)
+{
+    MX_ASSERT_SELFPTR(bloom);
+    MX_ASSERT_PTR(results, "Results must be non-null.");
+
+    uint64_t hashes[MX_SKETCH_BATCH];
+    size_t found = 0;
+
+    for (size_t base = 0; base < count; )
+    {
+        size_t n = mx_bloom_prepare(bloom, keys + base, lengths + base, count - base, hashes);
+
+        for (size_t i = 0; i < n; i++)
+            found += (results[base + i] = mx_bloom_contains_hash(bloom, hashes[i]));
+
+        base += n;
+    }
+
+    return found;
+}
+
+MX_IMPL bool mx_bloom_save(const mx_bloom_t *bloom, fatptr_t(IStream) stream)
+{
+    MX_ASSERT_SELFPTR(bloom);
+
+    if (!mx_sketch_write_header(stream, mx_bloom_magic, bloom->blocks, bloom->probes, bloom->seed))
+        return false;
+
+    unsigned char buffer[MX_SKETCH_CHUNK];
+    size_t words = bloom->blocks * (MX_BLOOM_BLOCK / 8);
+
+    for (size_t base = 0; base < words; base += MX_SKETCH_CHUNK / 8)
+    {
+        size_t n = words - base < MX_SKETCH_CHUNK / 8 ? words - base : MX_SKETCH_CHUNK / 8;
+
+        for (size_t i = 0; i < n; i++)
+            mx_sketch_put64(buffer + 8 * i, MX_LOAD(&bloom->words[base + i]));
+
+        if (!mx_sketch_write(stream, buffer, 8 * n))
+            return false;
+    }
+
+    return true;
+}
+
+MX_IMPL bool mx_bloom_load(mx_bloom_t *bloom, fatptr_t(IStream) stream)
+{
+    MX_ASSERT_SELFPTR(bloom);
+
+    uint64_t blocks, probes, seed;
+
+    if (!mx_sketch_read_header(stream, mx_bloom_magic, &blocks, &probes, &seed))
+        return false;
+
+    if (blocks == 0 || blocks > UINT32_MAX || blocks > (SIZE_MAX - MX_BLOOM_BLOCK) / MX_BLOOM_BLOCK
+        || probes == 0 || probes > MX_BLOOM_MAX_PROBES)
+        return false;
+
+    /*
+     * The header may claim more than the stream holds. Allocation failure is
+     * bad input here, and the memory is not cleared, so pages are only
+     * touched as far as the data goes.
+     */
+    if (!mx_bloom_alloc(bloom, (size_t)blocks, (unsigned)probes, seed))
+        return false;
+
+    unsigned char buffer[MX_SKETCH_CHUNK];
+    size_t words = bloom->blocks * (MX_BLOOM_BLOCK / 8);
+
+    for (size_t base = 0; base < words; base += MX_SKETCH_CHUNK / 8)
+    {
+        size_t n = words - base < MX_SKETCH_CHUNK / 8 ? words - base : MX_SKETCH_CHUNK / 8;
+
+        if (!mx_sketch_read(stream, buffer, 8 * n))
+        {
+            mx_bloom_destroy(bloom);
+            return false;
+        }
+
+        for (size_t i = 0; i < n; i++)
+            MX_STORE(&bloom->words[base + i], mx_sketch_get64(buffer + 8 * i));
+    }
+
+    return true;
+}
+
+/*
+ * Count-min sketch. Row r of a key counts at start + r * step, so the rows
+ * are independent enough with a single hash.
+ */
+
+static _Atomic uint32_t *mx_cms_counter(const mx_cms_t *cms, unsigned row, uint32_t at)
+{
+    return cms->counters + row * cms->width + mx_sketch_range(at, cms->width);
+}
+
+MX_IMPL void mx_cms_init(mx_cms_t *cms, double epsilon, double delta)
+{
+    MX_ASSERT(epsilon > 0 && epsilon < 1, "Epsilon must be in (0, 1).");
+    MX_ASSERT(delta > 0 && delta < 1, "Delta must be in (0, 1).");
+
+    double depth = ceil(log(1 / delta));
+    depth = depth < 1 ? 1 : depth > MX_CMS_MAX_DEPTH ? MX_CMS_MAX_DEPTH : depth;
+    mx_cms_init_shape(cms, (size_t)ceil(MX_E / epsilon), (unsigned)depth, 0);
+}
+
+/** Allocate the counters of a sketch without clearing them. False if out of memory. */
+static bool mx_cms_alloc(mx_cms_t *cms, size_t width, unsigned depth, uint64_t seed)
+{
+    cms->width = width;
+    cms->depth = depth;
+    cms->seed = seed;
+    cms->allocator = mx_get_allocator();
+    cms->counters = IAllocator_alloc(cms->allocator, width * depth * sizeof(uint32_t), MX_ALLOC_ALIGN);
+    return cms->counters != NULL;
+}
+
+MX_IMPL void mx_cms_init_shape(mx_cms_t *cms, size_t width, unsigned depth, uint64_t seed)
+{
+    MX_ASSERT_SELFPTR(cms);
+    MX_ASSERT(depth >= 1 && depth <= MX_CMS_MAX_DEPTH, "Depth must be in 1 to MX_CMS_MAX_DEPTH.");
+
+    width = width ? width : 1;
+    MX_ASSERT((uint64_t)width <= UINT32_MAX && width <= SIZE_MAX / sizeof(uint32_t) / depth, "Too many counters.");
+
+    mx_cms_alloc(cms, width, depth, seed);
+    MX_ASSERT_OOM(cms->counters);
+
+    mx_cms_clear(cms);
+}
+
+MX_IMPL void mx_cms_destroy(mx_cms_t *cms)
+{
+    MX_ASSERT_SELFPTR(cms);
+
+    if (cms->counters)
+        IAllocator_free(cms->allocator, (void*)cms->counters, cms->width * cms->depth * sizeof(uint32_t));
+
+    cms->counters = NULL;
+    cms->width = 0;
+}
+
+MX_IMPL void mx_cms_clear(mx_cms_t *cms)
+{
+    MX_ASSERT_SELFPTR(cms);
+    memset((void*)cms->counters, 0, cms->width * cms->depth * sizeof(uint32_t));
+}
+
+MX_IMPL uint64_t mx_cms_hash(const mx_cms_t *cms, const void *key, size_t length)
+{
+    MX_ASSERT_SELFPTR(cms);
+    return mx_sketch_hash(key, length, cms->seed);
+}
+
+MX_IMPL void mx_cms_add_hash(mx_cms_t *cms, uint64_t hash, uint32_t count)
+{
+    MX_ASSERT_SELFPTR(cms);
+
+    uint32_t at = mx_sketch_start(hash), step = mx_sketch_step(hash);
+
+    for (unsigned r = 0; r < cms->depth; r++, at += step)
+    {
+        _Atomic uint32_t *counter = mx_cms_counter(cms, r, at);
+        uint32_t value = MX_LOAD(counter);
+        MX_STORE(counter, value > UINT32_MAX - count ? UINT32_MAX : value + count);
+    }
+}
+
+MX_IMPL void mx_cms_add_hash_concurrent(mx_cms_t *cms, uint64_t hash, uint32_t count)
+{
+    MX_ASSERT_SELFPTR(cms);
+
+    uint32_t at = mx_sketch_start(hash), step = mx_sketch_step(hash);
+
+    for (unsigned r = 0; r < cms->depth; r++, at += step)
+    {
+        _Atomic uint32_t *counter = mx_cms_counter(cms, r, at);
+        uint32_t value = MX_LOAD(counter);
+
+        /* Saturate like mx_cms_add_hash(), a wrapped count would underestimate. */
+        while (value != UINT32_MAX && !atomic_compare_exchange_weak_explicit(counter, &value,
+                value > UINT32_MAX - count ? UINT32_MAX : value + count, memory_order_relaxed, memory_order_relaxed))
+            ;
+    }
+}
+
+MX_IMPL uint32_t mx_cms_estimate_hash(const mx_cms_t *cms, uint64_t hash)
+{
+    MX_ASSERT_SELFPTR(cms);
+
+    uint32_t at = mx_sketch_start(hash), step = mx_sketch_step(hash);
+    uint32_t estimate = UINT32_MAX;
+
+    for (unsigned r = 0; r < cms->depth; r++, at += step)
+    {
+        uint32_t value = MX_LOAD(mx_cms_counter(cms, r, at));
+        estimate = value < estimate ? value : estimate;
+    }
+
+    return estimate;
+}
+
+MX_IMPL void mx_cms_add(mx_cms_t *cms, const void *key, size_t length, uint32_t count)
+{
+    mx_cms_add_hash(cms, mx_cms_hash(cms, key, length), count);
+}
+
+MX_IMPL void mx_cms_add_concurrent(mx_cms_t *cms, const void *key, size_t length, uint32_t count)
+{
+    mx_cms_add_hash_concurrent(cms, mx_cms_hash(cms, key, length), count);
+}
+
+MX_IMPL uint32_t mx_cms_estimate(const mx_cms_t *cms, const void *key, size_t length)
+{
+    return mx_cms_estimate_hash(cms, mx_cms_hash(cms, key, length));
+}
+
+/** Hash a group of keys and prefetch the counters of every row. */
+static size_t mx_cms_prepare(const mx_cms_t *cms, const void *const *keys, const size_t *lengths, size_t count, uint64_t *hashes)
+{
+    size_t n = count < MX_SKETCH_BATCH ? count : MX_SKETCH_BATCH;
+
+    for (size_t i = 0; i < n; i++)
+    {
+        hashes[i] = mx_cms_hash(cms, keys[i], lengths[i]);
+
+        uint32_t at = mx_sketch_start(hashes[i]), step = mx_sketch_step(hashes[i]);
+
+        for (unsigned r = 0; r < cms->depth; r++, at += step)
+            __builtin_prefetch((const void*)mx_cms_counter(cms, r, at));
+    }
+
+    return n;
+}
+
+MX_IMPL void mx_cms_add_batch(mx_cms_t *cms, const void *const *keys, const size_t *lengths, size_t count)
+{
+    MX_ASSERT_SELFPTR(cms);
+
+    uint64_t hashes[MX_SKETCH_BATCH];
+
+    for (size_t base = 0; base < count; )
+    {
+        size_t n = mx_cms_prepare(cms, keys + base, lengths + base, count - base, hashes);
+
+        for (size_t i = 0; i < n; i++)
+            mx_cms_add_hash(cms, hashes[i], 1);
+
+        base += n;
+    }
+}
+
+MX_IMPL void mx_cms_add_batch_concurrent(mx_cms_t *cms, const void *const *keys, const size_t *lengths, size_t count)
+{
+    MX_ASSERT_SELFPTR(cms);
+
+    uint64_t hashes[MX_SKETCH_BATCH];
+
+    for (size_t base = 0; base < count; )
+    {
+        size_t n = mx_cms_prepare(cms, keys + base, lengths + base, count - base, hashes);
+
+        for (size_t i = 0; i < n; i++)
+            mx_cms_add_hash_concurrent(cms, hashes[i], 1);
+
+        base += n;
+    }
+}
+
+MX_IMPL void mx_cms_estimate_batch(const mx_cms_t *cms, const void *const *keys, const size_t *lengths, size_t count, uint32_t *estimates)
+{
+    MX_ASSERT_SELFPTR(cms);
+    MX_ASSERT_PTR(estimates, "Estimates must be non-null.");
+
+    uint64_t hashes[MX_SKETCH_BATCH];
+
+    for (size_t base = 0; base < count; )
+    {
+        size_t n = mx_cms_prepare(cms, keys + base, lengths + base, count - base, hashes);
+
+        for (size_t i = 0; i < n; i++)
+            estimates[base + i] = mx_cms_estimate_hash(cms, hashes[i]);
+
+        base += n;
+    }
+}
+
+MX_IMPL bool mx_cms_save(const mx_cms_t *cms, fatptr_t(IStream) stream)
+{
+    MX_ASSERT_SELFPTR(cms);
+
+    if (!mx_sketch_write_header(stream, mx_cms_magic, cms->width, cms->depth, cms->seed))
+        return false;
+
+    unsigned char buffer[MX_SKETCH_CHUNK];
+    size_t counters = cms->width * cms->depth;
+
+    for (size_t base = 0; base < counters; base += MX_SKETCH_CHUNK / 4)
+    {
+        size_t n = counters - base < MX_SKETCH_CHUNK / 4 ? counters - base : MX_SKETCH_CHUNK / 4;
+
+        for (size_t i = 0; i < n; i++)
+        {
+            uint32_t v = MX_LOAD(&cms->counters[base + i]);
+
+            for (int b = 0; b < 4; b++)
+                buffer[4 * i + b] = (unsigned char)(v >> (8 * b));
+        }
+
+        if (!mx_sketch_write(stream, buffer, 4 * n))
+            return false;
+    }
+
+    return true;
+}
+
+MX_IMPL bool mx_cms_load(mx_cms_t *cms, fatptr_t(IStream) stream)
+{
+    MX_ASSERT_SELFPTR(cms);
+
+    uint64_t width, depth, seed;
+
+    if (!mx_sketch_read_header(stream, mx_cms_magic, &width, &depth, &seed))
+        return false;
+
+    if (depth == 0 || depth > MX_CMS_MAX_DEPTH || width == 0 || width > UINT32_MAX
+        || width > SIZE_MAX / sizeof(uint32_t) / depth)
+        return false;
+
+    /* As for mx_bloom_load(), a bad header must not abort on allocation. */
+    if (!mx_cms_alloc(cms, (size_t)width, (unsigned)depth, seed))
+        return false;
+
+    unsigned char buffer[MX_SKETCH_CHUNK];
+    size_t counters = cms->width * cms->depth;
+
+    for (size_t base = 0; base < counters; base += MX_SKETCH_CHUNK / 4)
+    {
+        size_t n = counters - base < MX_SKETCH_CHUNK / 4 ? counters - base : MX_SKETCH_CHUNK / 4;
+
+        if (!mx_sketch_read(stream, buffer, 4 * n))
+        {
+            mx_cms_destroy(cms);
+            return false;
+        }
+
+        for (size_t i = 0; i < n; i++)
+        {
+            uint32_t v = 0;
+
+            for (int b = 0; b < 4; b++)
+                v |= (uint32_t)buffer[4 * i + b] << (8 * b);
+
+            MX_STORE(&cms->counters[base + i], v);
+        }
+    }
+
+    return true;
+}
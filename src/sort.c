@@ -0,0 +1,63 @@
+#include "mx/sort.h"
+
+/*
+ * Keys that sort in the same order as the values. Signed integers have their
+ * sign bit flipped. Negative floats have all bits flipped, so larger
+ * magnitudes sort first, and positive floats have their sign bit set.
+ */
+
+#define MX_KEY_U32(x) (x)
+#define MX_KEY_U64(x) (x)
+#define MX_KEY_I32(x) ((uint32_t)(x) ^ 0x80000000u)
+#define MX_KEY_I64(x) ((uint64_t)(x) ^ 0x8000000000000000ull)
+
+static uint32_t mx_key_f32(float x)
+{
+    uint32_t bits;
+    memcpy(&bits, &x, sizeof bits);
+    return bits ^ ((uint32_t)((int32_t)bits >> 31) | 0x80000000u);
+}
+
+static uint64_t mx_key_f64(double x)
+{
+    uint64_t bits;
+    memcpy(&bits, &x, sizeof bits);
+    return bits ^ ((uint64_t)((int64_t)bits >> 63) | 0x8000000000000000ull);
+}
+
+MX_SORT_DEFINE_RADIX(mx_u32, uint32_t, uint32_t, MX_KEY_U32)
+MX_SORT_DEFINE_RADIX(mx_i32, int32_t,  uint32_t, MX_KEY_I32)
+MX_SORT_DEFINE_RADIX(mx_u64, uint64_t, uint64_t, MX_KEY_U64)
+MX_SORT_DEFINE_RADIX(mx_i64, int64_t,  uint64_t, MX_KEY_I64)
+MX_SORT_DEFINE_RADIX(mx_f32, float,    uint32_t, mx_key_f32)
+MX_SORT_DEFINE_RADIX(mx_f64, double,   uint64_t, mx_key_f64)
+
+MX_IMPL void mx_sort_u32(uint32_t *a, size_t n)
+{
+    mx_u32_radix_sort(a, n);
+}
+
+MX_IMPL void mx_sort_i32(int32_t *a, size_t n)
+{
+    mx_i32_radix_sort(a, n);
+}
+
+MX_IMPL void mx_sort_u64(uint64_t *a, size_t n)
+{
+    mx_u64_radix_sort(a, n);
+}
+
+MX_IMPL void mx_sort_i64(int64_t *a, size_t n)
+{
+    mx_i64_radix_sort(a, n);
+}
+
+MX_IMPL void mx_sort_f32(float *a, size_t n)
+{
+    mx_f32_radix_sort(a, n);
+}
+
+MX_IMPL void mx_sort_f64(double *a, size_t n)
+{
+    mx_f64_radix_sort(a, n);
+}
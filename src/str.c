@@ -0,0 +1,135 @@
+#include "mx/str.h"
+#include "mx/digest.h"
+#include "mx/assert.h"
+
+/** Slots of a new table. */
+#define MX_INTERN_INITIAL 64
+
+/*
+ * Linear probing over (hash, string) pairs. The full hash is kept so a probe
+ * only compares text when the hashes match, and so growing never rehashes.
+ * Strings are stored in the arena as [length][bytes][NUL].
+ */
+
+struct mx_intern_entry_t {
+    uint64_t hash;
+    const char *str;            /**< NULL for an empty slot. */
+};
+
+MX_IMPL uint64_t mx_str_hash(mx_str_t str)
+{
+    wyhash64_t hash;
+    mx_wyhash64(&hash, str.ptr, str.len);
+    return hash;
+}
+
+MX_IMPL void mx_intern_init(mx_intern_t *table)
+{
+    MX_ASSERT_SELFPTR(table);
+
+    mx_arena_init(&table->arena, 0);
+    table->entries = NULL;
+    table->count = 0;
+    table->mask = 0;
+    table->allocator = mx_get_allocator();
+}
+
+MX_IMPL void mx_intern_destroy(mx_intern_t *table)
+{
+    MX_ASSERT_SELFPTR(table);
+
+    if (table->entries)
+        IAllocator_free(table->allocator, table->entries, (table->mask + 1) * sizeof(mx_intern_entry_t));
+
+    mx_arena_destroy(&table->arena);
+    table->entries = NULL;
+    table->count = 0;
+    table->mask = 0;
+}
+
+static mx_intern_entry_t *mx_intern_probe(mx_intern_t *table, mx_str_t str, uint64_t hash)
+{
+    for (size_t i = (size_t)hash & table->mask; ; i = (i + 1) & table->mask)
+    {
+        mx_intern_entry_t *entry = &table->entries[i];
+
+        if (entry->str == NULL)
+            return entry;
+
+        if (entry->hash == hash && mx_str_equal(mx_intern_str(entry->str), str))
+            return entry;
+    }
+}
+
+static void mx_intern_grow(mx_intern_t *table)
+{
+    size_t capacity = table->entries ? (table->mask + 1) * 2 : MX_INTERN_INITIAL;
+    mx_intern_entry_t *entries = IAllocator_alloc(table->allocator, capacity * sizeof(mx_intern_entry_t), MX_ALLOC_ALIGN);
+    MX_ASSERT_OOM(entries);
+
+    memset(entries, 0, capacity * sizeof(mx_intern_entry_t));
+
+    if (table->entries)
+    {
+        for (size_t i = 0; i <= table->mask; i++)
+        {
+            mx_intern_entry_t *old = &table->entries[i];
+
+            if (old->str == NULL)
+                continue;
+
+            size_t j = (size_t)old->hash & (capacity - 1);
+
+            while (entries[j].str != NULL)
+                j = (j + 1) & (capacity - 1);
+
+            entries[j] = *old;
+        }
+
+        IAllocator_free(table->allocator, table->entries, (table->mask + 1) * sizeof(mx_intern_entry_t));
+    }
+
+    table->entries = entries;
+    table->mask = capacity - 1;
+}
+
+MX_IMPL const char *mx_intern(mx_intern_t *table, mx_str_t str)
+{
+    MX_ASSERT_SELFPTR(table);
+
+    /* Keep the load under 3/4 so probe runs stay short. */
+    if (table->entries == NULL || (table->count + 1) * 4 > (table->mask + 1) * 3)
+        mx_intern_grow(table);
+
+    uint64_t hash = mx_str_hash(str);
+    mx_intern_entry_t *entry = mx_intern_probe(table, str, hash);
+
+    if (entry->str)
+        return entry->str;
+
+    size_t *copy = mx_arena_alloc(&table->arena, sizeof(size_t) + str.len + 1, _Alignof(size_t));
+    MX_ASSERT_OOM(copy);
+
+    char *text = (char*)(copy + 1);
+    copy[0] = str.len;
+
+    if (str.len)
+        memcpy(text, str.ptr, str.len);
+
+    text[str.len] = '\0';
+
+    entry->hash = hash;
+    entry->str = text;
+    table->count++;
+    return text;
+}
+
+MX_IMPL const char *mx_intern_find(mx_intern_t *table, mx_str_t str)
+{
+    MX_ASSERT_SELFPTR(table);
+
+    if (table->entries == NULL)
+        return NULL;
+
+    return mx_intern_probe(table, str, mx_str_hash(str))->str;
+}
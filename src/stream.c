@@ -6,6 +6,56 @@
 
 #include "mx/assert.h"
 
+MX_API mx_len_t IStream_readv(fatptr_t(IStream) str, const mx_iovec_t *iov, int count)
+{
+    MX_ASSERT(count == 0 || iov, "Buffers must be non-null.");
+
+    if (str.traits->readv)
+        return fatptr_vcall(str, readv, iov, count);
+
+    mx_len_t total = 0;
+
+    for (int i = 0; i < count; i++)
+    {
+        mx_len_t n = IStream_read(str, iov[i].data, (mx_len_t)iov[i].size);
+
+        if (n < 0)
+            return total ? total : n;
+
+        total += n;
+
+        if ((size_t)n < iov[i].size)
+            break;
+    }
+
+    return total;
+}
+
+MX_API mx_len_t IStream_writev(fatptr_t(IStream) str, const mx_iovec_t *iov, int count)
+{
+    MX_ASSERT(count == 0 || iov, "Buffers must be non-null.");
+
+    if (str.traits->writev)
+        return fatptr_vcall(str, writev, iov, count);
+
+    mx_len_t total = 0;
+
+    for (int i = 0; i < count; i++)
+    {
+        mx_len_t n = IStream_write(str, iov[i].data, (mx_len_t)iov[i].size);
+
+        if (n < 0)
+            return total ? total : n;
+
+        total += n;
+
+        if ((size_t)n < iov[i].size)
+            break;
+    }
+
+    return total;
+}
+
 MX_API void IStream_printf(fatptr_t(IStream) str, const char *format, ...)
 {
     va_list va;
@@ -29,12 +79,13 @@ MX_API void IStream_vprintf(fatptr_t(IStream) str, const char *format, va_list v
         return;
     }
 
-    char *buffer2 = malloc(size+1);
+    fatptr_t(IAllocator) allocator = mx_get_allocator();
+    char *buffer2 = IAllocator_alloc(allocator, size+1, 1);
     MX_ASSERT_OOM(buffer2);
 
     va_copy(va2, va);
     vsnprintf(buffer2, size+1, format, va2);
     IStream_write(str, buffer2, size);
-    free(buffer2);
+    IAllocator_free(allocator, buffer2, size+1);
     va_end(va2);
 }
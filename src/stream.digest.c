@@ -0,0 +1,188 @@
+#include "mx/io/digest_stream.h"
+#include "mx/assert.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct mx_digest_stream_t {
+    fatptr_t(IStream) base;
+    const mx_digest_algorithm_t *algorithm;
+    bool own;
+    mx_digest_ctx_t ctx;
+} mx_digest_stream_t;
+
+static size_t mx_digest_stream_IObject_get_size(mx_digest_stream_t *self);
+static size_t mx_digest_stream_IObject_to_string(mx_digest_stream_t *self, char *buffer, size_t max);
+static void   mx_digest_stream_IObject_destruct(mx_digest_stream_t *self);
+
+static mx_stream_flags mx_digest_stream_IStream_get_flags(mx_digest_stream_t *self);
+static mx_len_t mx_digest_stream_IStream_read(mx_digest_stream_t *self, char *buffer, mx_len_t max);
+static mx_len_t mx_digest_stream_IStream_seek(mx_digest_stream_t *self, mx_len_t offset, IStream_SeekOrigin origin);
+static mx_len_t mx_digest_stream_IStream_write(mx_digest_stream_t *self, const char *buffer, mx_len_t max);
+static void mx_digest_stream_IStream_close(mx_digest_stream_t *self);
+static mx_len_t mx_digest_stream_IStream_borrow(mx_digest_stream_t *self, const char **data, mx_len_t max);
+static mx_len_t mx_digest_stream_IStream_readv(mx_digest_stream_t *self, const mx_iovec_t *iov, int count);
+static mx_len_t mx_digest_stream_IStream_writev(mx_digest_stream_t *self, const mx_iovec_t *iov, int count);
+
+const IStream fat_vtable(mx_digest_stream_t, IStream) = {
+    .Object = {
+        .get_size  = (void*)mx_digest_stream_IObject_get_size,
+        .get_type  = NULL,
+        .to_string = (void*)mx_digest_stream_IObject_to_string,
+        .destruct  = (void*)mx_digest_stream_IObject_destruct
+    },
+    .get_flags = (void*)mx_digest_stream_IStream_get_flags,
+    .read = (void*)mx_digest_stream_IStream_read,
+    .seek = (void*)mx_digest_stream_IStream_seek,
+    .write = (void*)mx_digest_stream_IStream_write,
+    .close = (void*)mx_digest_stream_IStream_close,
+    .borrow = (void*)mx_digest_stream_IStream_borrow,
+    .readv = (void*)mx_digest_stream_IStream_readv,
+    .writev = (void*)mx_digest_stream_IStream_writev,
+};
+
+static size_t mx_digest_stream_IObject_get_size(mx_digest_stream_t *self)
+{
+    return sizeof(*self);
+}
+
+static size_t mx_digest_stream_IObject_to_string(mx_digest_stream_t *self, char *buffer, size_t max)
+{
+    int n = snprintf(buffer, max, "%s(", self->algorithm->name);
+
+    if (n < 0 || (size_t)n >= max)
+        return n < 0 ? 0 : max;
+
+    size_t len = n + IObject_to_string(IStream_AsIObject(self->base), buffer + n, max - n);
+
+    if (len + 1 < max)
+    {
+        buffer[len++] = ')';
+        buffer[len] = '\0';
+    }
+
+    return len;
+}
+
+static void mx_digest_stream_IObject_destruct(mx_digest_stream_t *self)
+{
+    if (self->own)
+        IObject_destruct(IStream_AsIObject(self->base));
+
+    free(self);
+}
+
+static mx_stream_flags mx_digest_stream_IStream_get_flags(mx_digest_stream_t *self)
+{
+    return IStream_flags(self->base);
+}
+
+static mx_len_t mx_digest_stream_IStream_read(mx_digest_stream_t *self, char *buffer, mx_len_t max)
+{
+    mx_len_t n = IStream_read(self->base, buffer, max);
+
+    if (n > 0)
+        self->algorithm->update(&self->ctx, buffer, n);
+
+    return n;
+}
+
+static mx_len_t mx_digest_stream_IStream_seek(mx_digest_stream_t *self, mx_len_t offset, IStream_SeekOrigin origin)
+{
+    return IStream_seek(self->base, offset, origin);
+}
+
+static mx_len_t mx_digest_stream_IStream_write(mx_digest_stream_t *self, const char *buffer, mx_len_t max)
+{
+    mx_len_t n = IStream_write(self->base, buffer, max);
+
+    if (n > 0)
+        self->algorithm->update(&self->ctx, buffer, n);
+
+    return n;
+}
+
+static void mx_digest_stream_IStream_close(mx_digest_stream_t *self)
+{
+    IStream_close(self->base);
+}
+
+static mx_len_t mx_digest_stream_IStream_borrow(mx_digest_stream_t *self, const char **data, mx_len_t max)
+{
+    mx_len_t n = IStream_borrow(self->base, data, max);
+
+    if (n > 0)
+        self->algorithm->update(&self->ctx, *data, n);
+
+    return n;
+}
+
+/** Hash the first n bytes of the buffers. */
+static void mx_digest_stream_update_iov(mx_digest_stream_t *self, const mx_iovec_t *iov, int count, mx_len_t n)
+{
+    for (int i = 0; i < count && n > 0; i++)
+    {
+        size_t size = iov[i].size < (size_t)n ? iov[i].size : (size_t)n;
+
+        self->algorithm->update(&self->ctx, iov[i].data, size);
+        n -= (mx_len_t)size;
+    }
+}
+
+static mx_len_t mx_digest_stream_IStream_readv(mx_digest_stream_t *self, const mx_iovec_t *iov, int count)
+{
+    mx_len_t n = IStream_readv(self->base, iov, count);
+    mx_digest_stream_update_iov(self, iov, count, n);
+    return n;
+}
+
+static mx_len_t mx_digest_stream_IStream_writev(mx_digest_stream_t *self, const mx_iovec_t *iov, int count)
+{
+    mx_len_t n = IStream_writev(self->base, iov, count);
+    mx_digest_stream_update_iov(self, iov, count, n);
+    return n;
+}
+
+MX_IMPL fatptr_t(IStream) mx_digest_stream_open(fatptr_t(IStream) base, const mx_digest_algorithm_t *algorithm, bool own)
+{
+    MX_ASSERT_PTR(base.ptr, "Base stream must be valid.");
+    MX_ASSERT_PTR(algorithm, "Digest algorithm must be valid.");
+    MX_ASSERT(algorithm->context_size <= sizeof(mx_digest_ctx_t), "Digest context does not fit mx_digest_ctx_t.");
+
+    mx_digest_stream_t *self = malloc(sizeof(mx_digest_stream_t));
+    if (!self)
+    {
+        /* Ownership was handed over, so the base goes even on failure. */
+        if (own)
+            IObject_destruct(IStream_AsIObject(base));
+
+        return fat_new(NULL, fat_vtable(mx_digest_stream_t, IStream), IStream);
+    }
+
+    self->base = base;
+    self->algorithm = algorithm;
+    self->own = own;
+    algorithm->init(&self->ctx);
+
+    return fat_new(self, fat_vtable(mx_digest_stream_t, IStream), IStream);
+}
+
+MX_IMPL void mx_digest_stream_result(fatptr_t(IStream) str, void *digest)
+{
+    MX_ASSERT(str.traits == &fat_vtable(mx_digest_stream_t, IStream), "Stream must be a hashing stream.");
+
+    mx_digest_stream_t *self = str.ptr;
+    mx_digest_ctx_t ctx;
+
+    /* Finalize a copy, so hashing can continue after this. */
+    memcpy(&ctx, &self->ctx, self->algorithm->context_size);
+    self->algorithm->final(&ctx, digest);
+}
+
+MX_IMPL void mx_digest_stream_reset(fatptr_t(IStream) str)
+{
+    MX_ASSERT(str.traits == &fat_vtable(mx_digest_stream_t, IStream), "Stream must be a hashing stream.");
+
+    mx_digest_stream_t *self = str.ptr;
+    self->algorithm->init(&self->ctx);
+}
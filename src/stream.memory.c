@@ -0,0 +1,370 @@
+#include "mx/io/memory_stream.h"
+#include "mx/assert.h"
+#include <stdio.h>
+#include <string.h>
+
+/** Smallest buffer allocated by a growing stream. */
+#define MX_MEMORY_STREAM_MIN 64
+
+typedef struct mx_memory_t {
+    char *data;
+    size_t size;                    /**< End of the stream. */
+    size_t capacity;
+    size_t position;                /**< May be past the end after a seek. */
+    bool fixed;                     /**< data is the caller's and cannot grow. */
+    bool open;
+    bool eof;
+    fatptr_t(IAllocator) allocator;
+} mx_memory_t;
+
+static size_t mx_memory_IObject_get_size(mx_memory_t *self);
+static size_t mx_memory_IObject_to_string(mx_memory_t *self, char *buffer, size_t max);
+static void   mx_memory_IObject_destruct(mx_memory_t *self);
+
+static mx_stream_flags mx_memory_IStream_get_flags(mx_memory_t *self);
+static mx_len_t mx_memory_IStream_read(mx_memory_t *self, char *buffer, mx_len_t max);
+static mx_len_t mx_memory_IStream_seek(mx_memory_t *self, mx_len_t offset, IStream_SeekOrigin origin);
+static mx_len_t mx_memory_IStream_write(mx_memory_t *self, const char *buffer, mx_len_t max);
+static void mx_memory_IStream_close(mx_memory_t *self);
+static mx_len_t mx_memory_IStream_borrow(mx_memory_t *self, const char **data, mx_len_t max);
+static mx_len_t mx_memory_IStream_pread(mx_memory_t *self, char *buffer, mx_len_t max, mx_len_t offset);
+static mx_len_t mx_memory_IStream_pwrite(mx_memory_t *self, const char *buffer, mx_len_t size, mx_len_t offset);
+static mx_len_t mx_memory_IStream_readv(mx_memory_t *self, const mx_iovec_t *iov, int count);
+static mx_len_t mx_memory_IStream_writev(mx_memory_t *self, const mx_iovec_t *iov, int count);
+
+const IObject fat_vtable(mx_memory_t, IObject) = {
+    .get_size  = (void*)mx_memory_IObject_get_size,
+    .get_type  = NULL,
+    .to_string = (void*)mx_memory_IObject_to_string,
+    .destruct  = (void*)mx_memory_IObject_destruct
+};
+
+const IStream fat_vtable(mx_memory_t, IStream) = {
+    .Object = {
+        .get_size  = (void*)mx_memory_IObject_get_size,
+        .get_type  = NULL,
+        .to_string = (void*)mx_memory_IObject_to_string,
+        .destruct  = (void*)mx_memory_IObject_destruct
+    },
+    .get_flags = (void*)mx_memory_IStream_get_flags,
+    .read = (void*)mx_memory_IStream_read,
+    .seek = (void*)mx_memory_IStream_seek,
+    .write = (void*)mx_memory_IStream_write,
+    .close = (void*)mx_memory_IStream_close,
+    .borrow = (void*)mx_memory_IStream_borrow,
+    .pread = (void*)mx_memory_IStream_pread,
+    .pwrite = (void*)mx_memory_IStream_pwrite,
+    .readv = (void*)mx_memory_IStream_readv,
+    .writev = (void*)mx_memory_IStream_writev,
+};
+
+/** Grow the buffer to hold at least capacity bytes. */
+static bool mx_memory_grow(mx_memory_t *self, size_t capacity)
+{
+    if (capacity <= self->capacity)
+        return true;
+
+    if (self->fixed)
+        return false;
+
+    /* Double, so a run of small writes costs amortized constant time. */
+    size_t grown = self->capacity < MX_MEMORY_STREAM_MIN ? MX_MEMORY_STREAM_MIN : self->capacity;
+
+    while (grown < capacity)
+        grown = grown <= SIZE_MAX / 2 ? grown * 2 : capacity;
+
+    char *data = self->data ? IAllocator_realloc(self->allocator, self->data, self->capacity, grown, MX_ALLOC_ALIGN)
+                            : IAllocator_alloc(self->allocator, grown, MX_ALLOC_ALIGN);
+
+    if (!data)
+        return false;
+
+    self->data = data;
+    self->capacity = grown;
+    return true;
+}
+
+/**
+ * Copy size bytes in at offset, extending the stream as needed.
+ * @return Bytes copied, fewer than size once a fixed buffer is full.
+ */
+static size_t mx_memory_put(mx_memory_t *self, const void *src, size_t size, size_t offset)
+{
+    if (size == 0)
+        return 0;
+
+    size_t end = offset + size < offset ? SIZE_MAX : offset + size;
+
+    if (!mx_memory_grow(self, end))
+    {
+        if (!self->fixed)
+            return 0;
+
+        end = self->capacity;
+    }
+
+    if (offset >= end)
+        return 0;
+
+    /* Zero the gap left by a seek past the end. */
+    if (offset > self->size)
+        memset(self->data + self->size, 0, offset - self->size);
+
+    memcpy(self->data + offset, src, end - offset);
+
+    if (end > self->size)
+        self->size = end;
+
+    return end - offset;
+}
+
+/** Bytes from offset to the end, at most max. */
+static size_t mx_memory_available(mx_memory_t *self, size_t offset, mx_len_t max)
+{
+    if (max <= 0 || offset >= self->size)
+        return 0;
+
+    return (size_t)max < self->size - offset ? (size_t)max : self->size - offset;
+}
+
+static size_t mx_memory_IObject_get_size(mx_memory_t *self)
+{
+    return sizeof(*self);
+}
+
+static size_t mx_memory_IObject_to_string(mx_memory_t *self, char *buffer, size_t max)
+{
+    int n = snprintf(buffer, max, "memory %p+%zu", (void*)self->data, self->size);
+    return n < 0 ? 0 : (size_t)n < max ? (size_t)n : max;
+}
+
+static void mx_memory_IObject_destruct(mx_memory_t *self)
+{
+    if (!self->fixed && self->data)
+        IAllocator_free(self->allocator, self->data, self->capacity);
+
+    IAllocator_free(self->allocator, self, sizeof(*self));
+}
+
+static mx_stream_flags mx_memory_IStream_get_flags(mx_memory_t *self)
+{
+    if (!self->open)
+        return MX_STREAM_EOF;
+
+    return MX_STREAM_OPEN | (self->eof ? MX_STREAM_EOF : 0);
+}
+
+static mx_len_t mx_memory_IStream_read(mx_memory_t *self, char *buffer, mx_len_t max)
+{
+    if (!self->open || max <= 0)
+        return 0;
+
+    size_t n = mx_memory_available(self, self->position, max);
+
+    if (n)
+        memcpy(buffer, self->data + self->position, n);
+
+    self->position += n;
+    self->eof = n < (size_t)max;
+    return (mx_len_t)n;
+}
+
+static mx_len_t mx_memory_IStream_seek(mx_memory_t *self, mx_len_t offset, IStream_SeekOrigin origin)
+{
+    int64_t base = origin == ISTREAM_SEEK_START ? 0
+                 : origin == ISTREAM_SEEK_END ? (int64_t)self->size
+                 : (int64_t)self->position;
+
+    if (!self->open || base + offset < 0)
+        return -1;
+
+    self->position = (size_t)(base + offset);
+    self->eof = false;
+    return 0;
+}
+
+static mx_len_t mx_memory_IStream_write(mx_memory_t *self, const char *buffer, mx_len_t max)
+{
+    if (!self->open || max <= 0)
+        return 0;
+
+    size_t n = mx_memory_put(self, buffer, (size_t)max, self->position);
+
+    self->position += n;
+    return (mx_len_t)n;
+}
+
+static void mx_memory_IStream_close(mx_memory_t *self)
+{
+    /* The buffer stays readable through mx_memory_stream_data(). */
+    self->open = false;
+}
+
+static mx_len_t mx_memory_IStream_borrow(mx_memory_t *self, const char **data, mx_len_t max)
+{
+    if (!self->open)
+    {
+        *data = NULL;
+        return 0;
+    }
+
+    size_t n = mx_memory_available(self, self->position, max);
+
+    *data = n ? self->data + self->position : NULL;
+    self->position += n;
+    self->eof = n < (size_t)max;
+    return (mx_len_t)n;
+}
+
+static mx_len_t mx_memory_IStream_pread(mx_memory_t *self, char *buffer, mx_len_t max, mx_len_t offset)
+{
+    if (!self->open || offset < 0)
+        return -1;
+
+    size_t n = mx_memory_available(self, (size_t)offset, max);
+
+    if (n == 0)
+        return 0;
+
+    memcpy(buffer, self->data + offset, n);
+    return (mx_len_t)n;
+}
+
+/*
+ * Positional writes inside the stream only copy, so they may run on several
+ * threads at once. One that extends the stream may move the buffer and must
+ * not.
+ */
+
+static mx_len_t mx_memory_IStream_pwrite(mx_memory_t *self, const char *buffer, mx_len_t size, mx_len_t offset)
+{
+    if (!self->open || offset < 0)
+        return -1;
+
+    if (size <= 0)
+        return 0;
+
+    if ((size_t)offset <= self->size && (size_t)size <= self->size - (size_t)offset)
+    {
+        memcpy(self->data + offset, buffer, (size_t)size);
+        return size;
+    }
+
+    return (mx_len_t)mx_memory_put(self, buffer, (size_t)size, (size_t)offset);
+}
+
+static mx_len_t mx_memory_IStream_readv(mx_memory_t *self, const mx_iovec_t *iov, int count)
+{
+    mx_len_t total = 0;
+
+    for (int i = 0; i < count; i++)
+    {
+        mx_len_t n = mx_memory_IStream_read(self, iov[i].data, (mx_len_t)iov[i].size);
+
+        total += n;
+
+        if ((size_t)n < iov[i].size)
+            break;
+    }
+
+    return total;
+}
+
+static mx_len_t mx_memory_IStream_writev(mx_memory_t *self, const mx_iovec_t *iov, int count)
+{
+    if (!self->open)
+        return 0;
+
+    size_t size = 0;
+
+    for (int i = 0; i < count; i++)
+        size += iov[i].size;
+
+    /* Grow once for the whole record. A fixed buffer takes what fits. */
+    if (size && self->position + size > self->position)
+        mx_memory_grow(self, self->position + size);
+
+    mx_len_t total = 0;
+
+    for (int i = 0; i < count; i++)
+    {
+        size_t n = mx_memory_put(self, iov[i].data, iov[i].size, self->position);
+
+        self->position += n;
+        total += (mx_len_t)n;
+
+        if (n < iov[i].size)
+            break;
+    }
+
+    return total;
+}
+
+/** Allocate and set up the stream object. */
+static fatptr_t(IStream) mx_memory_new(char *data, size_t capacity, size_t size, bool fixed, fatptr_t(IAllocator) allocator)
+{
+    allocator = __mx_allocator(allocator);
+    mx_memory_t *self = IAllocator_alloc(allocator, sizeof(mx_memory_t), MX_ALLOC_ALIGN);
+
+    if (!self)
+        return fat_new(NULL, fat_vtable(mx_memory_t, IStream), IStream);
+
+    self->data = data;
+    self->size = size;
+    self->capacity = capacity;
+    self->position = 0;
+    self->fixed = fixed;
+    self->open = true;
+    self->eof = false;
+    self->allocator = allocator;
+    return fat_new(self, fat_vtable(mx_memory_t, IStream), IStream);
+}
+
+MX_IMPL fatptr_t(IStream) mx_memory_stream(size_t capacity, fatptr_t(IAllocator) allocator)
+{
+    fatptr_t(IStream) str = mx_memory_new(NULL, 0, 0, false, allocator);
+
+    if (str.ptr && capacity && !mx_memory_grow(str.ptr, capacity))
+    {
+        mx_memory_IObject_destruct(str.ptr);
+        str.ptr = NULL;
+    }
+
+    return str;
+}
+
+MX_IMPL fatptr_t(IStream) mx_memory_stream_fixed(void *buffer, size_t capacity, size_t size, fatptr_t(IAllocator) allocator)
+{
+    MX_ASSERT(buffer || !capacity, "Buffer must be non-null.");
+    MX_ASSERT(size <= capacity, "Size must fit the buffer.");
+
+    return mx_memory_new(buffer, capacity, size, true, allocator);
+}
+
+MX_IMPL char *mx_memory_stream_data(fatptr_t(IStream) str, size_t *size)
+{
+    MX_ASSERT(str.traits == &fat_vtable(mx_memory_t, IStream), "Stream must be a memory stream.");
+    MX_ASSERT_PTR(size, "Size must be non-null.");
+
+    mx_memory_t *self = str.ptr;
+    *size = self->size;
+    return self->data;
+}
+
+MX_IMPL bool mx_memory_stream_reserve(fatptr_t(IStream) str, size_t capacity)
+{
+    MX_ASSERT(str.traits == &fat_vtable(mx_memory_t, IStream), "Stream must be a memory stream.");
+
+    return mx_memory_grow(str.ptr, capacity);
+}
+
+MX_IMPL void mx_memory_stream_reset(fatptr_t(IStream) str)
+{
+    MX_ASSERT(str.traits == &fat_vtable(mx_memory_t, IStream), "Stream must be a memory stream.");
+
+    mx_memory_t *self = str.ptr;
+    self->size = 0;
+    self->position = 0;
+    self->open = true;
+    self->eof = false;
+}
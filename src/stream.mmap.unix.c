@@ -0,0 +1,237 @@
+#if __unix__
+#define _GNU_SOURCE
+#include "mx/io/mmap_stream.h"
+#include "mx/assert.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+typedef struct mx_mmap_t {
+    char *data;                     /**< The mapping, NULL for an empty file. */
+    size_t size;
+    size_t position;                /**< May be past the end after a seek. */
+    bool open;
+    bool eof;
+    fatptr_t(IAllocator) allocator;
+} mx_mmap_t;
+
+static size_t mx_mmap_IObject_get_size(mx_mmap_t *self);
+static size_t mx_mmap_IObject_to_string(mx_mmap_t *self, char *buffer, size_t max);
+static void   mx_mmap_IObject_destruct(mx_mmap_t *self);
+
+static mx_stream_flags mx_mmap_IStream_get_flags(mx_mmap_t *self);
+static mx_len_t mx_mmap_IStream_read(mx_mmap_t *self, char *buffer, mx_len_t max);
+static mx_len_t mx_mmap_IStream_seek(mx_mmap_t *self, mx_len_t offset, IStream_SeekOrigin origin);
+static mx_len_t mx_mmap_IStream_write(mx_mmap_t *self, const char *buffer, mx_len_t max);
+static void mx_mmap_IStream_close(mx_mmap_t *self);
+static mx_len_t mx_mmap_IStream_borrow(mx_mmap_t *self, const char **data, mx_len_t max);
+static mx_len_t mx_mmap_IStream_pread(mx_mmap_t *self, char *buffer, mx_len_t max, mx_len_t offset);
+
+const IStream fat_vtable(mx_mmap_t, IStream) = {
+    .Object = {
+        .get_size  = (void*)mx_mmap_IObject_get_size,
+        .get_type  = NULL,
+        .to_string = (void*)mx_mmap_IObject_to_string,
+        .destruct  = (void*)mx_mmap_IObject_destruct
+    },
+    .get_flags = (void*)mx_mmap_IStream_get_flags,
+    .read = (void*)mx_mmap_IStream_read,
+    .seek = (void*)mx_mmap_IStream_seek,
+    .write = (void*)mx_mmap_IStream_write,
+    .close = (void*)mx_mmap_IStream_close,
+    .borrow = (void*)mx_mmap_IStream_borrow,
+    .pread = (void*)mx_mmap_IStream_pread,
+};
+
+static size_t mx_mmap_IObject_get_size(mx_mmap_t *self)
+{
+    return sizeof(*self);
+}
+
+static size_t mx_mmap_IObject_to_string(mx_mmap_t *self, char *buffer, size_t max)
+{
+    int n = snprintf(buffer, max, "mmap %p+%zu", (void*)self->data, self->size);
+    return n < 0 ? 0 : (size_t)n < max ? (size_t)n : max;
+}
+
+static void mx_mmap_IObject_destruct(mx_mmap_t *self)
+{
+    mx_mmap_IStream_close(self);
+    IAllocator_free(self->allocator, self, sizeof(*self));
+}
+
+static mx_stream_flags mx_mmap_IStream_get_flags(mx_mmap_t *self)
+{
+    if (!self->open)
+        return MX_STREAM_EOF;
+
+    return MX_STREAM_OPEN | (self->eof ? MX_STREAM_EOF : 0);
+}
+
+/** Take up to max bytes at the position. */
+static size_t mx_mmap_take(mx_mmap_t *self, mx_len_t max)
+{
+    if (!self->open || max <= 0)
+        return 0;
+
+    size_t left = self->position < self->size ? self->size - self->position : 0;
+    size_t n = (size_t)max < left ? (size_t)max : left;
+
+    self->position += n;
+    self->eof = n < (size_t)max;
+    return n;
+}
+
+static mx_len_t mx_mmap_IStream_read(mx_mmap_t *self, char *buffer, mx_len_t max)
+{
+    size_t n = mx_mmap_take(self, max);
+
+    if (n)
+        memcpy(buffer, self->data + self->position - n, n);
+
+    return (mx_len_t)n;
+}
+
+static mx_len_t mx_mmap_IStream_borrow(mx_mmap_t *self, const char **data, mx_len_t max)
+{
+    size_t n = mx_mmap_take(self, max);
+
+    *data = n ? self->data + self->position - n : NULL;
+    return (mx_len_t)n;
+}
+
+static mx_len_t mx_mmap_IStream_pread(mx_mmap_t *self, char *buffer, mx_len_t max, mx_len_t offset)
+{
+    if (!self->open || offset < 0)
+        return -1;
+
+    if (max <= 0 || (uint64_t)offset >= self->size)
+        return 0;
+
+    size_t left = self->size - (size_t)offset;
+    size_t n = (size_t)max < left ? (size_t)max : left;
+
+    memcpy(buffer, self->data + offset, n);
+    return (mx_len_t)n;
+}
+
+static mx_len_t mx_mmap_IStream_seek(mx_mmap_t *self, mx_len_t offset, IStream_SeekOrigin origin)
+{
+    int64_t base = origin == ISTREAM_SEEK_START ? 0
+                 : origin == ISTREAM_SEEK_END ? (int64_t)self->size
+                 : (int64_t)self->position;
+
+    if (!self->open || base + offset < 0)
+        return -1;
+
+    self->position = (size_t)(base + offset);
+    self->eof = false;
+    return 0;
+}
+
+static mx_len_t mx_mmap_IStream_write(mx_mmap_t *self, const char *buffer, mx_len_t max)
+{
+    (void)self;
+    (void)buffer;
+    (void)max;
+    return 0;
+}
+
+static void mx_mmap_IStream_close(mx_mmap_t *self)
+{
+    if (!self->open)
+        return;
+
+    if (self->data)
+        munmap(self->data, self->size);
+
+    self->data = NULL;
+    self->open = false;
+}
+
+static void mx_mmap_advise(void *data, size_t size, mx_open_flags flags)
+{
+#ifdef MADV_SEQUENTIAL
+    if (flags & MX_OPEN_SEQUENTIAL) madvise(data, size, MADV_SEQUENTIAL);
+    if (flags & MX_OPEN_RANDOM)     madvise(data, size, MADV_RANDOM);
+    if (flags & MX_OPEN_WILLNEED)   madvise(data, size, MADV_WILLNEED);
+#endif
+#ifdef MADV_HUGEPAGE
+    if (flags & MX_OPEN_HUGEPAGES)  madvise(data, size, MADV_HUGEPAGE);
+#endif
+}
+
+MX_IMPL fatptr_t(IStream) mx_mmap_open(const char *file, mx_open_flags flags, fatptr_t(IAllocator) allocator)
+{
+    MX_ASSERT_PTR(file, "File path must be non-null.");
+
+    fatptr_t(IStream) none = fat_new(NULL, fat_vtable(mx_mmap_t, IStream), IStream);
+
+    if (flags & (MX_OPEN_WRITE | MX_OPEN_APPEND | MX_OPEN_NEW))
+        return none;
+
+    int fd = open(file, O_RDONLY | O_CLOEXEC);
+    struct stat st;
+
+    if (fd < 0)
+        return none;
+
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || (uint64_t)st.st_size > SIZE_MAX)
+    {
+        close(fd);
+        return none;
+    }
+
+    size_t size = (size_t)st.st_size;
+    void *data = NULL;
+
+    if (size)
+    {
+        data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        if (data == MAP_FAILED)
+        {
+            close(fd);
+            return none;
+        }
+    }
+
+    /* The mapping keeps the file alive on its own. */
+    close(fd);
+
+    allocator = __mx_allocator(allocator);
+    mx_mmap_t *self = IAllocator_alloc(allocator, sizeof(mx_mmap_t), MX_ALLOC_ALIGN);
+
+    if (!self)
+    {
+        if (data)
+            munmap(data, size);
+
+        return none;
+    }
+
+    if (data)
+        mx_mmap_advise(data, size, flags);
+
+    self->data = data;
+    self->size = size;
+    self->position = 0;
+    self->open = true;
+    self->eof = false;
+    self->allocator = allocator;
+    return fat_new(self, fat_vtable(mx_mmap_t, IStream), IStream);
+}
+
+MX_IMPL const char *mx_mmap_stream_data(fatptr_t(IStream) str, size_t *size)
+{
+    MX_ASSERT(str.traits == &fat_vtable(mx_mmap_t, IStream), "Stream must be a mapped stream.");
+    MX_ASSERT_PTR(size, "Size must be non-null.");
+
+    mx_mmap_t *self = str.ptr;
+    *size = self->data ? self->size : 0;
+    return self->data;
+}
+#endif
@@ -1,11 +1,28 @@
+#define _FILE_OFFSET_BITS 64
+#if __unix__
+#define _XOPEN_SOURCE 700
+#endif
 #include "mx/io/stream.h"
+#include "mx/io/mmap_stream.h"
 #include "mx/assert.h"
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#if __unix__
+    #include <unistd.h>
+    #define mx_fseek fseeko
+#elif defined(_WIN32)
+    #define mx_fseek _fseeki64
+#else
+    #define mx_fseek fseek
+#endif
+
 typedef struct mx_file_t {
     FILE *f;
+    bool writable;                  /**< Opened for writing, so stdio may hold unwritten data. */
+    fatptr_t(IAllocator) allocator;
 } mx_file_t;
 
 static size_t mx_file_IObject_get_size(mx_file_t *self);
@@ -17,6 +34,10 @@ static mx_len_t mx_file_IStream_read(mx_file_t *self, char *buffer, mx_len_t max
 static mx_len_t mx_file_IStream_seek(mx_file_t *self, mx_len_t offset, IStream_SeekOrigin origin);
 static mx_len_t mx_file_IStream_write(mx_file_t *self, const char *buffer, mx_len_t max);
 static void mx_file_IStream_close(mx_file_t *self);
+#if __unix__
+static mx_len_t mx_file_IStream_pread(mx_file_t *self, char *buffer, mx_len_t max, mx_len_t offset);
+static mx_len_t mx_file_IStream_pwrite(mx_file_t *self, const char *buffer, mx_len_t size, mx_len_t offset);
+#endif
 
 const IObject fat_vtable(mx_file_t, IObject) = {
     .get_size  = (void*)mx_file_IObject_get_size,
@@ -37,11 +58,15 @@ const IStream fat_vtable(mx_file_t, IStream) = {
     .seek = (void*)mx_file_IStream_seek,
     .write = (void*)mx_file_IStream_write,
     .close = (void*)mx_file_IStream_close,
+#if __unix__
+    .pread = (void*)mx_file_IStream_pread,
+    .pwrite = (void*)mx_file_IStream_pwrite,
+#endif
 };
 
 static size_t mx_file_IObject_get_size(mx_file_t *self)
 {
-    return sizeof(self);
+    return sizeof(*self);
 }
 
 static size_t mx_file_IObject_to_string(mx_file_t *self, char *buffer, size_t max)
@@ -74,7 +99,10 @@ static size_t mx_file_IObject_to_string(mx_file_t *self, char *buffer, size_t ma
 static void mx_file_IObject_destruct(mx_file_t *self)
 {
     fatptr_vcall(fat_new(self, fat_vtable(mx_file_t, IStream), IStream), close);
-    free(self);
+
+    /* The standard streams are static. */
+    if (self->allocator.ptr)
+        IAllocator_free(self->allocator, self, sizeof(*self));
 }
 
 static mx_stream_flags mx_file_IStream_get_flags(mx_file_t *self)
@@ -96,7 +124,7 @@ static mx_len_t mx_file_IStream_read(mx_file_t *self, char *buffer, mx_len_t max
 
 static mx_len_t mx_file_IStream_seek(mx_file_t *self, mx_len_t offset, IStream_SeekOrigin origin)
 {
-    return fseek(self->f, offset, origin);
+    return mx_fseek(self->f, offset, origin);
 }
 
 static mx_len_t mx_file_IStream_write(mx_file_t *self, const char *buffer, mx_len_t max)
@@ -108,12 +136,73 @@ static void mx_file_IStream_close(mx_file_t *self)
 {
     if (self->f == NULL)
         return;
-    else if (self->f != stdin || self->f != stdout || self->f != stderr)
+    else if (self->f != stdin && self->f != stdout && self->f != stderr)
         fclose(self->f);
 
     self->f = NULL;
 }
 
+#if __unix__
+/*
+ * Positional calls go to the descriptor under the FILE. Data stdio still
+ * buffers for writing is flushed first so both views agree; fflush locks
+ * the FILE, so this is safe on several threads.
+ */
+
+static mx_len_t mx_file_IStream_pread(mx_file_t *self, char *buffer, mx_len_t max, mx_len_t offset)
+{
+    if (self->f == NULL || offset < 0 || (self->writable && fflush(self->f) != 0))
+        return -1;
+
+    mx_len_t total = 0;
+
+    while (total < max)
+    {
+        ssize_t n = pread(fileno(self->f), buffer + total, (size_t)(max - total), (off_t)(offset + total));
+
+        if (n == 0)
+            break;
+
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+
+            return total ? total : -1;
+        }
+
+        total += n;
+    }
+
+    return total;
+}
+
+static mx_len_t mx_file_IStream_pwrite(mx_file_t *self, const char *buffer, mx_len_t size, mx_len_t offset)
+{
+    if (self->f == NULL || offset < 0 || (self->writable && fflush(self->f) != 0))
+        return -1;
+
+    mx_len_t total = 0;
+
+    while (total < size)
+    {
+        ssize_t n = pwrite(fileno(self->f), buffer + total, (size_t)(size - total), (off_t)(offset + total));
+
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+
+            return total ? total : -1;
+        }
+
+        total += n;
+    }
+
+    return total;
+}
+#endif
+
 MX_API fatptr_t(IStream) mx_get_stdin(void)
 {
     static bool init = false;
@@ -136,6 +225,7 @@ MX_API fatptr_t(IStream) mx_get_stdout(void)
     if (!init)
     {
         fd.f = stdout;
+        fd.writable = true;
         init = true;
     }
 
@@ -150,6 +240,7 @@ MX_API fatptr_t(IStream) mx_get_stderr(void)
     if (!init)
     {
         fd.f = stderr;
+        fd.writable = true;
         init = true;
     }
 
@@ -158,18 +249,47 @@ MX_API fatptr_t(IStream) mx_get_stderr(void)
 
 MX_API fatptr_t(IStream) mx_open(const char *file, mx_open_flags flags)
 {
-    char options[6] = "b";
-    if (flags & MX_OPEN_READ) strcat(options, "r");
-    if (flags & MX_OPEN_WRITE) strcat(options, "w");
-    if (flags & MX_OPEN_APPEND) strcat(options, "a");
-    if (flags & MX_OPEN_NEW) strcat(options, "s");
+    return mx_open_allocator(file, flags, (fatptr_t(IAllocator)){ NULL, NULL });
+}
+
+MX_API fatptr_t(IStream) mx_open_allocator(const char *file, mx_open_flags flags, fatptr_t(IAllocator) allocator)
+{
+#if __unix__
+    if (flags & MX_OPEN_MMAP)
+    {
+        fatptr_t(IStream) mapped = mx_mmap_open(file, flags, allocator);
+
+        /* Otherwise fall back to a regular stream. */
+        if (mapped.ptr)
+            return mapped;
+    }
+#endif
+
+    char options[6] = "";
+    bool read = flags & MX_OPEN_READ;
+    if (flags & MX_OPEN_APPEND) strcat(options, read ? "a+" : "a");
+    else if (flags & MX_OPEN_NEW) strcat(options, read ? "w+" : "w");
+    else if (flags & MX_OPEN_WRITE) strcat(options, read ? "r+" : "w");
+    else strcat(options, "r");
+    strcat(options, "b");
+    if (flags & MX_OPEN_NEW) strcat(options, "x");
 
-    mx_file_t *self = malloc(sizeof(mx_file_t));
+    allocator = __mx_allocator(allocator);
+
+    mx_file_t *self = IAllocator_alloc(allocator, sizeof(mx_file_t), MX_ALLOC_ALIGN);
     if (!self) 
     {
-        return fat_new(NULL, *(IStream*)NULL, IStream);
+        return fat_new(NULL, fat_vtable(mx_file_t, IStream), IStream);
     }
 
+    self->allocator = allocator;
+    self->writable = flags & (MX_OPEN_WRITE | MX_OPEN_APPEND | MX_OPEN_NEW);
     self->f = fopen(file, options);
+    if (!self->f)
+    {
+        IAllocator_free(allocator, self, sizeof(mx_file_t));
+        return fat_new(NULL, fat_vtable(mx_file_t, IStream), IStream);
+    }
+
     return fat_new(self, fat_vtable(mx_file_t, IStream), IStream);
 }
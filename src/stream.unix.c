@@ -0,0 +1,846 @@
+#if __unix__
+#define _GNU_SOURCE
+#define _FILE_OFFSET_BITS 64
+#include "mx/io/fd_stream.h"
+#include "mx/assert.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#ifndef O_DIRECT
+    #define O_DIRECT 0
+#endif
+
+/** Alignment of buffers, sizes and offsets for O_DIRECT transfers. */
+#define MX_FD_ALIGN 4096
+/** Buffers passed to one readv or writev. */
+#define MX_FD_IOV   64
+
+/*
+ * The buffer holds either unread data, between begin and end, or unwritten
+ * data, the first pending bytes, never both. offset is the position of the
+ * stream in the file. Aligned transfers go by offset to a second descriptor
+ * opened with O_DIRECT, so the flags of neither descriptor change while
+ * positional calls may be running; fd catches up with offset before its own
+ * position is used again.
+ */
+
+typedef struct mx_fd_t {
+    int fd;
+    int dfd;                        /**< The file with O_DIRECT, or -1. */
+    bool own;
+    bool eof;
+    bool direct;                    /**< Sequential transfers may use dfd. */
+    bool moved;                     /**< The position of fd is behind offset. */
+    mx_fd_hints hints;
+    off_t offset;                   /**< Position of fd. */
+    char *buffer;
+    size_t capacity;
+    size_t begin, end;              /**< Unread bytes. */
+    size_t pending;                 /**< Unwritten bytes. */
+    void *memory;                   /**< Allocation holding the buffer. */
+    size_t memory_size;
+    fatptr_t(IAllocator) allocator;
+} mx_fd_t;
+
+static size_t mx_fd_IObject_get_size(mx_fd_t *self);
+static size_t mx_fd_IObject_to_string(mx_fd_t *self, char *buffer, size_t max);
+static void   mx_fd_IObject_destruct(mx_fd_t *self);
+
+static mx_stream_flags mx_fd_IStream_get_flags(mx_fd_t *self);
+static mx_len_t mx_fd_IStream_read(mx_fd_t *self, char *buffer, mx_len_t max);
+static mx_len_t mx_fd_IStream_seek(mx_fd_t *self, mx_len_t offset, IStream_SeekOrigin origin);
+static mx_len_t mx_fd_IStream_write(mx_fd_t *self, const char *buffer, mx_len_t max);
+static void mx_fd_IStream_close(mx_fd_t *self);
+static mx_len_t mx_fd_IStream_pread(mx_fd_t *self, char *buffer, mx_len_t max, mx_len_t offset);
+static mx_len_t mx_fd_IStream_pwrite(mx_fd_t *self, const char *buffer, mx_len_t size, mx_len_t offset);
+static mx_len_t mx_fd_IStream_readv(mx_fd_t *self, const mx_iovec_t *iov, int count);
+static mx_len_t mx_fd_IStream_writev(mx_fd_t *self, const mx_iovec_t *iov, int count);
+
+const IStream fat_vtable(mx_fd_t, IStream) = {
+    .Object = {
+        .get_size  = (void*)mx_fd_IObject_get_size,
+        .get_type  = NULL,
+        .to_string = (void*)mx_fd_IObject_to_string,
+        .destruct  = (void*)mx_fd_IObject_destruct
+    },
+    .get_flags = (void*)mx_fd_IStream_get_flags,
+    .read = (void*)mx_fd_IStream_read,
+    .seek = (void*)mx_fd_IStream_seek,
+    .write = (void*)mx_fd_IStream_write,
+    .close = (void*)mx_fd_IStream_close,
+    .pread = (void*)mx_fd_IStream_pread,
+    .pwrite = (void*)mx_fd_IStream_pwrite,
+    .readv = (void*)mx_fd_IStream_readv,
+    .writev = (void*)mx_fd_IStream_writev,
+};
+
+/** True if a transfer is acceptable to O_DIRECT as it is. */
+static bool mx_fd_aligned(const void *ptr, size_t size, off_t offset)
+{
+    return (uintptr_t)ptr % MX_FD_ALIGN == 0 && size % MX_FD_ALIGN == 0 && offset % MX_FD_ALIGN == 0;
+}
+
+/** Move fd to the stream position after direct transfers went past it. */
+static void mx_fd_sync(mx_fd_t *self)
+{
+    if (self->moved && lseek(self->fd, self->offset, SEEK_SET) != -1)
+        self->moved = false;
+}
+
+static ssize_t mx_fd_sys_read(mx_fd_t *self, void *dst, size_t size)
+{
+    for (;;)
+    {
+        bool direct = self->direct && mx_fd_aligned(dst, size, self->offset);
+        ssize_t n;
+
+        if (direct)
+        {
+            n = pread(self->dfd, dst, size, self->offset);
+        }
+        else
+        {
+            mx_fd_sync(self);
+            n = read(self->fd, dst, size);
+        }
+
+        if (n >= 0)
+        {
+            self->offset += n;
+            self->moved |= direct;
+            return n;
+        }
+
+        /* Some file systems reject O_DIRECT; give up on it and retry. */
+        if (errno == EINVAL && direct)
+            self->direct = false;
+        else if (errno != EINTR)
+            return -1;
+    }
+}
+
+/** Write all of src, returning the number of bytes written before an error. */
+static size_t mx_fd_sys_write(mx_fd_t *self, const void *src, size_t size)
+{
+    const char *at = src;
+    size_t done = 0;
+
+    while (done < size)
+    {
+        bool direct = self->direct && mx_fd_aligned(at + done, size - done, self->offset);
+        ssize_t n;
+
+        if (direct)
+        {
+            n = pwrite(self->dfd, at + done, size - done, self->offset);
+        }
+        else
+        {
+            mx_fd_sync(self);
+            n = write(self->fd, at + done, size - done);
+        }
+
+        if (n >= 0)
+        {
+            self->offset += n;
+            self->moved |= direct;
+            done += (size_t)n;
+        }
+        else if (errno == EINVAL && direct)
+        {
+            self->direct = false;
+        }
+        else if (errno != EINTR)
+        {
+            break;
+        }
+    }
+
+    return done;
+}
+
+/**
+ * Write out pending data. With O_DIRECT and all false, only whole aligned
+ * blocks are written and the rest stays at the front of the buffer.
+ */
+static bool mx_fd_flush(mx_fd_t *self, bool all)
+{
+    size_t size = self->pending;
+
+    if (!all && self->direct && self->offset % MX_FD_ALIGN == 0)
+        size -= size % MX_FD_ALIGN;
+
+    if (size == 0)
+        return true;
+
+    size_t done = mx_fd_sys_write(self, self->buffer, size);
+
+    memmove(self->buffer, self->buffer + done, self->pending - done);
+    self->pending -= done;
+    return done == size;
+}
+
+/** Drop unread data, moving the descriptor back to the stream position. */
+static void mx_fd_unread(mx_fd_t *self)
+{
+    if (self->end > self->begin)
+    {
+        off_t at = self->offset - (off_t)(self->end - self->begin);
+
+        if (lseek(self->fd, at, SEEK_SET) != -1)
+        {
+            self->offset = at;
+            self->moved = false;
+        }
+    }
+
+    self->begin = self->end = 0;
+}
+
+static size_t mx_fd_IObject_get_size(mx_fd_t *self)
+{
+    return sizeof(*self);
+}
+
+static size_t mx_fd_IObject_to_string(mx_fd_t *self, char *buffer, size_t max)
+{
+    int n = snprintf(buffer, max, "fd %d", self->fd);
+    return n < 0 ? 0 : (size_t)n < max ? (size_t)n : max;
+}
+
+static void mx_fd_IObject_destruct(mx_fd_t *self)
+{
+    mx_fd_IStream_close(self);
+
+    if (self->memory)
+        IAllocator_free(self->allocator, self->memory, self->memory_size);
+
+    IAllocator_free(self->allocator, self, sizeof(*self));
+}
+
+static mx_stream_flags mx_fd_IStream_get_flags(mx_fd_t *self)
+{
+    if (self->fd < 0)
+        return MX_STREAM_EOF;
+
+    return MX_STREAM_OPEN | (self->eof ? MX_STREAM_EOF : 0);
+}
+
+static mx_len_t mx_fd_IStream_read(mx_fd_t *self, char *buffer, mx_len_t max)
+{
+    if (self->fd < 0 || max <= 0)
+        return 0;
+
+    if (self->pending && !mx_fd_flush(self, true))
+        return -1;
+
+    size_t total = 0, size = (size_t)max;
+
+    while (total < size)
+    {
+        if (self->begin < self->end)
+        {
+            size_t n = self->end - self->begin < size - total ? self->end - self->begin : size - total;
+            memcpy(buffer + total, self->buffer + self->begin, n);
+            self->begin += n;
+            total += n;
+            continue;
+        }
+
+        /* Large reads skip the buffer. */
+        bool direct = size - total >= self->capacity;
+        ssize_t n = direct ? mx_fd_sys_read(self, buffer + total, size - total)
+                           : mx_fd_sys_read(self, self->buffer, self->capacity);
+
+        if (n <= 0)
+        {
+            self->eof = n == 0;
+
+            /* An error with nothing read must not look like the end. */
+            if (n < 0 && total == 0)
+                return -1;
+
+            break;
+        }
+
+        if (direct)
+        {
+            total += (size_t)n;
+        }
+        else
+        {
+            self->begin = 0;
+            self->end = (size_t)n;
+        }
+    }
+
+    return (mx_len_t)total;
+}
+
+static mx_len_t mx_fd_IStream_seek(mx_fd_t *self, mx_len_t offset, IStream_SeekOrigin origin)
+{
+    if (self->fd < 0 || !mx_fd_flush(self, true))
+        return -1;
+
+    off_t target = offset;
+    int whence = origin == ISTREAM_SEEK_START ? SEEK_SET : origin == ISTREAM_SEEK_END ? SEEK_END : SEEK_CUR;
+
+    /* offset is ahead of the stream by the unread bytes. */
+    if (whence == SEEK_CUR)
+    {
+        target += self->offset - (off_t)(self->end - self->begin);
+        whence = SEEK_SET;
+    }
+
+    off_t at = lseek(self->fd, target, whence);
+
+    if (at == -1)
+        return -1;
+
+    self->offset = at;
+    self->moved = false;
+    self->begin = self->end = 0;
+    self->eof = false;
+    return 0;
+}
+
+static mx_len_t mx_fd_IStream_write(mx_fd_t *self, const char *buffer, mx_len_t max)
+{
+    if (self->fd < 0 || max <= 0)
+        return 0;
+
+    size_t size = (size_t)max;
+
+    mx_fd_unread(self);
+
+    if (self->pending + size > self->capacity)
+    {
+        if (!mx_fd_flush(self, false) || self->pending + size > self->capacity)
+        {
+            if (!mx_fd_flush(self, true))
+                return -1;
+        }
+    }
+
+    /* Large writes skip the buffer. */
+    if (size >= self->capacity)
+    {
+        size_t done = mx_fd_sys_write(self, buffer, size);
+        return done ? (mx_len_t)done : -1;
+    }
+
+    memcpy(self->buffer + self->pending, buffer, size);
+    self->pending += size;
+    return max;
+}
+
+/** Read until size bytes are read or the file ends. */
+static ssize_t mx_fd_sys_pread(int fd, void *dst, size_t size, off_t offset)
+{
+    size_t done = 0;
+
+    while (done < size)
+    {
+        ssize_t n = pread(fd, (char*)dst + done, size - done, offset + (off_t)done);
+
+        if (n == 0)
+            break;
+
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+
+            return done ? (ssize_t)done : -1;
+        }
+
+        done += (size_t)n;
+    }
+
+    return (ssize_t)done;
+}
+
+/** Write all of src, or as much as was written before an error. */
+static ssize_t mx_fd_sys_pwrite(int fd, const void *src, size_t size, off_t offset)
+{
+    size_t done = 0;
+
+    while (done < size)
+    {
+        ssize_t n = pwrite(fd, (const char*)src + done, size - done, offset + (off_t)done);
+
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+
+            return done ? (ssize_t)done : -1;
+        }
+
+        done += (size_t)n;
+    }
+
+    return (ssize_t)done;
+}
+
+/*
+ * Positional calls leave the buffer, the position and the descriptor flags
+ * alone, so they can run on several threads at once. Aligned transfers go
+ * to the O_DIRECT descriptor, the others to the cached one.
+ */
+
+static mx_len_t mx_fd_IStream_pread(mx_fd_t *self, char *buffer, mx_len_t max, mx_len_t offset)
+{
+    if (self->fd < 0 || offset < 0)
+        return -1;
+
+    if (max <= 0)
+        return 0;
+
+    size_t size = (size_t)max;
+
+    if (self->dfd >= 0 && mx_fd_aligned(buffer, size, offset))
+    {
+        ssize_t n = mx_fd_sys_pread(self->dfd, buffer, size, offset);
+
+        if (n >= 0 || errno != EINVAL)
+            return n;
+    }
+
+    return mx_fd_sys_pread(self->fd, buffer, size, offset);
+}
+
+static mx_len_t mx_fd_IStream_pwrite(mx_fd_t *self, const char *buffer, mx_len_t size, mx_len_t offset)
+{
+    if (self->fd < 0 || offset < 0)
+        return -1;
+
+    if (size <= 0)
+        return 0;
+
+    if (self->dfd >= 0 && mx_fd_aligned(buffer, (size_t)size, offset))
+    {
+        ssize_t n = mx_fd_sys_pwrite(self->dfd, buffer, (size_t)size, offset);
+
+        if (n >= 0 || errno != EINVAL)
+            return n;
+    }
+
+    return mx_fd_sys_pwrite(self->fd, buffer, (size_t)size, offset);
+}
+
+/** Move past done bytes of an iovec array. */
+static void mx_fd_iov_advance(struct iovec **iov, int *count, size_t done)
+{
+    while (*count > 0 && done >= (*iov)->iov_len)
+    {
+        done -= (*iov)->iov_len;
+        (*iov)++;
+        (*count)--;
+    }
+
+    if (*count > 0)
+    {
+        (*iov)->iov_base = (char*)(*iov)->iov_base + done;
+        (*iov)->iov_len -= done;
+    }
+}
+
+/** Sum of the sizes, saturating instead of overflowing. */
+static size_t mx_fd_iov_total(const mx_iovec_t *iov, int count)
+{
+    size_t total = 0;
+
+    for (int i = 0; i < count; i++)
+        total = iov[i].size < SIZE_MAX - total ? total + iov[i].size : SIZE_MAX;
+
+    return total;
+}
+
+/*
+ * Vectored calls skip the buffer once the data would not fit it anyway:
+ * buffered bytes and the caller's buffers go to the kernel in one readv or
+ * writev. O_DIRECT wants every buffer aligned, so under it they are
+ * transferred one by one.
+ */
+
+static mx_len_t mx_fd_IStream_readv(mx_fd_t *self, const mx_iovec_t *iov, int count)
+{
+    if (self->fd < 0)
+        return 0;
+
+    if (self->pending && !mx_fd_flush(self, true))
+        return -1;
+
+    size_t total = 0, skip = 0;
+    int i = 0;
+
+    /* Hand out what the buffer holds first. */
+    while (i < count && self->begin < self->end)
+    {
+        size_t left = iov[i].size - skip;
+        size_t n = self->end - self->begin < left ? self->end - self->begin : left;
+
+        memcpy((char*)iov[i].data + skip, self->buffer + self->begin, n);
+        self->begin += n;
+        total += n;
+        skip += n;
+
+        if (skip == iov[i].size)
+            i++, skip = 0;
+    }
+
+    if (self->direct || mx_fd_iov_total(iov + i, count - i) - skip < self->capacity)
+    {
+        for (; i < count; i++, skip = 0)
+        {
+            mx_len_t want = (mx_len_t)(iov[i].size - skip);
+            mx_len_t n = mx_fd_IStream_read(self, (char*)iov[i].data + skip, want);
+
+            if (n < 0)
+                return total ? (mx_len_t)total : -1;
+
+            total += (size_t)n;
+
+            if (n < want)
+                break;
+        }
+
+        return (mx_len_t)total;
+    }
+
+    mx_fd_sync(self);
+
+    while (i < count)
+    {
+        struct iovec batch[MX_FD_IOV], *at = batch;
+        int n = 0;
+
+        for (; n < MX_FD_IOV && i + n < count; n++)
+        {
+            batch[n].iov_base = (char*)iov[i + n].data + (n ? 0 : skip);
+            batch[n].iov_len = iov[i + n].size - (n ? 0 : skip);
+        }
+
+        int left = n;
+        size_t got = 0;
+
+        while (left > 0)
+        {
+            ssize_t r = readv(self->fd, at, left);
+
+            if (r < 0 && errno == EINTR)
+                continue;
+
+            if (r <= 0)
+            {
+                self->eof = r == 0;
+                return r < 0 && total + got == 0 ? -1 : (mx_len_t)(total + got);
+            }
+
+            self->offset += r;
+            got += (size_t)r;
+            mx_fd_iov_advance(&at, &left, (size_t)r);
+        }
+
+        total += got;
+        i += n;
+        skip = 0;
+    }
+
+    return (mx_len_t)total;
+}
+
+static mx_len_t mx_fd_IStream_writev(mx_fd_t *self, const mx_iovec_t *iov, int count)
+{
+    if (self->fd < 0)
+        return 0;
+
+    size_t size = mx_fd_iov_total(iov, count);
+
+    mx_fd_unread(self);
+
+    /* Small records are gathered in the buffer, without a system call. */
+    if (self->direct || size < self->capacity - self->pending)
+    {
+        size_t total = 0;
+
+        for (int i = 0; i < count; i++)
+        {
+            mx_len_t n = mx_fd_IStream_write(self, iov[i].data, (mx_len_t)iov[i].size);
+
+            if (n < 0)
+                return total ? (mx_len_t)total : -1;
+
+            total += (size_t)n;
+
+            if ((size_t)n < iov[i].size)
+                break;
+        }
+
+        return (mx_len_t)total;
+    }
+
+    size_t total = 0;
+
+    mx_fd_sync(self);
+
+    for (int i = 0; i < count;)
+    {
+        struct iovec batch[MX_FD_IOV + 1], *at = batch;
+        int n = 0, used = 0;
+        size_t pending = self->pending, want = 0;
+
+        /* Unwritten data goes out ahead of the caller's buffers. */
+        if (pending)
+        {
+            batch[n].iov_base = self->buffer;
+            batch[n++].iov_len = pending;
+            want += pending;
+        }
+
+        for (; used < MX_FD_IOV && i + used < count; used++, n++)
+        {
+            batch[n].iov_base = iov[i + used].data;
+            batch[n].iov_len = iov[i + used].size;
+            want += iov[i + used].size;
+        }
+
+        size_t done = 0;
+
+        while (done < want)
+        {
+            ssize_t r = writev(self->fd, at, n);
+
+            if (r < 0 && errno == EINTR)
+                continue;
+
+            if (r < 0)
+                break;
+
+            self->offset += r;
+            done += (size_t)r;
+            mx_fd_iov_advance(&at, &n, (size_t)r);
+        }
+
+        if (done < pending)
+        {
+            memmove(self->buffer, self->buffer + done, pending - done);
+            self->pending -= done;
+            return total ? (mx_len_t)total : -1;
+        }
+
+        self->pending = 0;
+        total += done - pending;
+
+        if (done < want)
+            return total ? (mx_len_t)total : -1;
+
+        i += used;
+    }
+
+    return (mx_len_t)total;
+}
+
+static void mx_fd_IStream_close(mx_fd_t *self)
+{
+    if (self->fd < 0)
+        return;
+
+    mx_fd_flush(self, true);
+
+#ifdef POSIX_FADV_DONTNEED
+    if (self->hints & MX_FD_DONTNEED)
+    {
+        /* Only clean pages are dropped, so write the dirty ones first. */
+        int flags = fcntl(self->fd, F_GETFL);
+
+        if (flags != -1 && (flags & O_ACCMODE) != O_RDONLY)
+            fdatasync(self->fd);
+
+        posix_fadvise(self->fd, 0, 0, POSIX_FADV_DONTNEED);
+    }
+#endif
+
+    if (self->dfd >= 0)
+        close(self->dfd);
+
+    if (self->own)
+        close(self->fd);
+    else
+        mx_fd_sync(self);
+
+    self->fd = self->dfd = -1;
+}
+
+static void mx_fd_advise(int fd, mx_fd_hints hints)
+{
+#ifdef POSIX_FADV_NORMAL
+    if (hints & MX_FD_SEQUENTIAL) posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    if (hints & MX_FD_RANDOM)     posix_fadvise(fd, 0, 0, POSIX_FADV_RANDOM);
+    if (hints & MX_FD_NOREUSE)    posix_fadvise(fd, 0, 0, POSIX_FADV_NOREUSE);
+    if (hints & MX_FD_WILLNEED)   posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+#else
+    (void)fd;
+    (void)hints;
+#endif
+}
+
+/** Create the stream, taking ownership of dfd. */
+static fatptr_t(IStream) mx_fd_create(int fd, int dfd, bool own, const mx_fd_options_t *options)
+{
+    mx_fd_options_t defaults = { MX_FD_BUFFER_DEFAULT, 0, { NULL, NULL } };
+    options = options ? options : &defaults;
+
+    fatptr_t(IAllocator) allocator = __mx_allocator(options->allocator);
+    mx_fd_t *self = IAllocator_alloc(allocator, sizeof(mx_fd_t), MX_ALLOC_ALIGN);
+
+    if (!self)
+    {
+        if (dfd >= 0)
+            close(dfd);
+
+        return fat_new(NULL, fat_vtable(mx_fd_t, IStream), IStream);
+    }
+
+    memset(self, 0, sizeof(*self));
+    self->fd = fd;
+    self->dfd = dfd;
+    self->direct = dfd >= 0;
+    self->own = own;
+    self->hints = options->hints;
+    self->allocator = allocator;
+    self->capacity = options->buffer_size;
+
+    off_t at = lseek(fd, 0, SEEK_CUR);
+    self->offset = at == -1 ? 0 : at;
+
+    /* Whole aligned blocks, so buffered transfers can go direct. */
+    if (self->direct)
+        self->capacity = (self->capacity + MX_FD_ALIGN - 1) / MX_FD_ALIGN * MX_FD_ALIGN;
+
+    if (self->capacity)
+    {
+        size_t align = self->direct ? MX_FD_ALIGN : MX_ALLOC_ALIGN;
+
+        self->memory_size = self->capacity + (self->direct ? MX_FD_ALIGN : 0);
+        self->memory = IAllocator_alloc(allocator, self->memory_size, MX_ALLOC_ALIGN);
+
+        if (!self->memory)
+        {
+            if (dfd >= 0)
+                close(dfd);
+
+            IAllocator_free(allocator, self, sizeof(*self));
+            return fat_new(NULL, fat_vtable(mx_fd_t, IStream), IStream);
+        }
+
+        self->buffer = (char*)(((uintptr_t)self->memory + align - 1) & ~(uintptr_t)(align - 1));
+    }
+
+    mx_fd_advise(fd, options->hints);
+    return fat_new(self, fat_vtable(mx_fd_t, IStream), IStream);
+}
+
+/**
+ * Open the file of fd again with O_DIRECT, and clear O_DIRECT from fd so
+ * its flags need not change afterwards. -1 where that is not possible.
+ */
+static int mx_fd_reopen_direct(int fd)
+{
+#if defined(__linux__)
+    int flags = fcntl(fd, F_GETFL);
+
+    /* Appends land at the end whatever the offset, which offset cannot follow. */
+    if (!O_DIRECT || flags == -1 || (flags & O_APPEND))
+        return -1;
+
+    char path[32];
+    snprintf(path, sizeof path, "/proc/self/fd/%d", fd);
+
+    int dfd = open(path, (flags & O_ACCMODE) | O_DIRECT | O_CLOEXEC);
+
+    if (dfd >= 0 && (flags & O_DIRECT) && fcntl(fd, F_SETFL, flags & ~O_DIRECT) == -1)
+    {
+        close(dfd);
+        return -1;
+    }
+
+    return dfd;
+#else
+    (void)fd;
+    return -1;
+#endif
+}
+
+MX_IMPL fatptr_t(IStream) mx_fd_stream(int fd, bool own, const mx_fd_options_t *options)
+{
+    MX_ASSERT(fd >= 0, "Descriptor must be valid.");
+
+    int dfd = options && (options->hints & MX_FD_DIRECT) ? mx_fd_reopen_direct(fd) : -1;
+    return mx_fd_create(fd, dfd, own, options);
+}
+
+MX_IMPL fatptr_t(IStream) mx_fd_open(const char *file, mx_open_flags flags, const mx_fd_options_t *options)
+{
+    MX_ASSERT_PTR(file, "File path must be non-null.");
+
+    /* The same modes as mx_open(). */
+    bool read = flags & MX_OPEN_READ;
+    int oflags = O_CLOEXEC;
+
+    if (flags & MX_OPEN_APPEND) oflags |= (read ? O_RDWR : O_WRONLY) | O_CREAT | O_APPEND;
+    else if (flags & MX_OPEN_NEW) oflags |= (read ? O_RDWR : O_WRONLY) | O_CREAT | O_TRUNC;
+    else if (flags & MX_OPEN_WRITE) oflags |= read ? O_RDWR : O_WRONLY | O_CREAT | O_TRUNC;
+    else oflags |= O_RDONLY;
+
+    if (flags & MX_OPEN_NEW) oflags |= O_EXCL;
+
+    int fd = open(file, oflags, 0666), dfd = -1;
+
+    if (fd < 0)
+        return fat_new(NULL, fat_vtable(mx_fd_t, IStream), IStream);
+
+    /*
+     * Bulk transfers go to a second descriptor with O_DIRECT. Not every file
+     * system supports it, and appends stay on fd.
+     */
+    if (options && (options->hints & MX_FD_DIRECT) && O_DIRECT && !(oflags & O_APPEND))
+        dfd = open(file, (oflags & O_ACCMODE) | O_DIRECT | O_CLOEXEC);
+
+    fatptr_t(IStream) str = mx_fd_create(fd, dfd, true, options);
+
+    if (!str.ptr)
+        close(fd);
+
+    return str;
+}
+
+MX_IMPL bool mx_fd_stream_flush(fatptr_t(IStream) str)
+{
+    MX_ASSERT(str.traits == &fat_vtable(mx_fd_t, IStream), "Stream must be a descriptor stream.");
+
+    mx_fd_t *self = str.ptr;
+    return self->fd < 0 || mx_fd_flush(self, true);
+}
+
+MX_IMPL int mx_fd_stream_fd(fatptr_t(IStream) str)
+{
+    MX_ASSERT(str.traits == &fat_vtable(mx_fd_t, IStream), "Stream must be a descriptor stream.");
+
+    mx_fd_t *self = str.ptr;
+
+    if (self->fd >= 0)
+    {
+        mx_fd_flush(self, true);
+        mx_fd_unread(self);
+        mx_fd_sync(self);
+    }
+
+    return self->fd;
+}
+#endif
@@ -0,0 +1,104 @@
+#if __unix__
+#include "mx/thread.h"
+#include "mx/assert.h"
+#include <sched.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+typedef struct mx_thread_start_t {
+    mx_thread_function function;
+    void *arg;
+} mx_thread_start_t;
+
+static void *mx_thread_main(void *arg)
+{
+    mx_thread_start_t start = *(mx_thread_start_t*)arg;
+    free(arg);
+
+    start.function(start.arg);
+    return NULL;
+}
+
+MX_IMPL bool mx_thread_create(mx_thread_t *thread, mx_thread_function function, void *arg)
+{
+    MX_ASSERT_PTR(thread, "Thread handle must be valid.");
+    MX_ASSERT_PTR(function, "Thread function must be valid.");
+
+    mx_thread_start_t *start = malloc(sizeof(mx_thread_start_t));
+    if (!start)
+        return false;
+
+    start->function = function;
+    start->arg = arg;
+
+    if (pthread_create(thread, NULL, mx_thread_main, start) != 0)
+    {
+        free(start);
+        return false;
+    }
+
+    return true;
+}
+
+MX_IMPL void mx_thread_join(mx_thread_t thread)
+{
+    pthread_join(thread, NULL);
+}
+
+MX_IMPL unsigned mx_thread_concurrency(void)
+{
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (unsigned)n : 1;
+}
+
+MX_IMPL void mx_thread_yield(void)
+{
+    sched_yield();
+}
+
+MX_IMPL void mx_mutex_init(mx_mutex_t *mutex)
+{
+    pthread_mutex_init(mutex, NULL);
+}
+
+MX_IMPL void mx_mutex_destroy(mx_mutex_t *mutex)
+{
+    pthread_mutex_destroy(mutex);
+}
+
+MX_IMPL void mx_mutex_lock(mx_mutex_t *mutex)
+{
+    pthread_mutex_lock(mutex);
+}
+
+MX_IMPL void mx_mutex_unlock(mx_mutex_t *mutex)
+{
+    pthread_mutex_unlock(mutex);
+}
+
+MX_IMPL void mx_cond_init(mx_cond_t *cond)
+{
+    pthread_cond_init(cond, NULL);
+}
+
+MX_IMPL void mx_cond_destroy(mx_cond_t *cond)
+{
+    pthread_cond_destroy(cond);
+}
+
+MX_IMPL void mx_cond_wait(mx_cond_t *cond, mx_mutex_t *mutex)
+{
+    pthread_cond_wait(cond, mutex);
+}
+
+MX_IMPL void mx_cond_signal(mx_cond_t *cond)
+{
+    pthread_cond_signal(cond);
+}
+
+MX_IMPL void mx_cond_broadcast(mx_cond_t *cond)
+{
+    pthread_cond_broadcast(cond);
+}
+
+#endif
@@ -0,0 +1,109 @@
+#if _WIN32
+#include "mx/thread.h"
+#include "mx/assert.h"
+#include <stdlib.h>
+#include "windows.h"
+
+typedef struct mx_thread_start_t {
+    mx_thread_function function;
+    void *arg;
+} mx_thread_start_t;
+
+static DWORD WINAPI mx_thread_main(LPVOID arg)
+{
+    mx_thread_start_t start = *(mx_thread_start_t*)arg;
+    free(arg);
+
+    start.function(start.arg);
+    return 0;
+}
+
+MX_IMPL bool mx_thread_create(mx_thread_t *thread, mx_thread_function function, void *arg)
+{
+    MX_ASSERT_PTR(thread, "Thread handle must be valid.");
+    MX_ASSERT_PTR(function, "Thread function must be valid.");
+
+    mx_thread_start_t *start = malloc(sizeof(mx_thread_start_t));
+    if (!start)
+        return false;
+
+    start->function = function;
+    start->arg = arg;
+
+    HANDLE handle = CreateThread(NULL, 0, mx_thread_main, start, 0, NULL);
+    if (handle == NULL)
+    {
+        free(start);
+        return false;
+    }
+
+    *thread = (mx_thread_t)handle;
+    return true;
+}
+
+MX_IMPL void mx_thread_join(mx_thread_t thread)
+{
+    WaitForSingleObject((HANDLE)thread, INFINITE);
+    CloseHandle((HANDLE)thread);
+}
+
+MX_IMPL unsigned mx_thread_concurrency(void)
+{
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors > 0 ? (unsigned)info.dwNumberOfProcessors : 1;
+}
+
+MX_IMPL void mx_thread_yield(void)
+{
+    SwitchToThread();
+}
+
+MX_IMPL void mx_mutex_init(mx_mutex_t *mutex)
+{
+    InitializeSRWLock((PSRWLOCK)mutex);
+}
+
+MX_IMPL void mx_mutex_destroy(mx_mutex_t *mutex)
+{
+    /* SRW locks need no cleanup. */
+    (void)mutex;
+}
+
+MX_IMPL void mx_mutex_lock(mx_mutex_t *mutex)
+{
+    AcquireSRWLockExclusive((PSRWLOCK)mutex);
+}
+
+MX_IMPL void mx_mutex_unlock(mx_mutex_t *mutex)
+{
+    ReleaseSRWLockExclusive((PSRWLOCK)mutex);
+}
+
+MX_IMPL void mx_cond_init(mx_cond_t *cond)
+{
+    InitializeConditionVariable((PCONDITION_VARIABLE)cond);
+}
+
+MX_IMPL void mx_cond_destroy(mx_cond_t *cond)
+{
+    /* Condition variables need no cleanup. */
+    (void)cond;
+}
+
+MX_IMPL void mx_cond_wait(mx_cond_t *cond, mx_mutex_t *mutex)
+{
+    SleepConditionVariableSRW((PCONDITION_VARIABLE)cond, (PSRWLOCK)mutex, INFINITE, 0);
+}
+
+MX_IMPL void mx_cond_signal(mx_cond_t *cond)
+{
+    WakeConditionVariable((PCONDITION_VARIABLE)cond);
+}
+
+MX_IMPL void mx_cond_broadcast(mx_cond_t *cond)
+{
+    WakeAllConditionVariable((PCONDITION_VARIABLE)cond);
+}
+
+#endif
@@ -0,0 +1,662 @@
+#include "mx/threadpool.h"
+#include "mx/ring.h"
+#include "mx/thread.h"
+#include "mx/assert.h"
+#include <stdlib.h>
+#include <string.h>
+
+/** Initial number of slots of a worker deque. */
+#define MX_THREADPOOL_DEQUE     256
+/** Slots of the injector queue. */
+#define MX_THREADPOOL_INJECTOR  1024
+/** Failed searches for work before a worker goes to sleep. */
+#define MX_THREADPOOL_SPINS     64
+/** Pieces per worker when no grain size is given. */
+#define MX_THREADPOOL_SPLIT     8
+/** Partial results up to this size live on the stack. */
+#define MX_REDUCE_INLINE        64
+
+/*
+ * A job is the unit the deques hold. Jobs of parallel_for and parallel_reduce
+ * live in the stack frame that forks them, and that frame joins them before
+ * returning; submitted tasks are wrapped in a heap allocated job.
+ */
+
+typedef struct mx_job_t mx_job_t;
+
+struct mx_job_t {
+    void (*run)(mx_job_t *job);
+    atomic_size_t *pending;     /**< Decremented once the job finished. */
+};
+
+/*
+ * Chase-Lev deque, with the memory orders of Le, Pop, Cohen and Zappa Nardelli,
+ * "Correct and Efficient Work-Stealing for Weak Memory Models". The owner
+ * pushes and takes at the bottom, thieves steal at the top. The array grows
+ * when full; old arrays are kept until the pool is destroyed because a thief
+ * may still be reading one.
+ */
+
+typedef struct mx_deque_array_t mx_deque_array_t;
+
+struct mx_deque_array_t {
+    mx_deque_array_t *prev;
+    int64_t mask;
+    _Atomic(mx_job_t*) jobs[];
+};
+
+typedef struct mx_deque_t {
+    _Alignas(MX_CACHE_LINE) _Atomic int64_t top;
+    _Alignas(MX_CACHE_LINE) _Atomic int64_t bottom;
+    _Atomic(mx_deque_array_t*) array;
+} mx_deque_t;
+
+typedef struct mx_worker_t {
+    mx_deque_t deque;
+    mx_threadpool_t *pool;
+    mx_thread_t thread;
+} mx_worker_t;
+
+struct mx_threadpool_t {
+    mx_mpmc_t injector;         /**< Jobs from threads outside the pool. */
+    mx_worker_t *workers;
+    unsigned nworkers;
+    atomic_bool stop;
+    atomic_uint sleeping;       /**< Workers waiting on wake. */
+    mx_mutex_t mutex;
+    mx_cond_t wake;
+    void *memory;               /**< Allocation holding the pool and workers. */
+};
+
+/** The worker running on this thread, if any. */
+static _Thread_local mx_worker_t *mx_current_worker;
+/** State of the victim picker of this thread. */
+static _Thread_local uint32_t mx_steal_seed;
+
+static _Atomic(mx_threadpool_t*) mx_default_pool;
+
+static mx_deque_array_t *mx_deque_array_new(int64_t capacity)
+{
+    mx_deque_array_t *array = malloc(sizeof(mx_deque_array_t) + (size_t)capacity * sizeof(array->jobs[0]));
+
+    if (array)
+    {
+        array->prev = NULL;
+        array->mask = capacity - 1;
+    }
+
+    return array;
+}
+
+static bool mx_deque_init(mx_deque_t *deque)
+{
+    mx_deque_array_t *array = mx_deque_array_new(MX_THREADPOOL_DEQUE);
+
+    if (!array)
+        return false;
+
+    atomic_init(&deque->top, 0);
+    atomic_init(&deque->bottom, 0);
+    atomic_init(&deque->array, array);
+    return true;
+}
+
+static void mx_deque_destroy(mx_deque_t *deque)
+{
+    mx_deque_array_t *array = atomic_load_explicit(&deque->array, memory_order_relaxed);
+
+    while (array)
+    {
+        mx_deque_array_t *prev = array->prev;
+        free(array);
+        array = prev;
+    }
+}
+
+static bool mx_deque_push(mx_deque_t *deque, mx_job_t *job)
+{
+    int64_t b = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+    int64_t t = atomic_load_explicit(&deque->top, memory_order_acquire);
+    mx_deque_array_t *array = atomic_load_explicit(&deque->array, memory_order_relaxed);
+
+    if (b - t > array->mask)
+    {
+        mx_deque_array_t *grown = mx_deque_array_new(2 * (array->mask + 1));
+
+        if (!grown)
+            return false;
+
+        for (int64_t i = t; i < b; i++)
+        {
+            mx_job_t *old = atomic_load_explicit(&array->jobs[i & array->mask], memory_order_relaxed);
+            atomic_store_explicit(&grown->jobs[i & grown->mask], old, memory_order_relaxed);
+        }
+
+        grown->prev = array;
+        atomic_store_explicit(&deque->array, grown, memory_order_release);
+        array = grown;
+    }
+
+    atomic_store_explicit(&array->jobs[b & array->mask], job, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&deque->bottom, b + 1, memory_order_relaxed);
+    return true;
+}
+
+static mx_job_t *mx_deque_take(mx_deque_t *deque)
+{
+    int64_t b = atomic_load_explicit(&deque->bottom, memory_order_relaxed) - 1;
+    mx_deque_array_t *array = atomic_load_explicit(&deque->array, memory_order_relaxed);
+
+    atomic_store_explicit(&deque->bottom, b, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+
+    int64_t t = atomic_load_explicit(&deque->top, memory_order_relaxed);
+    mx_job_t *job = NULL;
+
+    if (t <= b)
+    {
+        job = atomic_load_explicit(&array->jobs[b & array->mask], memory_order_relaxed);
+
+        if (t == b)
+        {
+            /* Last job, race the thieves for it. */
+            if (!atomic_compare_exchange_strong_explicit(&deque->top, &t, t + 1, memory_order_seq_cst, memory_order_relaxed))
+                job = NULL;
+
+            atomic_store_explicit(&deque->bottom, b + 1, memory_order_relaxed);
+        }
+    }
+    else
+    {
+        atomic_store_explicit(&deque->bottom, b + 1, memory_order_relaxed);
+    }
+
+    return job;
+}
+
+static mx_job_t *mx_deque_steal(mx_deque_t *deque)
+{
+    int64_t t = atomic_load_explicit(&deque->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    int64_t b = atomic_load_explicit(&deque->bottom, memory_order_acquire);
+
+    if (t >= b)
+        return NULL;
+
+    mx_deque_array_t *array = atomic_load_explicit(&deque->array, memory_order_acquire);
+    mx_job_t *job = atomic_load_explicit(&array->jobs[t & array->mask], memory_order_relaxed);
+
+    if (!atomic_compare_exchange_strong_explicit(&deque->top, &t, t + 1, memory_order_seq_cst, memory_order_relaxed))
+        return NULL;
+
+    return job;
+}
+
+static bool mx_deque_empty(mx_deque_t *deque)
+{
+    int64_t t = atomic_load_explicit(&deque->top, memory_order_relaxed);
+    int64_t b = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+
+    return t >= b;
+}
+
+/*
+ * Scheduling.
+ */
+
+static mx_threadpool_t *mx_threadpool_resolve(mx_threadpool_t *pool)
+{
+    return pool ? pool : mx_threadpool_default();
+}
+
+static mx_worker_t *mx_threadpool_self(mx_threadpool_t *pool)
+{
+    mx_worker_t *self = mx_current_worker;
+    return self && self->pool == pool ? self : NULL;
+}
+
+static void mx_job_execute(mx_job_t *job)
+{
+    /* The job may be gone once it ran, or once pending drops. */
+    atomic_size_t *pending = job->pending;
+
+    job->run(job);
+    atomic_fetch_sub_explicit(pending, 1, memory_order_release);
+}
+
+static void mx_threadpool_push(mx_threadpool_t *pool, mx_job_t *job)
+{
+    mx_worker_t *self = mx_threadpool_self(pool);
+
+    atomic_fetch_add_explicit(job->pending, 1, memory_order_relaxed);
+
+    if (self ? !mx_deque_push(&self->deque, job) : !mx_mpmc_push(&pool->injector, &job))
+    {
+        /* No room to queue it, run it here instead. */
+        mx_job_execute(job);
+        return;
+    }
+
+    /* Pairs with the fence of a worker going to sleep. */
+    atomic_thread_fence(memory_order_seq_cst);
+
+    if (atomic_load_explicit(&pool->sleeping, memory_order_relaxed) > 0)
+    {
+        mx_mutex_lock(&pool->mutex);
+        mx_cond_signal(&pool->wake);
+        mx_mutex_unlock(&pool->mutex);
+    }
+}
+
+static mx_job_t *mx_threadpool_find(mx_threadpool_t *pool, mx_worker_t *self)
+{
+    mx_job_t *job = NULL;
+
+    if (self && (job = mx_deque_take(&self->deque)))
+        return job;
+
+    if (mx_mpmc_pop(&pool->injector, &job))
+        return job;
+
+    /* Steal from the workers, starting at a random one. */
+    uint32_t x = mx_steal_seed ? mx_steal_seed : (uint32_t)(uintptr_t)&job | 1;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    mx_steal_seed = x;
+
+    for (unsigned i = 0; i < pool->nworkers; i++)
+    {
+        mx_worker_t *victim = &pool->workers[(x + i) % pool->nworkers];
+
+        if (victim != self && (job = mx_deque_steal(&victim->deque)))
+            return job;
+    }
+
+    return NULL;
+}
+
+static bool mx_threadpool_has_work(mx_threadpool_t *pool)
+{
+    if (mx_mpmc_count(&pool->injector) > 0)
+        return true;
+
+    for (unsigned i = 0; i < pool->nworkers; i++)
+    {
+        if (!mx_deque_empty(&pool->workers[i].deque))
+            return true;
+    }
+
+    return false;
+}
+
+/** Run queued jobs until pending drops to zero. */
+static void mx_threadpool_join(mx_threadpool_t *pool, atomic_size_t *pending)
+{
+    mx_worker_t *self = mx_threadpool_self(pool);
+
+    while (atomic_load_explicit(pending, memory_order_acquire) > 0)
+    {
+        mx_job_t *job = mx_threadpool_find(pool, self);
+
+        if (job)
+            mx_job_execute(job);
+        else
+            mx_thread_yield();
+    }
+}
+
+static void mx_worker_main(mx_worker_t *self)
+{
+    mx_threadpool_t *pool = self->pool;
+    unsigned idle = 0;
+
+    mx_current_worker = self;
+
+    while (!atomic_load_explicit(&pool->stop, memory_order_acquire))
+    {
+        mx_job_t *job = mx_threadpool_find(pool, self);
+
+        if (job)
+        {
+            mx_job_execute(job);
+            idle = 0;
+            continue;
+        }
+
+        if (++idle < MX_THREADPOOL_SPINS)
+        {
+            mx_thread_yield();
+            continue;
+        }
+
+        /* Announce the sleep before the last look, so a push either sees
+         * the sleeper or the sleeper sees the job. */
+        mx_mutex_lock(&pool->mutex);
+        atomic_fetch_add_explicit(&pool->sleeping, 1, memory_order_relaxed);
+        atomic_thread_fence(memory_order_seq_cst);
+
+        if (!atomic_load_explicit(&pool->stop, memory_order_relaxed) && !mx_threadpool_has_work(pool))
+            mx_cond_wait(&pool->wake, &pool->mutex);
+
+        atomic_fetch_sub_explicit(&pool->sleeping, 1, memory_order_relaxed);
+        mx_mutex_unlock(&pool->mutex);
+        idle = 0;
+    }
+
+    mx_current_worker = NULL;
+}
+
+/*
+ * Pool.
+ */
+
+/** Stop and join the first started workers, then free the pool. */
+static void mx_threadpool_release(mx_threadpool_t *pool, unsigned started)
+{
+    mx_mutex_lock(&pool->mutex);
+    atomic_store_explicit(&pool->stop, true, memory_order_release);
+    mx_cond_broadcast(&pool->wake);
+    mx_mutex_unlock(&pool->mutex);
+
+    for (unsigned i = 0; i < started; i++)
+        mx_thread_join(pool->workers[i].thread);
+
+    for (unsigned i = 0; i < pool->nworkers; i++)
+        mx_deque_destroy(&pool->workers[i].deque);
+
+    mx_mpmc_destroy(&pool->injector);
+    mx_cond_destroy(&pool->wake);
+    mx_mutex_destroy(&pool->mutex);
+    free(pool->memory);
+}
+
+MX_IMPL mx_threadpool_t *mx_threadpool_create(unsigned threads)
+{
+    if (threads == 0)
+        threads = mx_thread_concurrency();
+
+    /* Over allocate so the pool and workers start on a cache line. */
+    void *memory = malloc(sizeof(mx_threadpool_t) + threads * sizeof(mx_worker_t) + MX_CACHE_LINE);
+
+    if (!memory)
+        return NULL;
+
+    mx_threadpool_t *pool = (void*)(((uintptr_t)memory + MX_CACHE_LINE - 1) & ~(uintptr_t)(MX_CACHE_LINE - 1));
+    memset(pool, 0, sizeof(*pool));
+    pool->memory = memory;
+    pool->workers = (mx_worker_t*)(pool + 1);
+
+    if (!mx_mpmc_init(&pool->injector, MX_THREADPOOL_INJECTOR, sizeof(mx_job_t*)))
+    {
+        free(memory);
+        return NULL;
+    }
+
+    atomic_init(&pool->stop, false);
+    atomic_init(&pool->sleeping, 0);
+    mx_mutex_init(&pool->mutex);
+    mx_cond_init(&pool->wake);
+
+    /* Every deque exists before the first worker starts stealing. */
+    for (pool->nworkers = 0; pool->nworkers < threads; pool->nworkers++)
+    {
+        if (!mx_deque_init(&pool->workers[pool->nworkers].deque))
+        {
+            mx_threadpool_release(pool, 0);
+            return NULL;
+        }
+
+        pool->workers[pool->nworkers].pool = pool;
+    }
+
+    for (unsigned i = 0; i < threads; i++)
+    {
+        if (!mx_thread_create(&pool->workers[i].thread, (mx_thread_function)mx_worker_main, &pool->workers[i]))
+        {
+            mx_threadpool_release(pool, i);
+            return NULL;
+        }
+    }
+
+    return pool;
+}
+
+MX_IMPL void mx_threadpool_destroy(mx_threadpool_t *pool)
+{
+    if (pool)
+        mx_threadpool_release(pool, pool->nworkers);
+}
+
+MX_IMPL mx_threadpool_t *mx_threadpool_default(void)
+{
+    mx_threadpool_t *pool = atomic_load_explicit(&mx_default_pool, memory_order_acquire);
+
+    if (pool)
+        return pool;
+
+    mx_threadpool_t *created = mx_threadpool_create(0);
+
+    if (!created)
+        return NULL;
+
+    if (atomic_compare_exchange_strong(&mx_default_pool, &pool, created))
+        return created;
+
+    /* Another thread won the race. */
+    mx_threadpool_destroy(created);
+    return pool;
+}
+
+MX_IMPL unsigned mx_threadpool_threads(mx_threadpool_t *pool)
+{
+    pool = mx_threadpool_resolve(pool);
+    return pool ? pool->nworkers : 0;
+}
+
+/*
+ * Tasks.
+ */
+
+typedef struct mx_task_job_t {
+    mx_job_t job;
+    fatptr_t(ITask) task;
+} mx_task_job_t;
+
+static void mx_task_job_run(mx_job_t *job)
+{
+    fatptr_t(ITask) task = ((mx_task_job_t*)job)->task;
+
+    free(job);
+    ITask_run(task);
+}
+
+MX_IMPL bool mx_threadpool_submit(mx_threadpool_t *pool, mx_task_group_t *group, fatptr_t(ITask) task)
+{
+    MX_ASSERT_PTR(group, "Task group must be valid.");
+
+    pool = mx_threadpool_resolve(pool);
+    mx_task_job_t *job = pool ? malloc(sizeof(mx_task_job_t)) : NULL;
+
+    if (!job)
+    {
+        ITask_run(task);
+        return false;
+    }
+
+    job->job.run = mx_task_job_run;
+    job->job.pending = &group->pending;
+    job->task = task;
+    mx_threadpool_push(pool, &job->job);
+    return true;
+}
+
+MX_IMPL void mx_threadpool_wait(mx_threadpool_t *pool, mx_task_group_t *group)
+{
+    MX_ASSERT_PTR(group, "Task group must be valid.");
+
+    pool = mx_threadpool_resolve(pool);
+
+    if (pool)
+        mx_threadpool_join(pool, &group->pending);
+}
+
+static size_t mx_parallel_grain(mx_threadpool_t *pool, size_t count, size_t grain)
+{
+    if (grain == 0)
+        grain = count / ((size_t)pool->nworkers * MX_THREADPOOL_SPLIT);
+
+    return grain ? grain : 1;
+}
+
+/*
+ * Parallel for. The range is halved; the right half is queued for thieves and
+ * the left half is split further on this thread, then the right is joined.
+ */
+
+typedef struct mx_for_t {
+    mx_threadpool_t *pool;
+    size_t grain;
+    mx_parallel_for_function function;
+    void *arg;
+} mx_for_t;
+
+typedef struct mx_for_job_t {
+    mx_job_t job;
+    const mx_for_t *ctx;
+    size_t begin;
+    size_t end;
+} mx_for_job_t;
+
+static void mx_for_split(const mx_for_t *ctx, size_t begin, size_t end);
+
+static void mx_for_job_run(mx_job_t *job)
+{
+    mx_for_job_t *range = (mx_for_job_t*)job;
+    mx_for_split(range->ctx, range->begin, range->end);
+}
+
+static void mx_for_split(const mx_for_t *ctx, size_t begin, size_t end)
+{
+    if (end - begin <= ctx->grain)
+    {
+        ctx->function(ctx->arg, begin, end);
+        return;
+    }
+
+    size_t mid = begin + (end - begin) / 2;
+    atomic_size_t pending;
+    atomic_init(&pending, 0);
+
+    mx_for_job_t right = { { mx_for_job_run, &pending }, ctx, mid, end };
+    mx_threadpool_push(ctx->pool, &right.job);
+    mx_for_split(ctx, begin, mid);
+    mx_threadpool_join(ctx->pool, &pending);
+}
+
+MX_IMPL void mx_parallel_for(mx_threadpool_t *pool, size_t begin, size_t end, size_t grain,
+                             mx_parallel_for_function function, void *arg)
+{
+    MX_ASSERT_PTR(function, "Function must be valid.");
+
+    if (begin >= end)
+        return;
+
+    pool = mx_threadpool_resolve(pool);
+
+    if (!pool)
+    {
+        function(arg, begin, end);
+        return;
+    }
+
+    mx_for_t ctx = { pool, mx_parallel_grain(pool, end - begin, grain), function, arg };
+    mx_for_split(&ctx, begin, end);
+}
+
+/*
+ * Parallel reduce. Like the parallel for, but the right half reduces into a
+ * partial result of its own, which is combined into the left after the join.
+ */
+
+typedef struct mx_reduce_t {
+    mx_threadpool_t *pool;
+    size_t grain;
+    size_t size;
+    const void *identity;
+    mx_reduce_function reduce;
+    mx_combine_function combine;
+    void *arg;
+} mx_reduce_t;
+
+typedef struct mx_reduce_job_t {
+    mx_job_t job;
+    const mx_reduce_t *ctx;
+    size_t begin;
+    size_t end;
+    void *result;
+} mx_reduce_job_t;
+
+static void mx_reduce_split(const mx_reduce_t *ctx, size_t begin, size_t end, void *result);
+
+static void mx_reduce_job_run(mx_job_t *job)
+{
+    mx_reduce_job_t *range = (mx_reduce_job_t*)job;
+    mx_reduce_split(range->ctx, range->begin, range->end, range->result);
+}
+
+static void mx_reduce_split(const mx_reduce_t *ctx, size_t begin, size_t end, void *result)
+{
+    _Alignas(max_align_t) unsigned char local[MX_REDUCE_INLINE];
+    void *other = NULL;
+
+    if (end - begin > ctx->grain)
+        other = ctx->size <= sizeof(local) ? local : malloc(ctx->size);
+
+    if (!other)
+    {
+        ctx->reduce(ctx->arg, begin, end, result);
+        return;
+    }
+
+    size_t mid = begin + (end - begin) / 2;
+    atomic_size_t pending;
+    atomic_init(&pending, 0);
+    memcpy(other, ctx->identity, ctx->size);
+
+    mx_reduce_job_t right = { { mx_reduce_job_run, &pending }, ctx, mid, end, other };
+    mx_threadpool_push(ctx->pool, &right.job);
+    mx_reduce_split(ctx, begin, mid, result);
+    mx_threadpool_join(ctx->pool, &pending);
+    ctx->combine(ctx->arg, result, other);
+
+    if (other != local)
+        free(other);
+}
+
+MX_IMPL void mx_parallel_reduce(mx_threadpool_t *pool, size_t begin, size_t end, size_t grain,
+                                void *result, size_t size, const void *identity,
+                                mx_reduce_function reduce, mx_combine_function combine, void *arg)
+{
+    MX_ASSERT_PTR(result, "Result must be valid.");
+    MX_ASSERT_PTR(identity, "Identity must be valid.");
+    MX_ASSERT_PTR(reduce, "Reduce function must be valid.");
+    MX_ASSERT_PTR(combine, "Combine function must be valid.");
+
+    memcpy(result, identity, size);
+
+    if (begin >= end)
+        return;
+
+    pool = mx_threadpool_resolve(pool);
+
+    if (!pool)
+    {
+        reduce(arg, begin, end, result);
+        return;
+    }
+
+    mx_reduce_t ctx = { pool, mx_parallel_grain(pool, end - begin, grain), size, identity, reduce, combine, arg };
+    mx_reduce_split(&ctx, begin, end, result);
+}
@@ -0,0 +1,230 @@
+#include <mx/digest.h>
+#include <string.h>
+
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#endif
+
+/*
+ * wyhash, final version 4 (Wang Yi, public domain). Input is mixed by 64x64
+ * to 128 bit multiplications, 48 bytes per step in three independent chains.
+ */
+
+static const uint64_t WYHASH_SECRET[4] = {
+    0x2d358dccaa6c78a5ull, 0x8bb84b93962eacc9ull, 0x4b33a62ed433d4a3ull, 0x4d5a2da51de1aa47ull,
+};
+
+/** Full 128 bit product of a and b, low half in a, high half in b. */
+MX_INLINE void mx_wymum(uint64_t *a, uint64_t *b)
+{
+#if defined(__SIZEOF_INT128__)
+    __uint128_t r = (__uint128_t)*a * *b;
+    *a = (uint64_t)r;
+    *b = (uint64_t)(r >> 64);
+#elif defined(_MSC_VER) && defined(_M_X64)
+    *a = _umul128(*a, *b, b);
+#else
+    uint64_t ha = *a >> 32, hb = *b >> 32, la = (uint32_t)*a, lb = (uint32_t)*b;
+    uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+    uint64_t t = rl + (rm0 << 32), c = t < rl;
+    uint64_t lo = t + (rm1 << 32);
+    c += lo < t;
+    *a = lo;
+    *b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+}
+
+MX_INLINE uint64_t mx_wymix(uint64_t a, uint64_t b)
+{
+    mx_wymum(&a, &b);
+    return a ^ b;
+}
+
+MX_INLINE uint64_t mx_wyr8(const unsigned char *p)
+{
+    uint64_t v;
+    memcpy(&v, p, 8);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    v = __builtin_bswap64(v);
+#endif
+    return v;
+}
+
+MX_INLINE uint64_t mx_wyr4(const unsigned char *p)
+{
+    uint32_t v;
+    memcpy(&v, p, 4);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    v = __builtin_bswap32(v);
+#endif
+    return v;
+}
+
+MX_INLINE uint64_t mx_wyr3(const unsigned char *p, size_t k)
+{
+    return ((uint64_t)p[0] << 16) | ((uint64_t)p[k >> 1] << 8) | p[k - 1];
+}
+
+/** Hash of up to 16 bytes. */
+MX_INLINE uint64_t mx_wyhash_short(const unsigned char *p, size_t length, uint64_t seed)
+{
+    uint64_t a, b;
+
+    if (length >= 4)
+    {
+        a = (mx_wyr4(p) << 32) | mx_wyr4(p + ((length >> 3) << 2));
+        b = (mx_wyr4(p + length - 4) << 32) | mx_wyr4(p + length - 4 - ((length >> 3) << 2));
+    }
+    else if (length > 0)
+    {
+        a = mx_wyr3(p, length);
+        b = 0;
+    }
+    else
+    {
+        a = b = 0;
+    }
+
+    a ^= WYHASH_SECRET[1];
+    b ^= seed;
+    mx_wymum(&a, &b);
+    return mx_wymix(a ^ WYHASH_SECRET[0] ^ length, b ^ WYHASH_SECRET[1]);
+}
+
+/**
+ * Finish a hash of more than 16 bytes. p points to the last i bytes of the
+ * input, with at least 16 bytes readable before p + i.
+ */
+MX_INLINE uint64_t mx_wyhash_tail(const unsigned char *p, size_t i, size_t length, uint64_t seed)
+{
+    while (i > 16)
+    {
+        seed = mx_wymix(mx_wyr8(p) ^ WYHASH_SECRET[1], mx_wyr8(p + 8) ^ seed);
+        i -= 16;
+        p += 16;
+    }
+
+    uint64_t a = mx_wyr8(p + i - 16) ^ WYHASH_SECRET[1];
+    uint64_t b = mx_wyr8(p + i - 8) ^ seed;
+    mx_wymum(&a, &b);
+    return mx_wymix(a ^ WYHASH_SECRET[0] ^ length, b ^ WYHASH_SECRET[1]);
+}
+
+/** Consume 48 byte blocks into the three chains. */
+MX_INLINE void mx_wyhash_blocks(uint64_t chain[3], const unsigned char *p, size_t blocks)
+{
+    uint64_t seed = chain[0], see1 = chain[1], see2 = chain[2];
+
+    for (; blocks > 0; blocks--, p += 48)
+    {
+        seed = mx_wymix(mx_wyr8(p)      ^ WYHASH_SECRET[1], mx_wyr8(p + 8)  ^ seed);
+        see1 = mx_wymix(mx_wyr8(p + 16) ^ WYHASH_SECRET[2], mx_wyr8(p + 24) ^ see1);
+        see2 = mx_wymix(mx_wyr8(p + 32) ^ WYHASH_SECRET[3], mx_wyr8(p + 40) ^ see2);
+    }
+
+    chain[0] = seed;
+    chain[1] = see1;
+    chain[2] = see2;
+}
+
+MX_INLINE uint64_t mx_wyhash_seed(uint64_t seed)
+{
+    return seed ^ mx_wymix(seed ^ WYHASH_SECRET[0], WYHASH_SECRET[1]);
+}
+
+MX_IMPL void mx_wyhash64_seeded(wyhash64_t *digest, const char *src, size_t length, uint64_t seed)
+{
+    const unsigned char *p = (const unsigned char*)src;
+    seed = mx_wyhash_seed(seed);
+
+    if (length <= 16)
+    {
+        *digest = mx_wyhash_short(p, length, seed);
+        return;
+    }
+
+    size_t i = length;
+
+    if (i >= 48)
+    {
+        uint64_t chain[3] = { seed, seed, seed };
+        mx_wyhash_blocks(chain, p, i / 48);
+        p += i / 48 * 48;
+        i %= 48;
+        seed = chain[0] ^ chain[1] ^ chain[2];
+    }
+
+    *digest = mx_wyhash_tail(p, i, length, seed);
+}
+
+MX_IMPL void mx_wyhash64(wyhash64_t *digest, const char *src, size_t length)
+{
+    mx_wyhash64_seeded(digest, src, length, 0);
+}
+
+/*
+ * The streaming state keeps up to 48 pending bytes after 16 bytes of history,
+ * the end of the last block consumed, which the final step may read back.
+ */
+
+MX_IMPL void mx_wyhash64_init_seeded(mx_wyhash64_ctx_t *ctx, uint64_t seed)
+{
+    seed = mx_wyhash_seed(seed);
+    ctx->chain[0] = ctx->chain[1] = ctx->chain[2] = seed;
+    ctx->length = 0;
+}
+
+MX_IMPL void mx_wyhash64_init(mx_wyhash64_ctx_t *ctx)
+{
+    mx_wyhash64_init_seeded(ctx, 0);
+}
+
+MX_IMPL void mx_wyhash64_update(mx_wyhash64_ctx_t *ctx, const char *src, size_t length)
+{
+    const unsigned char *p = (const unsigned char*)src;
+    size_t used = ctx->length % 48;
+
+    ctx->length += length;
+
+    if (used > 0)
+    {
+        size_t n = 48 - used < length ? 48 - used : length;
+        memcpy(ctx->buffer + 16 + used, p, n);
+        p += n;
+        length -= n;
+
+        if (used + n < 48)
+            return;
+
+        mx_wyhash_blocks(ctx->chain, ctx->buffer + 16, 1);
+        memcpy(ctx->buffer, ctx->buffer + 48, 16);
+    }
+
+    if (length >= 48)
+    {
+        size_t blocks = length / 48;
+        mx_wyhash_blocks(ctx->chain, p, blocks);
+        p += blocks * 48;
+        length -= blocks * 48;
+        memcpy(ctx->buffer, p - 16, 16);
+    }
+
+    memcpy(ctx->buffer + 16, p, length);
+}
+
+MX_IMPL void mx_wyhash64_final(mx_wyhash64_ctx_t *ctx, wyhash64_t *digest)
+{
+    const unsigned char *pending = ctx->buffer + 16;
+    uint64_t seed = ctx->chain[0];
+
+    if (ctx->length <= 16)
+    {
+        *digest = mx_wyhash_short(pending, ctx->length, seed);
+        return;
+    }
+
+    if (ctx->length >= 48)
+        seed ^= ctx->chain[1] ^ ctx->chain[2];
+
+    *digest = mx_wyhash_tail(pending, ctx->length % 48, ctx->length, seed);
+}